@@ -13,6 +13,9 @@
 #include "Graphics/Targa.h"
 #include "Miscellaneous/Fileio.h"
 #include "Models/ModelStatic.h"
+#include "Physics/PhysicsWorld.h"
+#include "Physics/Shapes/ShapeMesh.h"
+#include "Miscellaneous/Time.h"
 #include <math.h>
 #include <algorithm>
 #include <stdlib.h>
@@ -246,3 +249,109 @@ DrawMap
 void DrawMap( VkCommandBuffer cmdBuffer ) {
 	g_quakeModel.DrawIndexed( cmdBuffer );
 }
+
+/*
+================================
+RandomUnit
+================================
+*/
+static float RandomUnit() {
+	return ( rand() / (float)RAND_MAX ) * 2.0f - 1.0f;
+}
+
+/*
+================================
+TimeMapRayCasts
+
+Returns the rays per second of the single ray path and the batched packet path
+================================
+*/
+static void TimeMapRayCasts( PhysicsWorld * world, const std::vector< rayCastQuery_t > & queries, float & singleRate, float & packetRate, int & numMismatches ) {
+	const int num = (int)queries.size();
+	std::vector< queryHit_t > singleHits( num );
+	std::vector< queryHit_t > packetHits( num );
+
+	const int startSingle = GetTimeMicroseconds();
+	for ( int i = 0; i < num; i++ ) {
+		world->RayCast( queries[ i ], singleHits[ i ] );
+	}
+	const int startPacket = GetTimeMicroseconds();
+	world->RayCastBatch( queries.data(), packetHits.data(), num );
+	const int end = GetTimeMicroseconds();
+
+	singleRate = num * 1000000.0f / (float)std::max( startPacket - startSingle, 1 );
+	packetRate = num * 1000000.0f / (float)std::max( end - startPacket, 1 );
+
+	numMismatches = 0;
+	for ( int i = 0; i < num; i++ ) {
+		if ( singleHits[ i ].bodyId != packetHits[ i ].bodyId || fabsf( singleHits[ i ].fraction - packetHits[ i ].fraction ) > 0.0001f ) {
+			numMismatches++;
+		}
+	}
+}
+
+/*
+================================
+BenchmarkMapRayCasts
+
+Casts rays through the loaded map's triangles, once as single rays and once as
+packets of four.  The coherent set fans four rays out from each origin, the
+random set points every ray somewhere else.
+================================
+*/
+void BenchmarkMapRayCasts() {
+	if ( g_quakeIndices.empty() ) {
+		printf( "WARNING: BenchmarkMapRayCasts: no map loaded\n" );
+		return;
+	}
+
+	std::vector< Vec3 > verts( g_quakeVerts.size() );
+	Bounds bounds;
+	for ( int i = 0; i < g_quakeVerts.size(); i++ ) {
+		verts[ i ] = g_quakeVerts[ i ].pos;
+		bounds.Expand( verts[ i ] );
+	}
+	ShapeMesh * mesh = new ShapeMesh( verts.data(), (int)verts.size(), g_quakeIndices.data(), (int)g_quakeIndices.size() );
+
+	// The world is too big for the stack
+	PhysicsWorld * world = new PhysicsWorld;
+	Body body;
+	body.m_position = Vec3( 0, 0, 0 );
+	body.m_orientation = Quat( 0, 0, 0, 1 );
+	body.m_shape = mesh;
+	body.m_invMass = 0.0f;
+	world->AllocateBody( body );
+
+	const int numRays = 1 << 16;
+	const Vec3 center = bounds.Center();
+	const Vec3 extents = ( bounds.maxs - bounds.mins ) * 0.4f;
+	const float length = ( bounds.maxs - bounds.mins ).GetMagnitude();
+
+	for ( int set = 0; set < 2; set++ ) {
+		const bool coherent = ( 0 == set );
+
+		srand( 1 );
+		std::vector< rayCastQuery_t > queries( numRays );
+		for ( int i = 0; i < numRays; i += 4 ) {
+			const Vec3 origin = center + Vec3( RandomUnit() * extents.x, RandomUnit() * extents.y, RandomUnit() * extents.z );
+			Vec3 aim = Vec3( RandomUnit(), RandomUnit(), RandomUnit() );
+			for ( int lane = 0; lane < 4; lane++ ) {
+				Vec3 dir = coherent ? aim + Vec3( RandomUnit(), RandomUnit(), RandomUnit() ) * 0.05f : Vec3( RandomUnit(), RandomUnit(), RandomUnit() );
+				dir.Normalize();
+				queries[ i + lane ].start = origin;
+				queries[ i + lane ].end = origin + dir * length;
+			}
+		}
+
+		float singleRate;
+		float packetRate;
+		int numMismatches;
+		TimeMapRayCasts( world, queries, singleRate, packetRate, numMismatches );
+		printf( "BenchmarkMapRayCasts: %s rays: single %.0f rays/sec, packets %.0f rays/sec, %.2fx, %i mismatches\n",
+			coherent ? "coherent" : "random", singleRate, packetRate, packetRate / singleRate, numMismatches
+		);
+	}
+
+	delete world;
+	delete mesh;
+}
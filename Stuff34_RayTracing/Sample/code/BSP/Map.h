@@ -11,5 +11,6 @@
 
 bool LoadMap( DeviceContext * device );
 void DrawMap( VkCommandBuffer cmdBuffer );
+void BenchmarkMapRayCasts();	// prints single vs packet ray cast throughput against the loaded map
 
 extern std::vector< brush_t > g_brushes;
@@ -0,0 +1,636 @@
+//
+//  BenchmarkScenes.cpp
+//
+#include "Benchmark/BenchmarkScenes.h"
+#include <stdio.h>
+
+/*
+========================================================================================================
+
+BenchmarkScene
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkScene::~BenchmarkScene
+====================================================
+*/
+BenchmarkScene::~BenchmarkScene() {
+	for ( int i = 0; i < m_constraints.size(); i++ ) {
+		delete m_constraints[ i ];
+	}
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		delete m_articulations[ i ];
+	}
+	for ( int i = 0; i < m_shapes.size(); i++ ) {
+		delete m_shapes[ i ];
+	}
+	m_constraints.clear();
+	m_articulations.clear();
+	m_shapes.clear();
+}
+
+/*
+====================================================
+BenchmarkScene::GetNumConstraints
+====================================================
+*/
+int BenchmarkScene::GetNumConstraints() const {
+	int num = (int)m_constraints.size();
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		num += m_articulations[ i ]->GetNumLinks();
+	}
+	return num;
+}
+
+/*
+====================================================
+BenchmarkScene::AddGround
+====================================================
+*/
+void BenchmarkScene::AddGround() {
+	Shape * shape = new ShapeBox( g_boxGround, 8 );
+	m_shapes.push_back( shape );
+
+	Body body;
+	body.m_shape = shape;
+	body.m_position = Vec3( 0, 0, 0 );
+	body.m_invMass = 0.0f;
+	body.m_friction = 0.5f;
+	body.m_enableGravity = false;
+	m_world->AllocateBody( body );
+}
+
+/*
+====================================================
+BenchmarkScene::AddBody
+====================================================
+*/
+bodyID_t BenchmarkScene::AddBody( Shape * shape, const Vec3 & pos, const float invMass ) {
+	Body body;
+	body.m_shape = shape;
+	body.m_position = pos;
+	body.m_invMass = invMass;
+	body.m_elasticity = 0.0f;
+	body.m_friction = 0.5f;
+	body.m_enableGravity = ( invMass > 0.0f );
+	return m_world->AllocateBody( body );
+}
+
+/*
+====================================================
+BenchmarkScene::RandomFloat
+
+A tiny lcg, so the scenes don't depend on the state of any other random number generator
+====================================================
+*/
+float BenchmarkScene::RandomFloat( const float min, const float max ) {
+	m_seed = m_seed * 1664525 + 1013904223;
+	const float t = (float)( m_seed >> 8 ) / (float)( 1 << 24 );
+	return min + ( max - min ) * t;
+}
+
+/*
+========================================================================================================
+
+BenchmarkScenePyramid
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkScenePyramid::Build
+====================================================
+*/
+void BenchmarkScenePyramid::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * box = new ShapeBox( g_boxUnit, 8 );
+	m_shapes.push_back( box );
+
+	// Each layer is one box narrower in both directions, 385 boxes in all
+	const int baseSize = 10;
+	for ( int z = 0; z < baseSize; z++ ) {
+		const int layerSize = baseSize - z;
+		for ( int y = 0; y < layerSize; y++ ) {
+			for ( int x = 0; x < layerSize; x++ ) {
+				Vec3 pos;
+				pos.x = ( (float)x - 0.5f * (float)( layerSize - 1 ) ) * 2.0f;
+				pos.y = ( (float)y - 0.5f * (float)( layerSize - 1 ) ) * 2.0f;
+				pos.z = 1.0f + 2.0f * (float)z;
+				AddBody( box, pos, 1.0f );
+			}
+		}
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneConvexPile
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneConvexPile::Build
+====================================================
+*/
+void BenchmarkSceneConvexPile::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	// A handful of random hulls are shared by all the bodies, building hulls isn't what's being measured
+	const int numHulls = 8;
+	const int numHullPts = 16;
+	Shape * hulls[ numHulls ];
+	for ( int i = 0; i < numHulls; i++ ) {
+		Vec3 pts[ numHullPts ];
+		for ( int j = 0; j < numHullPts; j++ ) {
+			pts[ j ] = Vec3( RandomFloat( -0.5f, 0.5f ), RandomFloat( -0.5f, 0.5f ), RandomFloat( -0.5f, 0.5f ) );
+		}
+		hulls[ i ] = new ShapeConvex( pts, numHullPts );
+		m_shapes.push_back( hulls[ i ] );
+	}
+
+	int numBodies = 5000;
+	const int maxBodies = world->MaxBodies() - 1;	// the ground takes a slot
+	if ( numBodies > maxBodies ) {
+		fprintf( stderr, "WARNING: BenchmarkSceneConvexPile: %i hulls requested, the world only holds %i\n", numBodies, maxBodies );
+		numBodies = maxBodies;
+	}
+
+	const int numPerSide = 12;
+	const float spacing = 1.25f;
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % numPerSide;
+		const int y = ( i / numPerSide ) % numPerSide;
+		const int z = i / ( numPerSide * numPerSide );
+
+		Vec3 pos;
+		pos.x = ( (float)x - 0.5f * (float)( numPerSide - 1 ) ) * spacing + RandomFloat( -0.1f, 0.1f );
+		pos.y = ( (float)y - 0.5f * (float)( numPerSide - 1 ) ) * spacing + RandomFloat( -0.1f, 0.1f );
+		pos.z = 1.0f + (float)z * spacing;
+
+		bodyID_t bodyid = AddBody( hulls[ i % numHulls ], pos, 1.0f );
+		Vec3 axis = Vec3( RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), 1.0f );
+		axis.Normalize();
+		bodyid.body->m_orientation = Quat( axis, RandomFloat( 0.0f, 3.14f ) );
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneOpenWorld
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneOpenWorld::Build
+====================================================
+*/
+void BenchmarkSceneOpenWorld::Build( PhysicsWorld * world ) {
+	m_world = world;
+
+	// The ground box is 100 x 50, so this tiles a 400 x 400 floor
+	Shape * ground = new ShapeBox( g_boxGround, 8 );
+	m_shapes.push_back( ground );
+
+	const int numTilesX = 4;
+	const int numTilesY = 8;
+	for ( int y = 0; y < numTilesY; y++ ) {
+		for ( int x = 0; x < numTilesX; x++ ) {
+			const Vec3 pos = Vec3( ( (float)x - 0.5f * (float)( numTilesX - 1 ) ) * 100.0f, ( (float)y - 0.5f * (float)( numTilesY - 1 ) ) * 50.0f, 0.0f );
+			AddBody( ground, pos, 0.0f );
+		}
+	}
+
+	Shape * shapes[ 2 ];
+	shapes[ 0 ] = new ShapeBox( g_boxSmall, 8 );
+	shapes[ 1 ] = new ShapeSphere( 0.25f );
+	m_shapes.push_back( shapes[ 0 ] );
+	m_shapes.push_back( shapes[ 1 ] );
+
+	// Clusters of bodies, so there's something to collide but most of the world is empty
+	const int numPerCluster = 8;
+	const int numClusters = ( world->MaxBodies() - numTilesX * numTilesY ) / numPerCluster;
+	for ( int i = 0; i < numClusters; i++ ) {
+		const Vec3 center = Vec3( RandomFloat( -190.0f, 190.0f ), RandomFloat( -190.0f, 190.0f ), 0.0f );
+		const Vec3 velocity = Vec3( RandomFloat( -4.0f, 4.0f ), RandomFloat( -4.0f, 4.0f ), 0.0f );
+
+		for ( int j = 0; j < numPerCluster; j++ ) {
+			const Vec3 offset = Vec3( RandomFloat( -1.5f, 1.5f ), RandomFloat( -1.5f, 1.5f ), 0.5f + (float)j * 0.6f );
+			bodyID_t bodyId = AddBody( shapes[ j & 1 ], center + offset, 1.0f );
+			bodyId.body->m_linearVelocity = velocity;
+		}
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneHingeChain
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneHingeChain::Build
+
+Chains start out horizontal and swing down from a static anchor
+====================================================
+*/
+void BenchmarkSceneHingeChain::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * link = new ShapeBox( g_boxSmall, 8 );
+	m_shapes.push_back( link );
+
+	const int numChains = 16;
+	const int numLinks = 24;
+	const float spacing = 0.6f;
+	const float height = 18.0f;
+	const Vec3 hingeAxis = Vec3( 0, 1, 0 );
+
+	for ( int chain = 0; chain < numChains; chain++ ) {
+		const Vec3 anchorPos = Vec3( -0.5f * spacing * (float)numLinks, ( (float)chain - 0.5f * (float)( numChains - 1 ) ) * 1.5f, height );
+		Body * prev = AddBody( link, anchorPos, 0.0f ).body;
+
+		for ( int i = 1; i <= numLinks; i++ ) {
+			Body * body = AddBody( link, anchorPos + Vec3( spacing * (float)i, 0, 0 ), 1.0f ).body;
+
+			const Vec3 jointPos = ( prev->m_position + body->m_position ) * 0.5f;
+
+			ConstraintHingeQuat * joint = new ConstraintHingeQuat();
+			joint->m_bodyA = prev;
+			joint->m_bodyB = body;
+			joint->m_anchorA = prev->WorldSpaceToBodySpace( jointPos );
+			joint->m_anchorB = body->WorldSpaceToBodySpace( jointPos );
+			joint->m_axisA = prev->m_orientation.Inverse().RotatePoint( hingeAxis );
+			joint->m_axisB = body->m_orientation.Inverse().RotatePoint( hingeAxis );
+			joint->q0 = prev->m_orientation.Inverse() * body->m_orientation;
+			m_world->RegisterConstraint( joint );
+			m_constraints.push_back( joint );
+
+			prev = body;
+		}
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneArticulatedChain
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneArticulatedChain::Build
+
+The same layout as the hinge chains, the first link is hinged to the world next to the static anchor
+====================================================
+*/
+void BenchmarkSceneArticulatedChain::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * link = new ShapeBox( g_boxSmall, 8 );
+	m_shapes.push_back( link );
+
+	const int numChains = 16;
+	const int numLinks = 24;
+	const float spacing = 0.6f;
+	const float height = 18.0f;
+	const Vec3 hingeAxis = Vec3( 0, 1, 0 );
+
+	for ( int chain = 0; chain < numChains; chain++ ) {
+		const Vec3 anchorPos = Vec3( -0.5f * spacing * (float)numLinks, ( (float)chain - 0.5f * (float)( numChains - 1 ) ) * 1.5f, height );
+		AddBody( link, anchorPos, 0.0f );
+
+		Articulation * articulation = new Articulation( m_world );
+		m_articulations.push_back( articulation );
+
+		int parent = -1;
+		for ( int i = 1; i <= numLinks; i++ ) {
+			Body body;
+			body.m_shape = link;
+			body.m_position = anchorPos + Vec3( spacing * (float)i, 0, 0 );
+			body.m_invMass = 1.0f;
+			body.m_friction = 0.5f;
+
+			const Vec3 jointPos = body.m_position - Vec3( 0.5f * spacing, 0, 0 );
+			parent = articulation->AddLink( parent, body, AJ_REVOLUTE, jointPos, hingeAxis );
+		}
+		m_world->RegisterArticulation( articulation );
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneRagdolls
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneRagdolls::AddRagdoll
+
+Ten links in a t-pose, floating from the torso.  The shapes are the torso, head and limb.
+====================================================
+*/
+void BenchmarkSceneRagdolls::AddRagdoll( Shape ** shapes, const Vec3 & pos, const Vec3 & angularVelocity ) {
+	Articulation * articulation = new Articulation( m_world );
+	m_articulations.push_back( articulation );
+
+	Body body;
+	body.m_invMass = 1.0f;
+	body.m_friction = 0.5f;
+
+	// Torso
+	body.m_shape = shapes[ 0 ];
+	body.m_position = pos;
+	body.m_angularVelocity = angularVelocity;
+	const int torso = articulation->AddLink( -1, body, AJ_FLOATING, pos, Vec3( 0, 0, 1 ) );
+	body.m_angularVelocity.Zero();
+
+	// Head
+	body.m_shape = shapes[ 1 ];
+	body.m_position = pos + Vec3( 0, 0, 1.3f );
+	const int head = articulation->AddLink( torso, body, AJ_SPHERICAL, pos + Vec3( 0, 0, 1.0f ), Vec3( 0, 0, 1 ) );
+	articulation->SetLimits( head, 0.0f, 0.5f );
+
+	const Quat armOrientation = Quat( Vec3( 0, 0, 1 ), 3.14159f * 0.5f );
+	const Quat legOrientation = Quat( Vec3( 0, 1, 0 ), 3.14159f * 0.5f );
+	for ( int side = -1; side <= 1; side += 2 ) {
+		const float y = (float)side;
+
+		// Arms are out to the sides
+		body.m_shape = shapes[ 2 ];
+		body.m_orientation = armOrientation;
+		body.m_position = pos + Vec3( 0, 1.55f * y, 0.75f );
+		const int upperArm = articulation->AddLink( torso, body, AJ_SPHERICAL, pos + Vec3( 0, 0.5f * y, 0.75f ), Vec3( 0, y, 0 ) );
+		articulation->SetLimits( upperArm, 0.0f, 1.2f );
+
+		body.m_position = pos + Vec3( 0, 3.6f * y, 0.75f );
+		const int lowerArm = articulation->AddLink( upperArm, body, AJ_REVOLUTE, pos + Vec3( 0, 2.575f * y, 0.75f ), Vec3( 0, 0, y ) );
+		articulation->SetLimits( lowerArm, 0.0f, 2.5f );
+
+		// Legs hang down
+		body.m_orientation = legOrientation;
+		body.m_position = pos + Vec3( 0, 0.25f * y, -2.05f );
+		const int thigh = articulation->AddLink( torso, body, AJ_SPHERICAL, pos + Vec3( 0, 0.25f * y, -1.0f ), Vec3( 0, 0, -1 ) );
+		articulation->SetLimits( thigh, 0.0f, 0.8f );
+
+		body.m_position = pos + Vec3( 0, 0.25f * y, -4.1f );
+		const int shin = articulation->AddLink( thigh, body, AJ_REVOLUTE, pos + Vec3( 0, 0.25f * y, -3.075f ), Vec3( 0, 1, 0 ) );
+		articulation->SetLimits( shin, 0.0f, 2.5f );
+
+		body.m_orientation = Quat( 0, 0, 0, 1 );
+	}
+
+	for ( int i = 1; i < articulation->GetNumLinks(); i++ ) {
+		articulation->SetDamping( i, 0.1f );
+	}
+	m_world->RegisterArticulation( articulation );
+}
+
+/*
+====================================================
+BenchmarkSceneRagdolls::Build
+====================================================
+*/
+void BenchmarkSceneRagdolls::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * shapes[ 3 ];
+	shapes[ 0 ] = new ShapeBox( g_boxBody, 8 );
+	shapes[ 1 ] = new ShapeBox( g_boxHead, 8 );
+	shapes[ 2 ] = new ShapeBox( g_boxLimb, 8 );
+	for ( int i = 0; i < 3; i++ ) {
+		m_shapes.push_back( shapes[ i ] );
+	}
+
+	const int numPerSide = 4;
+	const float spacing = 10.0f;
+	for ( int y = 0; y < numPerSide; y++ ) {
+		for ( int x = 0; x < numPerSide; x++ ) {
+			const Vec3 pos = Vec3( ( (float)x - 0.5f * (float)( numPerSide - 1 ) ) * spacing, ( (float)y - 0.5f * (float)( numPerSide - 1 ) ) * spacing, RandomFloat( 8.0f, 14.0f ) );
+			const Vec3 angularVelocity = Vec3( RandomFloat( -2.0f, 2.0f ), RandomFloat( -2.0f, 2.0f ), RandomFloat( -2.0f, 2.0f ) );
+			AddRagdoll( shapes, pos, angularVelocity );
+		}
+	}
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneBarrage
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneBarrage::Build
+====================================================
+*/
+void BenchmarkSceneBarrage::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * box = new ShapeBox( g_boxUnit, 8 );
+	Shape * sphere = new ShapeSphere( 0.2f );
+	m_shapes.push_back( box );
+	m_shapes.push_back( sphere );
+
+	// The wall
+	const int wallWidth = 16;
+	const int wallHeight = 8;
+	for ( int z = 0; z < wallHeight; z++ ) {
+		for ( int y = 0; y < wallWidth; y++ ) {
+			const float offset = ( z & 1 ) ? 1.0f : 0.0f;	// stagger the rows like bricks
+			const Vec3 pos = Vec3( 0, ( (float)y - 0.5f * (float)( wallWidth - 1 ) ) * 2.0f + offset, 1.0f + 2.0f * (float)z );
+			AddBody( box, pos, 1.0f );
+		}
+	}
+
+	// The projectiles start out spread along their flight path, so there's a steady stream of impacts
+	const int numProjectiles = 256;
+	for ( int i = 0; i < numProjectiles; i++ ) {
+		Body * body = AddBody( sphere, Vec3( 0, 0, 0 ), 10.0f ).body;
+		body->m_elasticity = 0.5f;
+		Launch( body );
+		body->m_position.x = RandomFloat( -60.0f, -5.0f );
+		m_projectiles.push_back( body );
+	}
+}
+
+/*
+====================================================
+BenchmarkSceneBarrage::Launch
+====================================================
+*/
+void BenchmarkSceneBarrage::Launch( Body * body ) {
+	body->m_position = Vec3( -60.0f, RandomFloat( -14.0f, 14.0f ), RandomFloat( 1.0f, 14.0f ) );
+	body->m_orientation = Quat( 0, 0, 0, 1 );
+	body->m_linearVelocity = Vec3( 120.0f, 0, 2.0f );	// 2m per step, ten times the radius
+	body->m_angularVelocity.Zero();
+}
+
+/*
+====================================================
+BenchmarkSceneBarrage::Update
+
+Relaunches a few of the oldest projectiles every frame
+====================================================
+*/
+void BenchmarkSceneBarrage::Update( const float dt_sec ) {
+	const int numPerFrame = 4;
+	for ( int i = 0; i < numPerFrame; i++ ) {
+		Launch( m_projectiles[ m_nextProjectile ] );
+		m_nextProjectile = ( m_nextProjectile + 1 ) % (int)m_projectiles.size();
+	}
+	m_world->MarkQueryTreeDirty();
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneCloth
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneCloth::Build
+
+Cloths pinned along one edge, draped over spheres that sit on the ground
+====================================================
+*/
+void BenchmarkSceneCloth::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	const float radius = 1.5f;
+	Shape * sphere = new ShapeSphere( radius );
+	m_shapes.push_back( sphere );
+
+	const float size = 5.0f;
+	const float spacing = size + 2.0f;
+	const float start = -0.5f * spacing * (float)m_numPerSide;
+	for ( int y = 0; y < m_numPerSide; y++ ) {
+		for ( int x = 0; x < m_numPerSide; x++ ) {
+			const Vec3 origin = Vec3( start + (float)x * spacing, start + (float)y * spacing, 7.0f );
+			Cloth * cloth = m_cloths.AddCloth( m_resolution, m_resolution, size, size, origin );
+			cloth->SetNumIterations( m_numIters );
+			if ( m_numSubsteps > 0 ) {
+				cloth->SetSolver( CS_XPBD );
+				cloth->SetNumSubsteps( m_numSubsteps );
+			}
+
+			const Vec3 pos = origin + Vec3( 0.5f * size, 0.5f * size, radius - origin.z );
+			AddBody( sphere, pos, 0.0f );
+		}
+	}
+}
+
+/*
+====================================================
+BenchmarkSceneCloth::Update
+====================================================
+*/
+void BenchmarkSceneCloth::Update( const float dt_sec ) {
+	m_cloths.Update( dt_sec, m_world );
+}
+
+/*
+========================================================================================================
+
+BenchmarkSceneParticles
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BenchmarkSceneParticles::Build
+====================================================
+*/
+void BenchmarkSceneParticles::Build( PhysicsWorld * world ) {
+	m_world = world;
+	AddGround();
+
+	Shape * box = new ShapeBox( g_boxUnit, 8 );
+	m_shapes.push_back( box );
+	for ( int i = 0; i < 16; i++ ) {
+		const Vec3 pos = Vec3( RandomFloat( -12.0f, 12.0f ), RandomFloat( -12.0f, 12.0f ), 1.0f );
+		AddBody( box, pos, 0.0f );
+	}
+
+	m_particles.Clear();
+
+	particleType_t debris;
+	debris.lifetime = 4.0f;
+	debris.restitution = 0.4f;
+	debris.spawnsDecals = true;
+	m_debrisType = m_particles.AddType( debris );
+
+	particleType_t spark;
+	spark.lifetime = 1.0f;
+	spark.restitution = 0.6f;
+	spark.friction = 0.05f;
+	spark.gravityScale = 0.5f;
+	m_sparkType = m_particles.AddType( spark );
+}
+
+/*
+====================================================
+BenchmarkSceneParticles::Update
+====================================================
+*/
+void BenchmarkSceneParticles::Update( const float dt_sec ) {
+	const int numPerFrame = 2000;
+	for ( int i = 0; i < numPerFrame; i++ ) {
+		const int type = ( i & 3 ) ? m_debrisType : m_sparkType;
+		const Vec3 pos = Vec3( RandomFloat( -10.0f, 10.0f ), RandomFloat( -10.0f, 10.0f ), 6.0f );
+		const Vec3 vel = Vec3( RandomFloat( -4.0f, 4.0f ), RandomFloat( -4.0f, 4.0f ), RandomFloat( 0.0f, 6.0f ) );
+		m_particles.Emit( type, pos, vel );
+	}
+
+	m_particles.Update( dt_sec, m_world );
+}
+
+/*
+====================================================
+CreateBenchmarkScenes
+====================================================
+*/
+void CreateBenchmarkScenes( std::vector< BenchmarkScene * > & scenes ) {
+	scenes.push_back( new BenchmarkScenePyramid );
+	scenes.push_back( new BenchmarkSceneConvexPile );
+	scenes.push_back( new BenchmarkSceneOpenWorld );
+	scenes.push_back( new BenchmarkSceneHingeChain );
+	scenes.push_back( new BenchmarkSceneArticulatedChain );
+	scenes.push_back( new BenchmarkSceneRagdolls );
+	scenes.push_back( new BenchmarkSceneBarrage );
+	scenes.push_back( new BenchmarkSceneCloth( "cloth", 6, 32, 4 ) );
+	scenes.push_back( new BenchmarkSceneCloth( "cloth_large", 1, 128, 16 ) );
+	scenes.push_back( new BenchmarkSceneCloth( "cloth_xpbd", 1, 128, 1, 8 ) );
+	scenes.push_back( new BenchmarkSceneParticles );
+}
@@ -0,0 +1,187 @@
+//
+//  BenchmarkScenes.h
+//
+#pragma once
+#include <vector>
+#include "Physics/PhysicsWorld.h"
+#include "Physics/Articulation.h"
+#include "Physics/ClothWorld.h"
+#include "Physics/ParticleSystem.h"
+
+/*
+====================================================
+BenchmarkScene
+
+A repeatable stress test for the physics.  Scenes build themselves into an empty world,
+and everything random is seeded so that every run simulates the same thing.
+====================================================
+*/
+class BenchmarkScene {
+public:
+	BenchmarkScene() : m_world( NULL ), m_seed( 1 ) {}
+	virtual ~BenchmarkScene();
+
+	virtual const char * GetName() const = 0;
+	virtual void Build( PhysicsWorld * world ) = 0;
+	virtual void Update( const float dt_sec ) {}	// work the scene does outside of the physics world each frame
+
+	int GetNumConstraints() const;	// articulation joints count as constraints
+
+protected:
+	void AddGround();
+	bodyID_t AddBody( Shape * shape, const Vec3 & pos, const float invMass );
+	float RandomFloat( const float min, const float max );
+
+	PhysicsWorld *				m_world;
+	std::vector< Shape * >		m_shapes;
+	std::vector< Constraint * >	m_constraints;
+	std::vector< Articulation * >	m_articulations;
+	unsigned int				m_seed;
+};
+
+/*
+====================================================
+BenchmarkScenePyramid
+====================================================
+*/
+class BenchmarkScenePyramid : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "pyramid"; }
+	void Build( PhysicsWorld * world ) override;
+};
+
+/*
+====================================================
+BenchmarkSceneConvexPile
+====================================================
+*/
+class BenchmarkSceneConvexPile : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "convex_pile"; }
+	void Build( PhysicsWorld * world ) override;
+};
+
+/*
+====================================================
+BenchmarkSceneOpenWorld
+
+Small bodies scattered and sliding over a big floor of ground tiles, the case the hash grid is for
+====================================================
+*/
+class BenchmarkSceneOpenWorld : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "open_world"; }
+	void Build( PhysicsWorld * world ) override;
+};
+
+/*
+====================================================
+BenchmarkSceneHingeChain
+====================================================
+*/
+class BenchmarkSceneHingeChain : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "hinge_chain"; }
+	void Build( PhysicsWorld * world ) override;
+};
+
+/*
+====================================================
+BenchmarkSceneArticulatedChain
+
+The hinge chains again, as articulations
+====================================================
+*/
+class BenchmarkSceneArticulatedChain : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "articulated_chain"; }
+	void Build( PhysicsWorld * world ) override;
+};
+
+/*
+====================================================
+BenchmarkSceneRagdolls
+
+Tumbling ragdolls dropped onto the ground, with joint limits on all their joints
+====================================================
+*/
+class BenchmarkSceneRagdolls : public BenchmarkScene {
+public:
+	const char * GetName() const override { return "ragdolls"; }
+	void Build( PhysicsWorld * world ) override;
+
+private:
+	void AddRagdoll( Shape ** shapes, const Vec3 & pos, const Vec3 & angularVelocity );
+};
+
+/*
+====================================================
+BenchmarkSceneBarrage
+
+Fast projectiles into a wall, this is what keeps the time of impact busy
+====================================================
+*/
+class BenchmarkSceneBarrage : public BenchmarkScene {
+public:
+	BenchmarkSceneBarrage() : m_nextProjectile( 0 ) {}
+
+	const char * GetName() const override { return "projectile_barrage"; }
+	void Build( PhysicsWorld * world ) override;
+	void Update( const float dt_sec ) override;
+
+private:
+	void Launch( Body * body );
+
+	std::vector< Body * >	m_projectiles;
+	int						m_nextProjectile;
+};
+
+/*
+====================================================
+BenchmarkSceneCloth
+
+A grid of numPerSide x numPerSide cloths, each with resolution x resolution particles.
+Giving it substeps switches the cloths to the extended position based solver.
+====================================================
+*/
+class BenchmarkSceneCloth : public BenchmarkScene {
+public:
+	BenchmarkSceneCloth( const char * name, const int numPerSide, const int resolution, const int numIters, const int numSubsteps = 0 ) :
+		m_name( name ), m_numPerSide( numPerSide ), m_resolution( resolution ), m_numIters( numIters ), m_numSubsteps( numSubsteps ) {}
+
+	const char * GetName() const override { return m_name; }
+	void Build( PhysicsWorld * world ) override;
+	void Update( const float dt_sec ) override;
+
+private:
+	const char *			m_name;
+	int						m_numPerSide;
+	int						m_resolution;
+	int						m_numIters;
+	int						m_numSubsteps;
+
+	ClothWorld				m_cloths;
+};
+
+/*
+====================================================
+BenchmarkSceneParticles
+
+Fountains of bouncing debris over the ground and a few static boxes, enough to keep the pool full
+====================================================
+*/
+class BenchmarkSceneParticles : public BenchmarkScene {
+public:
+	BenchmarkSceneParticles() : m_particles( 100 * 1024 ), m_debrisType( 0 ), m_sparkType( 0 ) {}
+
+	const char * GetName() const override { return "particles"; }
+	void Build( PhysicsWorld * world ) override;
+	void Update( const float dt_sec ) override;
+
+private:
+	ParticleSystem			m_particles;
+	int						m_debrisType;
+	int						m_sparkType;
+};
+
+void CreateBenchmarkScenes( std::vector< BenchmarkScene * > & scenes );
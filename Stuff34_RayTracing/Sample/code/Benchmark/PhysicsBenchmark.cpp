@@ -0,0 +1,565 @@
+//
+//  PhysicsBenchmark.cpp
+//
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "Benchmark/BenchmarkScenes.h"
+#include "Math/gjk.h"
+#include "Physics/Intersections.h"
+#include "Physics/NarrowPhase.h"
+#include "Physics/PhysicsState.h"
+#include "Physics/PhysicsStats.h"
+#include "JobSystem/JobSystem.h"
+#include "Miscellaneous/Time.h"
+
+//
+//	Headless runner for the benchmark scenes.  Every scene is stepped for a fixed number of frames
+//	and the per frame phase timings and step stats are written out as json, for tracking the performance over time.
+//
+//	PhysicsBenchmark [-frames N] [-out file.json] [-scene name] [-broadphase sap|bvh|lbvh|hash_grid|auto] [-jobs]
+//	PhysicsBenchmark -check_allocs
+//	PhysicsBenchmark -check_restore
+//
+//	-check_allocs counts the heap allocations made by the contact code, which should make none once it's warmed up.
+//	-check_restore feeds the world tampered snapshots, which it has to turn away without changing anything.
+//
+
+enum benchmarkPhase_t {
+	BP_BROADPHASE = 0,
+	BP_BROADPHASE_PROBE,
+	BP_NARROWPHASE,
+	BP_SOLVE,
+	BP_INTEGRATE,
+	BP_TOI,
+	BP_SCENE,
+	BP_TOTAL,
+	BP_NUM,
+};
+
+static const char * s_phaseNames[ BP_NUM ] = {
+	"broadphase",
+	"broadphase_probe",
+	"narrowphase",
+	"solve",
+	"integrate",
+	"toi",
+	"scene",
+	"total",
+};
+
+enum benchmarkCounter_t {
+	BC_CANDIDATE_PAIRS = 0,
+	BC_FILTERED_PAIRS,
+	BC_GJK_CALLS,
+	BC_EPA_CALLS,
+	BC_BALLISTIC_CONTACTS,
+	BC_MANIFOLDS,
+	BC_CONSTRAINT_ROWS,
+	BC_ITERATIONS,
+	BC_BYTES_ALLOCATED,
+	BC_NUM,
+};
+
+static const char * s_counterNames[ BC_NUM ] = {
+	"candidate_pairs",
+	"filtered_pairs",
+	"gjk_calls",
+	"epa_calls",
+	"ballistic_contacts",
+	"manifolds",
+	"constraint_rows",
+	"iterations",
+	"bytes_allocated",
+};
+
+/*
+====================================================
+WritePhase
+
+Samples are in microseconds, and get sorted in place
+====================================================
+*/
+static void WritePhase( FILE * file, const char * name, std::vector< int > & samples, const bool isLast ) {
+	std::sort( samples.begin(), samples.end() );
+
+	const int num = (int)samples.size();
+	double sum = 0.0;
+	for ( int i = 0; i < num; i++ ) {
+		sum += samples[ i ];
+	}
+
+	// Nearest rank percentiles
+	const float percentiles[ 3 ] = { 0.5f, 0.9f, 0.99f };
+	int values[ 3 ];
+	for ( int i = 0; i < 3; i++ ) {
+		int rank = (int)( percentiles[ i ] * (float)num + 0.999f ) - 1;
+		rank = std::max( 0, std::min( rank, num - 1 ) );
+		values[ i ] = samples[ rank ];
+	}
+
+	fprintf( file, "        \"%s\": { \"min\": %i, \"p50\": %i, \"p90\": %i, \"p99\": %i, \"max\": %i, \"mean\": %.1f }%s\n",
+		name, samples[ 0 ], values[ 0 ], values[ 1 ], values[ 2 ], samples[ num - 1 ], sum / (double)num, isLast ? "" : "," );
+}
+
+/*
+====================================================
+WriteCounter
+====================================================
+*/
+static void WriteCounter( FILE * file, const char * name, const std::vector< int > & samples, const bool isLast ) {
+	const int num = (int)samples.size();
+	double sum = 0.0;
+	int maxValue = samples[ 0 ];
+	for ( int i = 0; i < num; i++ ) {
+		sum += samples[ i ];
+		maxValue = std::max( maxValue, samples[ i ] );
+	}
+
+	fprintf( file, "        \"%s\": { \"mean\": %.1f, \"max\": %i }%s\n", name, sum / (double)num, maxValue, isLast ? "" : "," );
+}
+
+/*
+====================================================
+RunScene
+====================================================
+*/
+static void RunScene( FILE * file, BenchmarkScene * scene, const int numFrames, const broadPhase_t broadPhase, const bool isLast ) {
+	const float dt_sec = 1.0f / 60.0f;
+
+	PhysicsWorld * world = new PhysicsWorld;
+	world->SetBroadPhase( broadPhase );
+	g_physicsWorld = world;
+
+	const int buildStartTime = GetTimeMicroseconds();
+	scene->Build( world );
+	const int buildTime = GetTimeMicroseconds() - buildStartTime;
+
+	std::vector< int > bodyIds;
+	world->GetAllocatedBodyIDs( bodyIds );
+
+	std::vector< int > samples[ BP_NUM ];
+	for ( int i = 0; i < BP_NUM; i++ ) {
+		samples[ i ].resize( numFrames );
+	}
+	std::vector< int > counters[ BC_NUM ];
+	for ( int i = 0; i < BC_NUM; i++ ) {
+		counters[ i ].resize( numFrames );
+	}
+	int broadPhaseSteps[ BROADPHASE_NUM ] = { 0 };	// which one found the pairs, auto can switch between them
+
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		const int sceneStartTime = GetTimeMicroseconds();
+		scene->Update( dt_sec );
+		const int sceneTime = GetTimeMicroseconds() - sceneStartTime;
+
+		world->StepSimulation( dt_sec );
+
+		const stepTimings_t & timings = world->GetStepTimings();
+		samples[ BP_BROADPHASE ][ frame ] = timings.broadPhase;
+		samples[ BP_BROADPHASE_PROBE ][ frame ] = timings.broadPhaseProbe;
+		samples[ BP_NARROWPHASE ][ frame ] = timings.narrowPhase;
+		samples[ BP_SOLVE ][ frame ] = timings.solve;
+		samples[ BP_INTEGRATE ][ frame ] = timings.integrate;
+		samples[ BP_TOI ][ frame ] = timings.timeOfImpact;
+		samples[ BP_SCENE ][ frame ] = sceneTime;
+		samples[ BP_TOTAL ][ frame ] = timings.total + sceneTime;
+
+		const stepStats_t & stats = world->GetStepStats();
+		counters[ BC_CANDIDATE_PAIRS ][ frame ] = stats.numCandidatePairs;
+		counters[ BC_FILTERED_PAIRS ][ frame ] = stats.numFilteredPairs;
+		counters[ BC_GJK_CALLS ][ frame ] = stats.numGjkCalls;
+		counters[ BC_EPA_CALLS ][ frame ] = stats.numEpaCalls;
+		counters[ BC_BALLISTIC_CONTACTS ][ frame ] = stats.numBallisticContacts;
+		counters[ BC_MANIFOLDS ][ frame ] = stats.numManifolds;
+		counters[ BC_CONSTRAINT_ROWS ][ frame ] = stats.numConstraintRows;
+		counters[ BC_ITERATIONS ][ frame ] = stats.numIterations;
+		counters[ BC_BYTES_ALLOCATED ][ frame ] = stats.numBytesAllocated;
+		if ( stats.broadPhase >= 0 && stats.broadPhase < BROADPHASE_NUM ) {
+			broadPhaseSteps[ stats.broadPhase ]++;
+		}
+	}
+
+	fprintf( file, "    {\n" );
+	fprintf( file, "      \"name\": \"%s\",\n", scene->GetName() );
+	fprintf( file, "      \"bodies\": %i,\n", (int)bodyIds.size() );
+	fprintf( file, "      \"constraints\": %i,\n", scene->GetNumConstraints() );
+	fprintf( file, "      \"build_us\": %i,\n", buildTime );
+	fprintf( file, "      \"broadphase_steps\": {" );
+	bool isFirst = true;
+	for ( int i = 0; i < BROADPHASE_NUM; i++ ) {
+		if ( broadPhaseSteps[ i ] > 0 ) {
+			fprintf( file, "%s \"%s\": %i", isFirst ? "" : ",", BroadPhaseName( (broadPhase_t)i ), broadPhaseSteps[ i ] );
+			isFirst = false;
+		}
+	}
+	fprintf( file, " },\n" );
+	fprintf( file, "      \"phases_us\": {\n" );
+	for ( int i = 0; i < BP_NUM; i++ ) {
+		WritePhase( file, s_phaseNames[ i ], samples[ i ], i == BP_NUM - 1 );
+	}
+	fprintf( file, "      },\n" );
+	fprintf( file, "      \"stats\": {\n" );
+	for ( int i = 0; i < BC_NUM; i++ ) {
+		WriteCounter( file, s_counterNames[ i ], counters[ i ], i == BC_NUM - 1 );
+	}
+	fprintf( file, "      }\n" );
+	fprintf( file, "    }%s\n", isLast ? "" : "," );
+	fflush( file );
+
+	// The scene owns the shapes and constraints, so the world has to go first
+	g_physicsWorld = NULL;
+	delete world;
+}
+
+/*
+========================================================================================================
+
+Allocation counting
+
+Every new in the program goes through these, so the checks can count what a piece of code allocates.
+Counting is off unless a check turns it on.
+
+========================================================================================================
+*/
+
+static bool s_countAllocations = false;
+static std::atomic< int > s_numAllocations( 0 );
+
+void * operator new( size_t size ) {
+	if ( s_countAllocations ) {
+		s_numAllocations++;
+	}
+	void * ptr = malloc( ( size > 0 ) ? size : 1 );
+	if ( NULL == ptr ) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete( void * ptr ) noexcept {
+	free( ptr );
+}
+
+/*
+====================================================
+RandomUnit
+====================================================
+*/
+static float RandomUnit( unsigned int & seed ) {
+	seed = seed * 1664525 + 1013904223;
+	return (float)( seed >> 8 ) / (float)( 1 << 24 );
+}
+
+/*
+====================================================
+CheckEpaAllocations
+
+Pushes random hulls into each other so GJK hands them to EPA, and counts the allocations
+====================================================
+*/
+static bool CheckEpaAllocations() {
+	unsigned int seed = 1;
+	std::vector< Vec3 > pts( 64 );
+	for ( int i = 0; i < pts.size(); i++ ) {
+		pts[ i ] = Vec3( RandomUnit( seed ), RandomUnit( seed ), RandomUnit( seed ) ) * 2.0f - Vec3( 1.0f );
+	}
+	ShapeConvex hull( pts.data(), (int)pts.size() );
+	ShapeBox box( g_boxUnit, 8 );
+
+	Body bodyA;
+	Body bodyB;
+	bodyA.m_shape = &hull;
+	bodyB.m_shape = &box;
+
+	// The first query sets up the thread's polytope arena
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	GJK_DoesIntersect( &bodyA, &bodyB, 0.001f, ptOnA, ptOnB );
+
+	const int numQueries = 1000;
+	ResetPhysicsCounters();
+	s_numAllocations = 0;
+	s_countAllocations = true;
+	for ( int i = 0; i < numQueries; i++ ) {
+		Vec3 axis = Vec3( RandomUnit( seed ), RandomUnit( seed ), RandomUnit( seed ) ) * 2.0f - Vec3( 0.9f );
+		axis.Normalize();
+		bodyA.m_orientation = Quat( axis, RandomUnit( seed ) * 6.28f );
+		bodyB.m_position = ( Vec3( RandomUnit( seed ), RandomUnit( seed ), RandomUnit( seed ) ) - Vec3( 0.5f ) ) * 1.5f;
+		GJK_DoesIntersect( &bodyA, &bodyB, 0.001f, ptOnA, ptOnB );
+	}
+	s_countAllocations = false;
+
+	const int numAllocations = s_numAllocations;
+	const int numEpaCalls = GetPhysicsCounters().numEpaCalls;
+	printf( "epa: %i allocations over %i expansions\n", numAllocations, numEpaCalls );
+	return ( 0 == numAllocations && numEpaCalls > 0 );
+}
+
+/*
+====================================================
+CheckNarrowPhaseAllocations
+
+Drops a box onto a triangle grid and onto a compound, through both the discrete and the continuous
+narrowphase, and counts the allocations.  The queries run once beforehand, so the thread's scratch
+lists have already grown to fit them.
+====================================================
+*/
+static bool CheckNarrowPhaseAllocations() {
+	const int gridSize = 8;
+	std::vector< Vec3 > verts;
+	std::vector< int > indices;
+	for ( int y = 0; y <= gridSize; y++ ) {
+		for ( int x = 0; x <= gridSize; x++ ) {
+			verts.push_back( Vec3( (float)( x - gridSize / 2 ), (float)( y - gridSize / 2 ), 0.0f ) );
+		}
+	}
+	for ( int y = 0; y < gridSize; y++ ) {
+		for ( int x = 0; x < gridSize; x++ ) {
+			const int a = y * ( gridSize + 1 ) + x;
+			const int b = a + 1;
+			const int c = a + gridSize + 1;
+			const int d = c + 1;
+			const int quad[ 6 ] = { a, b, d, a, d, c };
+			indices.insert( indices.end(), quad, quad + 6 );
+		}
+	}
+	ShapeMesh mesh( verts.data(), (int)verts.size(), indices.data(), (int)indices.size() );
+
+	ShapeBox box( g_boxUnit, 8 );
+	compoundChild_t children[ 4 ];
+	for ( int i = 0; i < 4; i++ ) {
+		children[ i ].shape = &box;
+		children[ i ].position = Vec3( (float)( i % 2 ) * 2.0f - 1.0f, (float)( i / 2 ) * 2.0f - 1.0f, -1.0f );
+	}
+	ShapeCompound compound( children, 4 );
+
+	Body statics[ 2 ];
+	statics[ 0 ].m_shape = &mesh;
+	statics[ 1 ].m_shape = &compound;
+
+	Body dropped;
+	dropped.m_shape = &box;
+	dropped.m_invMass = 1.0f;
+
+	int numContacts = 0;
+	for ( int pass = 0; pass < 2; pass++ ) {
+		if ( 1 == pass ) {
+			numContacts = 0;
+			s_numAllocations = 0;
+			s_countAllocations = true;
+		}
+
+		unsigned int seed = 1;
+		for ( int i = 0; i < 1000; i++ ) {
+			Vec3 axis = Vec3( RandomUnit( seed ), RandomUnit( seed ), RandomUnit( seed ) ) * 2.0f - Vec3( 0.9f );
+			axis.Normalize();
+			dropped.m_orientation = Quat( axis, RandomUnit( seed ) * 6.28f );
+			dropped.m_position = Vec3( RandomUnit( seed ) * 4.0f - 2.0f, RandomUnit( seed ) * 4.0f - 2.0f, RandomUnit( seed ) * 1.5f );
+			dropped.m_linearVelocity = Vec3( 0.0f, 0.0f, -RandomUnit( seed ) * 20.0f );
+
+			contact_t contacts[ MAX_PAIR_CONTACTS ];
+			Body & other = statics[ i % 2 ];
+			numContacts += Intersect( &dropped, &other, contacts, MAX_PAIR_CONTACTS );
+			numContacts += Intersect( &dropped, &other, 1.0f / 60.0f, contacts, MAX_PAIR_CONTACTS );
+		}
+	}
+	s_countAllocations = false;
+
+	const int numAllocations = s_numAllocations;
+	printf( "narrowphase: %i allocations over %i contacts\n", numAllocations, numContacts );
+	return ( 0 == numAllocations && numContacts > 0 );
+}
+
+/*
+====================================================
+IsRestoreRejected
+
+Restores the tampered snapshot, which has to fail and leave the world saving the same state as before
+====================================================
+*/
+static bool IsRestoreRejected( PhysicsWorld * world, const std::vector< unsigned char > & tampered, const std::vector< unsigned char > & before, const char * name ) {
+	const bool isRestored = world->RestoreState( tampered );
+
+	std::vector< unsigned char > after;
+	world->SaveState( after );
+	const bool isUnchanged = ( after == before );
+
+	printf( "restore: %s is %s, the world is %s\n", name, isRestored ? "accepted" : "rejected", isUnchanged ? "unchanged" : "changed" );
+	return ( !isRestored && isUnchanged );
+}
+
+/*
+====================================================
+CheckStateRestore
+
+Settles the pyramid for a few frames, then restores snapshots with their manifolds tampered with.
+The scene has no joints, so the manifolds follow straight on from the bodies.
+====================================================
+*/
+static bool CheckStateRestore() {
+	BenchmarkScenePyramid scene;
+	PhysicsWorld * world = new PhysicsWorld;
+	g_physicsWorld = world;
+	scene.Build( world );
+	for ( int i = 0; i < 5; i++ ) {
+		world->StepSimulation( 1.0f / 60.0f );
+	}
+
+	std::vector< unsigned char > saved;
+	world->SaveState( saved );
+
+	physicsStateHeader_t header;
+	memcpy( &header, saved.data(), sizeof( header ) );
+	const int * ids = (const int *)( saved.data() + sizeof( header ) );
+	const int manifoldsOffset = (int)sizeof( header ) + header.maxBodies * (int)sizeof( int ) + header.numUsedBodies * (int)sizeof( Body );
+
+	manifoldStateHeader_t manifolds;
+	memcpy( &manifolds, saved.data() + manifoldsOffset, sizeof( manifolds ) );
+	const int firstRecord = manifoldsOffset + (int)sizeof( manifolds ) + manifolds.numFree * (int)sizeof( int );
+	if ( header.numConstraints > 0 || manifolds.numActive < 2 || header.numUsedBodies >= header.maxBodies ) {
+		printf( "restore: the scene doesn't have what the check needs\n" );
+		g_physicsWorld = NULL;
+		delete world;
+		return false;
+	}
+
+	manifoldState_t recordA;
+	memcpy( &recordA, saved.data() + firstRecord, sizeof( recordA ) );
+	const int secondRecord = firstRecord + (int)sizeof( manifoldState_t ) + recordA.numContacts * (int)sizeof( contactState_t );
+
+	bool isClean = true;
+
+	// Two manifolds in the same slot
+	std::vector< unsigned char > tampered = saved;
+	memcpy( tampered.data() + secondRecord + offsetof( manifoldState_t, slot ), &recordA.slot, sizeof( int ) );
+	isClean = IsRestoreRejected( world, tampered, saved, "a repeated slot" ) && isClean;
+
+	// Two manifolds for the same pair
+	tampered = saved;
+	memcpy( tampered.data() + secondRecord + offsetof( manifoldState_t, bodyA ), &recordA.bodyA, sizeof( int ) );
+	memcpy( tampered.data() + secondRecord + offsetof( manifoldState_t, bodyB ), &recordA.bodyB, sizeof( int ) );
+	isClean = IsRestoreRejected( world, tampered, saved, "a repeated body pair" ) && isClean;
+
+	// A manifold on a body that isn't in use
+	tampered = saved;
+	const int freeBody = ids[ header.numUsedBodies ];
+	memcpy( tampered.data() + firstRecord + offsetof( manifoldState_t, bodyA ), &freeBody, sizeof( int ) );
+	isClean = IsRestoreRejected( world, tampered, saved, "a free body" ) && isClean;
+
+	const bool isRestored = world->RestoreState( saved );
+	std::vector< unsigned char > after;
+	world->SaveState( after );
+	printf( "restore: the saved state is %s\n", ( isRestored && after == saved ) ? "restored" : "broken" );
+	isClean = isClean && isRestored && ( after == saved );
+
+	g_physicsWorld = NULL;
+	delete world;
+	return isClean;
+}
+
+/*
+====================================================
+main
+====================================================
+*/
+int main( int argc, char * argv[] ) {
+	int numFrames = 600;
+	const char * outFile = NULL;
+	const char * sceneName = NULL;
+	bool useJobs = false;
+	broadPhase_t broadPhase = BROADPHASE_BVH;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( 0 == strcmp( argv[ i ], "-frames" ) && i + 1 < argc ) {
+			numFrames = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "-out" ) && i + 1 < argc ) {
+			outFile = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "-scene" ) && i + 1 < argc ) {
+			sceneName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "-broadphase" ) && i + 1 < argc ) {
+			const char * name = argv[ ++i ];
+			broadPhase = BROADPHASE_NUM;
+			for ( int j = 0; j < BROADPHASE_NUM; j++ ) {
+				if ( 0 == strcmp( name, BroadPhaseName( (broadPhase_t)j ) ) ) {
+					broadPhase = (broadPhase_t)j;
+				}
+			}
+			if ( BROADPHASE_NUM == broadPhase ) {
+				printf( "WARNING: PhysicsBenchmark: no broadphase named %s\n", name );
+				return EXIT_FAILURE;
+			}
+		} else if ( 0 == strcmp( argv[ i ], "-jobs" ) ) {
+			useJobs = true;
+		} else if ( 0 == strcmp( argv[ i ], "-check_allocs" ) ) {
+			const bool isEpaClean = CheckEpaAllocations();
+			const bool isNarrowPhaseClean = CheckNarrowPhaseAllocations();
+			return ( isEpaClean && isNarrowPhaseClean ) ? EXIT_SUCCESS : EXIT_FAILURE;
+		} else if ( 0 == strcmp( argv[ i ], "-check_restore" ) ) {
+			return CheckStateRestore() ? EXIT_SUCCESS : EXIT_FAILURE;
+		} else {
+			printf( "usage: %s [-frames N] [-out file.json] [-scene name] [-broadphase sap|bvh|lbvh|hash_grid|auto] [-jobs] | -check_allocs | -check_restore\n", argv[ 0 ] );
+			return EXIT_FAILURE;
+		}
+	}
+	if ( numFrames <= 0 ) {
+		printf( "WARNING: PhysicsBenchmark: invalid frame count %i\n", numFrames );
+		return EXIT_FAILURE;
+	}
+
+	FILE * file = stdout;
+	if ( NULL != outFile ) {
+		file = fopen( outFile, "wb" );
+		if ( NULL == file ) {
+			printf( "WARNING: PhysicsBenchmark: unable to open %s\n", outFile );
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ( useJobs ) {
+		g_jobSystem = new JobSystem;
+	}
+
+	std::vector< BenchmarkScene * > scenes;
+	CreateBenchmarkScenes( scenes );
+
+	std::vector< BenchmarkScene * > selected;
+	for ( int i = 0; i < scenes.size(); i++ ) {
+		if ( NULL == sceneName || 0 == strcmp( sceneName, scenes[ i ]->GetName() ) ) {
+			selected.push_back( scenes[ i ] );
+		}
+	}
+	if ( selected.empty() ) {
+		fprintf( stderr, "WARNING: PhysicsBenchmark: no scene named %s\n", sceneName );
+	}
+
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"frames\": %i,\n", numFrames );
+	fprintf( file, "  \"jobs\": %s,\n", useJobs ? "true" : "false" );
+	fprintf( file, "  \"broadphase\": \"%s\",\n", BroadPhaseName( broadPhase ) );
+	fprintf( file, "  \"scenes\": [\n" );
+	for ( int i = 0; i < selected.size(); i++ ) {
+		RunScene( file, selected[ i ], numFrames, broadPhase, i == selected.size() - 1 );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+
+	if ( stdout != file ) {
+		fclose( file );
+	}
+
+	for ( int i = 0; i < scenes.size(); i++ ) {
+		delete scenes[ i ];
+	}
+	if ( NULL != g_jobSystem ) {
+		delete g_jobSystem;
+		g_jobSystem = NULL;
+	}
+
+	return selected.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
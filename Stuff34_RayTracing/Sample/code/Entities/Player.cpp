@@ -81,28 +81,18 @@ void Player::Update( float dt_sec ) {
 	//	Check for ground
 	//
 	ShapeSphere testSphere( 0.05f );
-	Body testBody;
-	testBody.m_position = player->m_position;
-	testBody.m_position.z += player->m_shape->GetBounds().mins.z;
-	testBody.m_shape = &testSphere;
+	overlapQuery_t groundQuery;
+	groundQuery.shape = &testSphere;
+	groundQuery.position = player->m_position;
+	groundQuery.position.z += player->m_shape->GetBounds().mins.z;
+	groundQuery.ignoreBodyId = m_bodyid.id;
 
-	//bool isOnGround = false;
-	bool isOnGround = true;
-//	contact_t groundContact;
-// 	if ( player->m_linearVelocity.z < 0.01f ) {
-// 		for ( int i = 0; i < g_scene->m_entities.size() - 1; i++ ) {
-// 			const Entity * entity = g_scene->m_entities[ i ];
-// 			if ( entity->m_bodyid.id == m_bodyid.id ) {
-// 				continue;
-// 			}
-// 
-// 			if ( Intersect( &testBody, entity->m_bodyid.body, groundContact ) ) {
-// 				m_jumpCount = 0;
-// 				isOnGround = true;
-// 				break;
-// 			}
-// 		}
-// 	}
+	bool isOnGround = false;
+	int groundId = -1;
+	if ( player->m_linearVelocity.z < 0.01f && g_physicsWorld->Overlap( groundQuery, &groundId, 1 ) > 0 ) {
+		m_jumpCount = 0;
+		isOnGround = true;
+	}
 	
 	//
 	//	Keyboard
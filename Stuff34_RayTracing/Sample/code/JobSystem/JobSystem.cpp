@@ -19,7 +19,7 @@ JobSystem::JobSystem
 JobSystem::JobSystem() {
 	m_numThreads = Thread::NumHardwareThreads();
 
-	printf( "Num Job System Threads: %i\n", m_numThreads );
+	fprintf( stderr, "Num Job System Threads: %i\n", m_numThreads );
 
 	m_queue = new WorkStealingQueue;
 	m_threads = new JobThread[ m_numThreads ];
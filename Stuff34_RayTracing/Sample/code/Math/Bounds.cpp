@@ -32,6 +32,54 @@ bool Bounds::DoesIntersect( const Bounds & rhs ) const {
 	return true;
 }
 
+/*
+====================================================
+Bounds::DoesIntersectRay
+
+Slab test for the segment start to start + dir * maxT.  tEnter is where the ray enters
+the bounds, clamped to zero when it starts inside, and enterAxis is the slab it entered
+through, or -1 when it started inside.
+====================================================
+*/
+bool Bounds::DoesIntersectRay( const Vec3 & start, const Vec3 & dir, const float maxT, float & tEnter, int & enterAxis ) const {
+	float tMin = 0.0f;
+	float tMax = maxT;
+	enterAxis = -1;
+
+	for ( int i = 0; i < 3; i++ ) {
+		if ( fabsf( dir[ i ] ) < 1e-12f ) {
+			// Parallel to the slab, so it has to start between the planes
+			if ( start[ i ] < mins[ i ] || start[ i ] > maxs[ i ] ) {
+				return false;
+			}
+			continue;
+		}
+
+		const float invDir = 1.0f / dir[ i ];
+		float t0 = ( mins[ i ] - start[ i ] ) * invDir;
+		float t1 = ( maxs[ i ] - start[ i ] ) * invDir;
+		if ( t0 > t1 ) {
+			const float tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+
+		if ( t0 > tMin ) {
+			tMin = t0;
+			enterAxis = i;
+		}
+		if ( t1 < tMax ) {
+			tMax = t1;
+		}
+		if ( tMin > tMax ) {
+			return false;
+		}
+	}
+
+	tEnter = tMin;
+	return true;
+}
+
 /*
 ====================================================
 Bounds::Expand
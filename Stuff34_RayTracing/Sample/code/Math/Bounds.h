@@ -22,6 +22,7 @@ public:
 
 	void Clear() { mins = Vec3( 1e6 ); maxs = Vec3( -1e6 ); }
 	bool DoesIntersect( const Bounds & rhs ) const;
+	bool DoesIntersectRay( const Vec3 & start, const Vec3 & dir, const float maxT, float & tEnter, int & enterAxis ) const;
 	void Expand( const Vec3 * pts, const int num );
 	void Expand( const Vec3 & rhs );
 	void Expand( const Bounds & rhs );
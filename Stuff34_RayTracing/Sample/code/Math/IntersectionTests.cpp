@@ -3,6 +3,12 @@
 //
 #include "Math/IntersectionTests.h"
 
+#define RAY_TRIANGLE_SIMD	// comment out to test packed triangles one at a time
+
+#if defined( RAY_TRIANGLE_SIMD )
+#include <xmmintrin.h>
+#endif
+
 Vec3 gIntersectPoint;
 static const float gEpsilon = 0.000001f;
 
@@ -206,6 +212,134 @@ bool RayTriangleIntersectionTestBackFaceCull( const Vec3& rpos, const Vec3& rdir
 }
 #endif
 
+/*
+====================================================
+SetTriangle4
+====================================================
+*/
+void SetTriangle4( triangle4_t & tris, const int lane, const Vec3 & v0, const Vec3 & v1, const Vec3 & v2 ) {
+	const Vec3 edge1 = v1 - v0;
+	const Vec3 edge2 = v2 - v0;
+	for ( int i = 0; i < 3; i++ ) {
+		tris.v0[ i ][ lane ] = v0[ i ];
+		tris.edge1[ i ][ lane ] = edge1[ i ];
+		tris.edge2[ i ][ lane ] = edge2[ i ];
+	}
+}
+
+/*
+====================================================
+RayTriangleIntersectionTest4
+
+The same Moller-Trumbore test as RayTriangleIntersectionTest, run on four triangles at once.
+Both faces are hit.  Returns the lane of the nearest hit between minT and maxT, or -1.
+====================================================
+*/
+int RayTriangleIntersectionTest4( const Vec3 & rpos, const Vec3 & rdir, const triangle4_t & tris, const float minT, const float maxT, float & t ) {
+#if defined( RAY_TRIANGLE_SIMD )
+	const __m128 dirX = _mm_set1_ps( rdir.x );
+	const __m128 dirY = _mm_set1_ps( rdir.y );
+	const __m128 dirZ = _mm_set1_ps( rdir.z );
+
+	const __m128 edge1X = _mm_loadu_ps( tris.edge1[ 0 ] );
+	const __m128 edge1Y = _mm_loadu_ps( tris.edge1[ 1 ] );
+	const __m128 edge1Z = _mm_loadu_ps( tris.edge1[ 2 ] );
+	const __m128 edge2X = _mm_loadu_ps( tris.edge2[ 0 ] );
+	const __m128 edge2Y = _mm_loadu_ps( tris.edge2[ 1 ] );
+	const __m128 edge2Z = _mm_loadu_ps( tris.edge2[ 2 ] );
+
+	// vp = rdir x edge2
+	const __m128 vpX = _mm_sub_ps( _mm_mul_ps( dirY, edge2Z ), _mm_mul_ps( dirZ, edge2Y ) );
+	const __m128 vpY = _mm_sub_ps( _mm_mul_ps( dirZ, edge2X ), _mm_mul_ps( dirX, edge2Z ) );
+	const __m128 vpZ = _mm_sub_ps( _mm_mul_ps( dirX, edge2Y ), _mm_mul_ps( dirY, edge2X ) );
+	const __m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vpX, edge1X ), _mm_mul_ps( vpY, edge1Y ) ), _mm_mul_ps( vpZ, edge1Z ) );
+
+	// if det is zero, then the ray is coincident with the triangle's plane, this also rejects the unused lanes
+	const __m128 absDet = _mm_andnot_ps( _mm_set1_ps( -0.0f ), det );
+	__m128 valid = _mm_cmpge_ps( absDet, _mm_set1_ps( 1e-12f ) );
+	const __m128 invDet = _mm_div_ps( _mm_set1_ps( 1.0f ), det );
+
+	// calculate distance from vert0 to ray origin
+	const __m128 vtX = _mm_sub_ps( _mm_set1_ps( rpos.x ), _mm_loadu_ps( tris.v0[ 0 ] ) );
+	const __m128 vtY = _mm_sub_ps( _mm_set1_ps( rpos.y ), _mm_loadu_ps( tris.v0[ 1 ] ) );
+	const __m128 vtZ = _mm_sub_ps( _mm_set1_ps( rpos.z ), _mm_loadu_ps( tris.v0[ 2 ] ) );
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+
+	// calculate U parameter and test bounds
+	const __m128 u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( vtX, vpX ), _mm_mul_ps( vtY, vpY ) ), _mm_mul_ps( vtZ, vpZ ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( u, zero ), _mm_cmple_ps( u, one ) ) );
+
+	// vq = vt x edge1
+	const __m128 vqX = _mm_sub_ps( _mm_mul_ps( vtY, edge1Z ), _mm_mul_ps( vtZ, edge1Y ) );
+	const __m128 vqY = _mm_sub_ps( _mm_mul_ps( vtZ, edge1X ), _mm_mul_ps( vtX, edge1Z ) );
+	const __m128 vqZ = _mm_sub_ps( _mm_mul_ps( vtX, edge1Y ), _mm_mul_ps( vtY, edge1X ) );
+
+	// calculate V parameter and test bounds
+	const __m128 v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dirX, vqX ), _mm_mul_ps( dirY, vqY ) ), _mm_mul_ps( dirZ, vqZ ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( v, zero ), _mm_cmple_ps( _mm_add_ps( u, v ), one ) ) );
+
+	// calculate t, ray intersects triangle
+	const __m128 hitT = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( edge2X, vqX ), _mm_mul_ps( edge2Y, vqY ) ), _mm_mul_ps( edge2Z, vqZ ) ), invDet );
+	valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( hitT, _mm_set1_ps( minT ) ), _mm_cmple_ps( hitT, _mm_set1_ps( maxT ) ) ) );
+
+	const int mask = _mm_movemask_ps( valid );
+	if ( 0 == mask ) {
+		return -1;
+	}
+
+	float hits[ 4 ];
+	_mm_storeu_ps( hits, hitT );
+
+	int best = -1;
+	for ( int i = 0; i < 4; i++ ) {
+		if ( ( mask & ( 1 << i ) ) && ( best < 0 || hits[ i ] < hits[ best ] ) ) {
+			best = i;
+		}
+	}
+	t = hits[ best ];
+	return best;
+#else
+	int best = -1;
+	float bestT = maxT;
+	for ( int i = 0; i < 4; i++ ) {
+		const Vec3 edge1 = Vec3( tris.edge1[ 0 ][ i ], tris.edge1[ 1 ][ i ], tris.edge1[ 2 ][ i ] );
+		const Vec3 edge2 = Vec3( tris.edge2[ 0 ][ i ], tris.edge2[ 1 ][ i ], tris.edge2[ 2 ][ i ] );
+
+		const Vec3 vp = rdir.Cross( edge2 );
+		const float det = vp.Dot( edge1 );
+		if ( fabsf( det ) < 1e-12f ) {
+			continue;
+		}
+		const float invDet = 1.0f / det;
+
+		const Vec3 vt = rpos - Vec3( tris.v0[ 0 ][ i ], tris.v0[ 1 ][ i ], tris.v0[ 2 ][ i ] );
+		const float u = vt.Dot( vp ) * invDet;
+		if ( u < 0.0f || u > 1.0f ) {
+			continue;
+		}
+
+		const Vec3 vq = vt.Cross( edge1 );
+		const float v = rdir.Dot( vq ) * invDet;
+		if ( v < 0.0f || u + v > 1.0f ) {
+			continue;
+		}
+
+		const float hitT = edge2.Dot( vq ) * invDet;
+		if ( hitT < minT || hitT > bestT ) {
+			continue;
+		}
+		best = i;
+		bestT = hitT;
+	}
+	if ( best >= 0 ) {
+		t = bestT;
+	}
+	return best;
+#endif
+}
+
 
 
 
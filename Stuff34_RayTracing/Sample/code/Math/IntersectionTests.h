@@ -9,6 +9,22 @@ extern bool RayTriangleIntersectionTest( const Vec3& rpos, const Vec3& rdir,
 extern bool RayTriangleIntersectionTestBackFaceCull( const Vec3& rpos, const Vec3& rdir, 
 													const Vec3& v0, const Vec3& v1, const Vec3& v2 );
 
+/*
+====================================================
+triangle4_t
+
+Four triangles in SoA form for RayTriangleIntersectionTest4.  Unused lanes have zero edges.
+====================================================
+*/
+struct triangle4_t {
+	float v0[ 3 ][ 4 ];		// [ axis ][ lane ]
+	float edge1[ 3 ][ 4 ];	// v1 - v0
+	float edge2[ 3 ][ 4 ];	// v2 - v0
+};
+
+extern void SetTriangle4( triangle4_t & tris, const int lane, const Vec3 & v0, const Vec3 & v1, const Vec3 & v2 );
+extern int RayTriangleIntersectionTest4( const Vec3 & rpos, const Vec3 & rdir, const triangle4_t & tris, const float minT, const float maxT, float & t );
+
 extern int triBoxOverlap( const float boxcenter[3], const float boxhalfsize[3], const float triverts[3][3]);
 
 
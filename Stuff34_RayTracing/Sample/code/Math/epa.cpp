@@ -4,6 +4,7 @@
 #include "epa.h"
 #include "SignedVolumes.h"
 #include "lcp.h"
+#include "Physics/PhysicsStats.h"
 
 /*
 ========================================================================================================
@@ -211,52 +212,119 @@ Vec3 BarycentricCoordinates( const Vec3 & a, const Vec3 & b, const Vec3 & c, con
 }
 
 /*
-====================================================
-NormalDirection
-====================================================
+========================================================================================================
+
+epaArena_t
+
+Fixed capacity scratch space for the expansion.  Each thread owns one, so the narrowphase can run
+EPA from any job without touching the heap.  Faces store their neighbors, which lets the horizon
+be found by walking out from the closest face instead of comparing every edge against every other.
+
+========================================================================================================
 */
-Vec3 NormalDirection( const tri_t & tri, const std::vector< point_t > & points ) {
-	const Vec3 & a = points[ tri.a ].xyz;
-	const Vec3 & b = points[ tri.b ].xyz;
-	const Vec3 & c = points[ tri.c ].xyz;
 
-	Vec3 ab = b - a;
-	Vec3 ac = c - a;
-	Vec3 normal = ab.Cross( ac );
-	normal.Normalize();
-	return normal;
-}
+#define EPA_MAX_POINTS 128
+#define EPA_MAX_FACES ( 2 * EPA_MAX_POINTS )	// a closed triangle mesh with V verts has 2V - 4 faces
+#define EPA_MAX_HORIZON EPA_MAX_POINTS
+
+// Expansion stops once a new support point improves on the closest face by less than this.
+// Each iteration adds one point, so the point capacity is the hard iteration cap.
+#define EPA_TOLERANCE 0.001f
+#define EPA_MAX_ITERATIONS ( EPA_MAX_POINTS - 4 )
+
+struct epaFace_t {
+	int		v[ 3 ];		// counter clockwise when viewed from outside the polytope
+	int		adj[ 3 ];	// adj[ i ] is the face across the edge v[ i ] -> v[ ( i + 1 ) % 3 ]
+	Vec3	normal;
+	float	dist;		// distance from the origin to the plane of the face
+	bool	isValid;
+	bool	isVisible;
+};
+
+struct epaEdge_t {
+	int face;	// surviving face on the far side of the horizon
+	int edge;	// edge index within that face
+};
+
+struct epaArena_t {
+	point_t		points[ EPA_MAX_POINTS ];
+	epaFace_t	faces[ EPA_MAX_FACES ];
+	int			freeFaces[ EPA_MAX_FACES ];
+	int			visibleFaces[ EPA_MAX_FACES ];
+	epaEdge_t	horizon[ EPA_MAX_HORIZON ];
+
+	int numPoints;
+	int numFaces;
+	int numFreeFaces;
+	int numVisibleFaces;
+	int numHorizon;
+	bool horizonOverflow;
+};
+
+static thread_local epaArena_t s_epaArena;
 
 /*
 ====================================================
-SignedDistanceToTriangle
+AllocateFace
 ====================================================
 */
-float SignedDistanceToTriangle( const tri_t & tri, const Vec3 & pt, const std::vector< point_t > & points ) {
-	const Vec3 normal = NormalDirection( tri, points );
-	const Vec3 & a = points[ tri.a ].xyz;
-	const Vec3 a2pt = pt - a;
-	const float dist = normal.Dot( a2pt );
-	return dist;
+static int AllocateFace( epaArena_t & arena, const int a, const int b, const int c ) {
+	int idx = -1;
+	if ( arena.numFreeFaces > 0 ) {
+		arena.numFreeFaces--;
+		idx = arena.freeFaces[ arena.numFreeFaces ];
+	} else if ( arena.numFaces < EPA_MAX_FACES ) {
+		idx = arena.numFaces;
+		arena.numFaces++;
+	} else {
+		return -1;
+	}
+
+	epaFace_t & face = arena.faces[ idx ];
+	face.v[ 0 ] = a;
+	face.v[ 1 ] = b;
+	face.v[ 2 ] = c;
+	face.adj[ 0 ] = -1;
+	face.adj[ 1 ] = -1;
+	face.adj[ 2 ] = -1;
+	face.isValid = true;
+	face.isVisible = false;
+
+	const Vec3 & ptA = arena.points[ a ].xyz;
+	const Vec3 & ptB = arena.points[ b ].xyz;
+	const Vec3 & ptC = arena.points[ c ].xyz;
+	face.normal = ( ptB - ptA ).Cross( ptC - ptA );
+	const float lengthSqr = face.normal.GetLengthSqr();
+	if ( lengthSqr > 1e-12f ) {
+		face.normal /= sqrtf( lengthSqr );
+		face.dist = face.normal.Dot( ptA );
+	} else {
+		// A sliver face can't say which way is out, so never pick it as the closest
+		face.normal.Zero();
+		face.dist = 1e10f;
+	}
+	return idx;
 }
 
 /*
 ====================================================
-ClosestTriangle
+ClosestFace
 ====================================================
 */
-int ClosestTriangle( const std::vector< tri_t > & triangles, const std::vector< point_t > & points ) {
-	float minDistSqr = 1e10;
+static int ClosestFace( const epaArena_t & arena ) {
+	float minDist = 1e10f;
 
 	int idx = -1;
-	for ( int i = 0; i < triangles.size(); i++ ) {
-		const tri_t & tri = triangles[ i ];
+	for ( int i = 0; i < arena.numFaces; i++ ) {
+		const epaFace_t & face = arena.faces[ i ];
+		if ( !face.isValid ) {
+			continue;
+		}
 
-		float dist = SignedDistanceToTriangle( tri, Vec3( 0.0f ), points );
-		float distSqr = dist * dist;
-		if ( distSqr < minDistSqr ) {
+		const float dist = fabsf( face.dist );
+		if ( dist < minDist ) {
 			idx = i;
-			minDistSqr = distSqr;
+			minDist = dist;
 		}
 	}
 
@@ -268,22 +336,10 @@ int ClosestTriangle( const std::vector< tri_t > & triangles, const std::vector<
 HasPoint
 ====================================================
 */
-bool HasPoint( const Vec3 & w, const std::vector< tri_t > triangles, const std::vector< point_t > & points ) {
-	const float epsilons = 0.001f * 0.001f;
-	Vec3 delta;
-
-	for ( int i = 0; i < triangles.size(); i++ ) {
-		const tri_t & tri = triangles[ i ];
-
-		delta = w - points[ tri.a ].xyz;
-		if ( delta.GetLengthSqr() < epsilons ) {
-			return true;
-		}
-		delta = w - points[ tri.b ].xyz;
-		if ( delta.GetLengthSqr() < epsilons ) {
-			return true;
-		}
-		delta = w - points[ tri.c ].xyz;
+static bool HasPoint( const epaArena_t & arena, const Vec3 & w ) {
+	const float epsilons = EPA_TOLERANCE * EPA_TOLERANCE;
+	for ( int i = 0; i < arena.numPoints; i++ ) {
+		const Vec3 delta = w - arena.points[ i ].xyz;
 		if ( delta.GetLengthSqr() < epsilons ) {
 			return true;
 		}
@@ -293,205 +349,259 @@ bool HasPoint( const Vec3 & w, const std::vector< tri_t > triangles, const std::
 
 /*
 ====================================================
-RemoveTrianglesFacingPoint
+FindHorizon
+
+Walks across the faces visible from w, starting at a visible face.  Entering each face through
+the edge it was reached by and leaving through the next two edges in winding order means the
+horizon edges come out as a closed counter clockwise loop.
 ====================================================
 */
-int RemoveTrianglesFacingPoint( const Vec3 & pt, std::vector< tri_t > & triangles, const std::vector< point_t > & points ) {
-	int numRemoved = 0;
-	for ( int i = 0; i < triangles.size(); i++ ) {
-		const tri_t & tri = triangles[ i ];
-
-		float dist = SignedDistanceToTriangle( tri, pt, points );
-		if ( dist > 0.0f ) {
-			// This triangle faces the point.  Remove it.
-			triangles.erase( triangles.begin() + i );
-			i--;
-			numRemoved++;
+static void FindHorizon( epaArena_t & arena, const Vec3 & w, const int faceIdx, const int edgeIdx ) {
+	epaFace_t & face = arena.faces[ faceIdx ];
+	if ( face.isVisible ) {
+		return;
+	}
+
+	const Vec3 & a = arena.points[ face.v[ 0 ] ].xyz;
+	if ( face.normal.Dot( w - a ) <= 0.0f ) {
+		// This face can't see the point, so the edge we arrived through is on the horizon
+		if ( arena.numHorizon >= EPA_MAX_HORIZON ) {
+			arena.horizonOverflow = true;
+			return;
+		}
+		arena.horizon[ arena.numHorizon ].face = faceIdx;
+		arena.horizon[ arena.numHorizon ].edge = edgeIdx;
+		arena.numHorizon++;
+		return;
+	}
+
+	face.isVisible = true;
+	arena.visibleFaces[ arena.numVisibleFaces ] = faceIdx;
+	arena.numVisibleFaces++;
+
+	for ( int i = 1; i < 3; i++ ) {
+		const int edge = ( edgeIdx + i ) % 3;
+		const int neighbor = face.adj[ edge ];
+		const epaFace_t & next = arena.faces[ neighbor ];
+		for ( int j = 0; j < 3; j++ ) {
+			if ( next.adj[ j ] == faceIdx ) {
+				FindHorizon( arena, w, neighbor, j );
+				break;
+			}
 		}
 	}
-	return numRemoved;
 }
 
 /*
 ====================================================
-FindDanglingEdges
+ExpandToPoint
+
+Replaces the faces visible from the new point with a fan of faces connecting the point
+to the horizon.  Returns false, leaving the polytope untouched, if the horizon is unusable.
 ====================================================
 */
-void FindDanglingEdges( std::vector< edge_t > & danglingEdges, const std::vector< tri_t > & triangles ) {
-	danglingEdges.clear();
-
-	for ( int i = 0; i < triangles.size(); i++ ) {
-		const tri_t & tri = triangles[ i ];
-
-		edge_t edges[ 3 ];
-		edges[ 0 ].a = tri.a;
-		edges[ 0 ].b = tri.b;
+static bool ExpandToPoint( epaArena_t & arena, const int seedIdx, const int newIdx ) {
+	const Vec3 & w = arena.points[ newIdx ].xyz;
 
-		edges[ 1 ].a = tri.b;
-		edges[ 1 ].b = tri.c;
+	arena.numVisibleFaces = 0;
+	arena.numHorizon = 0;
+	arena.horizonOverflow = false;
 
-		edges[ 2 ].a = tri.c;
-		edges[ 2 ].b = tri.a;
-
-		int counts[ 3 ];
-		counts[ 0 ] = 0;
-		counts[ 1 ] = 0;
-		counts[ 2 ] = 0;
-
-		for ( int j = 0; j < triangles.size(); j++ ) {
-			if ( j == i ) {
-				continue;
+	epaFace_t & seed = arena.faces[ seedIdx ];
+	seed.isVisible = true;
+	arena.visibleFaces[ arena.numVisibleFaces ] = seedIdx;
+	arena.numVisibleFaces++;
+	for ( int i = 0; i < 3; i++ ) {
+		const int neighbor = seed.adj[ i ];
+		const epaFace_t & next = arena.faces[ neighbor ];
+		for ( int j = 0; j < 3; j++ ) {
+			if ( next.adj[ j ] == seedIdx ) {
+				FindHorizon( arena, w, neighbor, j );
+				break;
 			}
+		}
+	}
 
-			const tri_t & tri2 = triangles[ j ];
-
-			edge_t edges2[ 3 ];
-			edges2[ 0 ].a = tri2.a;
-			edges2[ 0 ].b = tri2.b;
+	// The horizon must be a closed loop, and there must be room for the new faces
+	bool isValid = !arena.horizonOverflow && arena.numHorizon >= 3;
+	const int numAvailable = arena.numFreeFaces + arena.numVisibleFaces + ( EPA_MAX_FACES - arena.numFaces );
+	if ( arena.numHorizon > numAvailable ) {
+		isValid = false;
+	}
+	for ( int i = 0; i < arena.numHorizon && isValid; i++ ) {
+		const epaEdge_t & edge = arena.horizon[ i ];
+		const epaEdge_t & next = arena.horizon[ ( i + 1 ) % arena.numHorizon ];
+		const int end = arena.faces[ edge.face ].v[ edge.edge ];
+		const int start = arena.faces[ next.face ].v[ ( next.edge + 1 ) % 3 ];
+		if ( end != start ) {
+			isValid = false;
+		}
+	}
 
-			edges2[ 1 ].a = tri2.b;
-			edges2[ 1 ].b = tri2.c;
+	if ( !isValid ) {
+		for ( int i = 0; i < arena.numVisibleFaces; i++ ) {
+			arena.faces[ arena.visibleFaces[ i ] ].isVisible = false;
+		}
+		return false;
+	}
 
-			edges2[ 2 ].a = tri2.c;
-			edges2[ 2 ].b = tri2.a;
+	// Retire the visible faces
+	for ( int i = 0; i < arena.numVisibleFaces; i++ ) {
+		epaFace_t & face = arena.faces[ arena.visibleFaces[ i ] ];
+		face.isValid = false;
+		face.isVisible = false;
+		arena.freeFaces[ arena.numFreeFaces ] = arena.visibleFaces[ i ];
+		arena.numFreeFaces++;
+	}
 
-			for ( int k = 0; k < 3; k++ ) {
-				if ( edges[ k ] == edges2[ 0 ] ) {
-					counts[ k ]++;
-				}
-				if ( edges[ k ] == edges2[ 1 ] ) {
-					counts[ k ]++;
-				}
-				if ( edges[ k ] == edges2[ 2 ] ) {
-					counts[ k ]++;
-				}		
-			}
+	// Build the fan.  Each horizon edge is reversed so the new face winds the same way as the one it replaced.
+	int firstIdx = -1;
+	int prevIdx = -1;
+	for ( int i = 0; i < arena.numHorizon; i++ ) {
+		const epaEdge_t & edge = arena.horizon[ i ];
+		epaFace_t & outer = arena.faces[ edge.face ];
+		const int a = outer.v[ ( edge.edge + 1 ) % 3 ];
+		const int b = outer.v[ edge.edge ];
+
+		const int faceIdx = AllocateFace( arena, a, b, newIdx );
+		epaFace_t & face = arena.faces[ faceIdx ];
+		face.adj[ 0 ] = edge.face;
+		outer.adj[ edge.edge ] = faceIdx;
+
+		// Consecutive fan faces share the edge running out to the new point
+		if ( prevIdx >= 0 ) {
+			face.adj[ 2 ] = prevIdx;
+			arena.faces[ prevIdx ].adj[ 1 ] = faceIdx;
+		} else {
+			firstIdx = faceIdx;
 		}
-
-		// An edge that isn't shared, is dangling 
-		for ( int k = 0; k < 3; k++ ) {
-			if ( 0 == counts[ k ] ) {
-				danglingEdges.push_back( edges[ k ] );
-			}
-		}		
+		prevIdx = faceIdx;
 	}
+	arena.faces[ firstIdx ].adj[ 2 ] = prevIdx;
+	arena.faces[ prevIdx ].adj[ 1 ] = firstIdx;
+
+	return true;
 }
 
 /*
 ====================================================
-EPA_Expand
+BuildTetrahedron
 ====================================================
 */
-float EPA_Expand( const Body * bodyA, const Body * bodyB, const float bias, const point_t simplexPoints[ 4 ], Vec3 & ptOnA, Vec3 & ptOnB ) {
-	std::vector< point_t > points;
-	std::vector< tri_t > triangles;
-	std::vector< edge_t > danglingEdges;
+static void BuildTetrahedron( epaArena_t & arena, const point_t simplexPoints[ 4 ] ) {
+	arena.numPoints = 0;
+	arena.numFaces = 0;
+	arena.numFreeFaces = 0;
 
-	Vec3 center( 0.0f );
 	for ( int i = 0; i < 4; i++ ) {
-		points.push_back( simplexPoints[ i ] );
-		center += simplexPoints[ i ].xyz;
+		arena.points[ arena.numPoints ] = simplexPoints[ i ];
+		arena.numPoints++;
 	}
-	center *= 0.25f;
 
-	// Build the triangles
 	for ( int i = 0; i < 4; i++ ) {
-		int j = ( i + 1 ) % 4;
-		int k = ( i + 2 ) % 4;
-		tri_t tri;
-		tri.a = i;
-		tri.b = j;
-		tri.c = k;
-
-		int unusedPt = ( i + 3 ) % 4;
-		float dist = SignedDistanceToTriangle( tri, points[ unusedPt ].xyz, points );
+		int a = i;
+		int b = ( i + 1 ) % 4;
+		int c = ( i + 2 ) % 4;
 
 		// The unused point is always on the negative/inside of the triangle.. make sure the normal points away
-		if ( dist > 0.0f ) {
-			std::swap( tri.a, tri.b );
+		const int unusedPt = ( i + 3 ) % 4;
+		const Vec3 & ptA = arena.points[ a ].xyz;
+		const Vec3 normal = ( arena.points[ b ].xyz - ptA ).Cross( arena.points[ c ].xyz - ptA );
+		if ( normal.Dot( arena.points[ unusedPt ].xyz - ptA ) > 0.0f ) {
+			std::swap( a, b );
 		}
 
-		triangles.push_back( tri );
+		AllocateFace( arena, a, b, c );
 	}
 
+	// Every edge of the tetrahedron is shared by exactly two faces, wound in opposite directions
+	for ( int i = 0; i < 4; i++ ) {
+		epaFace_t & face = arena.faces[ i ];
+		for ( int e = 0; e < 3; e++ ) {
+			const int a = face.v[ e ];
+			const int b = face.v[ ( e + 1 ) % 3 ];
+			for ( int j = 0; j < 4; j++ ) {
+				const epaFace_t & other = arena.faces[ j ];
+				if ( j == i ) {
+					continue;
+				}
+				if ( ( other.v[ 0 ] == b && other.v[ 1 ] == a ) || ( other.v[ 1 ] == b && other.v[ 2 ] == a ) || ( other.v[ 2 ] == b && other.v[ 0 ] == a ) ) {
+					face.adj[ e ] = j;
+					break;
+				}
+			}
+		}
+	}
+}
+
+/*
+====================================================
+EPA_Expand
+
+Returns the penetration depth, or -1 when every face of the polytope was too thin to trust
+====================================================
+*/
+float EPA_Expand( const Body * bodyA, const Body * bodyB, const float bias, const point_t simplexPoints[ 4 ], Vec3 & ptOnA, Vec3 & ptOnB ) {
+	GetPhysicsCounters().numEpaCalls++;
+
+	epaArena_t & arena = s_epaArena;
+	BuildTetrahedron( arena, simplexPoints );
+
 	//
 	//	Expand the simplex to find the closest face of the CSO to the origin
 	//
-	while ( 1 ) {
-		const int idx = ClosestTriangle( triangles, points );
-		Vec3 normal = NormalDirection( triangles[ idx ], points );
-
-		const point_t newPt = Support( bodyA, bodyB, normal, bias );
-
-		// if w already exists, then just stop
-		// because it means we can't expand any further
-		if ( HasPoint( newPt.xyz, triangles, points ) ) {
+	for ( int iter = 0; iter < EPA_MAX_ITERATIONS; iter++ ) {
+		const int idx = ClosestFace( arena );
+		if ( idx < 0 ) {
 			break;
 		}
+		const epaFace_t & face = arena.faces[ idx ];
 
-		float dist = SignedDistanceToTriangle( triangles[ idx ], newPt.xyz, points );
-		if ( dist <= 0.0f ) {
-			break;	// can't expand
-		}
-
-		const int newIdx = (int)points.size();
-		points.push_back( newPt );
+		const point_t newPt = Support( bodyA, bodyB, face.normal, bias );
 
-		// Remove Triangles that face this point
-		int numRemoved = RemoveTrianglesFacingPoint( newPt.xyz, triangles, points );
-		if ( 0 == numRemoved ) {
+		// Stop once the support point no longer pushes the closest face out
+		const float dist = face.normal.Dot( newPt.xyz ) - face.dist;
+		if ( dist < EPA_TOLERANCE ) {
 			break;
 		}
 
-		// Find Dangling Edges
-		danglingEdges.clear();
-		FindDanglingEdges( danglingEdges, triangles );
-		if ( 0 == danglingEdges.size() ) {
+		// if w already exists, then just stop
+		// because it means we can't expand any further
+		if ( HasPoint( arena, newPt.xyz ) ) {
 			break;
 		}
 
-		// In theory the edges should be a proper CCW order
-		// So we only need to add the new point as 'a' in order
-		// to create new triangles that face away from origin
-		for ( int i = 0; i < danglingEdges.size(); i++ ) {
-			const edge_t & edge = danglingEdges[ i ];
-
-			tri_t triangle;
-			triangle.a = newIdx;
-			triangle.b = edge.b;
-			triangle.c = edge.a;
-
-			// Make sure it's oriented properly
-			float dist = SignedDistanceToTriangle( triangle, center, points );
-			if ( dist > 0.0f ) {
-				std::swap( triangle.b, triangle.c );
-			}
+		if ( arena.numPoints >= EPA_MAX_POINTS ) {
+			break;
+		}
+		const int newIdx = arena.numPoints;
+		arena.points[ newIdx ] = newPt;
+		arena.numPoints++;
 
-			triangles.push_back( triangle );
+		if ( !ExpandToPoint( arena, idx, newIdx ) ) {
+			arena.numPoints--;
+			break;
 		}
 	}
 
 	// Get the projection of the origin on the closest triangle
-	const int idx = ClosestTriangle( triangles, points );
-	const tri_t & tri = triangles[ idx ];
-	Vec3 ptA_w = points[ tri.a ].xyz;
-	Vec3 ptB_w = points[ tri.b ].xyz;
-	Vec3 ptC_w = points[ tri.c ].xyz;
-	Vec3 lambdas = BarycentricCoordinates( ptA_w, ptB_w, ptC_w, Vec3( 0.0f ) );
+	const int idx = ClosestFace( arena );
+	if ( idx < 0 ) {
+		return -1.0f;
+	}
+	const epaFace_t & face = arena.faces[ idx ];
+	const point_t & ptA = arena.points[ face.v[ 0 ] ];
+	const point_t & ptB = arena.points[ face.v[ 1 ] ];
+	const point_t & ptC = arena.points[ face.v[ 2 ] ];
+	Vec3 lambdas = BarycentricCoordinates( ptA.xyz, ptB.xyz, ptC.xyz, Vec3( 0.0f ) );
 
 	// Get the point on shape A
-	Vec3 ptA_a = points[ tri.a ].ptA;
-	Vec3 ptB_a = points[ tri.b ].ptA;
-	Vec3 ptC_a = points[ tri.c ].ptA;
-	ptOnA = ptA_a * lambdas[ 0 ] + ptB_a * lambdas[ 1 ] + ptC_a * lambdas[ 2 ];
+	ptOnA = ptA.ptA * lambdas[ 0 ] + ptB.ptA * lambdas[ 1 ] + ptC.ptA * lambdas[ 2 ];
 
 	// Get the point on shape B
-	Vec3 ptA_b = points[ tri.a ].ptB;
-	Vec3 ptB_b = points[ tri.b ].ptB;
-	Vec3 ptC_b = points[ tri.c ].ptB;
-	ptOnB = ptA_b * lambdas[ 0 ] + ptB_b * lambdas[ 1 ] + ptC_b * lambdas[ 2 ];
+	ptOnB = ptA.ptB * lambdas[ 0 ] + ptB.ptB * lambdas[ 1 ] + ptC.ptB * lambdas[ 2 ];
 
 	// Return the penetration distance
 	Vec3 delta = ptOnB - ptOnA;
 	return delta.GetMagnitude();
-}
\ No newline at end of file
+}
@@ -7,4 +7,4 @@
 #include "../Physics/Body.h"
 #include "gjk.h"
 
-float EPA_Expand( const Body * bodyA, const Body * bodyB, const float bias, const point_t simplexPoints[ 4 ], Vec3 & ptOnA, Vec3 & ptOnB );
\ No newline at end of file
+float EPA_Expand( const Body * bodyA, const Body * bodyB, const float bias, const point_t simplexPoints[ 4 ], Vec3 & ptOnA, Vec3 & ptOnB );	// negative if it failed
\ No newline at end of file
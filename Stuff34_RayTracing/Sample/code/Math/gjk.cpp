@@ -11,6 +11,7 @@
 #include "gjk.h"
 #include "epa.h"
 #include "SignedVolumes.h"
+#include "Physics/PhysicsStats.h"
 
 /*
 ========================================================================================================
@@ -191,6 +192,81 @@ bool ValidateTetrahedron( const point_t simplexPoints[ 4 ] ) {
 	return true;
 }
 
+/*
+================================
+LoadCache
+
+Rebuilds the cached simplex at the bodies' current transforms
+================================
+*/
+static int LoadCache( const Body * bodyA, const Body * bodyB, const gjkCache_t * cache, point_t simplexPoints[ 4 ] ) {
+	if ( NULL == cache || 0 == cache->numPts ) {
+		return 0;
+	}
+
+	const bool isFlipped = ( cache->bodyA != bodyA );
+	for ( int i = 0; i < cache->numPts; i++ ) {
+		const Vec3 & localA = isFlipped ? cache->simplexB[ i ] : cache->simplexA[ i ];
+		const Vec3 & localB = isFlipped ? cache->simplexA[ i ] : cache->simplexB[ i ];
+
+		simplexPoints[ i ].ptA = bodyA->BodySpaceToWorldSpace( localA );
+		simplexPoints[ i ].ptB = bodyB->BodySpaceToWorldSpace( localB );
+		simplexPoints[ i ].xyz = simplexPoints[ i ].ptA - simplexPoints[ i ].ptB;
+	}
+	return cache->numPts;
+}
+
+/*
+================================
+StoreCache
+================================
+*/
+static void StoreCache( const Body * bodyA, const Body * bodyB, gjkCache_t * cache, const point_t simplexPoints[ 4 ], const int numPts, const Vec3 & ptOnA, const Vec3 & ptOnB, const bool isSeparated ) {
+	if ( NULL == cache ) {
+		return;
+	}
+
+	cache->bodyA = bodyA;
+	cache->numPts = numPts;
+	for ( int i = 0; i < numPts; i++ ) {
+		cache->simplexA[ i ] = bodyA->WorldSpaceToBodySpace( simplexPoints[ i ].ptA );
+		cache->simplexB[ i ] = bodyB->WorldSpaceToBodySpace( simplexPoints[ i ].ptB );
+	}
+
+	cache->hasAxis = false;
+	if ( isSeparated ) {
+		Vec3 ab = ptOnB - ptOnA;
+		const float separation = ab.GetMagnitude();
+		if ( separation > 1e-6f ) {
+			cache->hasAxis = true;
+			cache->axis = ab * ( 1.0f / separation );
+			cache->separation = separation;
+		}
+	}
+}
+
+/*
+================================
+GJK_CachedAxisSeparates
+
+Checks if the separating axis from the last query still separates the bodies.
+This only costs a single support query, and returns the gap along the axis,
+which is a lower bound on the distance between the bodies.
+================================
+*/
+bool GJK_CachedAxisSeparates( const Body * bodyA, const Body * bodyB, const gjkCache_t * cache, Vec3 & axis, float & separation ) {
+	if ( NULL == cache || !cache->hasAxis ) {
+		return false;
+	}
+
+	axis = ( cache->bodyA == bodyA ) ? cache->axis : cache->axis * -1.0f;
+
+	// The point on A furthest towards B, and the point on B furthest towards A
+	const point_t pt = Support( bodyA, bodyB, axis, 0.0f );
+	separation = -axis.Dot( pt.xyz );
+	return ( separation > 0.0f );
+}
+
 /*
 ================================
 GJK_ClosestPoints
@@ -199,19 +275,37 @@ Gilbert-Johnson-Keerthi
 Johnson algorithm replaced with Signed Volumes
 ================================
 */
-void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB ) {
+void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache ) {
+	GetPhysicsCounters().numGjkCalls++;
 	const Vec3 origin( 0.0f );
 
 	float closestDist = 1e10f;
 	const float bias = 0.0f;
 
-	int numPts = 1;
 	point_t simplexPoints[ 4 ];
-	simplexPoints[ 0 ] = Support( bodyA, bodyB, Vec3( 1, 1, 1 ), bias );
-
 	Vec4 lambdas = Vec4( 1, 0, 0, 0 );
-	Vec3 newDir = simplexPoints[ 0 ].xyz * -1.0f;
-	do {
+	Vec3 newDir;
+
+	// Warm start from the previous simplex
+	int numPts = LoadCache( bodyA, bodyB, cache, simplexPoints );
+	if ( numPts > 1 ) {
+		SimplexSignedVolumes( simplexPoints, numPts, newDir, lambdas );
+		SortValids( simplexPoints, lambdas );
+		numPts = NumValids( lambdas );
+		closestDist = newDir.GetLengthSqr();
+	}
+	if ( 1 == numPts ) {
+		lambdas = Vec4( 1, 0, 0, 0 );
+		newDir = simplexPoints[ 0 ].xyz * -1.0f;
+	}
+	if ( 0 == numPts ) {
+		numPts = 1;
+		simplexPoints[ 0 ] = Support( bodyA, bodyB, Vec3( 1, 1, 1 ), bias );
+		lambdas = Vec4( 1, 0, 0, 0 );
+		newDir = simplexPoints[ 0 ].xyz * -1.0f;
+	}
+
+	while ( numPts < 4 ) {
 		// Get the new point to check on
 		point_t newPt = Support( bodyA, bodyB, newDir, bias );
 
@@ -234,7 +328,7 @@ void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Ve
 			break;
 		}
 		closestDist = dist;
-	} while ( numPts < 4 );
+	}
 
 	ptOnA.Zero();
 	ptOnB.Zero();
@@ -242,6 +336,8 @@ void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Ve
 		ptOnA += simplexPoints[ i ].ptA * lambdas[ i ];
 		ptOnB += simplexPoints[ i ].ptB * lambdas[ i ];
 	}
+
+	StoreCache( bodyA, bodyB, cache, simplexPoints, NumValids( lambdas ), ptOnA, ptOnB, true );
 }
 
 /*
@@ -252,17 +348,37 @@ Gilbert-Johnson-Keerthi
 Johnson algorithm replaced with Signed Volumes
 ====================================================
 */
-bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB ) {
+bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache ) {
+	GetPhysicsCounters().numGjkCalls++;
 	const Vec3 origin( 0.0f );
 
-	int numPts = 1;
 	point_t simplexPoints[ 4 ];
-	simplexPoints[ 0 ] = Support( bodyA, bodyB, Vec3( 1, 1, 1 ), 0.0f );
-
 	float closestDist = 1e10f;
 	bool doesContainOrigin = false;
-	Vec3 newDir = simplexPoints[ 0 ].xyz * -1.0f;
-	do {
+	Vec3 newDir;
+
+	// Warm start from the previous simplex, if it still holds the origin we're done already
+	int numPts = LoadCache( bodyA, bodyB, cache, simplexPoints );
+	if ( numPts > 1 ) {
+		Vec4 lambdas;
+		doesContainOrigin = SimplexSignedVolumes( simplexPoints, numPts, newDir, lambdas );
+		if ( !doesContainOrigin ) {
+			SortValids( simplexPoints, lambdas );
+			numPts = NumValids( lambdas );
+			doesContainOrigin = ( 4 == numPts );
+			closestDist = newDir.GetLengthSqr();
+		}
+	}
+	if ( 1 == numPts ) {
+		newDir = simplexPoints[ 0 ].xyz * -1.0f;
+	}
+	if ( 0 == numPts ) {
+		numPts = 1;
+		simplexPoints[ 0 ] = Support( bodyA, bodyB, Vec3( 1, 1, 1 ), 0.0f );
+		newDir = simplexPoints[ 0 ].xyz * -1.0f;
+	}
+
+	while ( !doesContainOrigin ) {
 		// Get the new point to check on
 		point_t newPt = Support( bodyA, bodyB, newDir, 0.0f );
 
@@ -278,6 +394,8 @@ bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias
 		// origin cannot be in the set. And therefore there is no collision.
 		float dotdot = newDir.Dot( newPt.xyz - origin );
 		if ( dotdot < 0.0f ) {
+			// Don't cache the point that failed to pass the origin, the rest of the simplex is still good
+			numPts--;
 			break;
 		}
 
@@ -298,9 +416,11 @@ bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias
 		SortValids( simplexPoints, lambdas );
 		numPts = NumValids( lambdas );
 		doesContainOrigin = ( 4 == numPts );
-	} while ( !doesContainOrigin );
+	}
 
 	if ( !doesContainOrigin ) {
+		// Keep the simplex for next time, the caller follows up with the closest points query which stores the separating axis
+		StoreCache( bodyA, bodyB, cache, simplexPoints, std::min( numPts, 3 ), ptOnA, ptOnB, false );
 		return false;
 	}
 
@@ -334,6 +454,9 @@ bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias
 		numPts++;
 	}
 
+	// The simplex before it's expanded by the bias is what we want to start from next time
+	StoreCache( bodyA, bodyB, cache, simplexPoints, numPts, ptOnA, ptOnB, false );
+
 	//
 	// Expand the simplex by the bias amount
 	//
@@ -364,6 +487,9 @@ bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias
 	//
 	// Perform EPA expansion of the simplex to find the closest face on the CSO
 	//
-	EPA_Expand( bodyA, bodyB, bias, simplexPoints, ptOnA, ptOnB );
+	// A polytope of nothing but slivers gives no depth, so the caller falls back to the closest points
+	if ( EPA_Expand( bodyA, bodyB, bias, simplexPoints, ptOnA, ptOnB ) < 0.0f ) {
+		return false;
+	}
 	return true;
 }
\ No newline at end of file
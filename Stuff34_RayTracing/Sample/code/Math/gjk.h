@@ -25,7 +25,33 @@ struct point_t {
 	}
 };
 
+/*
+====================================================
+gjkCache_t
+
+Warm start data for a pair of bodies, kept from one query to the next.
+The simplex points are stored in body space, so they move with the bodies
+and are still valid points on the minkowski difference next time.
+====================================================
+*/
+struct gjkCache_t {
+	gjkCache_t() : bodyA( NULL ), numPts( 0 ), hasAxis( false ), separation( 0.0f ), axis( 0.0f ) {}
+
+	void Clear() { bodyA = NULL; numPts = 0; hasAxis = false; }
+
+	const Body * bodyA;		// the body the cache was built for as "A", queries with the bodies swapped flip the data
+
+	int numPts;
+	Vec3 simplexA[ 4 ];		// body space
+	Vec3 simplexB[ 4 ];		// body space
+
+	bool hasAxis;
+	float separation;
+	Vec3 axis;				// world space direction from A to B that separated the pair in the last query
+};
+
 point_t Support( const Body * bodyA, const Body * bodyB, Vec3 dir, const float bias );
 
-void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB );
-bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB );
\ No newline at end of file
+void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = NULL );
+bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = NULL );
+bool GJK_CachedAxisSeparates( const Body * bodyA, const Body * bodyB, const gjkCache_t * cache, Vec3 & axis, float & separation );
\ No newline at end of file
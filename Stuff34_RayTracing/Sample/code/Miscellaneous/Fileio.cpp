@@ -137,19 +137,13 @@ bool GetFileData( const char * fileName, unsigned char ** data, unsigned int & s
 #endif
 
 static char g_ApplicationDirectory[ FILENAME_MAX ];	// needs to be CWD
-static bool g_WasInitialized = false;
 
 /*
 =================================
-InitializeFileSystem
+ReadApplicationDirectory
 =================================
 */
-void InitializeFileSystem() {
-	if ( g_WasInitialized ) {
-		return;
-	}
-	g_WasInitialized = true;
-
+static bool ReadApplicationDirectory() {
 	const bool result = GetCurrentDir( g_ApplicationDirectory, sizeof( g_ApplicationDirectory ) );
 	assert( result );
 	if ( result ) {
@@ -157,6 +151,20 @@ void InitializeFileSystem() {
 	} else {
 		printf( "ERROR: Unable to get current working directory!\n");
 	}
+	return result;
+}
+
+/*
+=================================
+InitializeFileSystem
+
+Hulls get cooked on the job threads, so this can be reached from several at once.  The function
+static is initialized exactly once, and the others wait for it, so nobody sees the directory before it's filled in.
+=================================
+*/
+void InitializeFileSystem() {
+	static const bool s_wasInitialized = ReadApplicationDirectory();
+	(void)s_wasInitialized;
 }
 
 /*
@@ -403,4 +411,76 @@ int GetFileTimeStampWrite( const char * fileNameLocal ) {
 	itime.QuadPart -= reinterpret_cast< LARGE_INTEGER & >( base_ft ).QuadPart;
 	itime.QuadPart /= 10000000LL;
 	return (int)itime.QuadPart;
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+MapFileData
+Maps the whole file into memory read only, the view stays valid until UnmapFileData
+====================================================
+*/
+bool MapFileData( const char * fileNameLocal, fileMapping_t & mapping ) {
+	InitializeFileSystem();
+
+	mapping.data = NULL;
+	mapping.size = 0;
+	mapping.fileHandle = NULL;
+	mapping.mappingHandle = NULL;
+
+	char fileName[ 2048 ];
+	sprintf( fileName, "%s/%s", g_ApplicationDirectory, fileNameLocal );
+
+	HANDLE hFile = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( INVALID_HANDLE_VALUE == hFile ) {
+		return false;
+	}
+
+	const DWORD size = GetFileSize( hFile, NULL );
+	if ( INVALID_FILE_SIZE == size || 0 == size ) {
+		CloseHandle( hFile );
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( NULL == hMapping ) {
+		printf( "ERROR: CreateFileMapping failed with %i  %s\n", (int)GetLastError(), fileName );
+		CloseHandle( hFile );
+		return false;
+	}
+
+	const void * view = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( NULL == view ) {
+		printf( "ERROR: MapViewOfFile failed with %i  %s\n", (int)GetLastError(), fileName );
+		CloseHandle( hMapping );
+		CloseHandle( hFile );
+		return false;
+	}
+
+	mapping.data = (const unsigned char *)view;
+	mapping.size = (unsigned int)size;
+	mapping.fileHandle = hFile;
+	mapping.mappingHandle = hMapping;
+	return true;
+}
+
+/*
+====================================================
+UnmapFileData
+====================================================
+*/
+void UnmapFileData( fileMapping_t & mapping ) {
+	if ( NULL != mapping.data ) {
+		UnmapViewOfFile( mapping.data );
+	}
+	if ( NULL != mapping.mappingHandle ) {
+		CloseHandle( (HANDLE)mapping.mappingHandle );
+	}
+	if ( NULL != mapping.fileHandle ) {
+		CloseHandle( (HANDLE)mapping.fileHandle );
+	}
+
+	mapping.data = NULL;
+	mapping.size = 0;
+	mapping.fileHandle = NULL;
+	mapping.mappingHandle = NULL;
+}
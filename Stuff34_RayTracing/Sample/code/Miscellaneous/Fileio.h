@@ -17,4 +17,20 @@ bool WriteFileStream( const char * data );
 void CloseFileWriteStream();
 
 bool SaveFileData( const char * fileNameLocal, const void * data, unsigned int size );
-int GetFileTimeStampWrite( const char * fileNameLocal );
\ No newline at end of file
+int GetFileTimeStampWrite( const char * fileNameLocal );
+
+/*
+====================================================
+fileMapping_t
+A read only view of a whole file, from MapFileData
+====================================================
+*/
+struct fileMapping_t {
+	const unsigned char * data;
+	unsigned int size;
+	void * fileHandle;
+	void * mappingHandle;
+};
+
+bool MapFileData( const char * fileNameLocal, fileMapping_t & mapping );
+void UnmapFileData( fileMapping_t & mapping );
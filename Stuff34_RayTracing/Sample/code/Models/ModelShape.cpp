@@ -538,17 +538,18 @@ bool Model::BuildFromShape( const Shape * shape ) {
 				m_vertices[ v ].pos[ 2 ] -= shapeCapsule->m_height * 0.5f;
 			}
 		}
-	} else if ( shape->GetType() == Shape::SHAPE_CONVEX ) {
+	} else if ( shape->GetType() == Shape::SHAPE_CONVEX || shape->GetType() == Shape::SHAPE_MESH ) {
 		const ShapeConvex * shapeConvex = (const ShapeConvex *)shape;
+		const ShapeMesh * shapeMesh = (const ShapeMesh *)shape;
+		const bool isMesh = ( shape->GetType() == Shape::SHAPE_MESH );
 
 		m_vertices.clear();
 		m_indices.clear();
 
-		// Build the connected convex hull from the points
-		std::vector< Vec3 > hullPts;
-		std::vector< tri_t > hullTris;
-		//void BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris );
-		BuildConvexHull( shapeConvex->m_points, hullPts, hullTris );
+		// The shape keeps the triangles of its hull, so there's no need to build it again.
+		// Meshes draw their triangles the same way.
+		const std::vector< Vec3 > & hullPts = isMesh ? shapeMesh->m_verts : shapeConvex->m_points;
+		const std::vector< tri_t > & hullTris = isMesh ? shapeMesh->m_triangles : shapeConvex->m_triangles;
 
 		Bounds bounds;
 		bounds.Expand( hullPts.data(), hullPts.size() );
@@ -691,6 +692,92 @@ bool Model::BuildFromShape( const Shape * shape ) {
 			m_indices.push_back( i );
 		}
 #endif
+	} else if ( shape->GetType() == Shape::SHAPE_HEIGHTFIELD ) {
+		const ShapeHeightfield * shapeHeightfield = (const ShapeHeightfield *)shape;
+		const int numX = shapeHeightfield->m_numX;
+		const int numY = shapeHeightfield->m_numY;
+
+		m_vertices.clear();
+		m_indices.clear();
+
+		m_vertices.reserve( numX * numY );
+		for ( int y = 0; y < numY; y++ ) {
+			for ( int x = 0; x < numX; x++ ) {
+				vert_t vert;
+				memset( &vert, 0, sizeof( vert_t ) );
+
+				vert.pos = shapeHeightfield->GetVertex( x, y );
+				vert.st[ 0 ] = float( x ) / float( numX - 1 );
+				vert.st[ 1 ] = float( y ) / float( numY - 1 );
+
+				// Central differences, clamped at the edges
+				const Vec3 dx = shapeHeightfield->GetVertex( std::min( x + 1, numX - 1 ), y ) - shapeHeightfield->GetVertex( std::max( x - 1, 0 ), y );
+				const Vec3 dy = shapeHeightfield->GetVertex( x, std::min( y + 1, numY - 1 ) ) - shapeHeightfield->GetVertex( x, std::max( y - 1, 0 ) );
+				Vec3 norm = dx.Cross( dy );
+				norm.Normalize();
+
+				vert.norm[ 0 ] = vert_t::FloatToByte_n11( norm[ 0 ] );
+				vert.norm[ 1 ] = vert_t::FloatToByte_n11( norm[ 1 ] );
+				vert.norm[ 2 ] = vert_t::FloatToByte_n11( norm[ 2 ] );
+				vert.norm[ 3 ] = vert_t::FloatToByte_n11( 0.0f );
+
+				m_vertices.push_back( vert );
+			}
+		}
+
+		// Same split as the collision triangles
+		m_indices.reserve( ( numX - 1 ) * ( numY - 1 ) * 6 );
+		for ( int y = 0; y < numY - 1; y++ ) {
+			for ( int x = 0; x < numX - 1; x++ ) {
+				const unsigned int a = y * numX + x;
+				const unsigned int b = a + 1;
+				const unsigned int c = a + numX;
+				const unsigned int d = c + 1;
+
+				m_indices.push_back( a );
+				m_indices.push_back( b );
+				m_indices.push_back( d );
+
+				m_indices.push_back( a );
+				m_indices.push_back( d );
+				m_indices.push_back( c );
+			}
+		}
+	} else if ( shape->GetType() == Shape::SHAPE_COMPOUND ) {
+		const ShapeCompound * shapeCompound = (const ShapeCompound *)shape;
+
+		m_vertices.clear();
+		m_indices.clear();
+
+		// Build each child on its own and move it into place
+		for ( int c = 0; c < shapeCompound->m_children.size(); c++ ) {
+			const compoundChild_t & child = shapeCompound->m_children[ c ];
+
+			Model childModel;
+			if ( !childModel.BuildFromShape( child.shape ) ) {
+				continue;
+			}
+
+			const unsigned int firstVert = (unsigned int)m_vertices.size();
+			for ( int v = 0; v < childModel.m_vertices.size(); v++ ) {
+				vert_t vert = childModel.m_vertices[ v ];
+				vert.pos = child.position + child.orientation.RotatePoint( vert.pos );
+
+				// Only the direction gets rotated, the fourth byte passes through
+				const Vec3 norm = child.orientation.RotatePoint( Byte4ToVec3( vert.norm ) );
+				const Vec3 tang = child.orientation.RotatePoint( Byte4ToVec3( vert.tang ) );
+				const unsigned char normW = vert.norm[ 3 ];
+				const unsigned char tangW = vert.tang[ 3 ];
+				Vec3ToByte4( norm, vert.norm );
+				Vec3ToByte4( tang, vert.tang );
+				vert.norm[ 3 ] = normW;
+				vert.tang[ 3 ] = tangW;
+				m_vertices.push_back( vert );
+			}
+			for ( int i = 0; i < childModel.m_indices.size(); i++ ) {
+				m_indices.push_back( firstVert + childModel.m_indices[ i ] );
+			}
+		}
 	}
 
 	return true;
@@ -0,0 +1,912 @@
+//
+//	Articulation.cpp
+//
+#include "Physics/Articulation.h"
+#include "Physics/PhysicsWorld.h"
+#include <math.h>
+#include <stdio.h>
+
+static const Vec3 s_gravity = Vec3( 0, 0, -10 );	// the same as the world's
+static const float s_limitBeta = 0.2f;				// fraction of a limit's violation that's corrected each step
+
+/*
+========================================================================================================
+
+Spatial Algebra
+
+========================================================================================================
+*/
+
+/*
+====================================================
+Skew
+
+Skew( a ) * b = a x b
+====================================================
+*/
+static Mat3 Skew( const Vec3 & a ) {
+	return Mat3( Vec3( 0, -a.z, a.y ), Vec3( a.z, 0, -a.x ), Vec3( -a.y, a.x, 0 ) );
+}
+
+/*
+====================================================
+Outer
+====================================================
+*/
+static Mat3 Outer( const Vec3 & a, const Vec3 & b ) {
+	return Mat3( b * a.x, b * a.y, b * a.z );
+}
+
+/*
+====================================================
+CrossMotion
+====================================================
+*/
+static spatialVec_t CrossMotion( const spatialVec_t & v, const spatialVec_t & m ) {
+	return spatialVec_t( v.w.Cross( m.w ), v.w.Cross( m.v ) + v.v.Cross( m.w ) );
+}
+
+/*
+====================================================
+CrossForce
+====================================================
+*/
+static spatialVec_t CrossForce( const spatialVec_t & v, const spatialVec_t & f ) {
+	return spatialVec_t( v.w.Cross( f.w ) + v.v.Cross( f.v ), v.w.Cross( f.v ) );
+}
+
+/*
+====================================================
+Dot
+
+Motion dotted with force is power
+====================================================
+*/
+static float Dot( const spatialVec_t & m, const spatialVec_t & f ) {
+	return m.w.Dot( f.w ) + m.v.Dot( f.v );
+}
+
+/*
+====================================================
+AddOuter
+
+M += a * b^T * scale
+====================================================
+*/
+static void AddOuter( spatialMat_t & M, const spatialVec_t & a, const spatialVec_t & b, const float scale ) {
+	M.ww += Outer( a.w, b.w ) * scale;
+	M.wv += Outer( a.w, b.v ) * scale;
+	M.vw += Outer( a.v, b.w ) * scale;
+	M.vv += Outer( a.v, b.v ) * scale;
+}
+
+/*
+====================================================
+SpatialInertia
+
+Rigid body inertia about the world origin, from the inertia about the center of mass in world space
+====================================================
+*/
+static spatialMat_t SpatialInertia( const float mass, const Mat3 & inertia, const Vec3 & centerOfMass ) {
+	const Mat3 cx = Skew( centerOfMass );
+	const Mat3 cxT = cx.Transpose();
+
+	spatialMat_t I;
+	I.ww = inertia + cx * cxT * mass;
+	I.wv = cx * mass;
+	I.vw = cxT * mass;
+	I.vv.Identity();
+	I.vv *= mass;
+	return I;
+}
+
+/*
+====================================================
+SolveSpatial
+
+Solves M x = b with the Schur complement of the lower right block
+====================================================
+*/
+static spatialVec_t SolveSpatial( const spatialMat_t & M, const spatialVec_t & b ) {
+	const Mat3 invVV = M.vv.Inverse();
+	const Mat3 schur = M.ww + M.wv * invVV * M.vw * -1.0f;
+
+	spatialVec_t x;
+	x.w = schur.Inverse() * ( b.w - M.wv * ( invVV * b.v ) );
+	x.v = invVV * ( b.v - M.vw * x.w );
+	return x;
+}
+
+/*
+====================================================
+RotationFromAngularVelocity
+====================================================
+*/
+static Quat RotationFromAngularVelocity( const Vec3 & angularVelocity, const float dt_sec ) {
+	const float angle = angularVelocity.GetMagnitude() * dt_sec;
+	if ( angle < 1e-8f ) {
+		return Quat( 0, 0, 0, 1 );
+	}
+	return Quat( angularVelocity, angle );
+}
+
+/*
+========================================================================================================
+
+Articulation
+
+========================================================================================================
+*/
+
+/*
+====================================================
+Articulation::Articulation
+====================================================
+*/
+Articulation::Articulation( PhysicsWorld * world ) {
+	m_world = world;
+	m_numSubsteps = 4;
+}
+
+/*
+====================================================
+Articulation::AddLink
+====================================================
+*/
+int Articulation::AddLink( const int parent, const Body & body, const articulationJoint_t joint, const Vec3 & pivot, const Vec3 & axis ) {
+	if ( m_links.empty() != ( parent < 0 ) || parent >= GetNumLinks() ) {
+		printf( "WARNING: Articulation::AddLink: invalid parent %i, the root has to be added first and only once\n", parent );
+		return -1;
+	}
+	if ( AJ_FLOATING == joint && parent >= 0 ) {
+		printf( "WARNING: Articulation::AddLink: only the root can float\n" );
+		return -1;
+	}
+	if ( NULL == body.m_shape || body.m_invMass <= 0.0f ) {
+		printf( "WARNING: Articulation::AddLink: links need a shape and a mass\n" );
+		return -1;
+	}
+
+	// The articulation integrates its own gravity
+	Body linkBody = body;
+	linkBody.m_enableGravity = false;
+	linkBody.m_enableRotation = true;
+	const bodyID_t bodyId = m_world->AllocateBody( linkBody );
+	if ( NULL == bodyId.body ) {
+		return -1;
+	}
+
+	const int idx = GetNumLinks();
+	bodyId.body->m_articulation = this;
+	bodyId.body->m_articulationLink = idx;
+
+	articulationLink_t link;
+	link.parent = parent;
+	link.body = bodyId.body;
+	link.bodyId = bodyId.id;
+	link.joint = joint;
+	link.numDofs = ( AJ_REVOLUTE == joint ) ? 1 : ( ( AJ_SPHERICAL == joint ) ? 3 : ( ( AJ_FLOATING == joint ) ? 6 : 0 ) );
+	link.mass = 1.0f / body.m_invMass;
+	link.inertia = body.m_shape->InertiaTensor() * link.mass;
+	link.centerOfMass = bodyId.body->GetCenterOfMassWorldSpace();
+	link.orientation = body.m_orientation;
+
+	Quat parentOrientation = Quat( 0, 0, 0, 1 );
+	Vec3 parentCenterOfMass = Vec3( 0.0f );
+	if ( parent >= 0 ) {
+		parentOrientation = m_links[ parent ].orientation;
+		parentCenterOfMass = m_links[ parent ].centerOfMass;
+	}
+	const Quat invParentOrientation = parentOrientation.Inverse();
+	const Quat invOrientation = link.orientation.Inverse();
+
+	Vec3 jointAxis = axis;
+	if ( jointAxis.GetLengthSqr() < 1e-8f ) {
+		jointAxis = Vec3( 0, 0, 1 );
+	}
+	jointAxis.Normalize();
+
+	link.parentAnchor = invParentOrientation.RotatePoint( pivot - parentCenterOfMass );
+	link.childAnchor = invOrientation.RotatePoint( pivot - link.centerOfMass );
+	link.parentAxis = invParentOrientation.RotatePoint( jointAxis );
+	link.childAxis = invOrientation.RotatePoint( jointAxis );
+	link.restOrientation = invParentOrientation * link.orientation;
+	link.relative = link.restOrientation;
+	link.angle = 0.0f;
+	for ( int i = 0; i < 6; i++ ) {
+		link.qd[ i ] = 0.0f;
+		link.deltaQd[ i ] = 0.0f;
+		link.freeQd[ i ] = 0.0f;
+	}
+	for ( int i = 0; i < 3; i++ ) {
+		link.u[ i ] = 0.0f;
+		link.impulseU[ i ] = 0.0f;
+	}
+	link.invD.Zero();
+
+	link.hasLimits = false;
+	link.lower = 0.0f;
+	link.upper = 0.0f;
+	link.hasMotor = false;
+	link.motorSpeed = 0.0f;
+	link.motorMaxTorque = 0.0f;
+	link.damping = 0.0f;
+	link.isResponseValid = false;
+
+	if ( AJ_FLOATING == joint ) {
+		const Vec3 w = body.m_angularVelocity;
+		const Vec3 v = body.m_linearVelocity - w.Cross( link.centerOfMass );
+		for ( int i = 0; i < 3; i++ ) {
+			link.qd[ i ] = w[ i ];
+			link.qd[ 3 + i ] = v[ i ];
+			link.freeQd[ i ] = w[ i ];
+			link.freeQd[ 3 + i ] = v[ i ];
+		}
+	}
+	GetPose( link, link.startPose );
+	link.freePose = link.startPose;
+
+	m_links.push_back( link );
+
+	UpdateKinematics();
+	UpdateVelocities();
+	UpdateArticulatedInertias();
+	SyncBodies();
+	return idx;
+}
+
+/*
+====================================================
+Articulation::RemoveFromWorld
+====================================================
+*/
+void Articulation::RemoveFromWorld() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		Body * body = m_links[ i ].body;
+		body->m_articulation = NULL;
+		body->m_articulationLink = -1;
+		m_world->FreeBody( m_links[ i ].bodyId );
+	}
+	m_links.clear();
+	m_rows.clear();
+}
+
+/*
+====================================================
+Articulation::SetLimits
+====================================================
+*/
+void Articulation::SetLimits( const int link, const float lower, const float upper ) {
+	articulationLink_t & l = m_links[ link ];
+	if ( AJ_REVOLUTE != l.joint && AJ_SPHERICAL != l.joint ) {
+		printf( "WARNING: Articulation::SetLimits: link %i doesn't rotate\n", link );
+		return;
+	}
+	if ( lower > upper ) {
+		printf( "WARNING: Articulation::SetLimits: lower limit %f is above upper limit %f\n", lower, upper );
+		return;
+	}
+
+	l.hasLimits = true;
+	l.lower = lower;
+	l.upper = upper;
+}
+
+/*
+====================================================
+Articulation::SetMotor
+====================================================
+*/
+void Articulation::SetMotor( const int link, const float targetSpeed, const float maxTorque ) {
+	articulationLink_t & l = m_links[ link ];
+	if ( AJ_REVOLUTE != l.joint ) {
+		printf( "WARNING: Articulation::SetMotor: link %i isn't revolute\n", link );
+		return;
+	}
+
+	l.hasMotor = ( maxTorque > 0.0f );
+	l.motorSpeed = targetSpeed;
+	l.motorMaxTorque = maxTorque;
+}
+
+/*
+====================================================
+Articulation::SetDamping
+====================================================
+*/
+void Articulation::SetDamping( const int link, const float damping ) {
+	m_links[ link ].damping = ( damping > 0.0f ) ? damping : 0.0f;
+}
+
+/*
+====================================================
+Articulation::SetNumSubsteps
+====================================================
+*/
+void Articulation::SetNumSubsteps( const int numSubsteps ) {
+	m_numSubsteps = ( numSubsteps > 1 ) ? numSubsteps : 1;
+}
+
+/*
+====================================================
+Articulation::GetPose
+====================================================
+*/
+void Articulation::GetPose( const articulationLink_t & link, articulationPose_t & pose ) const {
+	pose.angle = link.angle;
+	pose.relative = link.relative;
+	pose.centerOfMass = link.centerOfMass;
+	pose.orientation = link.orientation;
+}
+
+/*
+====================================================
+Articulation::SetPose
+
+Kinematics have to be updated afterwards, except for a floating link
+====================================================
+*/
+void Articulation::SetPose( articulationLink_t & link, const articulationPose_t & pose ) {
+	link.angle = pose.angle;
+	link.relative = pose.relative;
+	if ( AJ_FLOATING == link.joint ) {
+		link.centerOfMass = pose.centerOfMass;
+		link.orientation = pose.orientation;
+	}
+}
+
+/*
+====================================================
+Articulation::UpdateKinematics
+
+Places the links from the joint positions, root first
+====================================================
+*/
+void Articulation::UpdateKinematics() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		if ( AJ_FLOATING == link.joint ) {
+			continue;
+		}
+
+		Quat parentOrientation = Quat( 0, 0, 0, 1 );
+		Vec3 parentCenterOfMass = Vec3( 0.0f );
+		if ( link.parent >= 0 ) {
+			parentOrientation = m_links[ link.parent ].orientation;
+			parentCenterOfMass = m_links[ link.parent ].centerOfMass;
+		}
+
+		Quat relative = link.restOrientation;
+		if ( AJ_REVOLUTE == link.joint ) {
+			relative = Quat( link.parentAxis, link.angle ) * link.restOrientation;
+		} else if ( AJ_SPHERICAL == link.joint ) {
+			relative = link.relative;
+		}
+		link.orientation = parentOrientation * relative;
+		link.orientation.Normalize();
+
+		const Vec3 pivot = parentCenterOfMass + parentOrientation.RotatePoint( link.parentAnchor );
+		link.centerOfMass = pivot - link.orientation.RotatePoint( link.childAnchor );
+
+		// Rotation about an axis through the pivot
+		if ( AJ_REVOLUTE == link.joint ) {
+			const Vec3 a = parentOrientation.RotatePoint( link.parentAxis );
+			link.S[ 0 ] = spatialVec_t( a, pivot.Cross( a ) );
+		} else if ( AJ_SPHERICAL == link.joint ) {
+			const Vec3 axes[ 3 ] = { Vec3( 1, 0, 0 ), Vec3( 0, 1, 0 ), Vec3( 0, 0, 1 ) };
+			for ( int k = 0; k < 3; k++ ) {
+				const Vec3 a = parentOrientation.RotatePoint( axes[ k ] );
+				link.S[ k ] = spatialVec_t( a, pivot.Cross( a ) );
+			}
+		}
+	}
+}
+
+/*
+====================================================
+Articulation::UpdateVelocities
+====================================================
+*/
+void Articulation::UpdateVelocities() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		if ( AJ_FLOATING == link.joint ) {
+			link.velocity = spatialVec_t( Vec3( link.qd[ 0 ], link.qd[ 1 ], link.qd[ 2 ] ), Vec3( link.qd[ 3 ], link.qd[ 4 ], link.qd[ 5 ] ) );
+			link.velocityProduct.Zero();
+			continue;
+		}
+
+		spatialVec_t jointVelocity( Vec3( 0.0f ), Vec3( 0.0f ) );
+		for ( int k = 0; k < link.numDofs; k++ ) {
+			jointVelocity += link.S[ k ] * link.qd[ k ];
+		}
+
+		link.velocity = jointVelocity;
+		if ( link.parent >= 0 ) {
+			link.velocity += m_links[ link.parent ].velocity;
+		}
+		link.velocityProduct = CrossMotion( link.velocity, jointVelocity );
+	}
+}
+
+/*
+====================================================
+Articulation::UpdateArticulatedInertias
+
+The first two passes of the articulated body algorithm.  Each link's inertia and bias force
+take in everything outboard of it, as seen through its joint.
+====================================================
+*/
+void Articulation::UpdateArticulatedInertias() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+
+		const Mat3 orientation = link.orientation.ToMat3();
+		const Mat3 inertia = orientation * link.inertia * orientation.Transpose();
+		const spatialMat_t I = SpatialInertia( link.mass, inertia, link.centerOfMass );
+
+		const Vec3 weight = s_gravity * link.mass;
+		const spatialVec_t gravity( link.centerOfMass.Cross( weight ), weight );
+
+		link.articulatedInertia = I;
+		link.articulatedBias = CrossForce( link.velocity, I * link.velocity ) - gravity;
+	}
+
+	for ( int i = (int)m_links.size() - 1; i >= 0; i-- ) {
+		articulationLink_t & link = m_links[ i ];
+		if ( AJ_FLOATING == link.joint ) {
+			continue;
+		}
+
+		spatialMat_t Ia = link.articulatedInertia;
+		spatialVec_t pa = link.articulatedBias;
+		if ( link.numDofs > 0 ) {
+			Mat3 D;
+			D.Identity();
+			for ( int j = 0; j < link.numDofs; j++ ) {
+				link.U[ j ] = link.articulatedInertia * link.S[ j ];
+				link.u[ j ] = -link.damping * link.qd[ j ] - Dot( link.S[ j ], link.articulatedBias );
+			}
+			for ( int j = 0; j < link.numDofs; j++ ) {
+				for ( int k = 0; k < link.numDofs; k++ ) {
+					D.rows[ j ][ k ] = Dot( link.S[ j ], link.U[ k ] );
+				}
+			}
+			link.invD = D.Inverse();
+
+			for ( int j = 0; j < link.numDofs; j++ ) {
+				for ( int k = 0; k < link.numDofs; k++ ) {
+					AddOuter( Ia, link.U[ j ], link.U[ k ], -link.invD.rows[ j ][ k ] );
+				}
+			}
+			pa += Ia * link.velocityProduct;
+			for ( int j = 0; j < link.numDofs; j++ ) {
+				for ( int k = 0; k < link.numDofs; k++ ) {
+					pa += link.U[ j ] * ( link.invD.rows[ j ][ k ] * link.u[ k ] );
+				}
+			}
+		}
+
+		if ( link.parent >= 0 ) {
+			articulationLink_t & parent = m_links[ link.parent ];
+			parent.articulatedInertia.ww += Ia.ww;
+			parent.articulatedInertia.wv += Ia.wv;
+			parent.articulatedInertia.vw += Ia.vw;
+			parent.articulatedInertia.vv += Ia.vv;
+			parent.articulatedBias += pa;
+		}
+	}
+
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		m_links[ i ].isResponseValid = false;
+	}
+}
+
+/*
+====================================================
+Articulation::ForwardDynamics
+
+Gravity and the joint damping, the last pass of the articulated body algorithm
+====================================================
+*/
+void Articulation::ForwardDynamics( const float dt_sec ) {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		spatialVec_t & acceleration = link.deltaVelocity;
+
+		if ( AJ_FLOATING == link.joint ) {
+			acceleration = SolveSpatial( link.articulatedInertia, link.articulatedBias ) * -1.0f;
+			for ( int k = 0; k < 3; k++ ) {
+				link.qd[ k ] += acceleration.w[ k ] * dt_sec;
+				link.qd[ 3 + k ] += acceleration.v[ k ] * dt_sec;
+			}
+			continue;
+		}
+
+		spatialVec_t parentAcceleration( Vec3( 0.0f ), Vec3( 0.0f ) );
+		if ( link.parent >= 0 ) {
+			parentAcceleration = m_links[ link.parent ].deltaVelocity;
+		}
+		parentAcceleration += link.velocityProduct;
+
+		acceleration = parentAcceleration;
+		for ( int j = 0; j < link.numDofs; j++ ) {
+			float qdd = 0.0f;
+			for ( int k = 0; k < link.numDofs; k++ ) {
+				qdd += link.invD.rows[ j ][ k ] * ( link.u[ k ] - Dot( parentAcceleration, link.U[ k ] ) );
+			}
+			acceleration += link.S[ j ] * qdd;
+			link.qd[ j ] += qdd * dt_sec;
+		}
+	}
+}
+
+/*
+====================================================
+Articulation::AdvancePositions
+====================================================
+*/
+void Articulation::AdvancePositions( const float dt_sec ) {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+
+		if ( AJ_FLOATING == link.joint ) {
+			const Vec3 w = link.velocity.w;
+			const Vec3 v = link.velocity.v + w.Cross( link.centerOfMass );
+			link.centerOfMass += v * dt_sec;
+			link.orientation = RotationFromAngularVelocity( w, dt_sec ) * link.orientation;
+			link.orientation.Normalize();
+		} else if ( AJ_REVOLUTE == link.joint ) {
+			link.angle += link.qd[ 0 ] * dt_sec;
+		} else if ( AJ_SPHERICAL == link.joint ) {
+			const Vec3 w = Vec3( link.qd[ 0 ], link.qd[ 1 ], link.qd[ 2 ] );
+			link.relative = RotationFromAngularVelocity( w, dt_sec ) * link.relative;
+			link.relative.Normalize();
+		}
+	}
+
+	UpdateKinematics();
+}
+
+/*
+====================================================
+Articulation::IntegrateVelocities
+
+Runs the free motion through the substeps and keeps where it ends up.  Then the links go back
+to where they started, with the velocities from the end of the step, for the solver.
+====================================================
+*/
+void Articulation::IntegrateVelocities( const float dt_sec ) {
+	const float dt = dt_sec / (float)m_numSubsteps;
+
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		GetPose( m_links[ i ], m_links[ i ].startPose );
+	}
+
+	for ( int step = 0; step < m_numSubsteps; step++ ) {
+		UpdateVelocities();
+		UpdateArticulatedInertias();
+		ForwardDynamics( dt );
+		UpdateVelocities();
+		AdvancePositions( dt );
+	}
+
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		GetPose( link, link.freePose );
+		for ( int k = 0; k < 6; k++ ) {
+			link.freeQd[ k ] = link.qd[ k ];
+		}
+		SetPose( link, link.startPose );
+	}
+
+	UpdateKinematics();
+	UpdateVelocities();
+	UpdateArticulatedInertias();
+	SyncBodies();
+}
+
+/*
+====================================================
+Articulation::IntegratePositions
+
+The free motion from the substeps, plus however much the solver changed the velocities
+====================================================
+*/
+void Articulation::IntegratePositions( const float dt_sec ) {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		SetPose( link, link.freePose );
+
+		float delta[ 6 ];
+		for ( int k = 0; k < 6; k++ ) {
+			delta[ k ] = link.qd[ k ] - link.freeQd[ k ];
+		}
+
+		if ( AJ_FLOATING == link.joint ) {
+			const Vec3 w = Vec3( delta[ 0 ], delta[ 1 ], delta[ 2 ] );
+			const Vec3 v = Vec3( delta[ 3 ], delta[ 4 ], delta[ 5 ] ) + w.Cross( link.centerOfMass );
+			link.centerOfMass += v * dt_sec;
+			link.orientation = RotationFromAngularVelocity( w, dt_sec ) * link.orientation;
+			link.orientation.Normalize();
+		} else if ( AJ_REVOLUTE == link.joint ) {
+			link.angle += delta[ 0 ] * dt_sec;
+		} else if ( AJ_SPHERICAL == link.joint ) {
+			const Vec3 w = Vec3( delta[ 0 ], delta[ 1 ], delta[ 2 ] );
+			link.relative = RotationFromAngularVelocity( w, dt_sec ) * link.relative;
+			link.relative.Normalize();
+		}
+	}
+
+	UpdateKinematics();
+	UpdateVelocities();
+	UpdateArticulatedInertias();
+	SyncBodies();
+}
+
+/*
+====================================================
+Articulation::PropagateImpulse
+
+The velocity change of every link from a spatial impulse on a link, and a generalized impulse on a joint.
+Either can be skipped with a negative link.  The results are left in deltaQd and deltaVelocity.
+====================================================
+*/
+void Articulation::PropagateImpulse( const int link, const spatialVec_t & impulse, const int jointLink, const float * jointImpulse ) {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		m_links[ i ].impulseBias.Zero();
+		m_links[ i ].impulseU[ 0 ] = 0.0f;
+		m_links[ i ].impulseU[ 1 ] = 0.0f;
+		m_links[ i ].impulseU[ 2 ] = 0.0f;
+	}
+	if ( link >= 0 ) {
+		m_links[ link ].impulseBias = impulse * -1.0f;
+	}
+	if ( jointLink >= 0 ) {
+		for ( int k = 0; k < m_links[ jointLink ].numDofs && k < 3; k++ ) {
+			m_links[ jointLink ].impulseU[ k ] = jointImpulse[ k ];
+		}
+	}
+
+	// Inwards, the same as the bias forces but without any velocity terms
+	for ( int i = (int)m_links.size() - 1; i >= 0; i-- ) {
+		articulationLink_t & l = m_links[ i ];
+		if ( AJ_FLOATING == l.joint ) {
+			continue;
+		}
+
+		spatialVec_t pa = l.impulseBias;
+		for ( int j = 0; j < l.numDofs; j++ ) {
+			l.impulseU[ j ] -= Dot( l.S[ j ], l.impulseBias );
+		}
+		for ( int j = 0; j < l.numDofs; j++ ) {
+			for ( int k = 0; k < l.numDofs; k++ ) {
+				pa += l.U[ j ] * ( l.invD.rows[ j ][ k ] * l.impulseU[ k ] );
+			}
+		}
+
+		if ( l.parent >= 0 ) {
+			m_links[ l.parent ].impulseBias += pa;
+		}
+	}
+
+	// Outwards
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & l = m_links[ i ];
+
+		if ( AJ_FLOATING == l.joint ) {
+			l.deltaVelocity = SolveSpatial( l.articulatedInertia, l.impulseBias ) * -1.0f;
+			for ( int k = 0; k < 3; k++ ) {
+				l.deltaQd[ k ] = l.deltaVelocity.w[ k ];
+				l.deltaQd[ 3 + k ] = l.deltaVelocity.v[ k ];
+			}
+			continue;
+		}
+
+		spatialVec_t parentDelta( Vec3( 0.0f ), Vec3( 0.0f ) );
+		if ( l.parent >= 0 ) {
+			parentDelta = m_links[ l.parent ].deltaVelocity;
+		}
+
+		l.deltaVelocity = parentDelta;
+		for ( int j = 0; j < l.numDofs; j++ ) {
+			float dqd = 0.0f;
+			for ( int k = 0; k < l.numDofs; k++ ) {
+				dqd += l.invD.rows[ j ][ k ] * ( l.impulseU[ k ] - Dot( parentDelta, l.U[ k ] ) );
+			}
+			l.deltaQd[ j ] = dqd;
+			l.deltaVelocity += l.S[ j ] * dqd;
+		}
+	}
+}
+
+/*
+====================================================
+Articulation::ApplyDeltaVelocities
+====================================================
+*/
+void Articulation::ApplyDeltaVelocities() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		articulationLink_t & link = m_links[ i ];
+		for ( int k = 0; k < link.numDofs; k++ ) {
+			link.qd[ k ] += link.deltaQd[ k ];
+		}
+		link.velocity += link.deltaVelocity;
+
+		link.body->m_angularVelocity = link.velocity.w;
+		link.body->m_linearVelocity = link.velocity.v + link.velocity.w.Cross( link.centerOfMass );
+	}
+}
+
+/*
+====================================================
+Articulation::ApplyImpulse
+====================================================
+*/
+void Articulation::ApplyImpulse( const int link, const Vec3 & linear, const Vec3 & angular ) {
+	const spatialVec_t impulse( angular + m_links[ link ].centerOfMass.Cross( linear ), linear );
+	PropagateImpulse( link, impulse, -1, NULL );
+	ApplyDeltaVelocities();
+}
+
+/*
+====================================================
+Articulation::GetInverseMassMatrix
+
+The 6x6 response of a link to an impulse on itself, row major with linear then angular.
+It's built from six test impulses the first time it's needed after the articulation moves.
+====================================================
+*/
+const float * Articulation::GetInverseMassMatrix( const int link ) {
+	articulationLink_t & l = m_links[ link ];
+	if ( l.isResponseValid ) {
+		return &l.response[ 0 ][ 0 ];
+	}
+
+	for ( int col = 0; col < 6; col++ ) {
+		Vec3 linear( 0.0f );
+		Vec3 angular( 0.0f );
+		if ( col < 3 ) {
+			linear[ col ] = 1.0f;
+		} else {
+			angular[ col - 3 ] = 1.0f;
+		}
+
+		PropagateImpulse( link, spatialVec_t( angular + l.centerOfMass.Cross( linear ), linear ), -1, NULL );
+
+		const Vec3 dw = l.deltaVelocity.w;
+		const Vec3 dv = l.deltaVelocity.v + dw.Cross( l.centerOfMass );
+		for ( int row = 0; row < 3; row++ ) {
+			l.response[ row ][ col ] = dv[ row ];
+			l.response[ 3 + row ][ col ] = dw[ row ];
+		}
+	}
+
+	l.isResponseValid = true;
+	return &l.response[ 0 ][ 0 ];
+}
+
+/*
+====================================================
+Articulation::SyncBodies
+====================================================
+*/
+void Articulation::SyncBodies() {
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		const articulationLink_t & link = m_links[ i ];
+		Body * body = link.body;
+
+		body->m_orientation = link.orientation;
+		body->m_position = link.centerOfMass - link.orientation.RotatePoint( body->GetCenterOfMassModelSpace() );
+		body->m_angularVelocity = link.velocity.w;
+		body->m_linearVelocity = link.velocity.v + link.velocity.w.Cross( link.centerOfMass );
+	}
+}
+
+/*
+====================================================
+Articulation::AddRow
+
+The row pushes J * qd to at least the target, or towards it for a motor with two sided lambda bounds
+====================================================
+*/
+void Articulation::AddRow( const int link, const Vec3 & J, const float target, const float minLambda, const float maxLambda ) {
+	articulationRow_t row;
+	row.link = link;
+	row.J[ 0 ] = J.x;
+	row.J[ 1 ] = J.y;
+	row.J[ 2 ] = J.z;
+	row.target = target;
+	row.minLambda = minLambda;
+	row.maxLambda = maxLambda;
+	row.lambda = 0.0f;
+
+	PropagateImpulse( -1, spatialVec_t( Vec3( 0.0f ), Vec3( 0.0f ) ), link, row.J );
+	float JMJ = 0.0f;
+	for ( int k = 0; k < m_links[ link ].numDofs; k++ ) {
+		JMJ += row.J[ k ] * m_links[ link ].deltaQd[ k ];
+	}
+	if ( JMJ < 1e-8f ) {
+		return;
+	}
+	row.effectiveMass = 1.0f / JMJ;
+
+	m_rows.push_back( row );
+}
+
+/*
+====================================================
+Articulation::PreSolve
+
+Builds the joint limit and motor rows.  Limits are speculative, they let the joint close the gap
+to the limit this step, and push back a fraction of anything past it.
+====================================================
+*/
+void Articulation::PreSolve( const float dt_sec ) {
+	m_rows.clear();
+
+	const float invDt = 1.0f / dt_sec;
+	for ( int i = 0; i < m_links.size(); i++ ) {
+		const articulationLink_t & link = m_links[ i ];
+
+		if ( AJ_REVOLUTE == link.joint ) {
+			if ( link.hasLimits ) {
+				const float lowerGap = link.angle - link.lower;
+				const float upperGap = link.upper - link.angle;
+				AddRow( i, Vec3( 1, 0, 0 ), -lowerGap * ( ( lowerGap > 0.0f ) ? invDt : s_limitBeta * invDt ), 0.0f, 1e10f );
+				AddRow( i, Vec3( -1, 0, 0 ), -upperGap * ( ( upperGap > 0.0f ) ? invDt : s_limitBeta * invDt ), 0.0f, 1e10f );
+			}
+			if ( link.hasMotor ) {
+				const float maxImpulse = link.motorMaxTorque * dt_sec;
+				AddRow( i, Vec3( 1, 0, 0 ), link.motorSpeed, -maxImpulse, maxImpulse );
+			}
+		} else if ( AJ_SPHERICAL == link.joint && link.hasLimits ) {
+			// The swing away from the cone's axis, the joint's velocities are in the parent's space
+			const Quat parentOrientation = ( link.parent >= 0 ) ? m_links[ link.parent ].orientation : Quat( 0, 0, 0, 1 );
+			const Vec3 parentAxis = parentOrientation.RotatePoint( link.parentAxis );
+			const Vec3 childAxis = link.orientation.RotatePoint( link.childAxis );
+
+			Vec3 n = parentAxis.Cross( childAxis );
+			if ( n.GetLengthSqr() < 1e-8f ) {
+				continue;
+			}
+			n.Normalize();
+
+			float cosAngle = parentAxis.Dot( childAxis );
+			cosAngle = ( cosAngle > 1.0f ) ? 1.0f : ( ( cosAngle < -1.0f ) ? -1.0f : cosAngle );
+			const float gap = link.upper - acosf( cosAngle );
+
+			const Vec3 J = parentOrientation.Inverse().RotatePoint( n ) * -1.0f;
+			AddRow( i, J, -gap * ( ( gap > 0.0f ) ? invDt : s_limitBeta * invDt ), 0.0f, 1e10f );
+		}
+	}
+}
+
+/*
+====================================================
+Articulation::Solve
+====================================================
+*/
+void Articulation::Solve() {
+	for ( int i = 0; i < m_rows.size(); i++ ) {
+		articulationRow_t & row = m_rows[ i ];
+		const articulationLink_t & link = m_links[ row.link ];
+
+		float Jqd = 0.0f;
+		for ( int k = 0; k < link.numDofs; k++ ) {
+			Jqd += row.J[ k ] * link.qd[ k ];
+		}
+
+		const float oldLambda = row.lambda;
+		row.lambda += row.effectiveMass * ( row.target - Jqd );
+		row.lambda = ( row.lambda < row.minLambda ) ? row.minLambda : ( ( row.lambda > row.maxLambda ) ? row.maxLambda : row.lambda );
+		const float deltaLambda = row.lambda - oldLambda;
+		if ( 0.0f == deltaLambda ) {
+			continue;
+		}
+
+		const float jointImpulse[ 3 ] = { row.J[ 0 ] * deltaLambda, row.J[ 1 ] * deltaLambda, row.J[ 2 ] * deltaLambda };
+		PropagateImpulse( -1, spatialVec_t( Vec3( 0.0f ), Vec3( 0.0f ) ), row.link, jointImpulse );
+		ApplyDeltaVelocities();
+	}
+}
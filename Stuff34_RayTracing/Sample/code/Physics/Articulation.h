@@ -0,0 +1,231 @@
+//
+//	Articulation.h
+//
+#pragma once
+#include <vector>
+#include "Math/Vector.h"
+#include "Math/Quat.h"
+#include "Math/Matrix.h"
+#include "Physics/Body.h"
+
+class PhysicsWorld;
+
+/*
+====================================================
+articulationJoint_t
+====================================================
+*/
+enum articulationJoint_t {
+	AJ_FIXED = 0,	// welded to the parent
+	AJ_REVOLUTE,	// rotates about one axis
+	AJ_SPHERICAL,	// rotates freely about the pivot
+	AJ_FLOATING,	// the root only, it isn't attached to anything
+};
+
+/*
+====================================================
+spatialVec_t
+
+Six dimensional motion or force, in world space about the world origin.
+For motion w is the angular velocity and v is the velocity of the body's point at the origin.
+For force w is the torque about the origin and v is the force.
+====================================================
+*/
+struct spatialVec_t {
+	spatialVec_t() {}
+	spatialVec_t( const Vec3 & W, const Vec3 & V ) : w( W ), v( V ) {}
+
+	spatialVec_t operator + ( const spatialVec_t & rhs ) const { return spatialVec_t( w + rhs.w, v + rhs.v ); }
+	spatialVec_t operator - ( const spatialVec_t & rhs ) const { return spatialVec_t( w - rhs.w, v - rhs.v ); }
+	spatialVec_t operator * ( const float rhs ) const { return spatialVec_t( w * rhs, v * rhs ); }
+	const spatialVec_t & operator += ( const spatialVec_t & rhs ) { w += rhs.w; v += rhs.v; return *this; }
+
+	void Zero() { w.Zero(); v.Zero(); }
+
+	Vec3 w;
+	Vec3 v;
+};
+
+/*
+====================================================
+spatialMat_t
+
+Maps spatial motion to spatial force, the blocks are [ ww wv ][ vw vv ]
+====================================================
+*/
+struct spatialMat_t {
+	spatialVec_t operator * ( const spatialVec_t & rhs ) const { return spatialVec_t( ww * rhs.w + wv * rhs.v, vw * rhs.w + vv * rhs.v ); }
+
+	Mat3 ww;
+	Mat3 wv;
+	Mat3 vw;
+	Mat3 vv;
+};
+
+/*
+====================================================
+articulationPose_t
+
+Where a link's joint is, floating links use the center of mass and orientation instead
+====================================================
+*/
+struct articulationPose_t {
+	float angle;
+	Quat relative;
+	Vec3 centerOfMass;
+	Quat orientation;
+};
+
+/*
+====================================================
+articulationLink_t
+====================================================
+*/
+struct articulationLink_t {
+	int parent;		// -1 for the root, whose parent is the world
+	Body * body;
+	int bodyId;
+	articulationJoint_t joint;
+	int numDofs;
+
+	// The joint in center of mass space, the root's parent space is world space
+	Vec3 parentAnchor;
+	Vec3 childAnchor;
+	Vec3 parentAxis;		// the hinge axis, or the middle of a spherical joint's cone
+	Vec3 childAxis;
+	Quat restOrientation;	// the child's orientation relative to the parent when it was added
+
+	// Joint position and velocity.  Spherical joints rotate relative to the parent by the angular velocity
+	// in qd, in the parent's space.  The floating root's position is its center of mass and orientation,
+	// and its velocity is spatial.
+	float angle;
+	Quat relative;
+	float qd[ 6 ];
+
+	bool hasLimits;
+	float lower;
+	float upper;
+	bool hasMotor;
+	float motorSpeed;
+	float motorMaxTorque;
+	float damping;
+
+	float mass;
+	Mat3 inertia;		// about the center of mass, in body space
+
+	// World space kinematics from the current position
+	Vec3 centerOfMass;
+	Quat orientation;
+	spatialVec_t S[ 3 ];	// motion of each joint dof
+	spatialVec_t velocity;
+	spatialVec_t velocityProduct;
+
+	// Articulated body inertias, they only depend on the position so they're kept for the impulses
+	spatialMat_t articulatedInertia;
+	spatialVec_t articulatedBias;
+	spatialVec_t U[ 3 ];
+	Mat3 invD;
+	float u[ 3 ];
+
+	// Scratch for propagating impulses
+	spatialVec_t impulseBias;
+	float impulseU[ 3 ];
+	spatialVec_t deltaVelocity;
+	float deltaQd[ 6 ];
+
+	// The free motion from the substeps, the solver's change in velocity is added onto it
+	articulationPose_t startPose;
+	articulationPose_t freePose;
+	float freeQd[ 6 ];
+
+	bool isResponseValid;
+	float response[ 6 ][ 6 ];	// velocity change of the link from an impulse on it, linear then angular
+};
+
+/*
+====================================================
+articulationRow_t
+
+A joint limit or motor row, acting on one joint's velocities
+====================================================
+*/
+struct articulationRow_t {
+	int link;
+	float J[ 3 ];
+	float effectiveMass;
+	float target;			// J * qd is pushed towards this
+	float minLambda;
+	float maxLambda;
+	float lambda;
+};
+
+/*
+====================================================
+Articulation
+
+A tree of bodies joined in reduced coordinates, for ragdolls and chains.  The joints only have the
+degrees of freedom they allow, so they can't come apart, and forward dynamics is Featherstone's
+articulated body algorithm, which is linear in the number of links.
+
+The links are regular bodies in the physics world, so they collide and can be queried and drawn like
+any other body.  Their velocities are owned by the articulation though.  An impulse on a link is
+propagated through the whole tree, and the contact solver gets each link's inverse mass as seen through
+the rest of the articulation.  Links of the same articulation don't collide with each other.
+
+Joint limits and motors are solved alongside the contacts in the world's island.  Limits are
+revolute angles from where the link was added, or a spherical joint's cone half angle.
+
+Long chains whip their ends around faster than a frame's explicit step can follow, so the free motion
+is integrated in substeps.  The solver's velocity change is added on top at the end of the step.
+Articulations aren't part of the world's saved state.
+====================================================
+*/
+class Articulation {
+public:
+	explicit Articulation( PhysicsWorld * world );
+
+	// Links are added parents first, and the first one is the root with a parent of -1.  The root's joint
+	// attaches it to the world, unless it's floating.  The body is copied into the world where it is.
+	// The pivot and axis are in world space, and the axis is only used by revolute and spherical joints.
+	int AddLink( const int parent, const Body & body, const articulationJoint_t joint, const Vec3 & pivot, const Vec3 & axis );
+	void RemoveFromWorld();		// frees the link bodies, unregister the articulation first
+
+	void SetLimits( const int link, const float lower, const float upper );
+	void SetMotor( const int link, const float targetSpeed, const float maxTorque );	// revolute joints only
+	void SetDamping( const int link, const float damping );
+	void SetNumSubsteps( const int numSubsteps );
+	int GetNumSubsteps() const { return m_numSubsteps; }
+
+	int GetNumLinks() const { return (int)m_links.size(); }
+	int GetLinkParent( const int link ) const { return m_links[ link ].parent; }
+	const Body * GetLinkBody( const int link ) const { return m_links[ link ].body; }
+	float GetJointAngle( const int link ) const { return m_links[ link ].angle; }
+	float GetJointSpeed( const int link ) const { return m_links[ link ].qd[ 0 ]; }
+
+	// The physics world runs these during its step
+	void IntegrateVelocities( const float dt_sec );
+	void IntegratePositions( const float dt_sec );
+	void PreSolve( const float dt_sec );
+	void Solve();
+	void ApplyImpulse( const int link, const Vec3 & linear, const Vec3 & angular );	// about the link's center of mass
+	const float * GetInverseMassMatrix( const int link );
+	int GetNumRows() const { return (int)m_rows.size(); }
+
+private:
+	void UpdateKinematics();
+	void UpdateVelocities();
+	void UpdateArticulatedInertias();
+	void ForwardDynamics( const float dt_sec );
+	void AdvancePositions( const float dt_sec );
+	void GetPose( const articulationLink_t & link, articulationPose_t & pose ) const;
+	void SetPose( articulationLink_t & link, const articulationPose_t & pose );
+	void PropagateImpulse( const int link, const spatialVec_t & impulse, const int jointLink, const float * jointImpulse );
+	void ApplyDeltaVelocities();
+	void SyncBodies();
+	void AddRow( const int link, const Vec3 & J, const float target, const float minLambda, const float maxLambda );
+
+	PhysicsWorld * m_world;
+	int m_numSubsteps;
+	std::vector< articulationLink_t > m_links;
+	std::vector< articulationRow_t > m_rows;
+};
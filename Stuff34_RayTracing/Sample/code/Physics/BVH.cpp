@@ -4,6 +4,7 @@
 #include "Physics/BVH.h"
 #include "Physics/Body.h"
 #include "Physics/PhysicsWorld.h"
+#include "Physics/PhysicsStats.h"
 #include "Math/Random.h"
 #include "Math/Morton.h"
 #include <stack>
@@ -305,7 +306,20 @@ BoundingVolumeHierarchy::node_t::node_t( bodyBounds_t * bodyIds, int numBodies )
 		return;
 	}
 
-	const int axis = int( 3.0f * Random::Get() );
+	// Split along the widest spread of the sort keys.  The axis used to be random, but then the
+	// order of the collision pairs depended on the random number generator, and replaying a saved
+	// physics state wouldn't give the same results.
+	Bounds spread;
+	for ( int i = 0; i < numBodies; i++ ) {
+		spread.Expand( bodyIds[ i ].m_bounds.mins );
+	}
+	int axis = 0;
+	if ( spread.WidthY() > spread.WidthX() ) {
+		axis = 1;
+	}
+	if ( spread.WidthZ() > spread.WidthX() && spread.WidthZ() > spread.WidthY() ) {
+		axis = 2;
+	}
 	switch ( axis ) {
 		default:
 		case 0: { qsort( bodyIds, numBodies, sizeof( BoundingVolumeHierarchy::bodyBounds_t ), BoundsCompareX ); } break;
@@ -386,6 +400,9 @@ void BoundingVolumeHierarchy::Build( const PhysicsWorld * world, const float dt_
 	//	Build the hierarchy
 	//
 	m_nodes = new node_t( bodies, numUsedBodies );
+	if ( numUsedBodies > 0 ) {
+		GetPhysicsCounters().numBytesAllocated += ( 2 * numUsedBodies - 1 ) * (int)sizeof( node_t );
+	}
 
 //	Print_r( m_nodes, 0 );
 }
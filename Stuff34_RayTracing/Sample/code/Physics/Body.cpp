@@ -2,6 +2,7 @@
 //  Body.cpp
 //
 #include "Physics/Body.h"
+#include "Physics/Articulation.h"
 #define MAX_ANGULAR_SPEED 30.0f
 
 const bodyID_t bodyID_invalid;
@@ -38,6 +39,8 @@ void Body::Reset() {
 	m_owner = NULL;
 	m_callbacks = NULL;
 	m_callbacks2 = NULL;
+	m_articulation = NULL;
+	m_articulationLink = -1;
 }
 
 /*
@@ -119,11 +122,17 @@ void Body::ApplyImpulse( const Vec3 & impulsePoint, const Vec3 & impulse ) {
 
 	// impulsePoint is the world space location of the application of the impulse
 	// impulse is the world space direction and magnitude of the impulse
-	ApplyImpulseLinear( impulse );
-
 	Vec3 position = GetCenterOfMassWorldSpace();	// applying impulses must produce torques through the center of mass
 	Vec3 r = impulsePoint - position;
 	Vec3 dL = r.Cross( impulse );	// this is in world space
+
+	// Articulations propagate the whole impulse through their links at once
+	if ( NULL != m_articulation ) {
+		m_articulation->ApplyImpulse( m_articulationLink, impulse, dL );
+		return;
+	}
+
+	ApplyImpulseLinear( impulse );
 	ApplyImpulseAngular( dL );
 }
 
@@ -137,6 +146,11 @@ void Body::ApplyImpulseLinear( const Vec3 & impulse ) {
 		return;
 	}
 
+	if ( NULL != m_articulation ) {
+		m_articulation->ApplyImpulse( m_articulationLink, impulse, Vec3( 0.0f ) );
+		return;
+	}
+
 	// p = mv
 	// dp = m dv = J
 	// => dv = J / m
@@ -152,6 +166,10 @@ void Body::ApplyImpulseAngular( const Vec3 & impulse ) {
 	if ( 0.0f == m_invMass || !m_enableRotation ) {
 		return;
 	}
+	if ( NULL != m_articulation ) {
+		m_articulation->ApplyImpulse( m_articulationLink, Vec3( 0.0f ), impulse );
+		return;
+	}
 
 	// L = I w = r x p
 	// dL = I dw = r x J 
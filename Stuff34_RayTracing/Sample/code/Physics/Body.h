@@ -10,6 +10,7 @@
 #include "Physics/Contact.h"
 
 class Body;
+class Articulation;
 
 /*
 ====================================================
@@ -103,6 +104,9 @@ public:
 	PhysicsCallbacks_t *	m_callbacks;	// pointer to function callbacks
 	PhysicsCallbacks2 *		m_callbacks2;	// pointer to function callbacks
 
+	Articulation *			m_articulation;		// set for articulation links, the articulation owns their velocities
+	int						m_articulationLink;
+
 	Vec3 GetCenterOfMassWorldSpace() const;	// returns the center of mass in world space
 	Vec3 GetCenterOfMassModelSpace() const;	// returns the center of mass in model space
 
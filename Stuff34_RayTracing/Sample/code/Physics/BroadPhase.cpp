@@ -5,11 +5,109 @@
 #include "Physics/Body.h"
 #include "Physics/PhysicsWorld.h"
 #include "Physics/BVH.h"
+#include "Physics/PhysicsStats.h"
 #include "JobSystem/JobSystem.h"
 
 /*
 ========================================================================================================
 
+CollisionPairSet
+
+========================================================================================================
+*/
+
+/*
+====================================================
+CollisionPairSet::HashKey
+====================================================
+*/
+unsigned int CollisionPairSet::HashKey( const unsigned long long key ) {
+	unsigned long long h = key * 0x9E3779B97F4A7C15ULL;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	return (unsigned int)h;
+}
+
+/*
+====================================================
+CollisionPairSet::Clear
+====================================================
+*/
+void CollisionPairSet::Clear( const int expectedPairs ) {
+	// Keep the load factor under one half
+	int size = 64;
+	while ( size < expectedPairs * 2 ) {
+		size *= 2;
+	}
+
+	if ( (int)m_table.size() < size ) {
+		m_table.resize( size );
+		GetPhysicsCounters().numBytesAllocated += size * (int)sizeof( unsigned long long );
+	}
+	for ( int i = 0; i < m_table.size(); i++ ) {
+		m_table[ i ] = ~0ULL;
+	}
+	m_numEntries = 0;
+}
+
+/*
+====================================================
+CollisionPairSet::GrowTable
+====================================================
+*/
+void CollisionPairSet::GrowTable() {
+	std::vector< unsigned long long > old;
+	old.swap( m_table );
+
+	const int newSize = old.empty() ? 64 : (int)old.size() * 2;
+	m_table.resize( newSize, ~0ULL );
+	GetPhysicsCounters().numBytesAllocated += newSize * (int)sizeof( unsigned long long );
+
+	const unsigned int mask = (unsigned int)newSize - 1;
+	for ( int i = 0; i < old.size(); i++ ) {
+		if ( ~0ULL == old[ i ] ) {
+			continue;
+		}
+		unsigned int idx = HashKey( old[ i ] ) & mask;
+		while ( ~0ULL != m_table[ idx ] ) {
+			idx = ( idx + 1 ) & mask;
+		}
+		m_table[ idx ] = old[ i ];
+	}
+}
+
+/*
+====================================================
+CollisionPairSet::Insert
+====================================================
+*/
+bool CollisionPairSet::Insert( const int a, const int b ) {
+	if ( 2 * ( m_numEntries + 1 ) > (int)m_table.size() ) {
+		GrowTable();
+	}
+
+	const unsigned int lo = (unsigned int)( ( a < b ) ? a : b );
+	const unsigned int hi = (unsigned int)( ( a < b ) ? b : a );
+	const unsigned long long key = ( (unsigned long long)lo << 32 ) | (unsigned long long)hi;
+
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int idx = HashKey( key ) & mask;
+	while ( ~0ULL != m_table[ idx ] ) {
+		if ( key == m_table[ idx ] ) {
+			return false;
+		}
+		idx = ( idx + 1 ) & mask;
+	}
+
+	m_table[ idx ] = key;
+	m_numEntries++;
+	return true;
+}
+
+/*
+========================================================================================================
+
 BroadPhase
 
 ========================================================================================================
@@ -169,6 +267,21 @@ void SweepAndPrune( const Body * bodies, const int * bodyIDs, const int num, std
 
 
 
+/*
+====================================================
+CountBodies
+====================================================
+*/
+static int CountBodies( const BodyPoolNode_t * nodes ) {
+	int numBodies = 0;
+	const BodyPoolNode_t * node = nodes;
+	while ( NULL != node ) {
+		node = node->m_next;
+		numBodies++;
+	}
+	return numBodies;
+}
+
 /*
 ====================================================
 BroadPhase_LBVH
@@ -178,6 +291,9 @@ void BroadPhase_LBVH( const Body * bodies, const BodyPoolNode_t * nodes, std::ve
 	LBVH lbvh;
 	lbvh.Build( g_physicsWorld, dt_sec );
 
+	CollisionPairSet pairSet;
+	pairSet.Clear( CountBodies( nodes ) * 4 );
+
 	std::vector< int > colliders;
 	const BodyPoolNode_t * node = nodes;
 	while ( NULL != node ) {
@@ -191,7 +307,7 @@ void BroadPhase_LBVH( const Body * bodies, const BodyPoolNode_t * nodes, std::ve
 			pair.b = colliders[ i ];
 			
 			// Add this pair only if it's unique
-			if ( std::find( finalPairs.begin(), finalPairs.end(), pair ) == finalPairs.end() ) {
+			if ( pairSet.Insert( pair.a, pair.b ) ) {
 				finalPairs.push_back( pair );
 			}
 		}
@@ -266,6 +382,8 @@ void BroadPhase_BVH( const Body * bodies, const BodyPoolNode_t * nodes, std::vec
 
 	// Collect the unique pairs
 	finalPairs.clear();
+	CollisionPairSet pairSet;
+	pairSet.Clear( (int)datas.size() * 4 );
 	for ( int i = 0; i < datas.size(); i++ ) {
 		const BroadPhaseData_t & data = datas[ i ];
 
@@ -275,13 +393,16 @@ void BroadPhase_BVH( const Body * bodies, const BodyPoolNode_t * nodes, std::vec
 			pair.b = data.colliders[ i ];
 			
 			// Add this pair only if it's unique
-			if ( std::find( finalPairs.begin(), finalPairs.end(), pair ) == finalPairs.end() ) {
+			if ( pairSet.Insert( pair.a, pair.b ) ) {
 				finalPairs.push_back( pair );
 			}
 		}
 	}
 
 #else
+	CollisionPairSet pairSet;
+	pairSet.Clear( CountBodies( nodes ) * 4 );
+
 	std::vector< int > colliders;
 	const BodyPoolNode_t * node = nodes;
 	while ( NULL != node ) {
@@ -295,39 +416,27 @@ void BroadPhase_BVH( const Body * bodies, const BodyPoolNode_t * nodes, std::vec
 			pair.b = colliders[ i ];
 			
 			// Add this pair only if it's unique
-			if ( std::find( finalPairs.begin(), finalPairs.end(), pair ) == finalPairs.end() ) {
+			if ( pairSet.Insert( pair.a, pair.b ) ) {
 				finalPairs.push_back( pair );
 			}
 		}
 
 		node = node->m_next;
 	}
+	GetPhysicsCounters().numBytesAllocated += (int)( colliders.capacity() * sizeof( int ) );
 #endif
 }
 
 /*
 ====================================================
-BroadPhase
+BroadPhase_SAP
 ====================================================
 */
-void BroadPhase( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
-#define USE_BVH
-//#define USE_LBVH
-#if defined( USE_BVH )
-	BroadPhase_BVH( bodies, nodes, finalPairs, dt_sec );
-#elif defined( USE_LBVH )
-	BroadPhase_LBVH( bodies, nodes, finalPairs, dt_sec );
-#else
-	int numBodies = 0;
-	const BodyPoolNode_t * node = nodes;
-	while ( NULL != node ) {
-		node = node->m_next;
-		numBodies++;
-	}
-
+void BroadPhase_SAP( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	int numBodies = CountBodies( nodes );
 	int * bodyIDs = (int *)alloca( sizeof( int ) * numBodies );
 
-	node = nodes;
+	const BodyPoolNode_t * node = nodes;
 	numBodies = 0;
 	while ( NULL != node ) {
 		bodyIDs[ numBodies ] = node->bodyID;
@@ -336,5 +445,54 @@ void BroadPhase( const Body * bodies, const BodyPoolNode_t * nodes, std::vector<
 	}
 
 	SweepAndPrune( bodies, bodyIDs, numBodies, finalPairs, dt_sec );
-#endif
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+BroadPhaseName
+====================================================
+*/
+const char * BroadPhaseName( const broadPhase_t type ) {
+	static const char * names[ BROADPHASE_NUM ] = {
+		"sap",
+		"bvh",
+		"lbvh",
+		"hash_grid",
+		"auto",
+	};
+	if ( type < 0 || type >= BROADPHASE_NUM ) {
+		return "unknown";
+	}
+	return names[ type ];
+}
+
+/*
+====================================================
+BroadPhase
+
+The hash grid keeps its cells between steps, so it's run by whoever owns it instead
+====================================================
+*/
+void BroadPhase( const broadPhase_t type, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	switch ( type ) {
+		case BROADPHASE_SAP: {
+			BroadPhase_SAP( bodies, nodes, finalPairs, dt_sec );
+		} break;
+		case BROADPHASE_LBVH: {
+			BroadPhase_LBVH( bodies, nodes, finalPairs, dt_sec );
+		} break;
+		default:
+		case BROADPHASE_BVH: {
+			BroadPhase_BVH( bodies, nodes, finalPairs, dt_sec );
+		} break;
+	}
+}
+
+/*
+====================================================
+BroadPhase
+====================================================
+*/
+void BroadPhase( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	BroadPhase( BROADPHASE_BVH, bodies, nodes, finalPairs, dt_sec );
+}
@@ -19,5 +19,49 @@ struct collisionPair_t {
 	}
 };
 
+/*
+====================================================
+broadPhase_t
+====================================================
+*/
+enum broadPhase_t {
+	BROADPHASE_SAP = 0,		// sweep and prune along the diagonal
+	BROADPHASE_BVH,
+	BROADPHASE_LBVH,
+	BROADPHASE_HASH_GRID,	// multi level spatial hash that's kept between steps, see BroadPhaseHashGrid
+	BROADPHASE_AUTO,		// measures the others as it goes and uses the cheapest, see BroadPhaseManager
+	BROADPHASE_NUM,
+};
+
+const char * BroadPhaseName( const broadPhase_t type );
+
+/*
+====================================================
+CollisionPairSet
+
+Open addressed set of body id pairs, for throwing out the pairs a broadphase finds more than once.
+The pairs are unordered, so ( a, b ) and ( b, a ) are the same pair.
+====================================================
+*/
+class CollisionPairSet {
+public:
+	CollisionPairSet() : m_numEntries( 0 ) {}
+
+	void Clear( const int expectedPairs );	// sizes the table so this many pairs won't need to grow it
+	bool Insert( const int a, const int b );	// false if the pair was already in the set
+	int GetNumPairs() const { return m_numEntries; }
+
+private:
+	static unsigned int HashKey( const unsigned long long key );
+	void GrowTable();
+
+	std::vector< unsigned long long >	m_table;	// the smaller id in the high bits, size is always zero or a power of two
+	int									m_numEntries;
+};
+
 void BroadPhase( const Body * bodies, const int num, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
-void BroadPhase( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
\ No newline at end of file
+void BroadPhase( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
+void BroadPhase( const broadPhase_t type, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );	// everything except the hash grid and auto
+void BroadPhase_SAP( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
+void BroadPhase_BVH( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
+void BroadPhase_LBVH( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
@@ -0,0 +1,610 @@
+//
+//  BroadPhaseHashGrid.cpp
+//
+#include "Physics/BroadPhaseHashGrid.h"
+#include "Physics/Body.h"
+#include "Physics/PhysicsWorld.h"
+#include "Physics/PhysicsStats.h"
+#include "JobSystem/JobSystem.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+/*
+====================================================
+CellCoord
+
+Clamped so that bodies flung far out of the world can't overflow the cell coordinates
+====================================================
+*/
+static int CellCoord( const float value, const float invCellSize ) {
+	float coord = floorf( value * invCellSize );
+	coord = ( coord < -1e8f ) ? -1e8f : ( ( coord > 1e8f ) ? 1e8f : coord );
+	return (int)coord;
+}
+
+/*
+====================================================
+ComparePairs
+====================================================
+*/
+static bool ComparePairs( const collisionPair_t & lhs, const collisionPair_t & rhs ) {
+	if ( lhs.a != rhs.a ) {
+		return ( lhs.a < rhs.a );
+	}
+	return ( lhs.b < rhs.b );
+}
+
+/*
+====================================================
+MakePair
+
+The smaller id goes first
+====================================================
+*/
+static collisionPair_t MakePair( const int a, const int b ) {
+	collisionPair_t pair;
+	pair.a = ( a < b ) ? a : b;
+	pair.b = ( a < b ) ? b : a;
+	return pair;
+}
+
+/*
+========================================================================================================
+
+BroadPhaseHashGrid
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BroadPhaseHashGrid::BroadPhaseHashGrid
+====================================================
+*/
+BroadPhaseHashGrid::BroadPhaseHashGrid() : m_numTableEntries( 0 ) {
+	SetCellSize( 1.0f );
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::SetCellSize
+====================================================
+*/
+void BroadPhaseHashGrid::SetCellSize( const float cellSize ) {
+	if ( cellSize <= 0.0f ) {
+		printf( "WARNING: BroadPhaseHashGrid::SetCellSize: invalid cell size %f\n", cellSize );
+		return;
+	}
+
+	m_cellSize = cellSize;
+	float size = cellSize;
+	for ( int i = 0; i < NUM_LEVELS; i++ ) {
+		m_invCellSizes[ i ] = 1.0f / size;
+		size *= 2.0f;
+	}
+	Clear();
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::Clear
+====================================================
+*/
+void BroadPhaseHashGrid::Clear() {
+	for ( int i = 0; i <= NUM_LEVELS; i++ ) {
+		m_levelCounts[ i ] = 0;
+	}
+	m_stamp = 0;
+	m_numMovedBodies = 0;
+
+	m_bodies.clear();
+	m_trackedBodies.clear();
+	m_oversized.clear();
+	m_cells.clear();
+	m_freeCells.clear();
+	m_activeCells.clear();
+	m_table.clear();
+	m_numTableEntries = 0;
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::CellRange
+====================================================
+*/
+void BroadPhaseHashGrid::CellRange( const Bounds & bounds, const int level, int * mins, int * maxs ) const {
+	const float invCellSize = m_invCellSizes[ level ];
+	for ( int i = 0; i < 3; i++ ) {
+		mins[ i ] = CellCoord( bounds.mins[ i ], invCellSize );
+		maxs[ i ] = CellCoord( bounds.maxs[ i ], invCellSize );
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::ChooseCells
+
+The lowest level whose cells are as big as the bounds
+====================================================
+*/
+void BroadPhaseHashGrid::ChooseCells( const Bounds & bounds, int & level, int * mins, int * maxs ) const {
+	float extent = bounds.WidthX();
+	extent = ( bounds.WidthY() > extent ) ? bounds.WidthY() : extent;
+	extent = ( bounds.WidthZ() > extent ) ? bounds.WidthZ() : extent;
+
+	level = 0;
+	float cellSize = m_cellSize;
+	while ( extent > cellSize && level < NUM_LEVELS ) {
+		cellSize *= 2.0f;
+		level++;
+	}
+
+	if ( level >= NUM_LEVELS ) {
+		level = OVERSIZED;
+		for ( int i = 0; i < 3; i++ ) {
+			mins[ i ] = 0;
+			maxs[ i ] = 0;
+		}
+		return;
+	}
+	CellRange( bounds, level, mins, maxs );
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::InsertBody
+====================================================
+*/
+void BroadPhaseHashGrid::InsertBody( const int bodyId ) {
+	const hashGridBody_t & body = m_bodies[ bodyId ];
+	m_levelCounts[ body.level ]++;
+
+	if ( OVERSIZED == body.level ) {
+		m_oversized.push_back( bodyId );
+		return;
+	}
+
+	for ( int z = body.mins[ 2 ]; z <= body.maxs[ 2 ]; z++ ) {
+		for ( int y = body.mins[ 1 ]; y <= body.maxs[ 1 ]; y++ ) {
+			for ( int x = body.mins[ 0 ]; x <= body.maxs[ 0 ]; x++ ) {
+				AddToCell( body.level, x, y, z, bodyId );
+			}
+		}
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::RemoveBody
+====================================================
+*/
+void BroadPhaseHashGrid::RemoveBody( const int bodyId ) {
+	hashGridBody_t & body = m_bodies[ bodyId ];
+	m_levelCounts[ body.level ]--;
+
+	if ( OVERSIZED == body.level ) {
+		m_oversized.erase( std::find( m_oversized.begin(), m_oversized.end(), bodyId ) );
+	} else {
+		for ( int z = body.mins[ 2 ]; z <= body.maxs[ 2 ]; z++ ) {
+			for ( int y = body.mins[ 1 ]; y <= body.maxs[ 1 ]; y++ ) {
+				for ( int x = body.mins[ 0 ]; x <= body.maxs[ 0 ]; x++ ) {
+					RemoveFromCell( body.level, x, y, z, bodyId );
+				}
+			}
+		}
+	}
+	body.level = -1;
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::Update
+
+Only the bodies that covered a different range of cells since the last update are moved
+====================================================
+*/
+void BroadPhaseHashGrid::Update( const Body * bodies, const BodyPoolNode_t * nodes, const float dt_sec ) {
+	m_stamp++;
+	m_numMovedBodies = 0;
+
+	const BodyPoolNode_t * node = nodes;
+	while ( NULL != node ) {
+		const int bodyId = node->bodyID;
+		node = node->m_next;
+
+		if ( bodyId >= (int)m_bodies.size() ) {
+			hashGridBody_t empty;
+			empty.level = -1;
+			empty.stamp = 0;
+			m_bodies.resize( bodyId + 1, empty );
+			GetPhysicsCounters().numBytesAllocated += (int)( m_bodies.capacity() * sizeof( hashGridBody_t ) );
+		}
+
+		hashGridBody_t & body = m_bodies[ bodyId ];
+		body.stamp = m_stamp;
+		body.bounds = bodies[ bodyId ].GetBounds( dt_sec );
+
+		int level;
+		int mins[ 3 ];
+		int maxs[ 3 ];
+		ChooseCells( body.bounds, level, mins, maxs );
+
+		const bool isTracked = ( body.level >= 0 );
+		if ( isTracked && level == body.level &&
+			mins[ 0 ] == body.mins[ 0 ] && mins[ 1 ] == body.mins[ 1 ] && mins[ 2 ] == body.mins[ 2 ] &&
+			maxs[ 0 ] == body.maxs[ 0 ] && maxs[ 1 ] == body.maxs[ 1 ] && maxs[ 2 ] == body.maxs[ 2 ] ) {
+			continue;
+		}
+
+		if ( isTracked ) {
+			RemoveBody( bodyId );
+		} else {
+			m_trackedBodies.push_back( bodyId );
+		}
+
+		body.level = level;
+		for ( int i = 0; i < 3; i++ ) {
+			body.mins[ i ] = mins[ i ];
+			body.maxs[ i ] = maxs[ i ];
+		}
+		InsertBody( bodyId );
+		m_numMovedBodies++;
+	}
+
+	// Take out the bodies that have been freed
+	int numTracked = 0;
+	for ( int i = 0; i < m_trackedBodies.size(); i++ ) {
+		const int bodyId = m_trackedBodies[ i ];
+		if ( m_bodies[ bodyId ].stamp == m_stamp ) {
+			m_trackedBodies[ numTracked ] = bodyId;
+			numTracked++;
+		} else {
+			RemoveBody( bodyId );
+		}
+	}
+	m_trackedBodies.resize( numTracked );
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::HashCell
+====================================================
+*/
+unsigned int BroadPhaseHashGrid::HashCell( const int level, const int x, const int y, const int z ) {
+	unsigned int h = (unsigned int)x * 73856093u;
+	h ^= (unsigned int)y * 19349663u;
+	h ^= (unsigned int)z * 83492791u;
+	h ^= (unsigned int)level * 2654435761u;
+
+	// Spread the low bits, the table is indexed by them
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h;
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::FindCell
+====================================================
+*/
+int BroadPhaseHashGrid::FindCell( const int level, const int x, const int y, const int z ) const {
+	if ( m_table.empty() ) {
+		return -1;
+	}
+
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int idx = HashCell( level, x, y, z ) & mask;
+	while ( -1 != m_table[ idx ] ) {
+		const hashGridCell_t & cell = m_cells[ m_table[ idx ] ];
+		if ( cell.x == x && cell.y == y && cell.z == z && cell.level == level ) {
+			return m_table[ idx ];
+		}
+		idx = ( idx + 1 ) & mask;
+	}
+	return -1;
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::GrowTable
+====================================================
+*/
+void BroadPhaseHashGrid::GrowTable() {
+	const int newSize = m_table.empty() ? 256 : (int)m_table.size() * 2;
+
+	m_table.clear();
+	m_table.resize( newSize, -1 );
+	GetPhysicsCounters().numBytesAllocated += newSize * (int)sizeof( int );
+	m_numTableEntries = 0;
+
+	for ( int i = 0; i < m_activeCells.size(); i++ ) {
+		InsertEntry( m_activeCells[ i ] );
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::InsertEntry
+====================================================
+*/
+void BroadPhaseHashGrid::InsertEntry( const int cellIdx ) {
+	// Keep the load factor under one half, so probe sequences stay short
+	if ( 2 * ( m_numTableEntries + 1 ) > (int)m_table.size() ) {
+		GrowTable();
+	}
+
+	const hashGridCell_t & cell = m_cells[ cellIdx ];
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int idx = HashCell( cell.level, cell.x, cell.y, cell.z ) & mask;
+	while ( -1 != m_table[ idx ] ) {
+		idx = ( idx + 1 ) & mask;
+	}
+
+	m_table[ idx ] = cellIdx;
+	m_numTableEntries++;
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::RemoveEntry
+
+Uses backward shift deletion, so the table never fills up with tombstones
+====================================================
+*/
+void BroadPhaseHashGrid::RemoveEntry( const int cellIdx ) {
+	const hashGridCell_t & removed = m_cells[ cellIdx ];
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+
+	unsigned int hole = HashCell( removed.level, removed.x, removed.y, removed.z ) & mask;
+	while ( cellIdx != m_table[ hole ] ) {
+		assert( -1 != m_table[ hole ] );
+		hole = ( hole + 1 ) & mask;
+	}
+	m_table[ hole ] = -1;
+	m_numTableEntries--;
+
+	unsigned int idx = hole;
+	while ( true ) {
+		idx = ( idx + 1 ) & mask;
+		if ( -1 == m_table[ idx ] ) {
+			break;
+		}
+
+		// Only move the entry back if the hole is between its home position and where it currently is
+		const hashGridCell_t & cell = m_cells[ m_table[ idx ] ];
+		const unsigned int home = HashCell( cell.level, cell.x, cell.y, cell.z ) & mask;
+		const unsigned int distFromHome = ( idx - home ) & mask;
+		const unsigned int distFromHole = ( idx - hole ) & mask;
+		if ( distFromHome >= distFromHole ) {
+			m_table[ hole ] = m_table[ idx ];
+			m_table[ idx ] = -1;
+			hole = idx;
+		}
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::AddToCell
+====================================================
+*/
+void BroadPhaseHashGrid::AddToCell( const int level, const int x, const int y, const int z, const int bodyId ) {
+	int cellIdx = FindCell( level, x, y, z );
+	if ( cellIdx < 0 ) {
+		if ( !m_freeCells.empty() ) {
+			cellIdx = m_freeCells.back();
+			m_freeCells.pop_back();
+		} else {
+			const size_t capacity = m_cells.capacity();
+			m_cells.push_back( hashGridCell_t() );
+			if ( m_cells.capacity() != capacity ) {
+				GetPhysicsCounters().numBytesAllocated += (int)( m_cells.capacity() * sizeof( hashGridCell_t ) );
+			}
+			cellIdx = (int)m_cells.size() - 1;
+		}
+
+		hashGridCell_t & cell = m_cells[ cellIdx ];
+		cell.level = level;
+		cell.x = x;
+		cell.y = y;
+		cell.z = z;
+		InsertEntry( cellIdx );	// before it's active, since growing the table re-inserts the active cells
+
+		m_cells[ cellIdx ].activeIdx = (int)m_activeCells.size();
+		m_activeCells.push_back( cellIdx );
+	}
+
+	m_cells[ cellIdx ].bodies.push_back( bodyId );
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::RemoveFromCell
+
+Empty cells go back on the free list, but keep their storage for the next time they're used
+====================================================
+*/
+void BroadPhaseHashGrid::RemoveFromCell( const int level, const int x, const int y, const int z, const int bodyId ) {
+	const int cellIdx = FindCell( level, x, y, z );
+	assert( cellIdx >= 0 );
+	if ( cellIdx < 0 ) {
+		return;
+	}
+
+	hashGridCell_t & cell = m_cells[ cellIdx ];
+	for ( int i = 0; i < cell.bodies.size(); i++ ) {
+		if ( bodyId == cell.bodies[ i ] ) {
+			cell.bodies[ i ] = cell.bodies.back();
+			cell.bodies.pop_back();
+			break;
+		}
+	}
+	if ( !cell.bodies.empty() ) {
+		return;
+	}
+
+	RemoveEntry( cellIdx );
+
+	const int lastCell = m_activeCells.back();
+	m_activeCells[ cell.activeIdx ] = lastCell;
+	m_cells[ lastCell ].activeIdx = cell.activeIdx;
+	m_activeCells.pop_back();
+
+	cell.activeIdx = -1;
+	m_freeCells.push_back( cellIdx );
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::CollideCells
+
+Pairs within each cell, and from each body's first cell to the overlapping cells of the levels above it
+====================================================
+*/
+void BroadPhaseHashGrid::CollideCells( hashGridRangeJob_t & range ) const {
+	const size_t capacity = range.pairs.capacity();
+	range.pairs.clear();
+
+	for ( int c = range.first; c < range.first + range.count; c++ ) {
+		const hashGridCell_t & cell = m_cells[ m_activeCells[ c ] ];
+		const int numBodies = (int)cell.bodies.size();
+
+		for ( int i = 0; i < numBodies; i++ ) {
+			const int idA = cell.bodies[ i ];
+			const hashGridBody_t & bodyA = m_bodies[ idA ];
+
+			for ( int j = i + 1; j < numBodies; j++ ) {
+				const int idB = cell.bodies[ j ];
+				if ( bodyA.bounds.DoesIntersect( m_bodies[ idB ].bounds ) ) {
+					range.pairs.push_back( MakePair( idA, idB ) );
+				}
+			}
+
+			if ( cell.x != bodyA.mins[ 0 ] || cell.y != bodyA.mins[ 1 ] || cell.z != bodyA.mins[ 2 ] ) {
+				continue;
+			}
+
+			for ( int level = cell.level + 1; level < NUM_LEVELS; level++ ) {
+				if ( 0 == m_levelCounts[ level ] ) {
+					continue;
+				}
+
+				int mins[ 3 ];
+				int maxs[ 3 ];
+				CellRange( bodyA.bounds, level, mins, maxs );
+				for ( int z = mins[ 2 ]; z <= maxs[ 2 ]; z++ ) {
+					for ( int y = mins[ 1 ]; y <= maxs[ 1 ]; y++ ) {
+						for ( int x = mins[ 0 ]; x <= maxs[ 0 ]; x++ ) {
+							const int otherIdx = FindCell( level, x, y, z );
+							if ( otherIdx < 0 ) {
+								continue;
+							}
+
+							const hashGridCell_t & other = m_cells[ otherIdx ];
+							for ( int k = 0; k < other.bodies.size(); k++ ) {
+								const int idB = other.bodies[ k ];
+								if ( bodyA.bounds.DoesIntersect( m_bodies[ idB ].bounds ) ) {
+									range.pairs.push_back( MakePair( idA, idB ) );
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if ( range.pairs.capacity() != capacity ) {
+		GetPhysicsCounters().numBytesAllocated += (int)( range.pairs.capacity() * sizeof( collisionPair_t ) );
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::CollideCellsJob
+====================================================
+*/
+void BroadPhaseHashGrid::CollideCellsJob( Job_t * job, void * data ) {
+	hashGridRangeJob_t * ranges = (hashGridRangeJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		ranges[ i ].grid->CollideCells( ranges[ i ] );
+	}
+}
+
+/*
+====================================================
+BroadPhaseHashGrid::BuildPairs
+====================================================
+*/
+void BroadPhaseHashGrid::BuildPairs( std::vector< collisionPair_t > & finalPairs ) {
+	finalPairs.clear();
+
+	const int numCells = (int)m_activeCells.size();
+	const int numRanges = ( numCells + CELLS_PER_JOB - 1 ) / CELLS_PER_JOB;
+	if ( (int)m_ranges.size() < numRanges ) {
+		m_ranges.resize( numRanges );
+	}
+	for ( int i = 0; i < numRanges; i++ ) {
+		m_ranges[ i ].grid = this;
+		m_ranges[ i ].first = i * CELLS_PER_JOB;
+		m_ranges[ i ].count = std::min( CELLS_PER_JOB, numCells - i * CELLS_PER_JOB );
+	}
+
+	if ( NULL != g_jobSystem && numRanges > 1 ) {
+		g_jobSystem->ParallelFor( CollideCellsJob, m_ranges.data(), sizeof( hashGridRangeJob_t ), numRanges );
+		g_jobSystem->Wait( NULL );
+	} else {
+		Job_t job;
+		job.m_data = m_ranges.data();
+		job.m_numElements = numRanges;
+		CollideCellsJob( &job, NULL );
+	}
+
+	// A pair that shares more than one cell was found in each of them
+	int numFound = 0;
+	for ( int i = 0; i < numRanges; i++ ) {
+		numFound += (int)m_ranges[ i ].pairs.size();
+	}
+	m_pairSet.Clear( numFound );
+	for ( int i = 0; i < numRanges; i++ ) {
+		const std::vector< collisionPair_t > & pairs = m_ranges[ i ].pairs;
+		for ( int j = 0; j < pairs.size(); j++ ) {
+			if ( m_pairSet.Insert( pairs[ j ].a, pairs[ j ].b ) ) {
+				finalPairs.push_back( pairs[ j ] );
+			}
+		}
+	}
+
+	// The oversized bodies could touch anything
+	for ( int i = 0; i < m_oversized.size(); i++ ) {
+		const int idA = m_oversized[ i ];
+		const Bounds & bounds = m_bodies[ idA ].bounds;
+
+		for ( int j = 0; j < m_trackedBodies.size(); j++ ) {
+			const int idB = m_trackedBodies[ j ];
+			if ( OVERSIZED == m_bodies[ idB ].level && idB <= idA ) {
+				continue;
+			}
+			if ( idB != idA && bounds.DoesIntersect( m_bodies[ idB ].bounds ) ) {
+				finalPairs.push_back( MakePair( idA, idB ) );
+			}
+		}
+	}
+
+	// The cells are in whatever order they were made in, so sort the pairs to keep the steps repeatable
+	std::sort( finalPairs.begin(), finalPairs.end(), ComparePairs );
+}
+
+/*
+====================================================
+BroadPhase_HashGrid
+====================================================
+*/
+void BroadPhase_HashGrid( BroadPhaseHashGrid & grid, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	grid.Update( bodies, nodes, dt_sec );
+	grid.BuildPairs( finalPairs );
+}
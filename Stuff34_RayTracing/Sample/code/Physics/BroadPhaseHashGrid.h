@@ -0,0 +1,121 @@
+//
+//	BroadPhaseHashGrid.h
+//
+#pragma once
+#include <vector>
+#include "Math/Bounds.h"
+#include "Physics/BroadPhase.h"
+
+class Body;
+class BroadPhaseHashGrid;
+struct BodyPoolNode_t;
+struct Job_t;
+
+/*
+====================================================
+hashGridCell_t
+====================================================
+*/
+struct hashGridCell_t {
+	int level;
+	int x;
+	int y;
+	int z;
+	int activeIdx;				// where the cell is in the active list, -1 when it's free
+	std::vector< int > bodies;
+};
+
+/*
+====================================================
+hashGridBody_t
+====================================================
+*/
+struct hashGridBody_t {
+	int level;		// -1 when the body isn't in the grid
+	int mins[ 3 ];	// the cells its bounds cover, inclusive
+	int maxs[ 3 ];
+	int stamp;		// the last update that saw the body
+	Bounds bounds;
+};
+
+struct hashGridRangeJob_t {
+	BroadPhaseHashGrid * grid;
+	int first;
+	int count;
+	std::vector< collisionPair_t > pairs;
+};
+
+/*
+====================================================
+BroadPhaseHashGrid
+
+Spatial hash for big open worlds, where the bodies are spread out and mostly about the same size.
+Each level's cells are twice the size of the one below it, and a body goes in the lowest level whose
+cells are at least as big as its bounds, so it never covers more than two cells along an axis.
+Bodies bigger than the top level's cells are checked against everything.
+
+The grid is kept between steps.  A body is only moved when the range of cells it covers changes,
+and bodies that were freed are taken out when an update doesn't see them anymore.
+
+Pairs are found per cell across the job system.  Bodies in the same cell are checked against each
+other, and each body checks the cells of the levels above its own from the first cell it's in.
+A pair can be found in more than one cell, so they're merged through a pair set, then sorted so
+the order doesn't depend on the history of the grid.
+====================================================
+*/
+class BroadPhaseHashGrid {
+public:
+	BroadPhaseHashGrid();
+
+	void SetCellSize( const float cellSize );	// of the lowest level, empties the grid
+	float GetCellSize() const { return m_cellSize; }
+	void Clear();
+
+	void Update( const Body * bodies, const BodyPoolNode_t * nodes, const float dt_sec );
+	void BuildPairs( std::vector< collisionPair_t > & finalPairs );
+
+	int GetNumCells() const { return (int)m_activeCells.size(); }
+	int GetNumMovedBodies() const { return m_numMovedBodies; }	// bodies that changed cells in the last update
+
+	static const int NUM_LEVELS = 12;
+	static const int OVERSIZED = NUM_LEVELS;	// the level of bodies that are too big for the grid
+	static const int CELLS_PER_JOB = 32;
+
+private:
+	void ChooseCells( const Bounds & bounds, int & level, int * mins, int * maxs ) const;
+	void CellRange( const Bounds & bounds, const int level, int * mins, int * maxs ) const;
+	void InsertBody( const int bodyId );
+	void RemoveBody( const int bodyId );
+
+	static unsigned int HashCell( const int level, const int x, const int y, const int z );
+	int FindCell( const int level, const int x, const int y, const int z ) const;
+	void AddToCell( const int level, const int x, const int y, const int z, const int bodyId );
+	void RemoveFromCell( const int level, const int x, const int y, const int z, const int bodyId );
+	void InsertEntry( const int cellIdx );
+	void RemoveEntry( const int cellIdx );
+	void GrowTable();
+
+	void CollideCells( hashGridRangeJob_t & range ) const;
+	static void CollideCellsJob( Job_t * job, void * data );
+
+	float							m_cellSize;
+	float							m_invCellSizes[ NUM_LEVELS ];
+	int								m_levelCounts[ NUM_LEVELS + 1 ];	// bodies in each level, and the oversized ones
+	int								m_stamp;
+	int								m_numMovedBodies;
+
+	std::vector< hashGridBody_t >	m_bodies;			// by body id
+	std::vector< int >				m_trackedBodies;	// ids of the bodies in the grid
+	std::vector< int >				m_oversized;
+
+	std::vector< hashGridCell_t >	m_cells;			// cell storage, indices are stable
+	std::vector< int >				m_freeCells;
+	std::vector< int >				m_activeCells;		// cells with bodies in them
+	std::vector< int >				m_table;			// cell indices or -1, size is always zero or a power of two
+	int								m_numTableEntries;
+
+	std::vector< hashGridRangeJob_t >	m_ranges;
+	CollisionPairSet				m_pairSet;
+};
+
+void BroadPhase_HashGrid( BroadPhaseHashGrid & grid, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
@@ -0,0 +1,317 @@
+//
+//  BroadPhaseManager.cpp
+//
+#include "Physics/BroadPhaseManager.h"
+#include "Miscellaneous/Time.h"
+#include <stdio.h>
+
+/*
+========================================================================================================
+
+broadPhaseWindow_t
+
+========================================================================================================
+*/
+
+/*
+====================================================
+broadPhaseWindow_t::Add
+====================================================
+*/
+void broadPhaseWindow_t::Add( const int sampleTime_us, const int sampleNumPairs, const int windowSize ) {
+	if ( num < windowSize ) {
+		time_us[ num ] = sampleTime_us;
+		numPairs[ num ] = sampleNumPairs;
+		num++;
+		return;
+	}
+
+	// Full, so the new sample replaces the oldest one
+	time_us[ next ] = sampleTime_us;
+	numPairs[ next ] = sampleNumPairs;
+	next = ( next + 1 ) % num;
+}
+
+/*
+====================================================
+broadPhaseWindow_t::GetCost
+====================================================
+*/
+float broadPhaseWindow_t::GetCost( const float pairCost_us ) const {
+	if ( 0 == num ) {
+		return 0.0f;
+	}
+
+	double sumTime = 0.0;
+	double sumPairs = 0.0;
+	for ( int i = 0; i < num; i++ ) {
+		sumTime += time_us[ i ];
+		sumPairs += numPairs[ i ];
+	}
+	return (float)( ( sumTime + sumPairs * pairCost_us ) / (double)num );
+}
+
+/*
+========================================================================================================
+
+BroadPhaseManager
+
+========================================================================================================
+*/
+
+/*
+====================================================
+BroadPhaseManager::BroadPhaseManager
+====================================================
+*/
+BroadPhaseManager::BroadPhaseManager() {
+	m_mode = BROADPHASE_BVH;
+	m_active = BROADPHASE_BVH;
+	Clear();
+}
+
+/*
+====================================================
+BroadPhaseManager::SetBroadPhase
+====================================================
+*/
+void BroadPhaseManager::SetBroadPhase( const broadPhase_t type ) {
+	if ( type < 0 || type >= BROADPHASE_NUM ) {
+		printf( "WARNING: BroadPhaseManager::SetBroadPhase: invalid broadphase %i\n", (int)type );
+		return;
+	}
+
+	if ( BROADPHASE_AUTO == type ) {
+		// Start from whatever is running now, the others get measured straight away
+		if ( BROADPHASE_AUTO != m_mode ) {
+			Clear();
+		}
+		m_mode = type;
+		return;
+	}
+
+	// The grid would only go stale while it isn't being updated
+	if ( BROADPHASE_HASH_GRID != type ) {
+		m_hashGrid.Clear();
+	}
+	m_mode = type;
+	m_active = type;
+}
+
+/*
+====================================================
+BroadPhaseManager::SetSettings
+====================================================
+*/
+void BroadPhaseManager::SetSettings( const broadPhaseSettings_t & settings ) {
+	m_settings = settings;
+	if ( m_settings.windowSize < 1 || m_settings.windowSize > broadPhaseWindow_t::MAX_SAMPLES ) {
+		printf( "WARNING: BroadPhaseManager::SetSettings: window size %i is out of range\n", m_settings.windowSize );
+		m_settings.windowSize = ( m_settings.windowSize < 1 ) ? 1 : broadPhaseWindow_t::MAX_SAMPLES;
+	}
+	if ( m_settings.probeInterval < 1 ) {
+		m_settings.probeInterval = 1;
+	}
+	if ( m_settings.probeSteps < 2 ) {
+		m_settings.probeSteps = 2;
+	}
+
+	// The windows were filled to the old size
+	for ( int i = 0; i < BROADPHASE_AUTO; i++ ) {
+		m_windows[ i ].Clear();
+	}
+	m_narrowPhase.Clear();
+}
+
+/*
+====================================================
+BroadPhaseManager::Clear
+
+Throws out the measurements and the hash grid's cells, the selection is kept
+====================================================
+*/
+void BroadPhaseManager::Clear() {
+	m_probed = BROADPHASE_NUM;
+	m_probeTime_us = 0;
+	m_numSwitches = 0;
+	m_stepsSinceSwitch = 0;
+	m_stepsSinceProbe = 0;
+	m_probeStep = 0;
+	m_nextProbe = BROADPHASE_SAP;
+
+	for ( int i = 0; i < BROADPHASE_AUTO; i++ ) {
+		m_windows[ i ].Clear();
+	}
+	m_narrowPhase.Clear();
+	m_hashGrid.Clear();
+}
+
+/*
+====================================================
+BroadPhaseManager::Run
+====================================================
+*/
+void BroadPhaseManager::Run( const broadPhase_t type, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	if ( BROADPHASE_HASH_GRID == type ) {
+		BroadPhase_HashGrid( m_hashGrid, bodies, nodes, finalPairs, dt_sec );
+	} else {
+		BroadPhase( type, bodies, nodes, finalPairs, dt_sec );
+	}
+}
+
+/*
+====================================================
+BroadPhaseManager::FindPairs
+====================================================
+*/
+void BroadPhaseManager::FindPairs( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec ) {
+	m_probed = BROADPHASE_NUM;
+	m_probeTime_us = 0;
+	if ( BROADPHASE_AUTO != m_mode ) {
+		Run( m_active, bodies, nodes, finalPairs, dt_sec );
+		return;
+	}
+
+	const int startTime = GetTimeMicroseconds();
+	Run( m_active, bodies, nodes, finalPairs, dt_sec );
+	const int time_us = GetTimeMicroseconds() - startTime;
+
+	// The first step after a switch builds caches, like the hash grid's cells, so it isn't typical
+	if ( m_stepsSinceSwitch > 0 ) {
+		m_windows[ m_active ].Add( time_us, (int)finalPairs.size(), m_settings.windowSize );
+	}
+	m_stepsSinceSwitch++;
+
+	Probe( bodies, nodes, dt_sec );
+	ChooseBroadPhase();
+}
+
+/*
+====================================================
+BroadPhaseManager::Probe
+
+Measures the broadphases that aren't in use one at a time, taking turns.  Any that haven't been
+measured yet are probed without waiting for the interval.
+====================================================
+*/
+void BroadPhaseManager::Probe( const Body * bodies, const BodyPoolNode_t * nodes, const float dt_sec ) {
+	if ( 0 == m_probeStep ) {
+		bool isMissing = false;
+		for ( int i = 0; i < BROADPHASE_AUTO; i++ ) {
+			if ( i != m_active && 0 == m_windows[ i ].num ) {
+				isMissing = true;
+			}
+		}
+
+		m_stepsSinceProbe++;
+		if ( m_stepsSinceProbe < m_settings.probeInterval && !isMissing ) {
+			return;
+		}
+		m_stepsSinceProbe = 0;
+
+		if ( m_nextProbe == m_active ) {
+			m_nextProbe = (broadPhase_t)( ( m_nextProbe + 1 ) % BROADPHASE_AUTO );
+		}
+	}
+
+	m_probed = m_nextProbe;
+	const int startTime = GetTimeMicroseconds();
+	Run( m_probed, bodies, nodes, m_probePairs, dt_sec );
+	const int time_us = GetTimeMicroseconds() - startTime;
+	m_probeTime_us = time_us;
+
+	if ( m_probeStep > 0 ) {
+		m_windows[ m_probed ].Add( time_us, (int)m_probePairs.size(), m_settings.windowSize );
+	}
+	m_probePairs.clear();
+
+	m_probeStep++;
+	if ( m_probeStep >= m_settings.probeSteps ) {
+		m_probeStep = 0;
+		m_nextProbe = (broadPhase_t)( ( m_nextProbe + 1 ) % BROADPHASE_AUTO );
+	}
+}
+
+/*
+====================================================
+BroadPhaseManager::ChooseBroadPhase
+
+The one in use has to have run for a whole window first, and the hysteresis keeps two that cost
+about the same from trading places back and forth
+====================================================
+*/
+void BroadPhaseManager::ChooseBroadPhase() {
+	if ( m_stepsSinceSwitch <= m_settings.windowSize ) {
+		return;
+	}
+
+	const float activeCost = GetCost( m_active );
+	if ( 0.0f == activeCost ) {
+		return;
+	}
+
+	broadPhase_t best = m_active;
+	float bestCost = activeCost * ( 1.0f - m_settings.hysteresis );
+	for ( int i = 0; i < BROADPHASE_AUTO; i++ ) {
+		if ( i == m_active || 0 == m_windows[ i ].num ) {
+			continue;
+		}
+
+		const float cost = GetCost( (broadPhase_t)i );
+		if ( cost < bestCost ) {
+			best = (broadPhase_t)i;
+			bestCost = cost;
+		}
+	}
+	if ( best == m_active ) {
+		return;
+	}
+
+	m_active = best;
+	m_numSwitches++;
+	m_stepsSinceSwitch = 0;
+	m_stepsSinceProbe = 0;
+	m_probeStep = 0;
+}
+
+/*
+====================================================
+BroadPhaseManager::RecordNarrowPhase
+====================================================
+*/
+void BroadPhaseManager::RecordNarrowPhase( const int time_us, const int numPairs ) {
+	if ( BROADPHASE_AUTO != m_mode ) {
+		return;
+	}
+	m_narrowPhase.Add( time_us, numPairs, m_settings.windowSize );
+}
+
+/*
+====================================================
+BroadPhaseManager::GetPairCost
+====================================================
+*/
+float BroadPhaseManager::GetPairCost() const {
+	double sumTime = 0.0;
+	double sumPairs = 0.0;
+	for ( int i = 0; i < m_narrowPhase.num; i++ ) {
+		sumTime += m_narrowPhase.time_us[ i ];
+		sumPairs += m_narrowPhase.numPairs[ i ];
+	}
+	if ( sumPairs <= 0.0 ) {
+		return m_settings.pairCost_us;
+	}
+	return (float)( sumTime / sumPairs );
+}
+
+/*
+====================================================
+BroadPhaseManager::GetCost
+====================================================
+*/
+float BroadPhaseManager::GetCost( const broadPhase_t type ) const {
+	if ( type < 0 || type >= BROADPHASE_AUTO ) {
+		return 0.0f;
+	}
+	return m_windows[ type ].GetCost( GetPairCost() );
+}
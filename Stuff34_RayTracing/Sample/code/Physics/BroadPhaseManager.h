@@ -0,0 +1,117 @@
+//
+//	BroadPhaseManager.h
+//
+#pragma once
+#include <vector>
+#include "Physics/BroadPhase.h"
+#include "Physics/BroadPhaseHashGrid.h"
+
+class Body;
+struct BodyPoolNode_t;
+
+/*
+====================================================
+broadPhaseSettings_t
+
+How BROADPHASE_AUTO measures and picks a broadphase
+====================================================
+*/
+struct broadPhaseSettings_t {
+	broadPhaseSettings_t() {
+		windowSize = 60;
+		probeInterval = 120;
+		probeSteps = 4;
+		hysteresis = 0.2f;
+		pairCost_us = 0.5f;
+	}
+
+	int windowSize;		// steps each broadphase's costs are averaged over, and the fewest steps between switches
+	int probeInterval;	// steps between measuring one of the broadphases that isn't in use
+	int probeSteps;		// steps a probe runs for, the first one is thrown out since it's building caches
+	float hysteresis;	// another broadphase has to be this fraction cheaper before it's switched to
+	float pairCost_us;	// narrowphase cost of a candidate pair until it's been measured
+};
+
+/*
+====================================================
+broadPhaseWindow_t
+
+The last few measurements of a broadphase, oldest first from next once it's full
+====================================================
+*/
+struct broadPhaseWindow_t {
+	static const int MAX_SAMPLES = 256;
+
+	void Clear() { num = 0; next = 0; }
+	void Add( const int time_us, const int numPairs, const int windowSize );
+	float GetCost( const float pairCost_us ) const;
+
+	int time_us[ MAX_SAMPLES ];
+	int numPairs[ MAX_SAMPLES ];
+	int num;
+	int next;
+};
+
+/*
+====================================================
+BroadPhaseManager
+
+Owns the broadphases and runs the one that's selected.  In BROADPHASE_AUTO it picks the cheapest
+for the scene as it goes, since that depends on how many bodies there are, how they're spread out
+and how much they move.
+
+A broadphase's cost is its time plus the narrowphase time of the pairs it finds, so one that's fast
+but loose doesn't win.  The cost per pair is the narrowphase's average over the last window.
+The broadphase in use is measured every step.  Every so often one of the others is run as well
+for a few steps, with its pairs thrown away, so its cost stays current.  Once the one in use has run
+for a whole window, it's swapped for any that's cheaper by more than the hysteresis.
+
+The pairs are different for each broadphase, and switching depends on timings, so a world in
+BROADPHASE_AUTO doesn't repeat exactly from a saved state.
+====================================================
+*/
+class BroadPhaseManager {
+public:
+	BroadPhaseManager();
+
+	void SetBroadPhase( const broadPhase_t type );	// any broadphase or BROADPHASE_AUTO
+	broadPhase_t GetBroadPhase() const { return m_mode; }
+	broadPhase_t GetActiveBroadPhase() const { return m_active; }	// the one finding the pairs
+	broadPhase_t GetProbedBroadPhase() const { return m_probed; }	// measured in the last step, BROADPHASE_NUM if none
+	int GetProbeTime_us() const { return m_probeTime_us; }			// how much of the last FindPairs went to the probe
+	int GetNumSwitches() const { return m_numSwitches; }
+
+	void SetSettings( const broadPhaseSettings_t & settings );
+	const broadPhaseSettings_t & GetSettings() const { return m_settings; }
+	void SetHashGridCellSize( const float cellSize ) { m_hashGrid.SetCellSize( cellSize ); }
+
+	void Clear();
+	void FindPairs( const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
+	void RecordNarrowPhase( const int time_us, const int numPairs );	// after each step, for the cost of a pair
+
+	float GetCost( const broadPhase_t type ) const;	// per step in microseconds, zero if it hasn't been measured
+
+private:
+	void Run( const broadPhase_t type, const Body * bodies, const BodyPoolNode_t * nodes, std::vector< collisionPair_t > & finalPairs, const float dt_sec );
+	void Probe( const Body * bodies, const BodyPoolNode_t * nodes, const float dt_sec );
+	void ChooseBroadPhase();
+	float GetPairCost() const;
+
+	broadPhaseSettings_t	m_settings;
+	broadPhase_t			m_mode;
+	broadPhase_t			m_active;
+	broadPhase_t			m_probed;
+	int						m_probeTime_us;
+	int						m_numSwitches;
+
+	int						m_stepsSinceSwitch;
+	int						m_stepsSinceProbe;
+	int						m_probeStep;
+	broadPhase_t			m_nextProbe;
+
+	broadPhaseWindow_t		m_windows[ BROADPHASE_AUTO ];
+	broadPhaseWindow_t		m_narrowPhase;		// time and pairs of the narrowphase
+	std::vector< collisionPair_t >	m_probePairs;
+
+	BroadPhaseHashGrid		m_hashGrid;
+};
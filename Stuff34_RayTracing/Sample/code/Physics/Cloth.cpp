@@ -2,12 +2,20 @@
 //  Cloth.cpp
 //
 #include "Physics/Cloth.h"
-#include "Math/lcp.h"
-
-const float Cloth::m_widthPhysical = 5.0f;
-const float Cloth::m_heightPhysical = 5.0f;
-
-const float Cloth::m_restDistance = Cloth::m_widthPhysical / (float)Cloth::m_width;
+#include "Physics/PhysicsWorld.h"
+#include "Physics/NarrowPhase.h"
+#include "JobSystem/JobSystem.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <algorithm>
+
+#define CLOTH_SIMD	// comment out to integrate and solve the particles one at a time
+
+#if defined( CLOTH_SIMD )
+#include <xmmintrin.h>
+#endif
 
 //
 //	Useful Papers:
@@ -15,430 +23,635 @@ const float Cloth::m_restDistance = Cloth::m_widthPhysical / (float)Cloth::m_wid
 //	Cloth Simulation on GPU - Cyril Zeller 2005
 //
 
+static const float s_gravity = -10.01f;
+static const float s_epsilon = 1e-12f;
+
+//
+//	The colors, each pair alternates so that neighboring constraints never share a particle.
+//	The bending constraints skip a particle, so they alternate in twos.
+//
+enum clothColor_t {
+	CC_HORIZONTAL_EVEN = 0,	// ( x, y ) to ( x + 1, y ) for even x
+	CC_HORIZONTAL_ODD,
+	CC_VERTICAL_EVEN,		// ( x, y ) to ( x, y + 1 ) for even y
+	CC_VERTICAL_ODD,
+	CC_BACKSLASH_EVEN,		// ( x, y ) to ( x + 1, y + 1 ) for even y
+	CC_BACKSLASH_ODD,
+	CC_SLASH_EVEN,			// ( x + 1, y ) to ( x, y + 1 ) for even y
+	CC_SLASH_ODD,
+	CC_BEND_HORIZONTAL_EVEN,	// ( x, y ) to ( x + 2, y ) for x % 4 of 0 or 1
+	CC_BEND_HORIZONTAL_ODD,		// and x % 4 of 2 or 3
+	CC_BEND_VERTICAL_EVEN,		// ( x, y ) to ( x, y + 2 ) for y % 4 of 0 or 1
+	CC_BEND_VERTICAL_ODD,		// and y % 4 of 2 or 3
+	CC_NUM,
+};
+
+static const int s_numPbdColors = CC_BEND_HORIZONTAL_EVEN;	// position based dynamics leaves out the bending
+
 /*
 ====================================================
-Cloth::Cloth
+HasStrip
+
+Returns true if the color has constraints starting in the row
 ====================================================
 */
-Cloth::Cloth() {
-	Reset();
+static bool HasStrip( const int color, const int row, const int height ) {
+	switch ( color ) {
+		case CC_HORIZONTAL_EVEN:
+		case CC_HORIZONTAL_ODD:
+		case CC_BEND_HORIZONTAL_EVEN:
+		case CC_BEND_HORIZONTAL_ODD: { return true; }
+		case CC_BEND_VERTICAL_EVEN: { return ( row + 2 < height ) && ( row % 4 ) < 2; }
+		case CC_BEND_VERTICAL_ODD: { return ( row + 2 < height ) && ( row % 4 ) >= 2; }
+		default: { return ( row + 1 < height ) && ( ( row & 1 ) == ( color & 1 ) ); }
+	};
 }
 
 /*
 ====================================================
-Cloth::Reset
+Cloth::Cloth
 ====================================================
 */
-void Cloth::Reset() {
-	// Reset cloth positions
-	for ( int y = 0; y < m_height; y++ ) {
-		for ( int x = 0; x < m_width; x++ ) {
-			const int idx = x + y * m_width;
-			m_particles[ idx ].m_position = Vec3( x, 0, -y );
-			m_particles[ idx ].m_position = Vec3( x, y, 0 );
-			m_particles[ idx ].m_position *= m_restDistance;
-			m_particles[ idx ].m_position.z += 7.0f;
-			m_particles[ idx ].m_position.x += -15.0f;
-			m_particles[ idx ].m_positionOld = m_particles[ idx ].m_position;
-			m_particles[ idx ].m_velocity.Zero();
-			m_particles[ idx ].m_acceleration.Zero();
-			m_particles[ idx ].m_invMass = 1.0f / float( m_width * m_height );
-		}
-	}
-
-	for ( int i = 0; i < m_numClamps; i++ ) {
-		int idx = ( m_width - 1 ) * i / ( m_numClamps - 1 );
-		m_clamped[ i ] = m_particles[ idx ].m_position;
-		m_particles[ idx ].m_invMass = 0;
-	}
+Cloth::Cloth() {
+	Init( 16, 16, 5.0f, 5.0f, Vec3( -15.0f, 0.0f, 7.0f ) );
+}
 
-	// Reset constraints
-	int numConstraints = 0;
-	for ( int y = 0; y < m_height; y++ ) {
-		for ( int x = 0; x < m_width; x++ ) {
-			int idx = x + y * m_width;
-
-			int x0 = x - 1;
-			int y0 = y - 1;
-			int x1 = x + 1;
-			int y1 = y + 1;
-
-			int idx00 = x0 + y0 * m_width;	// upper left
-			int idx01 = x0 + y1 * m_width;	// lower left
-			int idx10 = x1 + y0 * m_width;	// upper right
-			int idx11 = x1 + y1 * m_width;	// lower right
-
-			int idxY0 = x + y0 * m_width;	// above
-			int idxY1 = x + y1 * m_width;	// below
-			int idxX0 = x0 + y * m_width;	// left
-			int idxX1 = x1 + y * m_width;	// right
-
-			if ( x0 >= 0 ) {
-				ClothConstraint constraint;
-				constraint.m_idxA = idx;
-				constraint.m_idxB = idxX0;
-				constraint.m_restLength = m_restDistance;
-				m_constraints[ numConstraints ] = constraint;
-
-				m_constraints2[ numConstraints * 2 + 0 ].m_idxA = idx;
-				m_constraints2[ numConstraints * 2 + 0 ].m_idxB = idxX0;
-				m_constraints2[ numConstraints * 2 + 0 ].m_restLength = m_restDistance;
-				m_constraints2[ numConstraints * 2 + 1 ].m_idxB = idx;
-				m_constraints2[ numConstraints * 2 + 1 ].m_idxA = idxX0;
-				m_constraints2[ numConstraints * 2 + 1 ].m_restLength = m_restDistance;
-				numConstraints++;
-			}
-			if ( y0 >= 0 ) {
-				ClothConstraint constraint;
-				constraint.m_idxA = idx;
-				constraint.m_idxB = idxY0;
-				constraint.m_restLength = m_restDistance;
-				m_constraints[ numConstraints ] = constraint;
-
-				m_constraints2[ numConstraints * 2 + 0 ].m_idxA = idx;
-				m_constraints2[ numConstraints * 2 + 0 ].m_idxB = idxY0;
-				m_constraints2[ numConstraints * 2 + 0 ].m_restLength = m_restDistance;
-				m_constraints2[ numConstraints * 2 + 1 ].m_idxB = idx;
-				m_constraints2[ numConstraints * 2 + 1 ].m_idxA = idxY0;
-				m_constraints2[ numConstraints * 2 + 1 ].m_restLength = m_restDistance;
-				numConstraints++;
-			}
+Cloth::Cloth( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin ) {
+	Init( width, height, widthPhysical, heightPhysical, origin );
+}
 
-			if ( y1 < m_height ) {
-				float restLength = sqrtf( 2.0f ) * m_restDistance;
-
-				if ( x0 >= 0 ) {
-					ClothConstraint constraint;
-					constraint.m_idxA = idx;
-					constraint.m_idxB = idx01;
-					constraint.m_restLength = restLength;
-					m_constraints[ numConstraints ] = constraint;
-
-					m_constraints2[ numConstraints * 2 + 0 ].m_idxA = idx;
-					m_constraints2[ numConstraints * 2 + 0 ].m_idxB = idx01;
-					m_constraints2[ numConstraints * 2 + 0 ].m_restLength = restLength;
-					m_constraints2[ numConstraints * 2 + 1 ].m_idxB = idx;
-					m_constraints2[ numConstraints * 2 + 1 ].m_idxA = idx01;
-					m_constraints2[ numConstraints * 2 + 1 ].m_restLength = restLength;
-					numConstraints++;
-				}
-				if ( x1 < m_width ) {
-					ClothConstraint constraint;
-					constraint.m_idxA = idx;
-					constraint.m_idxB = idx11;
-					constraint.m_restLength = restLength;
-					m_constraints[ numConstraints ] = constraint;
-
-					m_constraints2[ numConstraints * 2 + 0 ].m_idxA = idx;
-					m_constraints2[ numConstraints * 2 + 0 ].m_idxB = idx11;
-					m_constraints2[ numConstraints * 2 + 0 ].m_restLength = restLength;
-					m_constraints2[ numConstraints * 2 + 1 ].m_idxB = idx;
-					m_constraints2[ numConstraints * 2 + 1 ].m_idxA = idx11;
-					m_constraints2[ numConstraints * 2 + 1 ].m_restLength = restLength;
-					numConstraints++;
-				}
-			}
-		}
-	}
-	m_numConstraints = numConstraints;
+/*
+====================================================
+Cloth::Init
+====================================================
+*/
+void Cloth::Init( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin ) {
+	assert( width >= 2 && height >= 2 );
+	m_width = ( width < 2 ) ? 2 : width;
+	m_height = ( height < 2 ) ? 2 : height;
+	m_numIters = 4;
+	m_solver = CS_PBD;
+	m_numSubsteps = 4;
+	m_complianceStretch = 0.0f;
+	m_complianceShear = 0.001f;
+	m_complianceBend = 1.0f;
+	m_alphaStretch = 0.0f;
+	m_alphaShear = 0.0f;
+	m_alphaBend = 0.0f;
+	m_origin = origin;
+
+	m_restX = widthPhysical / (float)( m_width - 1 );
+	m_restY = heightPhysical / (float)( m_height - 1 );
+	m_restDiagonal = sqrtf( m_restX * m_restX + m_restY * m_restY );
+	m_selfCollision = true;
+	m_thickness = 0.5f * ( ( m_restX < m_restY ) ? m_restX : m_restY );
+
+	const int numPadded = ( m_width * m_height + 3 ) & ~3;
+	m_posX.assign( numPadded, 0.0f );
+	m_posY.assign( numPadded, 0.0f );
+	m_posZ.assign( numPadded, 0.0f );
+	m_oldX.assign( numPadded, 0.0f );
+	m_oldY.assign( numPadded, 0.0f );
+	m_oldZ.assign( numPadded, 0.0f );
+	m_invMass.assign( numPadded, 0.0f );
 
 	//
-	//	Update Bounds
+	//	The hash table has at least twice as many cells as particles, to keep the collisions down
 	//
-	m_bounds.Clear();
-	for ( int i = 0; i < m_width * m_height; i++ ) {
-		m_bounds.Expand( m_particles[ i ].m_position );
+	const int numParticles = m_width * m_height;
+	int tableSize = 1;
+	while ( tableSize < 2 * numParticles ) {
+		tableSize <<= 1;
+	}
+	m_hashMask = tableSize - 1;
+	m_cellStart.assign( tableSize + 1, 0 );
+	m_cellEntries.assign( numParticles, 0 );
+	m_particleCells.assign( numParticles * 3, 0 );
+	m_deltaX.assign( numParticles, 0.0f );
+	m_deltaY.assign( numParticles, 0.0f );
+	m_deltaZ.assign( numParticles, 0.0f );
+
+	m_ranges.clear();
+	for ( int first = 0; first < numParticles; first += RANGE_SIZE ) {
+		clothRangeJob_t range;
+		range.cloth = this;
+		range.first = first;
+		range.count = ( numParticles - first < RANGE_SIZE ) ? ( numParticles - first ) : RANGE_SIZE;
+		m_ranges.push_back( range );
 	}
+	m_colliders.clear();
 
 	//
-	//	Build Constraint Colors
+	//	Build the rows of each color
 	//
-	memset( m_colorCounts, 0, sizeof( int ) * m_numColors );
-	for ( int y = 0; y < m_height; y++ ) {
-		// Horizontal 0
-		for ( int x = 0; x < m_width - 1; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + 1;
-
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
-
-			m_coloredConstraints[ 0 ][ m_colorCounts[ 0 ] ] = constraint;
-			m_colorCounts[ 0 ]++;
-		}
+	assert( CC_NUM == NUM_COLORS );
+	for ( int color = 0; color < NUM_COLORS; color++ ) {
+		m_strips[ color ].clear();
 
-		// Horizontal 1
-		for ( int x = 1; x < m_width - 1; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + 1;
-
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
-
-			m_coloredConstraints[ 1 ][ m_colorCounts[ 1 ] ] = constraint;
-			m_colorCounts[ 1 ]++;
-		}
-
-		// Vertical 0
-		for ( int x = 0; x < m_width; x++ ) {
-			int baseIdx = ( 2 * y + 0 ) * m_width + x;
-			int nextIdx = baseIdx + m_width;
-			if ( nextIdx >= m_width * m_height ) {
+		for ( int row = 0; row < m_height; row++ ) {
+			if ( !HasStrip( color, row, m_height ) ) {
 				continue;
 			}
 
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
-
-			m_coloredConstraints[ 2 ][ m_colorCounts[ 2 ] ] = constraint;
-			m_colorCounts[ 2 ]++;
+			clothStripJob_t strip;
+			strip.cloth = this;
+			strip.color = color;
+			strip.row = row;
+			m_strips[ color ].push_back( strip );
 		}
+	}
 
-		// Vertical 1
-		for ( int x = 0; x < m_width; x++ ) {
-			int baseIdx = ( 2 * y + 1 ) * m_width + x;
-			int nextIdx = baseIdx + m_width;
-			if ( nextIdx >= m_width * m_height ) {
-				continue;
-			}
+	Reset();
+}
 
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
+/*
+====================================================
+Cloth::Reset
+====================================================
+*/
+void Cloth::Reset() {
+	const int numParticles = m_width * m_height;
+	const float invMass = 1.0f / (float)numParticles;
 
-			m_coloredConstraints[ 3 ][ m_colorCounts[ 3 ] ] = constraint;
-			m_colorCounts[ 3 ]++;
+	for ( int y = 0; y < m_height; y++ ) {
+		for ( int x = 0; x < m_width; x++ ) {
+			const int idx = x + y * m_width;
+			m_posX[ idx ] = m_origin.x + (float)x * m_restX;
+			m_posY[ idx ] = m_origin.y + (float)y * m_restY;
+			m_posZ[ idx ] = m_origin.z;
+			m_oldX[ idx ] = m_posX[ idx ];
+			m_oldY[ idx ] = m_posY[ idx ];
+			m_oldZ[ idx ] = m_posZ[ idx ];
+
+			// The first row is pinned
+			m_invMass[ idx ] = ( 0 == y ) ? 0.0f : invMass;
 		}
+	}
 
-		// BackSlash 0
-		for ( int x = 0; x < m_width - 1; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + m_width + 1;
-			if ( nextIdx >= m_width * m_height ) {
-				continue;
-			}
-
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
+	UpdateBounds();
+}
 
-			m_coloredConstraints[ 4 ][ m_colorCounts[ 4 ] ] = constraint;
-			m_colorCounts[ 4 ]++;
-		}
+/*
+====================================================
+Cloth::SetThickness
+====================================================
+*/
+void Cloth::SetThickness( const float thickness ) {
+	if ( thickness <= 0.0f ) {
+		printf( "WARNING: Cloth::SetThickness: thickness must be positive, got %f\n", thickness );
+		return;
+	}
+	m_thickness = thickness;
+}
 
-		// BackSlash 1
-		for ( int x = 1; x < m_width - 1; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + m_width + 1;
-			if ( nextIdx >= m_width * m_height ) {
-				continue;
-			}
+/*
+====================================================
+Cloth::SetNumSubsteps
+====================================================
+*/
+void Cloth::SetNumSubsteps( const int numSubsteps ) {
+	if ( numSubsteps < 1 ) {
+		printf( "WARNING: Cloth::SetNumSubsteps: needs at least one substep, got %i\n", numSubsteps );
+		return;
+	}
+	m_numSubsteps = numSubsteps;
+}
 
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
+/*
+====================================================
+Cloth::SetCompliance
+====================================================
+*/
+void Cloth::SetCompliance( const float stretch, const float shear, const float bend ) {
+	if ( stretch < 0.0f || shear < 0.0f || bend < 0.0f ) {
+		printf( "WARNING: Cloth::SetCompliance: compliance can't be negative\n" );
+		return;
+	}
+	m_complianceStretch = stretch;
+	m_complianceShear = shear;
+	m_complianceBend = bend;
+}
 
-			m_coloredConstraints[ 5 ][ m_colorCounts[ 5 ] ] = constraint;
-			m_colorCounts[ 5 ]++;
-		}
+/*
+====================================================
+Cloth::Translate
+====================================================
+*/
+void Cloth::Translate( const Vec3 & offset ) {
+	const int numParticles = m_width * m_height;
+	for ( int i = 0; i < numParticles; i++ ) {
+		m_posX[ i ] += offset.x;
+		m_posY[ i ] += offset.y;
+		m_posZ[ i ] += offset.z;
+		m_oldX[ i ] += offset.x;
+		m_oldY[ i ] += offset.y;
+		m_oldZ[ i ] += offset.z;
+	}
+	m_origin += offset;
 
-		// ForwardSlash 0
-		for ( int x = 1; x < m_width; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + m_width - 1;
-			if ( nextIdx >= m_width * m_height ) {
-				continue;
-			}
+	UpdateBounds();
+}
 
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
+/*
+====================================================
+Cloth::Integrate
 
-			m_coloredConstraints[ 6 ][ m_colorCounts[ 6 ] ] = constraint;
-			m_colorCounts[ 6 ]++;
+Verlet integration:
+x1 = x0 + ( x0 - x_1 ) + 1/2 * a0 * dt^2
+====================================================
+*/
+void Cloth::Integrate( const float dt_sec ) {
+	const float gravity = s_gravity * dt_sec * dt_sec * 0.5f;
+	const int numPadded = (int)m_posX.size();
+
+#if defined( CLOTH_SIMD )
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 g = _mm_set1_ps( gravity );
+	for ( int i = 0; i < numPadded; i += 4 ) {
+		const __m128 x0 = _mm_loadu_ps( &m_posX[ i ] );
+		const __m128 y0 = _mm_loadu_ps( &m_posY[ i ] );
+		const __m128 z0 = _mm_loadu_ps( &m_posZ[ i ] );
+		const __m128 x_1 = _mm_loadu_ps( &m_oldX[ i ] );
+		const __m128 y_1 = _mm_loadu_ps( &m_oldY[ i ] );
+		const __m128 z_1 = _mm_loadu_ps( &m_oldZ[ i ] );
+
+		const __m128 x1 = _mm_sub_ps( _mm_add_ps( x0, x0 ), x_1 );
+		const __m128 y1 = _mm_sub_ps( _mm_add_ps( y0, y0 ), y_1 );
+		const __m128 z1 = _mm_add_ps( _mm_sub_ps( _mm_add_ps( z0, z0 ), z_1 ), g );
+
+		// Pinned particles stay where they are
+		const __m128 isFree = _mm_cmpgt_ps( _mm_loadu_ps( &m_invMass[ i ] ), zero );
+		_mm_storeu_ps( &m_posX[ i ], _mm_or_ps( _mm_and_ps( isFree, x1 ), _mm_andnot_ps( isFree, x0 ) ) );
+		_mm_storeu_ps( &m_posY[ i ], _mm_or_ps( _mm_and_ps( isFree, y1 ), _mm_andnot_ps( isFree, y0 ) ) );
+		_mm_storeu_ps( &m_posZ[ i ], _mm_or_ps( _mm_and_ps( isFree, z1 ), _mm_andnot_ps( isFree, z0 ) ) );
+		_mm_storeu_ps( &m_oldX[ i ], _mm_or_ps( _mm_and_ps( isFree, x0 ), _mm_andnot_ps( isFree, x_1 ) ) );
+		_mm_storeu_ps( &m_oldY[ i ], _mm_or_ps( _mm_and_ps( isFree, y0 ), _mm_andnot_ps( isFree, y_1 ) ) );
+		_mm_storeu_ps( &m_oldZ[ i ], _mm_or_ps( _mm_and_ps( isFree, z0 ), _mm_andnot_ps( isFree, z_1 ) ) );
+	}
+#else
+	for ( int i = 0; i < numPadded; i++ ) {
+		if ( m_invMass[ i ] <= 0.0f ) {
+			continue;
 		}
 
-		// ForwardSlash 0
-		for ( int x = 2; x < m_width; x += 2 ) {
-			int baseIdx = y * m_width + x;
-			int nextIdx = baseIdx + m_width - 1;
-			if ( nextIdx >= m_width * m_height ) {
-				continue;
-			}
-
-			ClothConstraint constraint;
-			constraint.m_idxA = baseIdx;
-			constraint.m_idxB = nextIdx;
-			constraint.m_restLength = m_restDistance;
-
-			m_coloredConstraints[ 7 ][ m_colorCounts[ 7 ] ] = constraint;
-			m_colorCounts[ 7 ]++;
-		}
+		const float x0 = m_posX[ i ];
+		const float y0 = m_posY[ i ];
+		const float z0 = m_posZ[ i ];
+		m_posX[ i ] = x0 + x0 - m_oldX[ i ];
+		m_posY[ i ] = y0 + y0 - m_oldY[ i ];
+		m_posZ[ i ] = z0 + z0 - m_oldZ[ i ] + gravity;
+		m_oldX[ i ] = x0;
+		m_oldY[ i ] = y0;
+		m_oldZ[ i ] = z0;
 	}
+#endif
 }
 
+#if defined( CLOTH_SIMD )
 /*
 ====================================================
-Cloth::SolveConstraintsClassic
+SolveLanes
+
+Projects four independent distance constraints.  Alpha is the compliance over the time step squared,
+it's zero for position based dynamics.  The extended version only takes a single iteration per substep,
+so the lagrange multipliers always start from zero and don't need to be stored.
 ====================================================
 */
-void Cloth::SolveConstraintsClassic( float dt_sec ) {
-	//
-	//	Satisfy constraints via projection
-	//
-	for ( int iter = 0; iter < m_numIters; iter++ ) {
-		for ( int i = 0; i < m_numConstraints; i++ ) {
-			ClothConstraint & c = m_constraints[ i ];
+static inline void SolveLanes( __m128 & ax, __m128 & ay, __m128 & az, __m128 & bx, __m128 & by, __m128 & bz, const __m128 invMassA, const __m128 invMassB, const __m128 restLength, const __m128 alpha ) {
+	const __m128 dx = _mm_sub_ps( bx, ax );
+	const __m128 dy = _mm_sub_ps( by, ay );
+	const __m128 dz = _mm_sub_ps( bz, az );
+
+	const __m128 lengthSqr = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+	const __m128 length = _mm_sqrt_ps( _mm_max_ps( lengthSqr, _mm_set1_ps( s_epsilon ) ) );
+	const __m128 diff = _mm_div_ps( _mm_sub_ps( length, restLength ), length );
+
+	// Both ends pinned divides by zero, the mask throws that away
+	const __m128 invMassSum = _mm_add_ps( invMassA, invMassB );
+	const __m128 isFree = _mm_cmpgt_ps( invMassSum, _mm_setzero_ps() );
+	const __m128 scale = _mm_and_ps( isFree, _mm_div_ps( diff, _mm_add_ps( invMassSum, alpha ) ) );
+	const __m128 scaleA = _mm_mul_ps( scale, invMassA );
+	const __m128 scaleB = _mm_mul_ps( scale, invMassB );
+
+	ax = _mm_add_ps( ax, _mm_mul_ps( dx, scaleA ) );
+	ay = _mm_add_ps( ay, _mm_mul_ps( dy, scaleA ) );
+	az = _mm_add_ps( az, _mm_mul_ps( dz, scaleA ) );
+	bx = _mm_sub_ps( bx, _mm_mul_ps( dx, scaleB ) );
+	by = _mm_sub_ps( by, _mm_mul_ps( dy, scaleB ) );
+	bz = _mm_sub_ps( bz, _mm_mul_ps( dz, scaleB ) );
+}
+#endif
 
-			Vec3 & x1 = m_particles[ c.m_idxA ].m_position;
-			Vec3 & x2 = m_particles[ c.m_idxB ].m_position;
+/*
+====================================================
+Cloth::SolvePair
+====================================================
+*/
+void Cloth::SolvePair( const int a, const int b, const float restLength, const float alpha ) {
+	const float invMassSum = m_invMass[ a ] + m_invMass[ b ];
+	if ( invMassSum <= 0.0f ) {
+		return;
+	}
 
-			Vec3 delta = x2 - x1;
+	const float dx = m_posX[ b ] - m_posX[ a ];
+	const float dy = m_posY[ b ] - m_posY[ a ];
+	const float dz = m_posZ[ b ] - m_posZ[ a ];
 
-			float deltaLength = delta.GetMagnitude();
-			float diff = ( deltaLength - c.m_restLength ) / deltaLength;
+	float lengthSqr = dx * dx + dy * dy + dz * dz;
+	if ( lengthSqr < s_epsilon ) {
+		lengthSqr = s_epsilon;
+	}
+	const float length = sqrtf( lengthSqr );
+	const float scale = ( ( length - restLength ) / length ) / ( invMassSum + alpha );
+	const float scaleA = scale * m_invMass[ a ];
+	const float scaleB = scale * m_invMass[ b ];
+
+	m_posX[ a ] += dx * scaleA;
+	m_posY[ a ] += dy * scaleA;
+	m_posZ[ a ] += dz * scaleA;
+	m_posX[ b ] -= dx * scaleB;
+	m_posY[ b ] -= dy * scaleB;
+	m_posZ[ b ] -= dz * scaleB;
+}
 
-			if ( diff * 0.0f == diff * 0.0f ) {
-				const float invMassA = m_particles[ c.m_idxA ].m_invMass;
-				const float invMassB = m_particles[ c.m_idxB ].m_invMass;
+/*
+====================================================
+Cloth::SolveRows
 
-				const float tA = invMassA / ( invMassA + invMassB );
-				const float tB = invMassB / ( invMassA + invMassB );
+Constraints between particle aBase + i and bBase + i, which are in different rows
+====================================================
+*/
+void Cloth::SolveRows( const int aBase, const int bBase, const int count, const float restLength, const float alpha ) {
+	int i = 0;
+#if defined( CLOTH_SIMD )
+	const __m128 rest = _mm_set1_ps( restLength );
+	const __m128 alpha4 = _mm_set1_ps( alpha );
+	for ( ; i + 4 <= count; i += 4 ) {
+		const int a = aBase + i;
+		const int b = bBase + i;
+
+		__m128 ax = _mm_loadu_ps( &m_posX[ a ] );
+		__m128 ay = _mm_loadu_ps( &m_posY[ a ] );
+		__m128 az = _mm_loadu_ps( &m_posZ[ a ] );
+		__m128 bx = _mm_loadu_ps( &m_posX[ b ] );
+		__m128 by = _mm_loadu_ps( &m_posY[ b ] );
+		__m128 bz = _mm_loadu_ps( &m_posZ[ b ] );
+		SolveLanes( ax, ay, az, bx, by, bz, _mm_loadu_ps( &m_invMass[ a ] ), _mm_loadu_ps( &m_invMass[ b ] ), rest, alpha4 );
+
+		_mm_storeu_ps( &m_posX[ a ], ax );
+		_mm_storeu_ps( &m_posY[ a ], ay );
+		_mm_storeu_ps( &m_posZ[ a ], az );
+		_mm_storeu_ps( &m_posX[ b ], bx );
+		_mm_storeu_ps( &m_posY[ b ], by );
+		_mm_storeu_ps( &m_posZ[ b ], bz );
+	}
+#endif
+	for ( ; i < count; i++ ) {
+		SolvePair( aBase + i, bBase + i, restLength, alpha );
+	}
+}
 
-				x1 += delta * diff * tA;
-				x2 -= delta * diff * tB;
-			}
-		}
+/*
+====================================================
+Cloth::SolveInterleaved
 
-		// Clamped cloth particles
-		for ( int i = 0; i < m_numClamps; i++ ) {
-			int idx = ( m_width - 1 ) * i / ( m_numClamps - 1 );
-			m_particles[ idx ].m_position = m_clamped[ i ];
-		}
+Constraints between particle aBase + 2i and aBase + 2i + 1, which are in the same row.
+Eight consecutive floats hold four constraints, so they're split into even and odd lanes.
+====================================================
+*/
+void Cloth::SolveInterleaved( const int aBase, const int count, const float restLength, const float alpha ) {
+	int i = 0;
+#if defined( CLOTH_SIMD )
+	const __m128 rest = _mm_set1_ps( restLength );
+	const __m128 alpha4 = _mm_set1_ps( alpha );
+	for ( ; i + 4 <= count; i += 4 ) {
+		const int a = aBase + 2 * i;
+
+		const __m128 loX = _mm_loadu_ps( &m_posX[ a ] );
+		const __m128 hiX = _mm_loadu_ps( &m_posX[ a + 4 ] );
+		const __m128 loY = _mm_loadu_ps( &m_posY[ a ] );
+		const __m128 hiY = _mm_loadu_ps( &m_posY[ a + 4 ] );
+		const __m128 loZ = _mm_loadu_ps( &m_posZ[ a ] );
+		const __m128 hiZ = _mm_loadu_ps( &m_posZ[ a + 4 ] );
+		const __m128 loM = _mm_loadu_ps( &m_invMass[ a ] );
+		const __m128 hiM = _mm_loadu_ps( &m_invMass[ a + 4 ] );
+
+		__m128 ax = _mm_shuffle_ps( loX, hiX, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 ay = _mm_shuffle_ps( loY, hiY, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 az = _mm_shuffle_ps( loZ, hiZ, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 bx = _mm_shuffle_ps( loX, hiX, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+		__m128 by = _mm_shuffle_ps( loY, hiY, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+		__m128 bz = _mm_shuffle_ps( loZ, hiZ, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+		const __m128 invMassA = _mm_shuffle_ps( loM, hiM, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		const __m128 invMassB = _mm_shuffle_ps( loM, hiM, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+		SolveLanes( ax, ay, az, bx, by, bz, invMassA, invMassB, rest, alpha4 );
+
+		_mm_storeu_ps( &m_posX[ a ], _mm_unpacklo_ps( ax, bx ) );
+		_mm_storeu_ps( &m_posX[ a + 4 ], _mm_unpackhi_ps( ax, bx ) );
+		_mm_storeu_ps( &m_posY[ a ], _mm_unpacklo_ps( ay, by ) );
+		_mm_storeu_ps( &m_posY[ a + 4 ], _mm_unpackhi_ps( ay, by ) );
+		_mm_storeu_ps( &m_posZ[ a ], _mm_unpacklo_ps( az, bz ) );
+		_mm_storeu_ps( &m_posZ[ a + 4 ], _mm_unpackhi_ps( az, bz ) );
+	}
+#endif
+	for ( ; i < count; i++ ) {
+		const int a = aBase + 2 * i;
+		SolvePair( a, a + 1, restLength, alpha );
 	}
 }
 
 /*
 ====================================================
-Cloth::SolveConstraintsColored
+Cloth::SolveBendRow
+
+Constraints between particle x and x + 2 of the row, for every x that's startX or startX + 1 mod four.
+Eight consecutive floats hold four constraints, the first and second pairs of each half.
 ====================================================
 */
-void Cloth::SolveConstraintsColored( float dt_sec ) {
-	//
-	//	Satisfy constraints via projection
-	//
-	for ( int iter = 0; iter < m_numIters; iter++ ) {
-		for ( int colorIdx = 0; colorIdx < m_numColors; colorIdx++ ) {
-			int colorCount = m_colorCounts[ colorIdx ];
-
-			for ( int i = 0; i < colorCount; i++ ) {
-				ClothConstraint & c = m_coloredConstraints[ colorIdx ][ i ];
+void Cloth::SolveBendRow( const int rowStart, const int startX, const float alpha ) {
+	const float restLength = 2.0f * m_restX;
+
+	int x = startX;
+#if defined( CLOTH_SIMD )
+	const __m128 rest = _mm_set1_ps( restLength );
+	const __m128 alpha4 = _mm_set1_ps( alpha );
+	for ( ; x + 8 <= m_width; x += 8 ) {
+		const int a = rowStart + x;
+
+		const __m128 loX = _mm_loadu_ps( &m_posX[ a ] );
+		const __m128 hiX = _mm_loadu_ps( &m_posX[ a + 4 ] );
+		const __m128 loY = _mm_loadu_ps( &m_posY[ a ] );
+		const __m128 hiY = _mm_loadu_ps( &m_posY[ a + 4 ] );
+		const __m128 loZ = _mm_loadu_ps( &m_posZ[ a ] );
+		const __m128 hiZ = _mm_loadu_ps( &m_posZ[ a + 4 ] );
+		const __m128 loM = _mm_loadu_ps( &m_invMass[ a ] );
+		const __m128 hiM = _mm_loadu_ps( &m_invMass[ a + 4 ] );
+
+		__m128 ax = _mm_shuffle_ps( loX, hiX, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m128 ay = _mm_shuffle_ps( loY, hiY, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m128 az = _mm_shuffle_ps( loZ, hiZ, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m128 bx = _mm_shuffle_ps( loX, hiX, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m128 by = _mm_shuffle_ps( loY, hiY, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m128 bz = _mm_shuffle_ps( loZ, hiZ, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		const __m128 invMassA = _mm_shuffle_ps( loM, hiM, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		const __m128 invMassB = _mm_shuffle_ps( loM, hiM, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		SolveLanes( ax, ay, az, bx, by, bz, invMassA, invMassB, rest, alpha4 );
+
+		_mm_storeu_ps( &m_posX[ a ], _mm_shuffle_ps( ax, bx, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+		_mm_storeu_ps( &m_posX[ a + 4 ], _mm_shuffle_ps( ax, bx, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+		_mm_storeu_ps( &m_posY[ a ], _mm_shuffle_ps( ay, by, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+		_mm_storeu_ps( &m_posY[ a + 4 ], _mm_shuffle_ps( ay, by, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+		_mm_storeu_ps( &m_posZ[ a ], _mm_shuffle_ps( az, bz, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+		_mm_storeu_ps( &m_posZ[ a + 4 ], _mm_shuffle_ps( az, bz, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+	}
+#endif
+	for ( ; x + 2 < m_width; x += 4 ) {
+		SolvePair( rowStart + x, rowStart + x + 2, restLength, alpha );
+		if ( x + 3 < m_width ) {
+			SolvePair( rowStart + x + 1, rowStart + x + 3, restLength, alpha );
+		}
+	}
+}
 
-				Vec3 & x1 = m_particles[ c.m_idxA ].m_position;
-				Vec3 & x2 = m_particles[ c.m_idxB ].m_position;
+/*
+====================================================
+Cloth::SolveStrip
 
-				Vec3 delta = x2 - x1;
+Solves one row's worth of a color's constraints
+====================================================
+*/
+void Cloth::SolveStrip( const int color, const int row ) {
+	const int rowStart = row * m_width;
+	const int nextRowStart = rowStart + m_width;
+
+	switch ( color ) {
+		case CC_HORIZONTAL_EVEN: { SolveInterleaved( rowStart, m_width / 2, m_restX, m_alphaStretch ); } break;
+		case CC_HORIZONTAL_ODD: { SolveInterleaved( rowStart + 1, ( m_width - 1 ) / 2, m_restX, m_alphaStretch ); } break;
+		case CC_VERTICAL_EVEN:
+		case CC_VERTICAL_ODD: { SolveRows( rowStart, nextRowStart, m_width, m_restY, m_alphaStretch ); } break;
+		case CC_BACKSLASH_EVEN:
+		case CC_BACKSLASH_ODD: { SolveRows( rowStart, nextRowStart + 1, m_width - 1, m_restDiagonal, m_alphaShear ); } break;
+		case CC_SLASH_EVEN:
+		case CC_SLASH_ODD: { SolveRows( rowStart + 1, nextRowStart, m_width - 1, m_restDiagonal, m_alphaShear ); } break;
+		case CC_BEND_HORIZONTAL_EVEN: { SolveBendRow( rowStart, 0, m_alphaBend ); } break;
+		case CC_BEND_HORIZONTAL_ODD: { SolveBendRow( rowStart, 2, m_alphaBend ); } break;
+		case CC_BEND_VERTICAL_EVEN:
+		case CC_BEND_VERTICAL_ODD: { SolveRows( rowStart, nextRowStart + m_width, m_width, 2.0f * m_restY, m_alphaBend ); } break;
+		default: { assert( false ); } break;
+	};
+}
 
-				float deltaLength = delta.GetMagnitude();
-				float diff = ( deltaLength - c.m_restLength ) / deltaLength;
+/*
+====================================================
+Cloth::SolveStripsJob
+====================================================
+*/
+void Cloth::SolveStripsJob( Job_t * job, void * data ) {
+	const clothStripJob_t * strips = (const clothStripJob_t *)job->m_data;
 
-				if ( diff * 0.0f == diff * 0.0f ) {
-					const float invMassA = m_particles[ c.m_idxA ].m_invMass;
-					const float invMassB = m_particles[ c.m_idxB ].m_invMass;
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		strips[ i ].cloth->SolveStrip( strips[ i ].color, strips[ i ].row );
+	}
+}
 
-					const float tA = invMassA / ( invMassA + invMassB );
-					const float tB = invMassB / ( invMassA + invMassB );
+/*
+====================================================
+Cloth::SolveConstraints
 
-					x1 += delta * diff * tA;
-					x2 -= delta * diff * tB;
+Satisfy constraints via projection, a color at a time
+====================================================
+*/
+void Cloth::SolveConstraints( const int numIters, const int numColors, const bool useJobs ) {
+	for ( int iter = 0; iter < numIters; iter++ ) {
+		for ( int color = 0; color < numColors; color++ ) {
+			std::vector< clothStripJob_t > & strips = m_strips[ color ];
+
+			if ( useJobs ) {
+				g_jobSystem->ParallelFor( SolveStripsJob, strips.data(), sizeof( clothStripJob_t ), (int)strips.size() );
+				g_jobSystem->Wait( NULL );
+			} else {
+				for ( int i = 0; i < strips.size(); i++ ) {
+					SolveStrip( color, strips[ i ].row );
 				}
 			}
 		}
-
-		// Clamped cloth particles
-		for ( int i = 0; i < m_numClamps; i++ ) {
-			int idx = ( m_width - 1 ) * i / ( m_numClamps - 1 );
-			m_particles[ idx ].m_position = m_clamped[ i ];
-		}
 	}
 }
 
 /*
 ====================================================
-Cloth::SolveConstraintsLagrange
+Cloth::UpdateBounds
 ====================================================
 */
-void Cloth::SolveConstraintsLagrange( float dt_sec ) {
-	//
-	//	Copy particle positions and velocities
-	//
-	for ( int i = 0; i < m_numConstraints; i++ ) {
-		ClothConstraint2 & constraint = m_constraints2[ i ];
-		const ClothParticle & a = m_particles[ constraint.m_idxA ];
-		const ClothParticle & b = m_particles[ constraint.m_idxB ];
-
-		constraint.m_posA = a.m_position;
-		constraint.m_posB = b.m_position;
+void Cloth::UpdateBounds() {
+	const int numParticles = m_width * m_height;
 
-		constraint.m_velA = a.m_velocity;//( a.m_position - a.m_positionOld ) / dt_sec;
-		constraint.m_velB = b.m_velocity;//( b.m_position - b.m_positionOld ) / dt_sec;
-
-		constraint.m_invMassA = a.m_invMass;
-		constraint.m_invMassB = b.m_invMass;
-	}
-
-	//
-	//	Solve Constraints
-	//
-	for ( int i = 0; i < m_numConstraints; i++ ) {
-		m_constraints2[ i ].PreSolve( dt_sec );
-	}
+	int i = 0;
+	m_bounds.Clear();
+#if defined( CLOTH_SIMD )
+	if ( numParticles >= 4 ) {
+		__m128 minX = _mm_loadu_ps( &m_posX[ 0 ] );
+		__m128 minY = _mm_loadu_ps( &m_posY[ 0 ] );
+		__m128 minZ = _mm_loadu_ps( &m_posZ[ 0 ] );
+		__m128 maxX = minX;
+		__m128 maxY = minY;
+		__m128 maxZ = minZ;
+		for ( i = 4; i + 4 <= numParticles; i += 4 ) {
+			const __m128 x = _mm_loadu_ps( &m_posX[ i ] );
+			const __m128 y = _mm_loadu_ps( &m_posY[ i ] );
+			const __m128 z = _mm_loadu_ps( &m_posZ[ i ] );
+			minX = _mm_min_ps( minX, x );
+			minY = _mm_min_ps( minY, y );
+			minZ = _mm_min_ps( minZ, z );
+			maxX = _mm_max_ps( maxX, x );
+			maxY = _mm_max_ps( maxY, y );
+			maxZ = _mm_max_ps( maxZ, z );
+		}
 
-	const int maxIters = 1;//5;
-	for ( int iters = 0; iters < maxIters; iters++ ) {
-		for ( int i = 0; i < m_numConstraints; i++ ) {
-			m_constraints2[ i ].Solve();
+		float mins[ 3 ][ 4 ];
+		float maxs[ 3 ][ 4 ];
+		_mm_storeu_ps( mins[ 0 ], minX );
+		_mm_storeu_ps( mins[ 1 ], minY );
+		_mm_storeu_ps( mins[ 2 ], minZ );
+		_mm_storeu_ps( maxs[ 0 ], maxX );
+		_mm_storeu_ps( maxs[ 1 ], maxY );
+		_mm_storeu_ps( maxs[ 2 ], maxZ );
+		for ( int lane = 0; lane < 4; lane++ ) {
+			m_bounds.Expand( Vec3( mins[ 0 ][ lane ], mins[ 1 ][ lane ], mins[ 2 ][ lane ] ) );
+			m_bounds.Expand( Vec3( maxs[ 0 ][ lane ], maxs[ 1 ][ lane ], maxs[ 2 ][ lane ] ) );
 		}
 	}
-
-	//
-	//	Copy positions/velocities back
-	//
-	for ( int i = 0; i < m_numConstraints; i++ ) {
-		const ClothConstraint2 & constraint = m_constraints2[ i ];
-		ClothParticle & a = m_particles[ constraint.m_idxA ];
-
-		a.m_position = constraint.m_posA;
-		a.m_velocity = constraint.m_velA;
-		//a.m_positionOld = constraint.m_posA - constraint.m_velA * dt_sec;
+#endif
+	for ( ; i < numParticles; i++ ) {
+		m_bounds.Expand( Vec3( m_posX[ i ], m_posY[ i ], m_posZ[ i ] ) );
 	}
+}
 
-	// Clamped cloth particles
-	for ( int i = 0; i < m_numClamps; i++ ) {
-		int idx = ( m_width - 1 ) * i / ( m_numClamps - 1 );
-		m_particles[ idx ].m_position = m_clamped[ i ];
-	}
+/*
+====================================================
+Cloth::UseJobs
+====================================================
+*/
+bool Cloth::UseJobs( const bool useJobs ) const {
+	return ( useJobs && NULL != g_jobSystem && GetNumParticles() >= PARALLEL_MIN_PARTICLES );
 }
 
 /*
 ====================================================
-Cloth::SolveConstraints
+Cloth::RunRanges
 ====================================================
 */
-void Cloth::SolveConstraints( float dt_sec ) {
-	SolveConstraintsClassic( dt_sec );
-//	SolveConstraintsColored( dt_sec );
-//	SolveConstraintsLagrange( dt_sec );
+void Cloth::RunRanges( void ( *function )( Job_t *, void * ), const bool useJobs ) {
+	if ( useJobs ) {
+		g_jobSystem->ParallelFor( function, m_ranges.data(), sizeof( clothRangeJob_t ), (int)m_ranges.size() );
+		g_jobSystem->Wait( NULL );
+		return;
+	}
+
+	Job_t job;
+	job.m_data = m_ranges.data();
+	job.m_numElements = (int)m_ranges.size();
+	function( &job, NULL );
 }
 
 /*
@@ -446,268 +659,388 @@ void Cloth::SolveConstraints( float dt_sec ) {
 Cloth::Update
 ====================================================
 */
-void Cloth::Update( float dt_sec ) {
-#if 1
-	//
-	//	Accumulate Forces
-	//
-	for ( int i = 0; i < m_width * m_height; i++ ) {
-		m_particles[ i ].m_acceleration = Vec3( 0, 0, -10.01f );
+void Cloth::Update( const float dt_sec, const bool useJobs ) {
+	const bool isParallel = UseJobs( useJobs );
+
+	if ( CS_XPBD == m_solver ) {
+		// Smaller steps make the cloth stiffer than more iterations would, for the same cost
+		const float dt = dt_sec / (float)m_numSubsteps;
+		const float invDtSqr = 1.0f / ( dt * dt );
+		m_alphaStretch = m_complianceStretch * invDtSqr;
+		m_alphaShear = m_complianceShear * invDtSqr;
+		m_alphaBend = m_complianceBend * invDtSqr;
+
+		for ( int step = 0; step < m_numSubsteps; step++ ) {
+			Integrate( dt );
+			SolveConstraints( 1, NUM_COLORS, isParallel );
+		}
+	} else {
+		m_alphaStretch = 0.0f;
+		m_alphaShear = 0.0f;
+		m_alphaBend = 0.0f;
+
+		Integrate( dt_sec );
+		SolveConstraints( m_numIters, s_numPbdColors, isParallel );
 	}
 
-	//
-	//	Velocity Verlet integration:
-	//
-	// x1 = x0 + v0 * dt + 1/2 * a0 * dt^2
-	// v = ( x0 - x_1 ) / dt
-	// => x1 = x0 + dt * ( x0 - x_1 ) / dt + 1/2 * a0 * dt^2
-	// => x1 = x0 + ( x0 - x_1 ) + 1/2 * a0 * dt^2
-	// => x1 = 2 * x0 - x_1 + 1/2 * a0 * dt^2
-	//
-	// If there's a damping factor k, then:
-	// => x1 = x0 + ( x0 - x_1 ) * k + 1/2 * a0 * dt^2
-
-	for ( int i = 0; i < m_width * m_height; i++ ) {
-		ClothParticle & particle = m_particles[ i ];
-
-		if ( particle.m_invMass > 0.0f ) {
-			Vec3 poo	= particle.m_position;
-			Vec3 x0		= particle.m_position;
-			Vec3 x_1	= particle.m_positionOld;
-			Vec3 a0		= particle.m_acceleration;
-			Vec3 x1		= x0 * 2.0f - x_1 + a0 * dt_sec * dt_sec * 0.5f;
-		 
-			const float k = 1.0f;//0.99f;
-			x1 = x0 + ( x0 - x_1 ) * k + a0 * dt_sec * dt_sec * 0.5f;
-		
-			particle.m_position = x1;
-			particle.m_positionOld = x0;
-		}
+	if ( m_selfCollision ) {
+		SelfCollide( isParallel );
 	}
 
-// 	for ( int i = 0; i < m_width * m_height; i++ ) {
-// 		ClothParticle & particle = m_particles[ i ];
-// 
-// 		if ( particle.m_invMass > 0.0f ) {
-// 			particle.m_velocity += Vec3( 0, 0, -10 ) * dt_sec;
-// 		}
-// 	}
+	UpdateBounds();
+}
+
+/*
+========================================================================================================
 
-	SolveConstraints( dt_sec );
+Self Collision
 
-// 	for ( int i = 0; i < m_width * m_height; i++ ) {
-// 		ClothParticle & particle = m_particles[ i ];
-// 
-// 		if ( particle.m_invMass > 0.0f ) {
-// 			particle.m_position += particle.m_velocity * dt_sec;
-// 		}
-// 	}
-#endif
-	//
-	//	Update Bounds
-	//
-	m_bounds.Clear();
-	for ( int i = 0; i < m_width * m_height; i++ ) {
-		m_bounds.Expand( m_particles[ i ].m_position );
-	}
-}
+========================================================================================================
+*/
 
 /*
 ====================================================
-Cloth::Collide
+HashCell
 ====================================================
 */
-void Cloth::Collide( const ShapeSphere * shape, const Vec3 & spherePos ) {
-	// Use bounds to early out
-	Bounds boundsShape = shape->GetBounds();
-	boundsShape.mins += spherePos;
-	boundsShape.maxs += spherePos;
-	if ( !m_bounds.DoesIntersect( boundsShape ) ) {
-		return;
-	}
-
-	const float radius = shape->m_radius;
-	for ( int i = 0; i < m_width * m_height; i++ ) {
-		Vec3 & pos = m_particles[ i ].m_position;
+static inline int HashCell( const int x, const int y, const int z, const int mask ) {
+	const unsigned int hash = ( (unsigned int)x * 73856093u ) ^ ( (unsigned int)y * 19349663u ) ^ ( (unsigned int)z * 83492791u );
+	return (int)( hash & (unsigned int)mask );
+}
 
-		Vec3 delta = pos - spherePos;	// ray from center of sphere to particle
-		float lengthSqr = delta.GetLengthSqr();
+/*
+====================================================
+Cloth::BuildHashGrid
 
+Counting sort of the particles by hash cell.  The cells are twice the thickness,
+so anything touching a particle is in its own cell or the neighbors on its nearer sides.
+====================================================
+*/
+void Cloth::BuildHashGrid() {
+	const int numParticles = GetNumParticles();
+	const float invCellSize = 0.5f / m_thickness;
+
+	std::fill( m_cellStart.begin(), m_cellStart.end(), 0 );
+	for ( int i = 0; i < numParticles; i++ ) {
+		int * cell = &m_particleCells[ i * 3 ];
+		cell[ 0 ] = (int)floorf( m_posX[ i ] * invCellSize );
+		cell[ 1 ] = (int)floorf( m_posY[ i ] * invCellSize );
+		cell[ 2 ] = (int)floorf( m_posZ[ i ] * invCellSize );
+		m_cellStart[ HashCell( cell[ 0 ], cell[ 1 ], cell[ 2 ], m_hashMask ) ]++;
+	}
 
-		if ( lengthSqr < radius * radius ) {
- 			delta.Normalize();
+	// Turn the counts into the end of each cell, then filling walks them back to the start
+	int sum = 0;
+	for ( int h = 0; h <= m_hashMask; h++ ) {
+		sum += m_cellStart[ h ];
+		m_cellStart[ h ] = sum;
+	}
+	m_cellStart[ m_hashMask + 1 ] = sum;
 
-			pos = spherePos + delta * radius;
-		}
+	for ( int i = 0; i < numParticles; i++ ) {
+		const int * cell = &m_particleCells[ i * 3 ];
+		const int h = HashCell( cell[ 0 ], cell[ 1 ], cell[ 2 ], m_hashMask );
+		m_cellStart[ h ]--;
+		m_cellEntries[ m_cellStart[ h ] ] = i;
 	}
 }
 
+/*
+====================================================
+Cloth::SelfCollideRange
 
+Each particle only writes its own correction, so the ranges can run at the same time.
+Both particles of a pair see each other, and each takes its share of the overlap.
+====================================================
+*/
+void Cloth::SelfCollideRange( const int first, const int count ) {
+	const float cellSize = 2.0f * m_thickness;
+	const float thicknessSqr = m_thickness * m_thickness;
+
+	for ( int i = first; i < first + count; i++ ) {
+		m_deltaX[ i ] = 0.0f;
+		m_deltaY[ i ] = 0.0f;
+		m_deltaZ[ i ] = 0.0f;
+		if ( m_invMass[ i ] <= 0.0f ) {
+			continue;
+		}
 
+		const int ix = i % m_width;
+		const int iy = i / m_width;
+		const int * cell = &m_particleCells[ i * 3 ];
+
+		// Step towards the nearer neighbor on each axis
+		const int stepX = ( m_posX[ i ] - (float)cell[ 0 ] * cellSize < m_thickness ) ? -1 : 1;
+		const int stepY = ( m_posY[ i ] - (float)cell[ 1 ] * cellSize < m_thickness ) ? -1 : 1;
+		const int stepZ = ( m_posZ[ i ] - (float)cell[ 2 ] * cellSize < m_thickness ) ? -1 : 1;
+
+		float deltaX = 0.0f;
+		float deltaY = 0.0f;
+		float deltaZ = 0.0f;
+		for ( int n = 0; n < 8; n++ ) {
+			const int x = cell[ 0 ] + ( ( n & 1 ) ? stepX : 0 );
+			const int y = cell[ 1 ] + ( ( n & 2 ) ? stepY : 0 );
+			const int z = cell[ 2 ] + ( ( n & 4 ) ? stepZ : 0 );
+			const int h = HashCell( x, y, z, m_hashMask );
+			for ( int k = m_cellStart[ h ]; k < m_cellStart[ h + 1 ]; k++ ) {
+				const int j = m_cellEntries[ k ];
+
+				// Other cells can share this hash, only visit the particle from its own cell
+				const int * cellJ = &m_particleCells[ j * 3 ];
+				if ( x != cellJ[ 0 ] || y != cellJ[ 1 ] || z != cellJ[ 2 ] ) {
+					continue;
+				}
 
+				// The constraints already keep the direct neighbors apart, and they're never more than a row plus one away
+				if ( abs( j - i ) <= m_width + 1 ) {
+					const int jx = j % m_width;
+					const int jy = j / m_width;
+					if ( abs( jx - ix ) <= 1 && abs( jy - iy ) <= 1 ) {
+						continue;
+					}
+				}
 
+				const float dx = m_posX[ i ] - m_posX[ j ];
+				const float dy = m_posY[ i ] - m_posY[ j ];
+				const float dz = m_posZ[ i ] - m_posZ[ j ];
+				const float distSqr = dx * dx + dy * dy + dz * dz;
+				if ( distSqr >= thicknessSqr || distSqr < s_epsilon ) {
+					continue;
+				}
 
+				const float dist = sqrtf( distSqr );
+				const float share = m_invMass[ i ] / ( m_invMass[ i ] + m_invMass[ j ] );
+				const float scale = share * ( m_thickness - dist ) / dist;
+				deltaX += dx * scale;
+				deltaY += dy * scale;
+				deltaZ += dz * scale;
+			}
+		}
 
+		m_deltaX[ i ] = deltaX;
+		m_deltaY[ i ] = deltaY;
+		m_deltaZ[ i ] = deltaZ;
+	}
+}
 
+/*
+====================================================
+Cloth::SelfCollideJob
+====================================================
+*/
+void Cloth::SelfCollideJob( Job_t * job, void * data ) {
+	const clothRangeJob_t * ranges = (const clothRangeJob_t *)job->m_data;
 
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		ranges[ i ].cloth->SelfCollideRange( ranges[ i ].first, ranges[ i ].count );
+	}
+}
+
+/*
+====================================================
+Cloth::SelfCollide
+====================================================
+*/
+void Cloth::SelfCollide( const bool useJobs ) {
+	BuildHashGrid();
+	RunRanges( SelfCollideJob, useJobs );
+
+	const int numParticles = GetNumParticles();
+	for ( int i = 0; i < numParticles; i++ ) {
+		m_posX[ i ] += m_deltaX[ i ];
+		m_posY[ i ] += m_deltaY[ i ];
+		m_posZ[ i ] += m_deltaZ[ i ];
+	}
+}
 
 /*
 ========================================================================================================
 
-ClothConstraint2
+World Collision
 
 ========================================================================================================
 */
 
-
-
-
-
-
-
 /*
 ====================================================
-ClothConstraint2::PreSolve
+IsConvexCollider
 ====================================================
 */
-void ClothConstraint2::PreSolve( const float dt_sec ) {
-	const Vec3 r = m_posB - m_posA;
-	Vec3 ur = r;
-	ur.Normalize();
-	float halfLength = m_restLength * 0.5f;
-	const Vec3 a = m_posA + ur * halfLength;	// anchor position for body a
-	const Vec3 b = m_posB - ur * halfLength;	// anchor position for body b
-
-	m_Jacobian.Zero();
-
-	Vec3 J1 = ( a - b ) * 2.0f;
-	m_Jacobian.rows[ 0 ][ 0 ] = J1.x;
-	m_Jacobian.rows[ 0 ][ 1 ] = J1.y;
-	m_Jacobian.rows[ 0 ][ 2 ] = J1.z;
-
-	Vec3 J3 = ( b - a ) * 2.0f;
-	m_Jacobian.rows[ 0 ][ 3 ] = J3.x;
-	m_Jacobian.rows[ 0 ][ 4 ] = J3.y;
-	m_Jacobian.rows[ 0 ][ 5 ] = J3.z;
-
-#define WARM_STARTING
-#if defined( WARM_STARTING )
-	//
-	// Apply warm starting from last frame
-	//
-	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
-	ApplyImpulses( impulses );
-#endif
+static bool IsConvexCollider( const Shape * shape ) {
+	if ( NULL == shape ) {
+		return false;
+	}
+	const Shape::shapeType_t type = shape->GetType();
+	return ( Shape::SHAPE_SPHERE == type || Shape::SHAPE_BOX == type || Shape::SHAPE_CONVEX == type || Shape::SHAPE_CAPSULE == type );
+}
 
-//#define BAUMGARTE_STABILIZATION
-#if defined( BAUMGARTE_STABILIZATION )
-	//
-	//	Calculate the baumgarte stabilization
-	//
-	float C = r.Dot( r );
-	C = std::max( 0.0f, C - 0.001f );
-	const float Beta = 0.05f;
-	m_baumgarte = ( Beta / dt_sec ) * C;
-#else
-	m_baumgarte = 0.0f;
-#endif
+/*
+====================================================
+Cloth::GatherColliders
+====================================================
+*/
+void Cloth::GatherColliders( PhysicsWorld * world, const unsigned int contentsMask ) {
+	m_colliders.clear();
+
+	Bounds bounds = m_bounds;
+	bounds.mins -= Vec3( m_thickness );
+	bounds.maxs += Vec3( m_thickness );
+
+	// Anything past the max is ignored until the cloth moves away from the others
+	int bodyIds[ MAX_COLLIDERS ];
+	const int numIds = world->QueryBounds( bounds, contentsMask, bodyIds, MAX_COLLIDERS );
+	const PhysicsWorld * constWorld = world;
+	for ( int i = 0; i < numIds; i++ ) {
+		const Body * body = constWorld->GetBody( bodyIds[ i ] );
+		if ( IsConvexCollider( body->m_shape ) ) {
+			m_colliders.push_back( body );
+		}
+	}
 }
 
 /*
 ====================================================
-ClothConstraint2::Solve
+Cloth::CollideWorldRange
+
+The particles are run through the narrowphase as spheres of the cloth's thickness,
+so everything but the spheres and boxes goes through the shape's support function.
 ====================================================
 */
-void ClothConstraint2::Solve() {
-	const MatMN JacobianTranspose = m_Jacobian.Transpose();
+void Cloth::CollideWorldRange( const int first, const int count ) {
+	ShapeSphere particleShape( m_thickness );
+	Body particle;
+	particle.m_shape = &particleShape;
 
-	// Build the system of equations
-	const VecN q_dt = GetVelocities();
-	const MatMN invMassMatrix = GetInverseMassMatrix();
-	const MatMN J_W_Jt = m_Jacobian * invMassMatrix * JacobianTranspose;
-	VecN rhs = ( m_Jacobian * q_dt * -1.0f );
-	rhs[ 0 ] -= m_baumgarte;
-	
-	// Solve for the Lagrange multipliers
-	const VecN lambdaN = LCP_GaussSeidel( J_W_Jt, rhs );
+	for ( int c = 0; c < m_colliders.size(); c++ ) {
+		const Body * body = m_colliders[ c ];
 
-	// Apply the impulses
-	const VecN impulses = JacobianTranspose * lambdaN;
-	ApplyImpulses( impulses );
+		Bounds bounds = body->m_shape->GetBounds( body->m_position, body->m_orientation );
+		bounds.mins -= Vec3( m_thickness );
+		bounds.maxs += Vec3( m_thickness );
 
-	// Accumulate the impulses for warm starting
-	m_cachedLambda += lambdaN;
-	m_cachedImpulses += impulses;
-}
+		for ( int i = first; i < first + count; i++ ) {
+			if ( m_invMass[ i ] <= 0.0f ) {
+				continue;
+			}
 
+			const Vec3 pos = Vec3( m_posX[ i ], m_posY[ i ], m_posZ[ i ] );
+			if ( pos.x < bounds.mins.x || pos.y < bounds.mins.y || pos.z < bounds.mins.z ||
+				pos.x > bounds.maxs.x || pos.y > bounds.maxs.y || pos.z > bounds.maxs.z ) {
+				continue;
+			}
 
+			// The kernels don't change the bodies, they only take them as non-const for the contacts
+			particle.m_position = pos;
+			contact_t contacts[ MAX_PAIR_CONTACTS ];
+			if ( 0 == NarrowPhase( &particle, (Body *)body, contacts, 1, NULL ) ) {
+				continue;
+			}
+			if ( contacts[ 0 ].separationDistance >= 0.0f ) {
+				continue;
+			}
 
+			// The normal points from the body to the particle
+			const Vec3 correction = contacts[ 0 ].normal * -contacts[ 0 ].separationDistance;
+			m_posX[ i ] += correction.x;
+			m_posY[ i ] += correction.y;
+			m_posZ[ i ] += correction.z;
+		}
+	}
+}
 
 /*
 ====================================================
-ClothConstraint2::GetInverseMassMatrix
+Cloth::CollideWorldJob
 ====================================================
 */
-MatMN ClothConstraint2::GetInverseMassMatrix() const {
-	MatMN invMassMatrix( 6, 6 );
-	invMassMatrix.Zero();
-
-	invMassMatrix.rows[ 0 ][ 0 ] = m_invMassA;
-	invMassMatrix.rows[ 1 ][ 1 ] = m_invMassA;
-	invMassMatrix.rows[ 2 ][ 2 ] = m_invMassA;
+void Cloth::CollideWorldJob( Job_t * job, void * data ) {
+	const clothRangeJob_t * ranges = (const clothRangeJob_t *)job->m_data;
 
-	invMassMatrix.rows[ 3 ][ 3 ] = m_invMassB;
-	invMassMatrix.rows[ 4 ][ 4 ] = m_invMassB;
-	invMassMatrix.rows[ 5 ][ 5 ] = m_invMassB;
-
-	return invMassMatrix;
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		ranges[ i ].cloth->CollideWorldRange( ranges[ i ].first, ranges[ i ].count );
+	}
 }
 
 /*
 ====================================================
-ClothConstraint2::GetVelocities
+Cloth::CollideWorld
 ====================================================
 */
-VecN ClothConstraint2::GetVelocities() const {
-	VecN q_dt( 6 );
-
-	q_dt[ 0 ] = m_velA.x;
-	q_dt[ 1 ] = m_velA.y;
-	q_dt[ 2 ] = m_velA.z;
-
-	q_dt[ 3 ] = m_velB.x;
-	q_dt[ 4 ] = m_velB.y;
-	q_dt[ 5 ] = m_velB.z;
+void Cloth::CollideWorld( const bool useJobs ) {
+	if ( m_colliders.empty() ) {
+		return;
+	}
 
-	return q_dt;
+	RunRanges( CollideWorldJob, UseJobs( useJobs ) );
+	UpdateBounds();
 }
 
 /*
 ====================================================
-ClothConstraint2::ApplyImpulses
+Cloth::Collide
+
+Pushes the particles out of the sphere
 ====================================================
 */
-void ClothConstraint2::ApplyImpulses( const VecN & impulses ) {
-	Vec3 forceInternalA( 0.0f );
-	Vec3 forceInternalB( 0.0f );
-
-	forceInternalA[ 0 ] = impulses[ 0 ];
-	forceInternalA[ 1 ] = impulses[ 1 ];
-	forceInternalA[ 2 ] = impulses[ 2 ];
-
-	forceInternalB[ 0 ] = impulses[ 6 ];
-	forceInternalB[ 1 ] = impulses[ 7 ];
-	forceInternalB[ 2 ] = impulses[ 8 ];
+void Cloth::Collide( const ShapeSphere * shape, const Vec3 & spherePos ) {
+	// Use bounds to early out
+	Bounds boundsShape = shape->GetBounds();
+	boundsShape.mins += spherePos;
+	boundsShape.maxs += spherePos;
+	if ( !m_bounds.DoesIntersect( boundsShape ) ) {
+		return;
+	}
 
-//	m_bodyA->ApplyImpulseLinear( forceInternalA );
-//	m_bodyB->ApplyImpulseLinear( forceInternalB );
-	m_velA += forceInternalA * m_invMassA;
-	m_velB += forceInternalB * m_invMassB;
+	const float radius = shape->m_radius;
+	const int numPadded = (int)m_posX.size();
+
+#if defined( CLOTH_SIMD )
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 epsilon = _mm_set1_ps( s_epsilon );
+	const __m128 r = _mm_set1_ps( radius );
+	const __m128 radiusSqr = _mm_set1_ps( radius * radius );
+	const __m128 cx = _mm_set1_ps( spherePos.x );
+	const __m128 cy = _mm_set1_ps( spherePos.y );
+	const __m128 cz = _mm_set1_ps( spherePos.z );
+	for ( int i = 0; i < numPadded; i += 4 ) {
+		const __m128 x = _mm_loadu_ps( &m_posX[ i ] );
+		const __m128 y = _mm_loadu_ps( &m_posY[ i ] );
+		const __m128 z = _mm_loadu_ps( &m_posZ[ i ] );
+
+		// ray from center of sphere to particle
+		const __m128 dx = _mm_sub_ps( x, cx );
+		const __m128 dy = _mm_sub_ps( y, cy );
+		const __m128 dz = _mm_sub_ps( z, cz );
+		const __m128 lengthSqr = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+
+		const __m128 isFree = _mm_cmpgt_ps( _mm_loadu_ps( &m_invMass[ i ] ), zero );
+		const __m128 isInside = _mm_and_ps( isFree, _mm_cmplt_ps( lengthSqr, radiusSqr ) );
+		if ( 0 == _mm_movemask_ps( isInside ) ) {
+			continue;
+		}
 
-	if ( !forceInternalA.IsValid() ) {
-		printf( "oh boy\n" );
+		const __m128 scale = _mm_div_ps( r, _mm_sqrt_ps( _mm_max_ps( lengthSqr, epsilon ) ) );
+		const __m128 px = _mm_add_ps( cx, _mm_mul_ps( dx, scale ) );
+		const __m128 py = _mm_add_ps( cy, _mm_mul_ps( dy, scale ) );
+		const __m128 pz = _mm_add_ps( cz, _mm_mul_ps( dz, scale ) );
+		_mm_storeu_ps( &m_posX[ i ], _mm_or_ps( _mm_and_ps( isInside, px ), _mm_andnot_ps( isInside, x ) ) );
+		_mm_storeu_ps( &m_posY[ i ], _mm_or_ps( _mm_and_ps( isInside, py ), _mm_andnot_ps( isInside, y ) ) );
+		_mm_storeu_ps( &m_posZ[ i ], _mm_or_ps( _mm_and_ps( isInside, pz ), _mm_andnot_ps( isInside, z ) ) );
 	}
-	if ( !forceInternalB.IsValid() ) {
-		printf( "oh boy\n" );
+#else
+	for ( int i = 0; i < numPadded; i++ ) {
+		if ( m_invMass[ i ] <= 0.0f ) {
+			continue;
+		}
+
+		Vec3 delta = Vec3( m_posX[ i ], m_posY[ i ], m_posZ[ i ] ) - spherePos;	// ray from center of sphere to particle
+		const float lengthSqr = delta.GetLengthSqr();
+		if ( lengthSqr < radius * radius ) {
+			delta *= radius / sqrtf( ( lengthSqr > s_epsilon ) ? lengthSqr : s_epsilon );
+			m_posX[ i ] = spherePos.x + delta.x;
+			m_posY[ i ] = spherePos.y + delta.y;
+			m_posZ[ i ] = spherePos.z + delta.z;
+		}
 	}
-}
\ No newline at end of file
+#endif
+}
@@ -2,123 +2,167 @@
 //	Cloth.h
 //
 #pragma once
+#include <vector>
 #include "Math/Vector.h"
-#include "Math/Quat.h"
-#include "Math/Matrix.h"
 #include "Math/Bounds.h"
 #include "Physics/Shapes.h"
-#include "Physics/Contact.h"
+#include "Physics/Body.h"
 
-class ClothConstraint2 {
-public:
-	ClothConstraint2() : m_cachedLambda( 1 ), m_cachedImpulses( 6 ), m_Jacobian( 1, 6 ) {
-		m_cachedLambda.Zero();
-		m_cachedImpulses.Zero();
-		m_baumgarte = 0.0f;
-
-		m_idxA = -1;
-		m_idxB = -1;
-
-		m_invMassA = 1.0f;
-		m_invMassB = 1.0f;
-	}
-
-	int m_idxA;
-	int m_idxB;
-	float m_restLength;
-
-	Vec3 m_posA;
-	Vec3 m_velA;
-	Vec3 m_posB;
-	Vec3 m_velB;
-
-	float m_invMassA;
-	float m_invMassB;
+struct Job_t;
+class Cloth;
+class PhysicsWorld;
 
-	void PreSolve( const float dt_sec );
-	void Solve();
-
-	MatMN GetInverseMassMatrix() const;
-	VecN GetVelocities() const;
-	void ApplyImpulses( const VecN & impulses );
-
-	VecN m_cachedLambda;
-	VecN m_cachedImpulses;	// We've left this in here to re-enforce how bad it is to do warm starting with direct impulses
-	MatMN m_Jacobian;
-
-	float m_baumgarte;
+struct clothStripJob_t {
+	Cloth * cloth;
+	int color;
+	int row;
 };
 
-struct ClothConstraint {
-	int m_idxA;
-	int m_idxB;
-	float m_restLength;
+struct clothRangeJob_t {
+	Cloth * cloth;
+	int first;
+	int count;
 };
 
-struct ClothParticle {
-	Vec3 m_position;
-	Vec3 m_positionOld;
-	Vec3 m_velocity;
-	Vec3 m_acceleration;	// accumulation of forces
-	float m_invMass;
+/*
+====================================================
+clothSolver_t
+
+Position based dynamics gets stiffer with more iterations and smaller time steps.  The extended version
+takes substeps of one iteration each, and its stiffness comes from the compliance alone.
+====================================================
+*/
+enum clothSolver_t {
+	CS_PBD = 0,
+	CS_XPBD,
 };
 
 /*
 ====================================================
 Cloth
+
+A grid of particles joined by distance constraints along the rows, the columns and both diagonals,
+and bending constraints that skip a particle along the rows and columns.
+The particles are stored SoA, so they're integrated and solved four at a time.
+
+The constraints are split into twelve colors, and no two constraints of the same color share a particle.
+So a color can be solved in any order, and the big cloths split its rows across the job system.
+Pinned particles have zero inverse mass, by default that's the first row.
+
+Particles are spheres of the cloth's thickness.  Self collision hashes them into a grid of
+cells twice the thickness every update, and pushes apart the ones that aren't direct neighbors.
+World collision finds the bodies near the cloth in the broadphase, then runs the particles
+through the narrowphase against the convex ones.  The cloth pushes out of the bodies,
+but never pushes the bodies back.
 ====================================================
 */
 class Cloth {
 public:
 	Cloth();
+	Cloth( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin );
 
+	// The cloth is laid out flat, with its rows along +x and its columns along +y from the origin
+	void Init( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin );
 	void Reset();
+	void Translate( const Vec3 & offset );	// moves every particle, including the pinned ones
+
+	void SetSolver( const clothSolver_t solver ) { m_solver = solver; }
+	clothSolver_t GetSolver() const { return m_solver; }
+	void SetNumIterations( const int numIters ) { m_numIters = numIters; }	// position based dynamics only
+	int GetNumIterations() const { return m_numIters; }
+	void SetNumSubsteps( const int numSubsteps );							// extended position based dynamics only
+	int GetNumSubsteps() const { return m_numSubsteps; }
+
+	// Inverse stiffness of each kind of constraint in meters per newton, for the extended solver.  The cloth
+	// weighs a kilogram, so the finer cloths need more compliance to hang the same way.  Zero is rigid.
+	void SetCompliance( const float stretch, const float shear, const float bend );
+	void SetThickness( const float thickness );	// defaults to half the shortest rest distance
+	float GetThickness() const { return m_thickness; }
+	void SetSelfCollision( const bool enable ) { m_selfCollision = enable; }
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	int GetNumParticles() const { return m_width * m_height; }
+	Vec3 GetPosition( const int idx ) const { return Vec3( m_posX[ idx ], m_posY[ idx ], m_posZ[ idx ] ); }
 	Bounds GetBounds() const { return m_bounds; }
-	void Update( float dt_sec );
 
-	void Collide( const ShapeSphere * shape, const Vec3 & spherePos );
-	
-#if 0
-	static const int m_width = 64;
-	static const int m_height = 64;
-	static const int m_numIters = 4;
-#elif 1
-	static const int m_width = 16;
-	static const int m_height = 16;
-	static const int m_numIters = 4;
-#elif 0
-	static const int m_width = 32;
-	static const int m_height = 32;
-	static const int m_numIters = 16;
-#elif 0
-	static const int m_width = 128;
-	static const int m_height = 128;
-	static const int m_numIters = 16;
-#endif
-	static const float m_restDistance;
-
-	static const float m_widthPhysical;
-	static const float m_heightPhysical;
-
-	ClothParticle m_particles[ m_width * m_height ];
-	ClothConstraint m_constraints[ m_width * m_height * 4 ];
-	ClothConstraint2 m_constraints2[ m_width * m_height * 4 * 2 ];
-	int m_numConstraints;
+	// Only big cloths use the job system, and never pass useJobs from inside a job
+	void Update( const float dt_sec, const bool useJobs = true );
 
-	Bounds m_bounds;
+	void Collide( const ShapeSphere * shape, const Vec3 & spherePos );
 
-	static const int m_numClamps = m_width;// / 4;
-	Vec3 m_clamped[ m_numClamps ];
+	// Gathering isn't thread safe since the broadphase query may rebuild the world's query tree,
+	// but colliding with the gathered bodies is, as long as the bodies don't move in the meantime.
+	void GatherColliders( PhysicsWorld * world, const unsigned int contentsMask = BC_ALL );
+	void CollideWorld( const bool useJobs = true );
 
-	// CPU coloring attempt.  While not necessary for cpu cloth, a step towards gpu cloth.
-	static const int m_numColors = 8;
-	int m_constraintColors[ m_numColors ][ m_width * m_height ];
-	ClothConstraint m_coloredConstraints[ m_numColors ][ m_width * m_height * 4 ];
-	int m_colorCounts[ m_numColors ];
+	static const int PARALLEL_MIN_PARTICLES = 64 * 64;	// smaller cloths aren't worth the job overhead
+	static const int NUM_COLORS = 12;
+	static const int RANGE_SIZE = 512;		// particles per job for the collisions
+	static const int MAX_COLLIDERS = 64;
 
 private:
-	void SolveConstraints( float dt_sec );
-	void SolveConstraintsClassic( float dt_sec );
-	void SolveConstraintsColored( float dt_sec );
-	void SolveConstraintsLagrange( float dt_sec );
+	void Integrate( const float dt_sec );
+	void SolveConstraints( const int numIters, const int numColors, const bool useJobs );
+	void SolveStrip( const int color, const int row );
+	void SolveRows( const int aBase, const int bBase, const int count, const float restLength, const float alpha );
+	void SolveInterleaved( const int aBase, const int count, const float restLength, const float alpha );
+	void SolveBendRow( const int rowStart, const int startX, const float alpha );
+	void SolvePair( const int a, const int b, const float restLength, const float alpha );
+	void UpdateBounds();
+	bool UseJobs( const bool useJobs ) const;
+
+	void BuildHashGrid();
+	void SelfCollide( const bool useJobs );
+	void SelfCollideRange( const int first, const int count );
+	void CollideWorldRange( const int first, const int count );
+	void RunRanges( void ( *function )( Job_t *, void * ), const bool useJobs );
+
+	static void SolveStripsJob( Job_t * job, void * data );
+	static void SelfCollideJob( Job_t * job, void * data );
+	static void CollideWorldJob( Job_t * job, void * data );
+
+	int m_width;
+	int m_height;
+	int m_numIters;
+	clothSolver_t m_solver;
+	int m_numSubsteps;
+
+	float m_complianceStretch;
+	float m_complianceShear;
+	float m_complianceBend;
+	float m_alphaStretch;	// compliance over the substep squared, set at the start of each update
+	float m_alphaShear;
+	float m_alphaBend;
+
+	Vec3 m_origin;
+	float m_restX;
+	float m_restY;
+	float m_restDiagonal;
+
+	// Padded to a multiple of four, the padding has zero inverse mass so it never moves
+	std::vector< float > m_posX;
+	std::vector< float > m_posY;
+	std::vector< float > m_posZ;
+	std::vector< float > m_oldX;
+	std::vector< float > m_oldY;
+	std::vector< float > m_oldZ;
+	std::vector< float > m_invMass;
+
+	std::vector< clothStripJob_t > m_strips[ NUM_COLORS ];	// the rows of each color
+	std::vector< clothRangeJob_t > m_ranges;
+
+	bool m_selfCollision;
+	float m_thickness;
+	int m_hashMask;
+	std::vector< int > m_cellStart;		// particles in hash cell h are m_cellEntries[ m_cellStart[ h ] ] up to m_cellStart[ h + 1 ]
+	std::vector< int > m_cellEntries;
+	std::vector< int > m_particleCells;	// the x, y, z cell of each particle
+	std::vector< float > m_deltaX;		// self collision corrections, so the ranges can run at the same time
+	std::vector< float > m_deltaY;
+	std::vector< float > m_deltaZ;
+
+	std::vector< const Body * > m_colliders;
+
+	Bounds m_bounds;
 };
@@ -0,0 +1,164 @@
+//
+//	ClothWorld.cpp
+//
+#include "Physics/ClothWorld.h"
+#include "JobSystem/JobSystem.h"
+#include <stdio.h>
+
+/*
+========================================================================================================
+
+ClothWorld
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ClothWorld::~ClothWorld
+====================================================
+*/
+ClothWorld::~ClothWorld() {
+	Clear();
+}
+
+/*
+====================================================
+ClothWorld::AddCloth
+====================================================
+*/
+Cloth * ClothWorld::AddCloth( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin ) {
+	Cloth * cloth = new Cloth( width, height, widthPhysical, heightPhysical, origin );
+	m_cloths.push_back( cloth );
+	return cloth;
+}
+
+/*
+====================================================
+ClothWorld::RemoveCloth
+====================================================
+*/
+void ClothWorld::RemoveCloth( Cloth * cloth ) {
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		if ( m_cloths[ i ] == cloth ) {
+			delete cloth;
+			m_cloths.erase( m_cloths.begin() + i );
+			return;
+		}
+	}
+
+	printf( "WARNING: ClothWorld::RemoveCloth: cloth is not in this world\n" );
+}
+
+/*
+====================================================
+ClothWorld::Clear
+====================================================
+*/
+void ClothWorld::Clear() {
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		delete m_cloths[ i ];
+	}
+	m_cloths.clear();
+	m_jobs.clear();
+}
+
+/*
+====================================================
+ClothWorld::UpdateClothsJob
+====================================================
+*/
+void ClothWorld::UpdateClothsJob( Job_t * job, void * data ) {
+	const clothUpdateJob_t * jobs = (const clothUpdateJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		// Already inside a job, so the cloth mustn't wait on the job system itself
+		jobs[ i ].cloth->Update( jobs[ i ].dt_sec, false );
+	}
+}
+
+/*
+====================================================
+ClothWorld::CollideClothsJob
+====================================================
+*/
+void ClothWorld::CollideClothsJob( Job_t * job, void * data ) {
+	const clothUpdateJob_t * jobs = (const clothUpdateJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		jobs[ i ].cloth->CollideWorld( false );
+	}
+}
+
+/*
+====================================================
+ClothWorld::RunSmallCloths
+
+The small cloths are independent of each other, so they all run at once
+====================================================
+*/
+void ClothWorld::RunSmallCloths( void ( *function )( Job_t *, void * ), const float dt_sec ) {
+	m_jobs.clear();
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		if ( m_cloths[ i ]->GetNumParticles() >= Cloth::PARALLEL_MIN_PARTICLES ) {
+			continue;
+		}
+
+		clothUpdateJob_t job;
+		job.cloth = m_cloths[ i ];
+		job.dt_sec = dt_sec;
+		m_jobs.push_back( job );
+	}
+
+	if ( m_jobs.empty() ) {
+		return;
+	}
+	g_jobSystem->ParallelFor( function, m_jobs.data(), sizeof( clothUpdateJob_t ), (int)m_jobs.size(), 1 );
+	g_jobSystem->Wait( NULL );
+}
+
+/*
+====================================================
+ClothWorld::Update
+====================================================
+*/
+void ClothWorld::Update( const float dt_sec, PhysicsWorld * physicsWorld ) {
+	if ( NULL == g_jobSystem ) {
+		for ( int i = 0; i < m_cloths.size(); i++ ) {
+			m_cloths[ i ]->Update( dt_sec, false );
+			if ( NULL != physicsWorld ) {
+				m_cloths[ i ]->GatherColliders( physicsWorld );
+				m_cloths[ i ]->CollideWorld( false );
+			}
+		}
+		return;
+	}
+
+	//
+	//	The big cloths parallelize internally
+	//
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		if ( m_cloths[ i ]->GetNumParticles() >= Cloth::PARALLEL_MIN_PARTICLES ) {
+			m_cloths[ i ]->Update( dt_sec, true );
+		}
+	}
+	RunSmallCloths( UpdateClothsJob, dt_sec );
+
+	if ( NULL == physicsWorld ) {
+		return;
+	}
+
+	//
+	//	The broadphase queries go first, since they can rebuild the query tree
+	//
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		m_cloths[ i ]->GatherColliders( physicsWorld );
+	}
+
+	for ( int i = 0; i < m_cloths.size(); i++ ) {
+		if ( m_cloths[ i ]->GetNumParticles() >= Cloth::PARALLEL_MIN_PARTICLES ) {
+			m_cloths[ i ]->CollideWorld( true );
+		}
+	}
+	RunSmallCloths( CollideClothsJob, dt_sec );
+}
@@ -0,0 +1,47 @@
+//
+//	ClothWorld.h
+//
+#pragma once
+#include <vector>
+#include "Physics/Cloth.h"
+
+class ClothWorld;
+
+struct clothUpdateJob_t {
+	Cloth * cloth;
+	float dt_sec;
+};
+
+/*
+====================================================
+ClothWorld
+
+Owns and updates all the cloths.  The small cloths are spread across the job system, one cloth per job,
+and the big cloths are updated one after another with their rows spread across the job system instead.
+Given a physics world, the cloths also collide with its bodies after they're updated.
+====================================================
+*/
+class ClothWorld {
+public:
+	ClothWorld() {}
+	~ClothWorld();
+
+	Cloth * AddCloth( const int width, const int height, const float widthPhysical, const float heightPhysical, const Vec3 & origin );
+	void RemoveCloth( Cloth * cloth );
+	void Clear();
+
+	int GetNumCloths() const { return (int)m_cloths.size(); }
+	Cloth * GetCloth( const int idx ) { return m_cloths[ idx ]; }
+	const Cloth * GetCloth( const int idx ) const { return m_cloths[ idx ]; }
+
+	void Update( const float dt_sec, PhysicsWorld * physicsWorld = NULL );
+
+private:
+	void RunSmallCloths( void ( *function )( Job_t *, void * ), const float dt_sec );
+
+	static void UpdateClothsJob( Job_t * job, void * data );
+	static void CollideClothsJob( Job_t * job, void * data );
+
+	std::vector< Cloth * >			m_cloths;
+	std::vector< clothUpdateJob_t >	m_jobs;		// the small cloths, rebuilt every update
+};
@@ -3,6 +3,7 @@
 //
 #include "Physics/Constraints/ConstraintBase.h"
 #include "Physics/Body.h"
+#include "Physics/Articulation.h"
 #include "Math/lcp.h"
 
  
@@ -15,6 +16,22 @@ Constraints
 ========================================================================================================
 */
 
+/*
+====================================================
+CopyArticulatedInverseMass
+
+Articulation links respond to impulses through the rest of the articulation
+====================================================
+*/
+static void CopyArticulatedInverseMass( const Body * body, MatMN & invMassMatrix, const int offset ) {
+	const float * response = body->m_articulation->GetInverseMassMatrix( body->m_articulationLink );
+	for ( int i = 0; i < 6; i++ ) {
+		for ( int j = 0; j < 6; j++ ) {
+			invMassMatrix.rows[ offset + i ][ offset + j ] = response[ i * 6 + j ];
+		}
+	}
+}
+
 /*
 ====================================================
 Constraint::GetInverseMassMatrix
@@ -46,6 +63,13 @@ MatMN Constraint::GetInverseMassMatrix() const {
 		invMassMatrix.rows[ 9 + i ][ 9 + 2 ] = invInertiaTensorB.rows[ i ][ 2 ];
 	}
 
+	if ( NULL != m_bodyA->m_articulation ) {
+		CopyArticulatedInverseMass( m_bodyA, invMassMatrix, 0 );
+	}
+	if ( NULL != m_bodyB->m_articulation ) {
+		CopyArticulatedInverseMass( m_bodyB, invMassMatrix, 6 );
+	}
+
 #if 0
 	printf( "Inverse Mass Matrix:\n" );
 	for ( int i = 0; i < invMassMatrix.M; i++ ) {
@@ -112,11 +136,20 @@ void Constraint::ApplyImpulses( const VecN & impulses ) {
 	torqueInternalB[ 1 ] = impulses[ 10];
 	torqueInternalB[ 2 ] = impulses[ 11];
 
-	m_bodyA->ApplyImpulseLinear( forceInternalA );
-	m_bodyA->ApplyImpulseAngular( torqueInternalA );
+	// Articulations propagate the whole impulse through their links at once
+	if ( NULL != m_bodyA->m_articulation ) {
+		m_bodyA->m_articulation->ApplyImpulse( m_bodyA->m_articulationLink, forceInternalA, torqueInternalA );
+	} else {
+		m_bodyA->ApplyImpulseLinear( forceInternalA );
+		m_bodyA->ApplyImpulseAngular( torqueInternalA );
+	}
 
-	m_bodyB->ApplyImpulseLinear( forceInternalB );
-	m_bodyB->ApplyImpulseAngular( torqueInternalB );
+	if ( NULL != m_bodyB->m_articulation ) {
+		m_bodyB->m_articulation->ApplyImpulse( m_bodyB->m_articulationLink, forceInternalB, torqueInternalB );
+	} else {
+		m_bodyB->ApplyImpulseLinear( forceInternalB );
+		m_bodyB->ApplyImpulseAngular( torqueInternalB );
+	}
 
 	if ( !forceInternalA.IsValid() ) {
 		printf( "oh boy\n" );
@@ -126,6 +159,17 @@ void Constraint::ApplyImpulses( const VecN & impulses ) {
 	}
 }
 
+/*
+====================================================
+Constraint::ScaleWarmStart
+====================================================
+*/
+void Constraint::ScaleWarmStart( VecN & cachedLambda ) const {
+	if ( 1.0f != m_warmStartScale ) {
+		cachedLambda *= m_warmStartScale;
+	}
+}
+
 #define DO_TRANSPOSE // Use to toggle the transpose matrices (our very simple example hinge is too symmetrical to know if we're correct)
 
 Mat4 Constraint::Left( const Quat & q ) {
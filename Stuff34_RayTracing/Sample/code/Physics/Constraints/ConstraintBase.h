@@ -17,19 +17,31 @@ Constraint
 */
 class Constraint {
 public:
+	Constraint() : m_warmStartScale( 1.0f ) {}
+	virtual ~Constraint() {}
+
 	virtual void PreSolve( const float dt_sec ) {}
 	virtual void Solve() {}
 	virtual void PostSolve() {}
 
+	virtual VecN * GetCachedLambda() { return NULL; }	// the warm start impulses, these are saved with the world's state
+
+	// PreSolve scales the cached impulses by this before warm starting with them.  They're a step's
+	// worth of impulse, or a substep's when substepping, so they only need it when that changes.
+	void SetWarmStartScale( const float scale ) { m_warmStartScale = scale; }
+
 protected:
 	MatMN GetInverseMassMatrix() const;
 	VecN GetVelocities() const;
 	void ApplyImpulses( const VecN & impulses );
+	void ScaleWarmStart( VecN & cachedLambda ) const;	// PreSolve's call before warm starting with the cached impulses
 
 protected:
 	static Mat4 Left( const Quat & q );
 	static Mat4 Right( const Quat & q );
 
+	float m_warmStartScale;
+
 public:
 	Body * m_bodyA;
 	Body * m_bodyB;
@@ -116,6 +116,7 @@ void ConstraintConstantVelocity::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
@@ -368,6 +369,7 @@ void ConstraintConstantVelocityLimited::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
@@ -19,6 +19,7 @@ public:
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
 	void PostSolve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	Quat m_q0;	// The initial relative quaternion q1 * q2^-1
 
@@ -47,6 +48,7 @@ public:
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
 	void PostSolve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	Quat m_q0;	// The initial relative quaternion q1^-1 * q2
 
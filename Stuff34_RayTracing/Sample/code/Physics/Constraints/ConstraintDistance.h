@@ -50,6 +50,7 @@ public:
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
 	void PostSolve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	VecN m_cachedLambda;
 	VecN m_cachedImpulses;	// We've left this in here to re-enforce how bad it is to do warm starting with direct impulses
@@ -561,6 +561,7 @@ void ConstraintHingeQuat::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
@@ -805,6 +806,7 @@ void ConstraintHingeQuatLimited::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
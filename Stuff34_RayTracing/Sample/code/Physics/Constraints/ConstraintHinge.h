@@ -41,6 +41,7 @@ public:
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
 	void PostSolve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	Quat q0;	// The initial relative quaternion q1^-1 * q2
 
@@ -67,6 +68,7 @@ public:
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
 	void PostSolve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	Quat m_q0;	// The initial relative quaternion q1^-1 * q2
 
@@ -134,6 +134,7 @@ void ConstraintManifold::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
@@ -22,6 +22,7 @@ public:
 
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	static const int MAX_CONTACTS = 4;
 
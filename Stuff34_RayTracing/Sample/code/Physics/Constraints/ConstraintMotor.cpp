@@ -166,6 +166,7 @@ void ConstraintMotor::PreSolve( const float dt_sec ) {
 	//
 	// Apply warm starting from last frame
 	//
+	ScaleWarmStart( m_cachedLambda );
 	const VecN impulses = m_Jacobian.Transpose() * m_cachedLambda;
 	ApplyImpulses( impulses );
 #endif
@@ -20,6 +20,7 @@ public:
 
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	float m_motorSpeed;
 	Vec3 m_motorAxis;	// Motor Axis in BodyA's local space
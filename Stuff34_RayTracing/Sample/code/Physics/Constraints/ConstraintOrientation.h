@@ -17,6 +17,7 @@ public:
 
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	Quat m_q0;			// The initial relative quaternion q1^-1 * q2
 
@@ -19,6 +19,7 @@ public:
 
 	void PreSolve( const float dt_sec ) override;
 	void Solve() override;
+	VecN * GetCachedLambda() override { return &m_cachedLambda; }
 
 	VecN m_cachedLambda;
 	Vec3 m_normal;		// in Body A's local space
@@ -107,7 +107,12 @@ void ResolveContact( contact_t & contact ) {
 		const float tA = invMassA / ( invMassA + invMassB );
 		const float tB = invMassB / ( invMassA + invMassB );
 
-		bodyA->m_position += ds * tA;
-		bodyB->m_position -= ds * tB;
+		// Static bodies are left untouched, since they can be shared by time of impact groups running in parallel
+		if ( 0.0f != invMassA ) {
+			bodyA->m_position += ds * tA;
+		}
+		if ( 0.0f != invMassB ) {
+			bodyB->m_position -= ds * tB;
+		}
 	}
 }
\ No newline at end of file
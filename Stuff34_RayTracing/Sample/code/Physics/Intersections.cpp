@@ -2,6 +2,7 @@
 //  Intersections.cpp
 //
 #include "Physics/Intersections.h"
+#include "Physics/NarrowPhase.h"
 #include "Physics/Body.h"
 #include "Physics/Contact.h"
 #include "Math/gjk.h"
@@ -44,28 +45,6 @@ bool RaySphere( const Vec3 & rayStart, const Vec3 & rayDir, const Vec3 & sphereC
 	return true;
 }
 
-/*
-====================================================
-SphereSphereStatic
-====================================================
-*/
-bool SphereSphereStatic( const ShapeSphere * sphereA, const ShapeSphere * sphereB, const Vec3 & posA, const Vec3 & posB, Vec3 & ptOnA, Vec3 & ptOnB ) {
-	const Vec3 ab = posB - posA;
-	Vec3 norm = ab;
-	norm.Normalize();
-
-	ptOnA = posA + norm * sphereA->m_radius;
-	ptOnB = posB - norm * sphereB->m_radius;
-
-	const float radiusAB = sphereA->m_radius + sphereB->m_radius;
-	const float lengthSquare = ab.GetLengthSqr();
-	if ( lengthSquare <= ( radiusAB * radiusAB ) ) {
-		return true;
-	}
-
-	return false;
-}
-
 /*
 ====================================================
 SphereSphereDynamic
@@ -119,12 +98,32 @@ bool SphereSphereDynamic( const ShapeSphere * shapeA, const ShapeSphere * shapeB
 	return true;
 }
 
+/*
+====================================================
+ApproachSpeed
+
+The fastest that any point on A can be moving towards B along the direction ab
+====================================================
+*/
+static float ApproachSpeed( const Body * bodyA, const Body * bodyB, const Vec3 & ab ) {
+	// project the relative velocity onto the ray
+	Vec3 relativeVelocity = bodyA->m_linearVelocity - bodyB->m_linearVelocity;
+	float orthoSpeed = relativeVelocity.Dot( ab );
+
+	// Add to the orthoSpeed the maximum angular speeds of the relative shapes
+	float angularSpeedA = bodyA->m_shape->FastestLinearSpeed( bodyA->m_angularVelocity, ab );
+	float angularSpeedB = bodyB->m_shape->FastestLinearSpeed( bodyB->m_angularVelocity, ab * -1.0f );
+	orthoSpeed += angularSpeedA + angularSpeedB;
+	return orthoSpeed;
+}
+
 /*
 ====================================================
 ConservativeAdvance
 ====================================================
 */
-bool ConservativeAdvance( Body * bodyA, Body * bodyB, float dt, contact_t & contact ) {
+int ConservativeAdvance( Body * bodyA, Body * bodyB, float dt, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	contact_t & contact = contacts[ 0 ];
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
@@ -134,13 +133,27 @@ bool ConservativeAdvance( Body * bodyA, Body * bodyB, float dt, contact_t & cont
 
 	// Advance the positions of the bodies until they touch or there's not time left
 	while ( dt > 0.0f ) {
-		// Check for intersection
-		bool didIntersect = Intersect( bodyA, bodyB, contact );
-		if ( didIntersect ) {
-			contact.timeOfImpact = toi;
+		// If the cached separating axis still holds, and the bodies can't close the gap
+		// along it within the remaining time, then there's no need to run GJK at all
+		Vec3 axis;
+		float separation;
+		if ( GJK_CachedAxisSeparates( bodyA, bodyB, cache, axis, separation ) ) {
+			const float orthoSpeed = ApproachSpeed( bodyA, bodyB, axis );
+			if ( orthoSpeed <= 0.0f || separation / orthoSpeed > dt ) {
+				break;
+			}
+		}
+
+		// Check for intersection.  A full manifold is only useful for resting contacts,
+		// a ballistic contact gets resolved as a single impulse.
+		const int numContacts = NarrowPhase( bodyA, bodyB, contacts, ( toi > 0.0f ) ? 1 : maxContacts, cache );
+		if ( numContacts > 0 ) {
+			for ( int i = 0; i < numContacts; i++ ) {
+				contacts[ i ].timeOfImpact = toi;
+			}
 			bodyA->Update( -toi );
 			bodyB->Update( -toi );
-			return true;
+			return numContacts;
 		}
 
 		++numIters;
@@ -153,13 +166,7 @@ bool ConservativeAdvance( Body * bodyA, Body * bodyB, float dt, contact_t & cont
 		ab.Normalize();
 
 		// project the relative velocity onto the ray of shortest distance
-		Vec3 relativeVelocity = bodyA->m_linearVelocity - bodyB->m_linearVelocity;
-		float orthoSpeed = relativeVelocity.Dot( ab );
-
-		// Add to the orthoSpeed the maximum angular speeds of the relative shapes
-		float angularSpeedA = bodyA->m_shape->FastestLinearSpeed( bodyA->m_angularVelocity, ab );
-		float angularSpeedB = bodyB->m_shape->FastestLinearSpeed( bodyB->m_angularVelocity, ab * -1.0f );
-		orthoSpeed += angularSpeedA + angularSpeedB;
+		float orthoSpeed = ApproachSpeed( bodyA, bodyB, ab );
 		if ( orthoSpeed <= 0.0f ) {
 			break;
 		}
@@ -178,78 +185,89 @@ bool ConservativeAdvance( Body * bodyA, Body * bodyB, float dt, contact_t & cont
 	// unwind the clock
 	bodyA->Update( -toi );
 	bodyB->Update( -toi );
-	return false;
+	return 0;
 }
 
+// Per thread scratch used as a stack like the narrowphase's, so advancing against triangles doesn't allocate
+static thread_local std::vector< Vec3 > s_triangles;
+
 /*
 ====================================================
-Intersect
+ConservativeAdvanceTriangles
+
+Advances the body against each mesh or heightfield triangle in its swept bounds.  Resting contacts
+from every triangle get reduced to one manifold, otherwise the earliest impact wins.
 ====================================================
 */
-bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact ) {
-	contact.bodyA = bodyA;
-	contact.bodyB = bodyB;
-	contact.timeOfImpact = 0.0f;
-
-	if ( bodyA->m_shape->GetType() == Shape::SHAPE_SPHERE && bodyB->m_shape->GetType() == Shape::SHAPE_SPHERE ) {
-		const ShapeSphere * sphereA = (const ShapeSphere *)bodyA->m_shape;
-		const ShapeSphere * sphereB = (const ShapeSphere *)bodyB->m_shape;
-
-		Vec3 posA = bodyA->m_position;
-		Vec3 posB = bodyB->m_position;
-
-		if ( SphereSphereStatic( sphereA, sphereB, posA, posB, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace ) ) {
-			contact.normal = posA - posB;
-			contact.normal.Normalize();
-
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( contact.ptOnA_WorldSpace );
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
-
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			float r = ab.GetMagnitude() - ( sphereA->m_radius + sphereB->m_radius );
-			contact.separationDistance = r;
-			return true;
-		}
-	} else {
-		Vec3 ptOnA;
-		Vec3 ptOnB;
-		const float bias = 0.001f;
-		if ( GJK_DoesIntersect( bodyA, bodyB, bias, ptOnA, ptOnB ) ) {
-			// There was an intersection, so get the contact data
-			Vec3 normal = ptOnB - ptOnA;
-			normal.Normalize();
-
-			ptOnA -= normal * bias;
-			ptOnB += normal * bias;
-
-			contact.normal = normal;
-
-			contact.ptOnA_WorldSpace = ptOnA;
-			contact.ptOnB_WorldSpace = ptOnB;
-
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( contact.ptOnA_WorldSpace );
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
-
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			float r = ( ptOnA - ptOnB ).GetMagnitude();
-			contact.separationDistance = -r;
-			return true;
+static int ConservativeAdvanceTriangles( Body * body, Body * staticBody, const float dt, contact_t * contacts, const int maxContacts ) {
+	Bounds sweptBounds = body->GetBounds( dt );
+	sweptBounds.Expand( sweptBounds.mins - Vec3( SUBSHAPE_QUERY_MARGIN ) );
+	sweptBounds.Expand( sweptBounds.maxs + Vec3( SUBSHAPE_QUERY_MARGIN ) );
+
+	std::vector< Vec3 > & triangles = s_triangles;
+	const int firstVert = (int)triangles.size();
+	GatherTriangles( staticBody, sweptBounds, triangles );
+	const int lastVert = (int)triangles.size();
+
+	Body triBody = *staticBody;
+
+	contact_t resting[ MAX_CANDIDATE_CONTACTS ];
+	int numResting = 0;
+	contact_t earliest;
+	bool hasImpact = false;
+
+	for ( int i = firstVert; i + 2 < lastVert; i += 3 ) {
+		ShapeTriangle triangle( triangles[ i + 0 ], triangles[ i + 1 ], triangles[ i + 2 ], staticBody->m_shape->GetCenterOfMass() );
+		triBody.m_shape = &triangle;
+
+		// Advancing and unwinding a rotating body doesn't land exactly where it started,
+		// so each triangle gets a fresh copy rather than letting the error pile up
+		Body moving = *body;
+
+		contact_t triContacts[ MAX_PAIR_CONTACTS ];
+		const int numContacts = ConservativeAdvance( &moving, &triBody, dt, triContacts, MAX_PAIR_CONTACTS, NULL );
+		for ( int j = 0; j < numContacts; j++ ) {
+			contact_t & contact = triContacts[ j ];
+			contact.bodyA = body;
+			contact.bodyB = staticBody;
+
+			if ( 0.0f == contact.timeOfImpact ) {
+				AddCandidateContact( resting, numResting, contact );
+			} else if ( !hasImpact || contact.timeOfImpact < earliest.timeOfImpact ) {
+				earliest = contact;
+				hasImpact = true;
+			}
 		}
+	}
 
-		// There was no collision, but we still want the contact data, so get it
-		GJK_ClosestPoints( bodyA, bodyB, ptOnA, ptOnB );
-		contact.ptOnA_WorldSpace = ptOnA;
-		contact.ptOnB_WorldSpace = ptOnB;
-
-		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( contact.ptOnA_WorldSpace );
-		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
+	triangles.resize( firstVert );
 
-		Vec3 ab = bodyB->m_position - bodyA->m_position;
-		float r = ( ptOnA - ptOnB ).GetMagnitude();
-		contact.separationDistance = r;
+	if ( numResting > 0 ) {
+		return ReduceContactSet( resting, numResting, contacts, maxContacts );
 	}
+	if ( hasImpact ) {
+		contacts[ 0 ] = earliest;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+====================================================
+Intersect
+====================================================
+*/
+int Intersect( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	return NarrowPhase( bodyA, bodyB, contacts, maxContacts, cache );
+}
 
-	return false;
+/*
+====================================================
+Intersect
+====================================================
+*/
+bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact, gjkCache_t * cache ) {
+	return ( NarrowPhase( bodyA, bodyB, &contact, 1, cache ) > 0 );
 }
 
 /*
@@ -257,7 +275,8 @@ bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact ) {
 Intersect
 ====================================================
 */
-bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact ) {
+int Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	contact_t & contact = contacts[ 0 ];
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
@@ -291,13 +310,29 @@ bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact
 			Vec3 ab = bodyB->m_position - bodyA->m_position;
 			float r = ab.GetMagnitude() - ( sphereA->m_radius + sphereB->m_radius );
 			contact.separationDistance = r;
-			return true;
+			return 1;
+		}
+	} else if ( IsTriangleShape( bodyB->m_shape ) ) {
+		return ConservativeAdvanceTriangles( bodyA, bodyB, dt, contacts, maxContacts );
+	} else if ( IsTriangleShape( bodyA->m_shape ) ) {
+		const int numContacts = ConservativeAdvanceTriangles( bodyB, bodyA, dt, contacts, maxContacts );
+		for ( int i = 0; i < numContacts; i++ ) {
+			FlipContact( contacts[ i ] );
 		}
+		return numContacts;
 	} else {
-		// Use GJK to perform conservative advancement
-		bool result = ConservativeAdvance( bodyA, bodyB, dt, contact );
-		return result;
+		// Use the narrowphase kernels to perform conservative advancement
+		return ConservativeAdvance( bodyA, bodyB, dt, contacts, maxContacts, cache );
 	}
 
-	return false;
+	return 0;
+}
+
+/*
+====================================================
+Intersect
+====================================================
+*/
+bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, gjkCache_t * cache ) {
+	return ( Intersect( bodyA, bodyB, dt, &contact, 1, cache ) > 0 );
 }
\ No newline at end of file
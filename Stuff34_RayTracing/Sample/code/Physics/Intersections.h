@@ -2,11 +2,17 @@
 //	Intersections.h
 //
 #pragma once
+#include <stddef.h>
 
 class Body;
 class Vec3;
 class ShapeSphere;
 struct contact_t;
+struct gjkCache_t;
 
-bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact );
-bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact );
+bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact, gjkCache_t * cache = NULL );
+bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, gjkCache_t * cache = NULL );
+
+// These write up to maxContacts contacts for the pair and return how many were written
+int Intersect( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache = NULL );
+int Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t * contacts, const int maxContacts, gjkCache_t * cache = NULL );
@@ -5,6 +5,7 @@
 #include "Physics/Contact.h"
 #include "Physics/Constraints.h"
 #include "Physics/Manifold.h"
+#include "Physics/PhysicsStats.h"
 
  
 
@@ -107,6 +108,19 @@ void Manifold::AddContact( const contact_t & contact_old ) {
 	}
 }
 
+/*
+====================================================
+Manifold::GetNumConstraintRows
+====================================================
+*/
+int Manifold::GetNumConstraintRows() const {
+	int numRows = 0;
+	for ( int i = 0; i < m_numContacts; i++ ) {
+		numRows += m_constraints[ i ].m_cachedLambda.N;
+	}
+	return numRows;
+}
+
 /*
 ====================================================
 Manifold::RemoveExpiredContacts
@@ -157,8 +171,9 @@ void Manifold::RemoveExpiredContacts() {
 Manifold::PreSolve
 ====================================================
 */
-void Manifold::PreSolve( const float dt_sec ) {
+void Manifold::PreSolve( const float dt_sec, const float warmStartScale ) {
 	for ( int i = 0; i < m_numContacts; i++ ) {
+		m_constraints[ i ].SetWarmStartScale( warmStartScale );
 		m_constraints[ i ].PreSolve( dt_sec );
 	}
 }
@@ -195,33 +210,225 @@ ManifoldCollector
 
 /*
 ====================================================
-ManifoldCollector::AddContact
+ManifoldCollector::HashPair
 ====================================================
 */
-void ManifoldCollector::AddContact( const contact_t & contact ) {
-	// Try to find the previously existing manifold for contacts between these two bodies
-	int foundIdx = -1;
-	for ( int i = 0; i < m_manifolds.size(); i++ ) {
-		const Manifold & manifold = m_manifolds[ i ];
-		bool hasA = ( manifold.m_bodyA == contact.bodyA || manifold.m_bodyB == contact.bodyA );
-		bool hasB = ( manifold.m_bodyA == contact.bodyB || manifold.m_bodyB == contact.bodyB );
-		if ( hasA && hasB ) {
-			foundIdx = i;
+unsigned int ManifoldCollector::HashPair( const Body * bodyA, const Body * bodyB ) {
+	unsigned long long a = (unsigned long long)bodyA;
+	unsigned long long b = (unsigned long long)bodyB;
+
+	// Mix the two addresses so that neighboring bodies in the pool don't cluster
+	unsigned long long h = a * 0x9E3779B97F4A7C15ULL;
+	h ^= b + 0x632BE59BD9B4E019ULL + ( h << 6 ) + ( h >> 2 );
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	return (unsigned int)h;
+}
+
+/*
+====================================================
+OrderPair
+====================================================
+*/
+static void OrderPair( const Body *& bodyA, const Body *& bodyB ) {
+	if ( bodyB < bodyA ) {
+		const Body * tmp = bodyA;
+		bodyA = bodyB;
+		bodyB = tmp;
+	}
+}
+
+/*
+====================================================
+ManifoldCollector::FindEntry
+====================================================
+*/
+int ManifoldCollector::FindEntry( const Body * bodyA, const Body * bodyB ) const {
+	if ( m_table.empty() ) {
+		return -1;
+	}
+
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int idx = HashPair( bodyA, bodyB ) & mask;
+	while ( -1 != m_table[ idx ].slot ) {
+		if ( m_table[ idx ].bodyA == bodyA && m_table[ idx ].bodyB == bodyB ) {
+			return (int)idx;
+		}
+		idx = ( idx + 1 ) & mask;
+	}
+	return -1;
+}
+
+/*
+====================================================
+ManifoldCollector::FindManifold
+====================================================
+*/
+int ManifoldCollector::FindManifold( const Body * bodyA, const Body * bodyB ) const {
+	OrderPair( bodyA, bodyB );
+
+	const int entry = FindEntry( bodyA, bodyB );
+	if ( entry < 0 ) {
+		return -1;
+	}
+	return m_table[ entry ].slot;
+}
+
+/*
+====================================================
+ManifoldCollector::GrowTable
+====================================================
+*/
+void ManifoldCollector::GrowTable() {
+	const int newSize = m_table.empty() ? 64 : (int)m_table.size() * 2;
+
+	hashEntry_t empty;
+	empty.bodyA = NULL;
+	empty.bodyB = NULL;
+	empty.slot = -1;
+
+	m_table.clear();
+	m_table.resize( newSize, empty );
+	GetPhysicsCounters().numBytesAllocated += newSize * (int)sizeof( hashEntry_t );
+	m_numTableEntries = 0;
+
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		const Manifold & manifold = m_manifolds[ m_activeSlots[ i ] ];
+		const Body * bodyA = manifold.m_bodyA;
+		const Body * bodyB = manifold.m_bodyB;
+		OrderPair( bodyA, bodyB );
+		InsertEntry( bodyA, bodyB, m_activeSlots[ i ] );
+	}
+}
+
+/*
+====================================================
+ManifoldCollector::InsertEntry
+====================================================
+*/
+void ManifoldCollector::InsertEntry( const Body * bodyA, const Body * bodyB, const int slot ) {
+	// Keep the load factor under one half, so probe sequences stay short
+	if ( 2 * ( m_numTableEntries + 1 ) > (int)m_table.size() ) {
+		GrowTable();
+	}
+
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	unsigned int idx = HashPair( bodyA, bodyB ) & mask;
+	while ( -1 != m_table[ idx ].slot ) {
+		idx = ( idx + 1 ) & mask;
+	}
+
+	m_table[ idx ].bodyA = bodyA;
+	m_table[ idx ].bodyB = bodyB;
+	m_table[ idx ].slot = slot;
+	m_numTableEntries++;
+}
+
+/*
+====================================================
+ManifoldCollector::RemoveEntry
+
+Uses backward shift deletion, so the table never fills up with tombstones
+====================================================
+*/
+void ManifoldCollector::RemoveEntry( const Body * bodyA, const Body * bodyB ) {
+	int hole = FindEntry( bodyA, bodyB );
+	if ( hole < 0 ) {
+		return;
+	}
+
+	const unsigned int mask = (unsigned int)m_table.size() - 1;
+	m_table[ hole ].slot = -1;
+	m_numTableEntries--;
+
+	unsigned int idx = (unsigned int)hole;
+	while ( true ) {
+		idx = ( idx + 1 ) & mask;
+		if ( -1 == m_table[ idx ].slot ) {
 			break;
 		}
+
+		// Only move the entry back if the hole is between its home position and where it currently is
+		const unsigned int home = HashPair( m_table[ idx ].bodyA, m_table[ idx ].bodyB ) & mask;
+		const unsigned int distFromHome = ( idx - home ) & mask;
+		const unsigned int distFromHole = ( idx - (unsigned int)hole ) & mask;
+		if ( distFromHome >= distFromHole ) {
+			m_table[ hole ] = m_table[ idx ];
+			m_table[ idx ].slot = -1;
+			hole = (int)idx;
+		}
 	}
+}
 
-	// Add contact to manifolds
-	if ( foundIdx >= 0 ) {
-		m_manifolds[ foundIdx ].AddContact( contact );
-	} else {
-		Manifold manifold;
-		manifold.m_bodyA = contact.bodyA;
-		manifold.m_bodyB = contact.bodyB;
+/*
+====================================================
+ManifoldCollector::AllocateSlot
+====================================================
+*/
+int ManifoldCollector::AllocateSlot() {
+	if ( !m_freeSlots.empty() ) {
+		const int slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		return slot;
+	}
 
-		manifold.AddContact( contact );
-		m_manifolds.push_back( manifold );
+	const size_t capacity = m_manifolds.capacity();
+	m_manifolds.push_back( Manifold() );
+	if ( m_manifolds.capacity() != capacity ) {
+		GetPhysicsCounters().numBytesAllocated += (int)( m_manifolds.capacity() * sizeof( Manifold ) );
+	}
+	return (int)m_manifolds.size() - 1;
+}
+
+/*
+====================================================
+ManifoldCollector::FindOrAllocateSlot
+====================================================
+*/
+int ManifoldCollector::FindOrAllocateSlot( Body * bodyA, Body * bodyB ) {
+	// Try to find the previously existing manifold for contacts between these two bodies
+	int slot = FindManifold( bodyA, bodyB );
+	if ( slot >= 0 ) {
+		return slot;
 	}
+
+	slot = AllocateSlot();
+
+	Manifold & manifold = m_manifolds[ slot ];
+	manifold.m_bodyA = bodyA;
+	manifold.m_bodyB = bodyB;
+	manifold.m_numContacts = 0;
+	manifold.m_gjkCache.Clear();
+	manifold.m_lastQueryFrame = m_frame;
+
+	const Body * orderedA = bodyA;
+	const Body * orderedB = bodyB;
+	OrderPair( orderedA, orderedB );
+	InsertEntry( orderedA, orderedB, slot );
+	m_activeSlots.push_back( slot );
+	return slot;
+}
+
+/*
+====================================================
+ManifoldCollector::AddContact
+====================================================
+*/
+void ManifoldCollector::AddContact( const contact_t & contact ) {
+	const int slot = FindOrAllocateSlot( contact.bodyA, contact.bodyB );
+	m_manifolds[ slot ].AddContact( contact );
+}
+
+/*
+====================================================
+ManifoldCollector::GetCacheSlot
+====================================================
+*/
+int ManifoldCollector::GetCacheSlot( Body * bodyA, Body * bodyB ) {
+	const int slot = FindOrAllocateSlot( bodyA, bodyB );
+	m_manifolds[ slot ].m_lastQueryFrame = m_frame;
+	return slot;
 }
 
 /*
@@ -230,23 +437,50 @@ ManifoldCollector::RemoveExpired
 ====================================================
 */
 void ManifoldCollector::RemoveExpired() {
-	// Remove expired manifolds
-	for ( int i = (int)m_manifolds.size() - 1; i >= 0; i-- ) {
-		Manifold & manifold = m_manifolds[ i ];
+	// Compact the active list in a single pass, returning expired slots to the free list
+	int numActive = 0;
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		const int slot = m_activeSlots[ i ];
+		Manifold & manifold = m_manifolds[ slot ];
 
 		// If either of the bodies have been removed, then remove this manifold
-		if ( !manifold.m_bodyA->IsUsed() || !manifold.m_bodyB->IsUsed() ) {
-			m_manifolds.erase( m_manifolds.begin() + i );
-			continue;
+		bool isExpired = ( !manifold.m_bodyA->IsUsed() || !manifold.m_bodyB->IsUsed() );
+		if ( !isExpired ) {
+			manifold.RemoveExpiredContacts();
+
+			// Remove manifolds that have no contacts, unless the pair was queried last step and the cache is still useful
+			isExpired = ( 0 == manifold.m_numContacts && manifold.m_lastQueryFrame != m_frame );
 		}
 
-		manifold.RemoveExpiredContacts();
+		if ( isExpired ) {
+			const Body * bodyA = manifold.m_bodyA;
+			const Body * bodyB = manifold.m_bodyB;
+			OrderPair( bodyA, bodyB );
+			RemoveEntry( bodyA, bodyB );
 
-		// Remove manifolds that have no contacts
-		if ( 0 == manifold.m_numContacts ) {
-			m_manifolds.erase( m_manifolds.begin() + i );
+			manifold.m_numContacts = 0;
+			m_freeSlots.push_back( slot );
+			continue;
 		}
+
+		m_activeSlots[ numActive ] = slot;
+		numActive++;
 	}
+	m_activeSlots.resize( numActive );
+	m_frame++;
+}
+
+/*
+====================================================
+ManifoldCollector::Clear
+====================================================
+*/
+void ManifoldCollector::Clear() {
+	m_manifolds.clear();
+	m_activeSlots.clear();
+	m_freeSlots.clear();
+	m_table.clear();
+	m_numTableEntries = 0;
 }
 
 /*
@@ -255,8 +489,8 @@ ManifoldCollector::PreSolve
 ====================================================
 */
 void ManifoldCollector::PreSolve( const float dt_sec ) {
-	for ( int i = 0; i < m_manifolds.size(); i++ ) {
-		m_manifolds[ i ].PreSolve( dt_sec );
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		m_manifolds[ m_activeSlots[ i ] ].PreSolve( dt_sec, 1.0f );
 	}
 }
 
@@ -266,8 +500,8 @@ ManifoldCollector::Solve
 ====================================================
 */
 void ManifoldCollector::Solve() {
-	for ( int i = 0; i < m_manifolds.size(); i++ ) {
-		m_manifolds[ i ].Solve();
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		m_manifolds[ m_activeSlots[ i ] ].Solve();
 	}
 }
 
@@ -277,7 +511,7 @@ Manifold::PostSolve
 ====================================================
 */
 void ManifoldCollector::PostSolve() {
-	for ( int i = 0; i < m_manifolds.size(); i++ ) {
-		m_manifolds[ i ].PostSolve();
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		m_manifolds[ m_activeSlots[ i ] ].PostSolve();
 	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 //	Manifold.h
 //
 #pragma once
+#include "Math/gjk.h"
 
 class Body;
 struct contact_t;
@@ -13,17 +14,20 @@ Manifold
 */
 class Manifold {
 public:
-	Manifold() : m_bodyA( NULL ), m_bodyB( NULL ), m_numContacts( 0 ) {}
+	Manifold() : m_numContacts( 0 ), m_bodyA( NULL ), m_bodyB( NULL ), m_lastQueryFrame( 0 ) {}
 
 	void AddContact( const contact_t & contact );
 	void RemoveExpiredContacts();
 
-	void PreSolve( const float dt_sec );
+	void PreSolve( const float dt_sec, const float warmStartScale );
 	void Solve();
 	void PostSolve();
 
 	contact_t GetContact( const int idx ) const { return m_contacts[ idx ]; }
 	int GetNumContacts() const { return m_numContacts; }
+	int GetNumConstraintRows() const;
+	const Body * GetBodyA() const { return m_bodyA; }
+	const Body * GetBodyB() const { return m_bodyB; }
 
 private:
 	static const int MAX_CONTACTS = 4;
@@ -36,27 +40,72 @@ private:
 
 	ConstraintPenetration m_constraints[ MAX_CONTACTS ];
 
+	// GJK warm starting, this lives as long as the broadphase keeps reporting the pair
+	gjkCache_t m_gjkCache;
+	int m_lastQueryFrame;
+
 	friend class ManifoldCollector;
 };
 
 /*
 ====================================================
 ManifoldCollector
+
+Manifolds live in stable slots that are recycled through a free list.
+An open addressing hash table maps a body pair to its slot, and a dense list
+of the active slots is what the solver iterates over.
 ====================================================
 */
 class ManifoldCollector {
 public:
-	ManifoldCollector() {}
+	ManifoldCollector() : m_numTableEntries( 0 ), m_frame( 0 ) {}
 
 	void AddContact( const contact_t & contact );
+	// The manifolds move when a new slot makes the storage grow, so a pair's cache is looked up by its
+	// slot each time it's needed, and the pointer is only good until the next slot is created
+	int GetCacheSlot( Body * bodyA, Body * bodyB );	// creates the pair's slot if it doesn't exist yet
+	gjkCache_t * GetCache( const int slot ) { return &m_manifolds[ slot ].m_gjkCache; }
 
 	void PreSolve( const float dt_sec );
 	void Solve();
 	void PostSolve();
 
 	void RemoveExpired();
-	void Clear() { m_manifolds.clear(); }	// For resetting the demo
+	void Clear();	// For resetting the demo
 
-public:
-	std::vector< Manifold > m_manifolds;
+	// Snapshots for PhysicsWorld::SaveState, bodies are stored as indices into the pool
+	int GetStateSize() const;
+	void SaveState( unsigned char *& data, const Body * bodyPool ) const;
+	bool RestoreState( const unsigned char *& data, const unsigned char * end, Body * bodyPool, const bool * isUsedBody, const int maxBodies );
+	static bool IsStateValid( const unsigned char *& data, const unsigned char * end, const bool * isUsedBody, const int maxBodies );	// walks a snapshot without restoring it
+
+	int GetNumManifolds() const { return (int)m_activeSlots.size(); }
+	Manifold & GetManifold( const int idx ) { return m_manifolds[ m_activeSlots[ idx ] ]; }
+	const Manifold & GetManifold( const int idx ) const { return m_manifolds[ m_activeSlots[ idx ] ]; }
+
+	int FindManifold( const Body * bodyA, const Body * bodyB ) const;	// returns the slot or -1
+
+private:
+	struct hashEntry_t {
+		const Body * bodyA;	// the body pair is stored in address order
+		const Body * bodyB;
+		int slot;			// -1 for an empty entry
+	};
+
+	static unsigned int HashPair( const Body * bodyA, const Body * bodyB );
+	int FindEntry( const Body * bodyA, const Body * bodyB ) const;
+	void InsertEntry( const Body * bodyA, const Body * bodyB, const int slot );
+	void RemoveEntry( const Body * bodyA, const Body * bodyB );
+	void GrowTable();
+
+	int AllocateSlot();
+	int FindOrAllocateSlot( Body * bodyA, Body * bodyB );
+
+private:
+	std::vector< Manifold >		m_manifolds;	// slot storage, indices are stable
+	std::vector< int >			m_activeSlots;
+	std::vector< int >			m_freeSlots;
+	std::vector< hashEntry_t >	m_table;		// size is always zero or a power of two
+	int							m_numTableEntries;
+	int							m_frame;		// incremented every RemoveExpired
 };
\ No newline at end of file
@@ -0,0 +1,1113 @@
+//
+//  NarrowPhase.cpp
+//
+#include "Physics/NarrowPhase.h"
+#include "Physics/Body.h"
+#include "Physics/Contact.h"
+#include "Physics/PhysicsStats.h"
+#include "Math/gjk.h"
+#include <stdio.h>
+
+/*
+========================================================================================================
+
+NarrowPhase
+
+Closed form kernels for the primitive shape pairs, with GJK/EPA as the fallback for everything else.
+
+========================================================================================================
+*/
+
+#define NUM_SHAPE_TYPES ( Shape::SHAPE_COMPOUND + 1 )
+
+// Shapes closer than this count as touching.  This matches the GJK path, where both shapes are inflated by the bias.
+static const float s_gjkBias = 0.001f;
+static const float s_contactSkin = 2.0f * s_gjkBias;
+
+/*
+====================================================
+FillContact
+====================================================
+*/
+static void FillContact( Body * bodyA, Body * bodyB, const Vec3 & ptOnA, const Vec3 & ptOnB, const Vec3 & normal, const float separation, contact_t & contact ) {
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.timeOfImpact = 0.0f;
+
+	contact.ptOnA_WorldSpace = ptOnA;
+	contact.ptOnB_WorldSpace = ptOnB;
+	contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( ptOnA );
+	contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( ptOnB );
+
+	contact.normal = normal;
+	contact.separationDistance = separation;
+}
+
+/*
+====================================================
+FlipContact
+====================================================
+*/
+void FlipContact( contact_t & contact ) {
+	std::swap( contact.bodyA, contact.bodyB );
+	std::swap( contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace );
+	std::swap( contact.ptOnA_LocalSpace, contact.ptOnB_LocalSpace );
+	contact.normal *= -1.0f;
+}
+
+/*
+====================================================
+SpheresContact
+
+Contact between two spheres, the building block for the sphere and capsule kernels
+====================================================
+*/
+static bool SpheresContact( Body * bodyA, Body * bodyB, const Vec3 & centerA, const float radiusA, const Vec3 & centerB, const float radiusB, contact_t & contact ) {
+	Vec3 normal = centerA - centerB;
+	const float dist = normal.GetMagnitude();
+	if ( dist > 1e-6f ) {
+		normal /= dist;
+	} else {
+		normal = Vec3( 0.0f, 0.0f, 1.0f );
+	}
+
+	const Vec3 ptOnA = centerA - normal * radiusA;
+	const Vec3 ptOnB = centerB + normal * radiusB;
+	const float separation = dist - ( radiusA + radiusB );
+	FillContact( bodyA, bodyB, ptOnA, ptOnB, normal, separation, contact );
+	return ( separation <= s_contactSkin );
+}
+
+/*
+====================================================
+ClosestPointOnSegment
+====================================================
+*/
+static Vec3 ClosestPointOnSegment( const Vec3 & a, const Vec3 & b, const Vec3 & pt ) {
+	const Vec3 ab = b - a;
+	const float lengthSqr = ab.GetLengthSqr();
+	if ( lengthSqr < 1e-12f ) {
+		return a;
+	}
+
+	float t = ( pt - a ).Dot( ab ) / lengthSqr;
+	t = std::max( 0.0f, std::min( 1.0f, t ) );
+	return a + ab * t;
+}
+
+/*
+====================================================
+ClosestPointsSegmentSegment
+
+From Real-time collision detection
+====================================================
+*/
+static void ClosestPointsSegmentSegment( const Vec3 & p1, const Vec3 & q1, const Vec3 & p2, const Vec3 & q2, Vec3 & c1, Vec3 & c2 ) {
+	const Vec3 d1 = q1 - p1;
+	const Vec3 d2 = q2 - p2;
+	const Vec3 r = p1 - p2;
+	const float a = d1.Dot( d1 );
+	const float e = d2.Dot( d2 );
+	const float f = d2.Dot( r );
+
+	float s = 0.0f;
+	float t = 0.0f;
+	if ( a < 1e-12f && e < 1e-12f ) {
+		c1 = p1;
+		c2 = p2;
+		return;
+	}
+
+	if ( a < 1e-12f ) {
+		t = std::max( 0.0f, std::min( 1.0f, f / e ) );
+	} else {
+		const float c = d1.Dot( r );
+		if ( e < 1e-12f ) {
+			s = std::max( 0.0f, std::min( 1.0f, -c / a ) );
+		} else {
+			const float b = d1.Dot( d2 );
+			const float denom = a * e - b * b;
+
+			// Parallel segments can pick any s, so just start at p1
+			if ( denom > 1e-12f ) {
+				s = std::max( 0.0f, std::min( 1.0f, ( b * f - c * e ) / denom ) );
+			}
+
+			t = ( b * s + f ) / e;
+			if ( t < 0.0f ) {
+				t = 0.0f;
+				s = std::max( 0.0f, std::min( 1.0f, -c / a ) );
+			} else if ( t > 1.0f ) {
+				t = 1.0f;
+				s = std::max( 0.0f, std::min( 1.0f, ( b - c ) / a ) );
+			}
+		}
+	}
+
+	c1 = p1 + d1 * s;
+	c2 = p2 + d2 * t;
+}
+
+/*
+====================================================
+CapsuleSegment
+====================================================
+*/
+static void CapsuleSegment( const Body * body, Vec3 & a, Vec3 & b ) {
+	const ShapeCapsule * capsule = (const ShapeCapsule *)body->m_shape;
+	const Vec3 halfAxis = body->m_orientation.RotatePoint( Vec3( 0.0f, 0.0f, capsule->m_height * 0.5f ) );
+	a = body->m_position - halfAxis;
+	b = body->m_position + halfAxis;
+}
+
+/*
+====================================================
+IntersectSphereSphere
+====================================================
+*/
+int IntersectSphereSphere( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const ShapeSphere * sphereA = (const ShapeSphere *)bodyA->m_shape;
+	const ShapeSphere * sphereB = (const ShapeSphere *)bodyB->m_shape;
+
+	if ( SpheresContact( bodyA, bodyB, bodyA->m_position, sphereA->m_radius, bodyB->m_position, sphereB->m_radius, contacts[ 0 ] ) ) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+====================================================
+IntersectSphereBox
+====================================================
+*/
+int IntersectSphereBox( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const ShapeSphere * sphere = (const ShapeSphere *)bodyA->m_shape;
+	const ShapeBox * box = (const ShapeBox *)bodyB->m_shape;
+	const Bounds & bounds = box->m_bounds;
+
+	// Work in the box's space
+	const Vec3 center = bodyA->m_position;
+	const Vec3 local = bodyB->m_orientation.Inverse().RotatePoint( center - bodyB->m_position );
+
+	Vec3 closest = local;
+	bool isInside = true;
+	for ( int i = 0; i < 3; i++ ) {
+		if ( closest[ i ] < bounds.mins[ i ] ) {
+			closest[ i ] = bounds.mins[ i ];
+			isInside = false;
+		} else if ( closest[ i ] > bounds.maxs[ i ] ) {
+			closest[ i ] = bounds.maxs[ i ];
+			isInside = false;
+		}
+	}
+
+	Vec3 normal;
+	float dist;
+	if ( isInside ) {
+		// The center is inside the box, push it out through the nearest face
+		int axis = 0;
+		float side = 1.0f;
+		dist = 1e10f;
+		for ( int i = 0; i < 3; i++ ) {
+			const float toMin = local[ i ] - bounds.mins[ i ];
+			const float toMax = bounds.maxs[ i ] - local[ i ];
+			if ( toMin < dist ) {
+				dist = toMin;
+				axis = i;
+				side = -1.0f;
+			}
+			if ( toMax < dist ) {
+				dist = toMax;
+				axis = i;
+				side = 1.0f;
+			}
+		}
+
+		closest[ axis ] = ( side > 0.0f ) ? bounds.maxs[ axis ] : bounds.mins[ axis ];
+		Vec3 localNormal( 0.0f );
+		localNormal[ axis ] = side;
+		normal = bodyB->m_orientation.RotatePoint( localNormal );
+		dist = -dist;
+	} else {
+		normal = local - closest;
+		dist = normal.GetMagnitude();
+		normal /= dist;
+		normal = bodyB->m_orientation.RotatePoint( normal );
+	}
+
+	const Vec3 ptOnB = bodyB->m_position + bodyB->m_orientation.RotatePoint( closest );
+	const Vec3 ptOnA = center - normal * sphere->m_radius;
+	const float separation = dist - sphere->m_radius;
+	FillContact( bodyA, bodyB, ptOnA, ptOnB, normal, separation, contacts[ 0 ] );
+	return ( separation <= s_contactSkin ) ? 1 : 0;
+}
+
+/*
+====================================================
+IntersectSphereCapsule
+====================================================
+*/
+int IntersectSphereCapsule( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const ShapeSphere * sphere = (const ShapeSphere *)bodyA->m_shape;
+	const ShapeCapsule * capsule = (const ShapeCapsule *)bodyB->m_shape;
+
+	Vec3 a;
+	Vec3 b;
+	CapsuleSegment( bodyB, a, b );
+	const Vec3 ptOnSegment = ClosestPointOnSegment( a, b, bodyA->m_position );
+
+	if ( SpheresContact( bodyA, bodyB, bodyA->m_position, sphere->m_radius, ptOnSegment, capsule->m_radius, contacts[ 0 ] ) ) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+====================================================
+IntersectCapsuleCapsule
+====================================================
+*/
+int IntersectCapsuleCapsule( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const ShapeCapsule * capsuleA = (const ShapeCapsule *)bodyA->m_shape;
+	const ShapeCapsule * capsuleB = (const ShapeCapsule *)bodyB->m_shape;
+
+	Vec3 a1;
+	Vec3 b1;
+	Vec3 a2;
+	Vec3 b2;
+	CapsuleSegment( bodyA, a1, b1 );
+	CapsuleSegment( bodyB, a2, b2 );
+
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	ClosestPointsSegmentSegment( a1, b1, a2, b2, ptOnA, ptOnB );
+	if ( !SpheresContact( bodyA, bodyB, ptOnA, capsuleA->m_radius, ptOnB, capsuleB->m_radius, contacts[ 0 ] ) ) {
+		return 0;
+	}
+
+	// Capsules lying side by side touch along a line, so support them at both ends of the overlap
+	const Vec3 d1 = b1 - a1;
+	const Vec3 d2 = b2 - a2;
+	const float lengthSqr1 = d1.GetLengthSqr();
+	const float lengthSqr2 = d2.GetLengthSqr();
+	if ( maxContacts < 2 || lengthSqr1 < 1e-6f || lengthSqr2 < 1e-6f ) {
+		return 1;
+	}
+	const Vec3 cross = d1.Cross( d2 );
+	if ( cross.GetLengthSqr() > 1e-4f * lengthSqr1 * lengthSqr2 ) {
+		return 1;
+	}
+
+	float t0 = ( a2 - a1 ).Dot( d1 ) / lengthSqr1;
+	float t1 = ( b2 - a1 ).Dot( d1 ) / lengthSqr1;
+	if ( t0 > t1 ) {
+		std::swap( t0, t1 );
+	}
+	t0 = std::max( t0, 0.0f );
+	t1 = std::min( t1, 1.0f );
+	if ( ( t1 - t0 ) * sqrtf( lengthSqr1 ) < 0.01f ) {
+		return 1;
+	}
+
+	int numContacts = 0;
+	const float ts[ 2 ] = { t0, t1 };
+	for ( int i = 0; i < 2; i++ ) {
+		const Vec3 pt1 = a1 + d1 * ts[ i ];
+		const Vec3 pt2 = ClosestPointOnSegment( a2, b2, pt1 );
+		if ( SpheresContact( bodyA, bodyB, pt1, capsuleA->m_radius, pt2, capsuleB->m_radius, contacts[ numContacts ] ) ) {
+			numContacts++;
+		}
+	}
+
+	if ( 0 == numContacts ) {
+		// Both ends fell outside the skin, so fall back to the single closest point
+		SpheresContact( bodyA, bodyB, ptOnA, capsuleA->m_radius, ptOnB, capsuleB->m_radius, contacts[ 0 ] );
+		return 1;
+	}
+	if ( 2 == numContacts && contacts[ 1 ].separationDistance < contacts[ 0 ].separationDistance ) {
+		std::swap( contacts[ 0 ], contacts[ 1 ] );
+	}
+	return numContacts;
+}
+
+/*
+========================================================================================================
+
+Box vs Box
+
+Separating axis test over the 15 candidate axes.  Face contacts clip the incident face against the
+side planes of the reference face, which gives the whole manifold in one pass.  Edge contacts take
+the closest points between the two edges.
+
+========================================================================================================
+*/
+
+struct orientedBox_t {
+	Vec3	center;
+	Vec3	axis[ 3 ];
+	float	halfSize[ 3 ];
+};
+
+/*
+====================================================
+BuildOrientedBox
+====================================================
+*/
+static void BuildOrientedBox( const Body * body, orientedBox_t & box ) {
+	const ShapeBox * shape = (const ShapeBox *)body->m_shape;
+	const Bounds & bounds = shape->m_bounds;
+
+	box.center = body->m_position + body->m_orientation.RotatePoint( bounds.Center() );
+	box.axis[ 0 ] = body->m_orientation.RotatePoint( Vec3( 1.0f, 0.0f, 0.0f ) );
+	box.axis[ 1 ] = body->m_orientation.RotatePoint( Vec3( 0.0f, 1.0f, 0.0f ) );
+	box.axis[ 2 ] = body->m_orientation.RotatePoint( Vec3( 0.0f, 0.0f, 1.0f ) );
+	box.halfSize[ 0 ] = bounds.WidthX() * 0.5f;
+	box.halfSize[ 1 ] = bounds.WidthY() * 0.5f;
+	box.halfSize[ 2 ] = bounds.WidthZ() * 0.5f;
+}
+
+/*
+====================================================
+ProjectedRadius
+====================================================
+*/
+static float ProjectedRadius( const orientedBox_t & box, const Vec3 & axis ) {
+	return	box.halfSize[ 0 ] * fabsf( box.axis[ 0 ].Dot( axis ) ) +
+			box.halfSize[ 1 ] * fabsf( box.axis[ 1 ].Dot( axis ) ) +
+			box.halfSize[ 2 ] * fabsf( box.axis[ 2 ].Dot( axis ) );
+}
+
+/*
+====================================================
+BoxSupport
+====================================================
+*/
+static Vec3 BoxSupport( const orientedBox_t & box, const Vec3 & dir ) {
+	Vec3 pt = box.center;
+	for ( int i = 0; i < 3; i++ ) {
+		const float sign = ( box.axis[ i ].Dot( dir ) >= 0.0f ) ? 1.0f : -1.0f;
+		pt += box.axis[ i ] * ( box.halfSize[ i ] * sign );
+	}
+	return pt;
+}
+
+/*
+====================================================
+TestAxis
+
+Returns the separation of the boxes along the axis, and flips the axis to point from A to B
+====================================================
+*/
+static float TestAxis( const orientedBox_t & boxA, const orientedBox_t & boxB, const Vec3 & ab, Vec3 & axis ) {
+	const float dist = ab.Dot( axis );
+	if ( dist < 0.0f ) {
+		axis *= -1.0f;
+	}
+	return fabsf( dist ) - ProjectedRadius( boxA, axis ) - ProjectedRadius( boxB, axis );
+}
+
+/*
+====================================================
+ClipPolygon
+
+Keeps the part of the polygon where dot( normal, pt ) <= offset
+====================================================
+*/
+static int ClipPolygon( const Vec3 * polyIn, const int numIn, const Vec3 & normal, const float offset, Vec3 * polyOut ) {
+	if ( 0 == numIn ) {
+		return 0;
+	}
+
+	int numOut = 0;
+	Vec3 prev = polyIn[ numIn - 1 ];
+	float prevDist = normal.Dot( prev ) - offset;
+	for ( int i = 0; i < numIn; i++ ) {
+		const Vec3 & curr = polyIn[ i ];
+		const float currDist = normal.Dot( curr ) - offset;
+
+		if ( ( prevDist <= 0.0f ) != ( currDist <= 0.0f ) ) {
+			const float t = prevDist / ( prevDist - currDist );
+			polyOut[ numOut ] = prev + ( curr - prev ) * t;
+			numOut++;
+		}
+		if ( currDist <= 0.0f ) {
+			polyOut[ numOut ] = curr;
+			numOut++;
+		}
+
+		prev = curr;
+		prevDist = currDist;
+	}
+	return numOut;
+}
+
+/*
+====================================================
+ReduceContacts
+
+Picks up to maxPoints of the clipped points that best cover the contact area.
+The deepest point goes first, then the point furthest from it, then the two points
+that add the most area on either side of the line between them.
+====================================================
+*/
+static int ReduceContacts( const Vec3 * points, const float * depths, const int numPoints, const Vec3 & normal, const int maxPoints, int * selected ) {
+	if ( numPoints <= maxPoints ) {
+		// Still put the deepest point first
+		int deepest = 0;
+		for ( int i = 0; i < numPoints; i++ ) {
+			selected[ i ] = i;
+			if ( depths[ i ] < depths[ deepest ] ) {
+				deepest = i;
+			}
+		}
+		std::swap( selected[ 0 ], selected[ deepest ] );
+		return numPoints;
+	}
+
+	int num = 0;
+	int deepest = 0;
+	for ( int i = 1; i < numPoints; i++ ) {
+		if ( depths[ i ] < depths[ deepest ] ) {
+			deepest = i;
+		}
+	}
+	selected[ num ] = deepest;
+	num++;
+	if ( num >= maxPoints ) {
+		return num;
+	}
+
+	int furthest = -1;
+	float maxDistSqr = -1.0f;
+	for ( int i = 0; i < numPoints; i++ ) {
+		const float distSqr = ( points[ i ] - points[ deepest ] ).GetLengthSqr();
+		if ( distSqr > maxDistSqr ) {
+			maxDistSqr = distSqr;
+			furthest = i;
+		}
+	}
+	selected[ num ] = furthest;
+	num++;
+	if ( num >= maxPoints ) {
+		return num;
+	}
+
+	// Signed areas of the triangles formed with the first two points
+	const Vec3 & p0 = points[ deepest ];
+	const Vec3 & p1 = points[ furthest ];
+	int maxIdx = -1;
+	int minIdx = -1;
+	float maxArea = 0.0f;
+	float minArea = 0.0f;
+	for ( int i = 0; i < numPoints; i++ ) {
+		const float area = normal.Dot( ( p1 - p0 ).Cross( points[ i ] - p0 ) );
+		if ( area > maxArea ) {
+			maxArea = area;
+			maxIdx = i;
+		}
+		if ( area < minArea ) {
+			minArea = area;
+			minIdx = i;
+		}
+	}
+
+	if ( maxIdx >= 0 ) {
+		selected[ num ] = maxIdx;
+		num++;
+	}
+	if ( minIdx >= 0 && num < maxPoints ) {
+		selected[ num ] = minIdx;
+		num++;
+	}
+	return num;
+}
+
+/*
+====================================================
+IntersectBoxBox
+====================================================
+*/
+int IntersectBoxBox( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	orientedBox_t boxA;
+	orientedBox_t boxB;
+	BuildOrientedBox( bodyA, boxA );
+	BuildOrientedBox( bodyB, boxB );
+
+	const Vec3 ab = boxB.center - boxA.center;
+
+	//
+	//	Find the axis of least penetration (or greatest separation)
+	//	axisType 0-2 are faces of A, 3-5 are faces of B, 6-14 are edge pairs
+	//
+	float bestFaceSep = -1e10f;
+	int bestFace = -1;
+	Vec3 bestFaceAxis;
+	for ( int i = 0; i < 3; i++ ) {
+		Vec3 axis = boxA.axis[ i ];
+		const float sep = TestAxis( boxA, boxB, ab, axis );
+		if ( sep > bestFaceSep ) {
+			bestFaceSep = sep;
+			bestFace = i;
+			bestFaceAxis = axis;
+		}
+	}
+
+	// Prefer the faces of A over the faces of B, so the reference face doesn't flicker between frames
+	const float relativeTolerance = 0.98f;
+	const float absoluteTolerance = 0.001f;
+	for ( int i = 0; i < 3; i++ ) {
+		Vec3 axis = boxB.axis[ i ];
+		const float sep = TestAxis( boxA, boxB, ab, axis );
+		if ( sep > bestFaceSep * relativeTolerance + absoluteTolerance ) {
+			bestFaceSep = sep;
+			bestFace = 3 + i;
+			bestFaceAxis = axis;
+		}
+	}
+
+	float bestEdgeSep = -1e10f;
+	int bestEdge = -1;
+	Vec3 bestEdgeAxis;
+	for ( int i = 0; i < 3; i++ ) {
+		for ( int j = 0; j < 3; j++ ) {
+			Vec3 axis = boxA.axis[ i ].Cross( boxB.axis[ j ] );
+			const float lengthSqr = axis.GetLengthSqr();
+			if ( lengthSqr < 1e-6f ) {
+				continue;	// parallel edges, the face axes already cover this
+			}
+			axis /= sqrtf( lengthSqr );
+
+			const float sep = TestAxis( boxA, boxB, ab, axis );
+			if ( sep > bestEdgeSep ) {
+				bestEdgeSep = sep;
+				bestEdge = 6 + i * 3 + j;
+				bestEdgeAxis = axis;
+			}
+		}
+	}
+
+	int axisType = bestFace;
+	float separation = bestFaceSep;
+	Vec3 axis = bestFaceAxis;
+	if ( bestEdge >= 0 && bestEdgeSep > bestFaceSep * relativeTolerance + absoluteTolerance ) {
+		axisType = bestEdge;
+		separation = bestEdgeSep;
+		axis = bestEdgeAxis;
+	}
+
+	// The normal for the contact points from B to A
+	const Vec3 normal = axis * -1.0f;
+
+	if ( separation > s_contactSkin ) {
+		// Separated.  The gap along the axis is a lower bound on the distance, which is what conservative advancement needs.
+		const Vec3 ptOnA = BoxSupport( boxA, axis );
+		const Vec3 ptOnB = ptOnA + axis * separation;
+		FillContact( bodyA, bodyB, ptOnA, ptOnB, normal, separation, contacts[ 0 ] );
+		return 0;
+	}
+
+	if ( axisType >= 6 ) {
+		//
+		//	Edge contact
+		//
+		const int i = ( axisType - 6 ) / 3;
+		const int j = ( axisType - 6 ) % 3;
+
+		// Find the edges on each box that are furthest along the axis
+		Vec3 edgeA = boxA.center;
+		Vec3 edgeB = boxB.center;
+		for ( int k = 0; k < 3; k++ ) {
+			if ( k != i ) {
+				const float sign = ( boxA.axis[ k ].Dot( axis ) >= 0.0f ) ? 1.0f : -1.0f;
+				edgeA += boxA.axis[ k ] * ( boxA.halfSize[ k ] * sign );
+			}
+			if ( k != j ) {
+				const float sign = ( boxB.axis[ k ].Dot( axis ) >= 0.0f ) ? -1.0f : 1.0f;
+				edgeB += boxB.axis[ k ] * ( boxB.halfSize[ k ] * sign );
+			}
+		}
+
+		const Vec3 halfEdgeA = boxA.axis[ i ] * boxA.halfSize[ i ];
+		const Vec3 halfEdgeB = boxB.axis[ j ] * boxB.halfSize[ j ];
+
+		Vec3 ptOnA;
+		Vec3 ptOnB;
+		ClosestPointsSegmentSegment( edgeA - halfEdgeA, edgeA + halfEdgeA, edgeB - halfEdgeB, edgeB + halfEdgeB, ptOnA, ptOnB );
+		FillContact( bodyA, bodyB, ptOnA, ptOnB, normal, separation, contacts[ 0 ] );
+		return 1;
+	}
+
+	//
+	//	Face contact
+	//
+	const bool isRefA = ( axisType < 3 );
+	const orientedBox_t & refBox = isRefA ? boxA : boxB;
+	const orientedBox_t & incBox = isRefA ? boxB : boxA;
+	const int refAxis = axisType % 3;
+	const Vec3 refNormal = isRefA ? axis : normal;	// points out of the reference box, towards the incident box
+
+	// The incident face is the one most anti-parallel to the reference normal
+	int incAxis = 0;
+	float minDot = 1e10f;
+	for ( int i = 0; i < 3; i++ ) {
+		const float dot = -fabsf( incBox.axis[ i ].Dot( refNormal ) );
+		if ( dot < minDot ) {
+			minDot = dot;
+			incAxis = i;
+		}
+	}
+	const float incSign = ( incBox.axis[ incAxis ].Dot( refNormal ) > 0.0f ) ? -1.0f : 1.0f;
+	const Vec3 incCenter = incBox.center + incBox.axis[ incAxis ] * ( incBox.halfSize[ incAxis ] * incSign );
+	const Vec3 incU = incBox.axis[ ( incAxis + 1 ) % 3 ] * incBox.halfSize[ ( incAxis + 1 ) % 3 ];
+	const Vec3 incV = incBox.axis[ ( incAxis + 2 ) % 3 ] * incBox.halfSize[ ( incAxis + 2 ) % 3 ];
+
+	// Clipping a quad against four planes leaves at most eight points
+	Vec3 polyA[ 8 ];
+	Vec3 polyB[ 8 ];
+	polyA[ 0 ] = incCenter + incU + incV;
+	polyA[ 1 ] = incCenter - incU + incV;
+	polyA[ 2 ] = incCenter - incU - incV;
+	polyA[ 3 ] = incCenter + incU - incV;
+	int numPoly = 4;
+
+	const Vec3 refCenter = refBox.center + refNormal * refBox.halfSize[ refAxis ];
+	for ( int i = 1; i < 3; i++ ) {
+		const int side = ( refAxis + i ) % 3;
+		const Vec3 & sideNormal = refBox.axis[ side ];
+		const float sideOffset = sideNormal.Dot( refBox.center );
+		const float halfSize = refBox.halfSize[ side ];
+
+		numPoly = ClipPolygon( polyA, numPoly, sideNormal, sideOffset + halfSize, polyB );
+		numPoly = ClipPolygon( polyB, numPoly, sideNormal * -1.0f, -sideOffset + halfSize, polyA );
+	}
+
+	// Keep the points that are below the reference face.  Points that are only within the skin
+	// would be dropped by the manifold on the next step anyway, so they just churn the warm starting.
+	Vec3 points[ 8 ];
+	float depths[ 8 ];
+	int numPoints = 0;
+	for ( int i = 0; i < numPoly; i++ ) {
+		const float depth = refNormal.Dot( polyA[ i ] - refCenter );
+		if ( depth <= 0.0f ) {
+			points[ numPoints ] = polyA[ i ];
+			depths[ numPoints ] = depth;
+			numPoints++;
+		}
+	}
+
+	if ( 0 == numPoints ) {
+		// The boxes are only touching within the skin, or barely overlap at a corner, so fall back to the support points
+		const Vec3 ptOnA = BoxSupport( boxA, axis );
+		const Vec3 ptOnB = ptOnA + axis * separation;
+		FillContact( bodyA, bodyB, ptOnA, ptOnB, normal, separation, contacts[ 0 ] );
+		return 1;
+	}
+
+	int selected[ MAX_PAIR_CONTACTS ];
+	const int numContacts = ReduceContacts( points, depths, numPoints, refNormal, std::min( maxContacts, MAX_PAIR_CONTACTS ), selected );
+	for ( int i = 0; i < numContacts; i++ ) {
+		const Vec3 & ptOnInc = points[ selected[ i ] ];
+		const float depth = depths[ selected[ i ] ];
+		const Vec3 ptOnRef = ptOnInc - refNormal * depth;
+
+		if ( isRefA ) {
+			FillContact( bodyA, bodyB, ptOnRef, ptOnInc, normal, depth, contacts[ i ] );
+		} else {
+			FillContact( bodyA, bodyB, ptOnInc, ptOnRef, normal, depth, contacts[ i ] );
+		}
+	}
+	return numContacts;
+}
+
+/*
+====================================================
+IntersectGJK
+====================================================
+*/
+int IntersectGJK( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	contact_t & contact = contacts[ 0 ];
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.timeOfImpact = 0.0f;
+
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	const float bias = s_gjkBias;
+	if ( GJK_DoesIntersect( bodyA, bodyB, bias, ptOnA, ptOnB, cache ) ) {
+		// There was an intersection, so get the contact data
+		Vec3 normal = ptOnB - ptOnA;
+		normal.Normalize();
+
+		ptOnA -= normal * bias;
+		ptOnB += normal * bias;
+
+		contact.normal = normal;
+
+		contact.ptOnA_WorldSpace = ptOnA;
+		contact.ptOnB_WorldSpace = ptOnB;
+
+		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( contact.ptOnA_WorldSpace );
+		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
+
+		float r = ( ptOnA - ptOnB ).GetMagnitude();
+		contact.separationDistance = -r;
+		return 1;
+	}
+
+	// There was no collision, but we still want the contact data, so get it
+	GJK_ClosestPoints( bodyA, bodyB, ptOnA, ptOnB, cache );
+	contact.ptOnA_WorldSpace = ptOnA;
+	contact.ptOnB_WorldSpace = ptOnB;
+
+	contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( contact.ptOnA_WorldSpace );
+	contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
+
+	float r = ( ptOnA - ptOnB ).GetMagnitude();
+	contact.separationDistance = r;
+	return 0;
+}
+
+/*
+====================================================
+ReduceContactSet
+
+Picks up to maxContacts of the candidates, keeping the deepest and then the ones
+that spread out the contact area the most.  Candidates must be penetrating.
+====================================================
+*/
+int ReduceContactSet( const contact_t * candidates, const int numCandidates, contact_t * contacts, const int maxContacts ) {
+	int num = numCandidates;
+	if ( num > MAX_CANDIDATE_CONTACTS ) {
+		printf( "WARNING: ReduceContactSet: %i candidates, only the first %i are used\n", num, MAX_CANDIDATE_CONTACTS );
+		num = MAX_CANDIDATE_CONTACTS;
+	}
+
+	Vec3 points[ MAX_CANDIDATE_CONTACTS ];
+	float depths[ MAX_CANDIDATE_CONTACTS ];
+	int selected[ MAX_CANDIDATE_CONTACTS ];
+	int deepest = 0;
+	for ( int i = 0; i < num; i++ ) {
+		points[ i ] = candidates[ i ].ptOnB_WorldSpace;
+		depths[ i ] = candidates[ i ].separationDistance;
+		if ( depths[ i ] < depths[ deepest ] ) {
+			deepest = i;
+		}
+	}
+
+	const int numSelected = ReduceContacts( points, depths, num, candidates[ deepest ].normal, maxContacts, selected );
+	for ( int i = 0; i < numSelected; i++ ) {
+		contacts[ i ] = candidates[ selected[ i ] ];
+	}
+	return numSelected;
+}
+
+/*
+====================================================
+AddCandidateContact
+
+Adds to a pair's candidates without allocating.  When they fill up they're reduced down to a
+manifold first, which always keeps the deepest, so the end result is close to reducing them all at once.
+====================================================
+*/
+void AddCandidateContact( contact_t * candidates, int & numCandidates, const contact_t & contact ) {
+	if ( numCandidates >= MAX_CANDIDATE_CONTACTS ) {
+		contact_t reduced[ MAX_PAIR_CONTACTS ];
+		numCandidates = ReduceContactSet( candidates, numCandidates, reduced, MAX_PAIR_CONTACTS );
+		for ( int i = 0; i < numCandidates; i++ ) {
+			candidates[ i ] = reduced[ i ];
+		}
+	}
+
+	candidates[ numCandidates ] = contact;
+	numCandidates++;
+}
+
+/*
+====================================================
+IsTriangleShape
+
+Static level geometry that the narrowphase only sees as the triangles near the other body
+====================================================
+*/
+bool IsTriangleShape( const Shape * shape ) {
+	return ( Shape::SHAPE_MESH == shape->GetType() || Shape::SHAPE_HEIGHTFIELD == shape->GetType() );
+}
+
+// Per thread scratch, so the narrowphase doesn't allocate once these have grown to fit the scene.
+// The triangle and child lists are used as stacks, a pair marks where its entries start and trims
+// back to that when it's done, since a compound's children run the narrowphase again.
+static thread_local std::vector< int > s_gatherSlots;
+static thread_local std::vector< Vec3 > s_triangles;
+static thread_local std::vector< int > s_children;
+
+/*
+====================================================
+CountScratchGrowth
+
+The scratch only allocates while it grows, that goes into the step's allocation stats like any other
+====================================================
+*/
+template< typename T >
+static void CountScratchGrowth( const std::vector< T > & scratch, const size_t oldCapacity ) {
+	if ( scratch.capacity() != oldCapacity ) {
+		GetPhysicsCounters().numBytesAllocated += (int)( scratch.capacity() * sizeof( T ) );
+	}
+}
+
+/*
+====================================================
+ReserveScratch
+
+Makes room for count more entries in one allocation, still growing geometrically since the lists are reused
+====================================================
+*/
+template< typename T >
+static void ReserveScratch( std::vector< T > & scratch, const size_t count ) {
+	const size_t needed = scratch.size() + count;
+	if ( needed > scratch.capacity() ) {
+		scratch.reserve( std::max( needed, 2 * scratch.capacity() ) );
+	}
+}
+
+/*
+====================================================
+GatherTriangles
+
+Appends three model space vertices for each of the body's triangles that might touch the world space bounds
+====================================================
+*/
+void GatherTriangles( const Body * body, const Bounds & worldBounds, std::vector< Vec3 > & triangles ) {
+	const size_t slotsCapacity = s_gatherSlots.capacity();
+	const size_t trianglesCapacity = triangles.capacity();
+
+	if ( Shape::SHAPE_MESH == body->m_shape->GetType() ) {
+		const ShapeMesh * mesh = (const ShapeMesh *)body->m_shape;
+
+		std::vector< int > & tris = s_gatherSlots;
+		tris.clear();
+		mesh->QueryTriangles( worldBounds, body->m_position, body->m_orientation, tris );
+		ReserveScratch( triangles, 3 * tris.size() );
+		for ( int i = 0; i < tris.size(); i++ ) {
+			Vec3 a;
+			Vec3 b;
+			Vec3 c;
+			mesh->GetTriangle( tris[ i ], a, b, c );
+			triangles.push_back( a );
+			triangles.push_back( b );
+			triangles.push_back( c );
+		}
+	} else if ( Shape::SHAPE_HEIGHTFIELD == body->m_shape->GetType() ) {
+		const ShapeHeightfield * heightfield = (const ShapeHeightfield *)body->m_shape;
+
+		std::vector< int > & cells = s_gatherSlots;
+		cells.clear();
+		heightfield->QueryCells( WorldBoundsToModelSpace( worldBounds, body->m_position, body->m_orientation ), cells );
+		ReserveScratch( triangles, 6 * cells.size() );
+		for ( int i = 0; i < cells.size(); i++ ) {
+			Vec3 cellTris[ 6 ];
+			heightfield->GetCellTriangles( cells[ i ], cellTris );
+			for ( int v = 0; v < 6; v++ ) {
+				triangles.push_back( cellTris[ v ] );
+			}
+		}
+	}
+
+	CountScratchGrowth( s_gatherSlots, slotsCapacity );
+	CountScratchGrowth( triangles, trianglesCapacity );
+}
+
+/*
+====================================================
+IntersectConvexTriangles
+
+Runs GJK against each triangle of B near the convex body A.  Every triangle
+adds at most one contact, those are then reduced down to a manifold.
+====================================================
+*/
+int IntersectConvexTriangles( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	Bounds boundsA = bodyA->GetBounds();
+	boundsA.Expand( boundsA.mins - Vec3( SUBSHAPE_QUERY_MARGIN ) );
+	boundsA.Expand( boundsA.maxs + Vec3( SUBSHAPE_QUERY_MARGIN ) );
+
+	std::vector< Vec3 > & triangles = s_triangles;
+	const int firstVert = (int)triangles.size();
+	GatherTriangles( bodyB, boundsA, triangles );
+	const int lastVert = (int)triangles.size();
+
+	// The triangle shapes live in B's model space, so a copy of B's body places them
+	Body triBody = *bodyB;
+
+	contact_t candidates[ MAX_CANDIDATE_CONTACTS ];
+	int numCandidates = 0;
+	contact_t closest;
+	closest.separationDistance = SUBSHAPE_QUERY_MARGIN;
+	closest.bodyA = bodyA;
+	closest.bodyB = bodyB;
+	closest.timeOfImpact = 0.0f;
+	closest.ptOnA_WorldSpace = bodyA->GetCenterOfMassWorldSpace();
+	closest.ptOnB_WorldSpace = closest.ptOnA_WorldSpace;
+	closest.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( closest.ptOnA_WorldSpace );
+	closest.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( closest.ptOnB_WorldSpace );
+
+	for ( int i = firstVert; i + 2 < lastVert; i += 3 ) {
+		ShapeTriangle triangle( triangles[ i + 0 ], triangles[ i + 1 ], triangles[ i + 2 ], bodyB->m_shape->GetCenterOfMass() );
+		triBody.m_shape = &triangle;
+
+		// The cache belongs to the pair, not to any one triangle, so it can't be used here
+		contact_t contact;
+		const int numContacts = IntersectGJK( bodyA, &triBody, &contact, 1, NULL );
+		contact.bodyB = bodyB;
+		if ( numContacts > 0 ) {
+			AddCandidateContact( candidates, numCandidates, contact );
+		} else if ( contact.separationDistance < closest.separationDistance ) {
+			closest = contact;
+		}
+	}
+	triangles.resize( firstVert );
+
+	if ( 0 == numCandidates ) {
+		contacts[ 0 ] = closest;
+		return 0;
+	}
+	return ReduceContactSet( candidates, numCandidates, contacts, maxContacts );
+}
+
+/*
+====================================================
+IntersectStatic
+
+Meshes and heightfields are static level geometry, they never need to collide with each other
+====================================================
+*/
+static int IntersectStatic( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	contact_t & contact = contacts[ 0 ];
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.timeOfImpact = 0.0f;
+	contact.separationDistance = 1e6f;
+	return 0;
+}
+
+/*
+====================================================
+IntersectCompound
+
+Runs the narrowphase between A and each child of B near it.  A child is placed with a copy
+of B's body, and its contacts are moved back onto B, so A can be any shape including
+another compound.
+====================================================
+*/
+int IntersectCompound( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const ShapeCompound * compound = (const ShapeCompound *)bodyB->m_shape;
+
+	Bounds boundsA = bodyA->GetBounds();
+	boundsA.Expand( boundsA.mins - Vec3( SUBSHAPE_QUERY_MARGIN ) );
+	boundsA.Expand( boundsA.maxs + Vec3( SUBSHAPE_QUERY_MARGIN ) );
+
+	std::vector< int > & children = s_children;
+	const int firstChild = (int)children.size();
+	const size_t childrenCapacity = children.capacity();
+	compound->QueryChildren( boundsA, bodyB->m_position, bodyB->m_orientation, children );
+	CountScratchGrowth( children, childrenCapacity );
+	const int numNear = (int)children.size() - firstChild;
+
+	Body childBody = *bodyB;
+
+	contact_t candidates[ MAX_CANDIDATE_CONTACTS ];
+	int numCandidates = 0;
+	contact_t closest;
+	closest.separationDistance = SUBSHAPE_QUERY_MARGIN;
+	closest.bodyA = bodyA;
+	closest.bodyB = bodyB;
+	closest.timeOfImpact = 0.0f;
+	closest.ptOnA_WorldSpace = bodyA->GetCenterOfMassWorldSpace();
+	closest.ptOnB_WorldSpace = closest.ptOnA_WorldSpace;
+	closest.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace( closest.ptOnA_WorldSpace );
+	closest.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( closest.ptOnB_WorldSpace );
+
+	for ( int pass = 0; pass < 2; pass++ ) {
+		int numChildren = numNear;
+		if ( 1 == pass ) {
+			if ( numCandidates > 0 || closest.separationDistance < SUBSHAPE_QUERY_MARGIN ) {
+				break;
+			}
+
+			// No child is near A, but conservative advancement steps by the separation,
+			// so it needs the real distance to the nearest child rather than the margin
+			numChildren = (int)compound->m_children.size();
+			closest.separationDistance = 1e6f;
+		}
+
+		for ( int i = 0; i < numChildren; i++ ) {
+			const int childIdx = ( 0 == pass ) ? children[ firstChild + i ] : i;
+			childBody.m_shape = compound->m_children[ childIdx ].shape;
+			compound->GetChildTransform( childIdx, bodyB->m_position, bodyB->m_orientation, childBody.m_position, childBody.m_orientation );
+
+			// The cache belongs to the pair, not to any one child, so it can't be used here
+			contact_t childContacts[ MAX_PAIR_CONTACTS ];
+			const int numContacts = NarrowPhase( bodyA, &childBody, childContacts, std::min( maxContacts, MAX_PAIR_CONTACTS ), NULL );
+			const int numFilled = std::max( numContacts, 1 );
+			for ( int j = 0; j < numFilled; j++ ) {
+				contact_t & contact = childContacts[ j ];
+				contact.bodyB = bodyB;
+				contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace( contact.ptOnB_WorldSpace );
+			}
+
+			if ( numContacts > 0 ) {
+				for ( int j = 0; j < numContacts; j++ ) {
+					AddCandidateContact( candidates, numCandidates, childContacts[ j ] );
+				}
+			} else if ( childContacts[ 0 ].separationDistance < closest.separationDistance ) {
+				closest = childContacts[ 0 ];
+			}
+		}
+	}
+	children.resize( firstChild );
+
+	if ( 0 == numCandidates ) {
+		contacts[ 0 ] = closest;
+		return 0;
+	}
+	return ReduceContactSet( candidates, numCandidates, contacts, maxContacts );
+}
+
+/*
+====================================================
+s_intersectTable
+
+Indexed by [ typeA ][ typeB ] with typeA <= typeB, the other half is reached by swapping the bodies
+====================================================
+*/
+static const intersectFn_t s_intersectTable[ NUM_SHAPE_TYPES ][ NUM_SHAPE_TYPES ] = {
+	//	SHAPE_SPHERE			SHAPE_BOX			SHAPE_CONVEX	SHAPE_CAPSULE				SHAPE_MESH					SHAPE_HEIGHTFIELD			SHAPE_COMPOUND
+	{	IntersectSphereSphere,	IntersectSphereBox,	IntersectGJK,	IntersectSphereCapsule,		IntersectConvexTriangles,	IntersectConvexTriangles,	IntersectCompound	},	// SHAPE_SPHERE
+	{	NULL,					IntersectBoxBox,	IntersectGJK,	IntersectGJK,				IntersectConvexTriangles,	IntersectConvexTriangles,	IntersectCompound	},	// SHAPE_BOX
+	{	NULL,					NULL,				IntersectGJK,	IntersectGJK,				IntersectConvexTriangles,	IntersectConvexTriangles,	IntersectCompound	},	// SHAPE_CONVEX
+	{	NULL,					NULL,				NULL,			IntersectCapsuleCapsule,	IntersectConvexTriangles,	IntersectConvexTriangles,	IntersectCompound	},	// SHAPE_CAPSULE
+	{	NULL,					NULL,				NULL,			NULL,						IntersectStatic,			IntersectStatic,			IntersectCompound	},	// SHAPE_MESH
+	{	NULL,					NULL,				NULL,			NULL,						NULL,						IntersectStatic,			IntersectCompound	},	// SHAPE_HEIGHTFIELD
+	{	NULL,					NULL,				NULL,			NULL,						NULL,						NULL,						IntersectCompound	},	// SHAPE_COMPOUND
+};
+
+/*
+====================================================
+NarrowPhase
+====================================================
+*/
+int NarrowPhase( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache ) {
+	const int typeA = bodyA->m_shape->GetType();
+	const int typeB = bodyB->m_shape->GetType();
+
+	if ( typeA <= typeB ) {
+		return s_intersectTable[ typeA ][ typeB ]( bodyA, bodyB, contacts, maxContacts, cache );
+	}
+
+	// Run the kernel with the bodies swapped, then put the contacts back in the caller's order.
+	// Contact zero is filled even when the bodies are apart.
+	const int numContacts = s_intersectTable[ typeB ][ typeA ]( bodyB, bodyA, contacts, maxContacts, cache );
+	const int numFilled = std::max( numContacts, 1 );
+	for ( int i = 0; i < numFilled; i++ ) {
+		FlipContact( contacts[ i ] );
+	}
+	return numContacts;
+}
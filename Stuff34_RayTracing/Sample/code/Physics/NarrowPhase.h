@@ -0,0 +1,50 @@
+//
+//	NarrowPhase.h
+//
+#pragma once
+#include "Math/Vector.h"
+#include <vector>
+
+class Body;
+class Bounds;
+class Shape;
+struct contact_t;
+struct gjkCache_t;
+
+#define MAX_PAIR_CONTACTS 4
+
+// Candidates gathered from a pair's triangles or children before they're reduced, see AddCandidateContact
+#define MAX_CANDIDATE_CONTACTS 32
+
+// How far past a body's bounds to look for mesh and heightfield triangles, and compound children
+#define SUBSHAPE_QUERY_MARGIN 0.05f
+
+/*
+====================================================
+intersectFn_t
+
+A shape pair kernel writes up to maxContacts contacts, deepest first, and returns the number written.
+When the bodies are apart it returns zero, but contacts[ 0 ] still holds the closest points and the
+separation, since conservative advancement steps along them.
+Normals point from B to A.
+====================================================
+*/
+typedef int ( *intersectFn_t )( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+
+int IntersectSphereSphere( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectSphereBox( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectSphereCapsule( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectBoxBox( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectCapsuleCapsule( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectGJK( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectConvexTriangles( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+int IntersectCompound( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
+
+void FlipContact( contact_t & contact );
+
+bool IsTriangleShape( const Shape * shape );
+void GatherTriangles( const Body * body, const Bounds & worldBounds, std::vector< Vec3 > & triangles );
+int ReduceContactSet( const contact_t * candidates, const int numCandidates, contact_t * contacts, const int maxContacts );
+void AddCandidateContact( contact_t * candidates, int & numCandidates, const contact_t & contact );	// candidates holds MAX_CANDIDATE_CONTACTS
+
+int NarrowPhase( Body * bodyA, Body * bodyB, contact_t * contacts, const int maxContacts, gjkCache_t * cache );
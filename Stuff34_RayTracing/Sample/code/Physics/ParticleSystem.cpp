@@ -0,0 +1,512 @@
+//
+//	ParticleSystem.cpp
+//
+#include "Physics/ParticleSystem.h"
+#include "Physics/PhysicsWorld.h"
+#include "BSP/Brush.h"
+#include "JobSystem/JobSystem.h"
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define PARTICLE_SIMD	// comment out to integrate the particles one at a time
+
+#if defined( PARTICLE_SIMD )
+#include <xmmintrin.h>
+#endif
+
+static const float s_gravity = -10.0f;
+static const float s_skin = 0.001f;				// how far off the surface a bounced particle is put
+static const float s_restSpeedSqr = 0.25f * 0.25f;	// slower than this on a floor and the particle settles
+static const float s_floorNormalZ = 0.7f;
+
+#define MAX_LEAF_BRUSHES 2
+
+/*
+========================================================================================================
+
+ParticleSystem
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ParticleSystem::ParticleSystem
+====================================================
+*/
+ParticleSystem::ParticleSystem( const int maxParticles ) {
+	assert( maxParticles > 0 );
+	m_maxParticles = ( maxParticles > 0 ) ? maxParticles : 1;
+	m_next = 0;
+	m_numAlive = 0;
+
+	const int numPadded = ( m_maxParticles + 3 ) & ~3;
+	m_posX.resize( numPadded );
+	m_posY.resize( numPadded );
+	m_posZ.resize( numPadded );
+	m_prevX.resize( numPadded );
+	m_prevY.resize( numPadded );
+	m_prevZ.resize( numPadded );
+	m_velX.resize( numPadded );
+	m_velY.resize( numPadded );
+	m_velZ.resize( numPadded );
+	m_gravity.resize( numPadded );
+	m_life.resize( numPadded );
+	m_type.resize( numPadded );
+	m_flags.resize( numPadded );
+	m_rayIndex.resize( numPadded );
+
+	for ( int first = 0; first < m_maxParticles; first += RANGE_SIZE ) {
+		particleRangeJob_t range;
+		range.system = this;
+		range.first = first;
+		range.count = ( m_maxParticles - first < RANGE_SIZE ) ? ( m_maxParticles - first ) : RANGE_SIZE;
+		m_ranges.push_back( range );
+	}
+
+	Clear();
+}
+
+/*
+====================================================
+ParticleSystem::AddType
+====================================================
+*/
+int ParticleSystem::AddType( const particleType_t & type ) {
+	if ( m_types.size() >= 256 ) {
+		printf( "WARNING: ParticleSystem::AddType: too many particle types\n" );
+		return -1;
+	}
+
+	m_types.push_back( type );
+	return (int)m_types.size() - 1;
+}
+
+/*
+====================================================
+ParticleSystem::Clear
+====================================================
+*/
+void ParticleSystem::Clear() {
+	const int numPadded = (int)m_posX.size();
+	for ( int i = 0; i < numPadded; i++ ) {
+		m_posX[ i ] = 0.0f;
+		m_posY[ i ] = 0.0f;
+		m_posZ[ i ] = 0.0f;
+		m_prevX[ i ] = 0.0f;
+		m_prevY[ i ] = 0.0f;
+		m_prevZ[ i ] = 0.0f;
+		m_velX[ i ] = 0.0f;
+		m_velY[ i ] = 0.0f;
+		m_velZ[ i ] = 0.0f;
+		m_gravity[ i ] = 0.0f;
+		m_life[ i ] = 0.0f;
+		m_type[ i ] = 0;
+		m_flags[ i ] = 0;
+		m_rayIndex[ i ] = -1;
+	}
+
+	m_next = 0;
+	m_numAlive = 0;
+	m_decals.clear();
+}
+
+/*
+====================================================
+ParticleSystem::Emit
+====================================================
+*/
+void ParticleSystem::Emit( const int type, const Vec3 & pos, const Vec3 & vel ) {
+	if ( type < 0 || type >= m_types.size() ) {
+		printf( "WARNING: ParticleSystem::Emit: invalid particle type %i\n", type );
+		return;
+	}
+
+	// The oldest particle is recycled once the pool is full
+	const int idx = m_next;
+	m_next = ( m_next + 1 ) % m_maxParticles;
+
+	const particleType_t & particleType = m_types[ type ];
+	m_posX[ idx ] = pos.x;
+	m_posY[ idx ] = pos.y;
+	m_posZ[ idx ] = pos.z;
+	m_prevX[ idx ] = pos.x;
+	m_prevY[ idx ] = pos.y;
+	m_prevZ[ idx ] = pos.z;
+	m_velX[ idx ] = vel.x;
+	m_velY[ idx ] = vel.y;
+	m_velZ[ idx ] = vel.z;
+	m_gravity[ idx ] = s_gravity * particleType.gravityScale;
+	m_life[ idx ] = particleType.lifetime;
+	m_type[ idx ] = (unsigned char)type;
+	m_flags[ idx ] = 0;
+}
+
+/*
+====================================================
+ParticleSystem::SetBrushes
+====================================================
+*/
+void ParticleSystem::SetBrushes( const brush_t * brushes, const int numBrushes ) {
+	m_brushPlanes.clear();
+	m_brushFirstPlane.clear();
+	m_brushNumPlanes.clear();
+	m_brushNodes.clear();
+
+	std::vector< Bounds > bounds;
+	std::vector< int > brushIds;
+	for ( int i = 0; i < numBrushes; i++ ) {
+		const brush_t & brush = brushes[ i ];
+
+		Bounds brushBounds;
+		for ( int j = 0; j < brush.numPlanes; j++ ) {
+			const winding_t & winding = brush.windings[ j ];
+			for ( int k = 0; k < winding.pts.size(); k++ ) {
+				brushBounds.Expand( winding.pts[ k ] );
+			}
+		}
+		if ( !brushBounds.IsValid() ) {
+			printf( "WARNING: ParticleSystem::SetBrushes: brush %i has no windings, was it built?\n", i );
+			continue;
+		}
+
+		bounds.push_back( brushBounds );
+		brushIds.push_back( i );
+	}
+
+	std::vector< int > order;
+	BuildBoundsTree( bounds.data(), (int)bounds.size(), MAX_LEAF_BRUSHES, m_brushNodes, order );
+
+	// Store the brushes in the tree's slot order
+	for ( int slot = 0; slot < order.size(); slot++ ) {
+		const brush_t & brush = brushes[ brushIds[ order[ slot ] ] ];
+
+		m_brushFirstPlane.push_back( (int)m_brushPlanes.size() );
+		m_brushNumPlanes.push_back( brush.numPlanes );
+		for ( int j = 0; j < brush.numPlanes; j++ ) {
+			const plane_t & plane = brush.planes[ j ];
+			m_brushPlanes.push_back( Vec4( plane.normal.x, plane.normal.y, plane.normal.z, plane.normal.Dot( plane.pts[ 0 ] ) ) );
+		}
+	}
+}
+
+/*
+====================================================
+ParticleSystem::Integrate
+
+Symplectic Euler, the dead and resting particles have zero velocity and gravity so they stay put
+====================================================
+*/
+void ParticleSystem::Integrate( const float dt_sec ) {
+	const int numPadded = (int)m_posX.size();
+
+#if defined( PARTICLE_SIMD )
+	const __m128 dt = _mm_set1_ps( dt_sec );
+	for ( int i = 0; i < numPadded; i += 4 ) {
+		const __m128 x = _mm_loadu_ps( &m_posX[ i ] );
+		const __m128 y = _mm_loadu_ps( &m_posY[ i ] );
+		const __m128 z = _mm_loadu_ps( &m_posZ[ i ] );
+		_mm_storeu_ps( &m_prevX[ i ], x );
+		_mm_storeu_ps( &m_prevY[ i ], y );
+		_mm_storeu_ps( &m_prevZ[ i ], z );
+
+		const __m128 vx = _mm_loadu_ps( &m_velX[ i ] );
+		const __m128 vy = _mm_loadu_ps( &m_velY[ i ] );
+		const __m128 vz = _mm_add_ps( _mm_loadu_ps( &m_velZ[ i ] ), _mm_mul_ps( _mm_loadu_ps( &m_gravity[ i ] ), dt ) );
+		_mm_storeu_ps( &m_velZ[ i ], vz );
+
+		_mm_storeu_ps( &m_posX[ i ], _mm_add_ps( x, _mm_mul_ps( vx, dt ) ) );
+		_mm_storeu_ps( &m_posY[ i ], _mm_add_ps( y, _mm_mul_ps( vy, dt ) ) );
+		_mm_storeu_ps( &m_posZ[ i ], _mm_add_ps( z, _mm_mul_ps( vz, dt ) ) );
+		_mm_storeu_ps( &m_life[ i ], _mm_sub_ps( _mm_loadu_ps( &m_life[ i ] ), dt ) );
+	}
+#else
+	for ( int i = 0; i < numPadded; i++ ) {
+		m_prevX[ i ] = m_posX[ i ];
+		m_prevY[ i ] = m_posY[ i ];
+		m_prevZ[ i ] = m_posZ[ i ];
+
+		m_velZ[ i ] += m_gravity[ i ] * dt_sec;
+		m_posX[ i ] += m_velX[ i ] * dt_sec;
+		m_posY[ i ] += m_velY[ i ] * dt_sec;
+		m_posZ[ i ] += m_velZ[ i ] * dt_sec;
+		m_life[ i ] -= dt_sec;
+	}
+#endif
+}
+
+/*
+====================================================
+brushTrace_t
+====================================================
+*/
+struct brushTrace_t {
+	const Vec4 * planes;
+	const int * firstPlane;
+	const int * numPlanes;
+	Vec3 start;
+	Vec3 dir;
+	Vec3 normal;
+	float fraction;
+	float depth;	// how far inside a brush the start was
+	bool didHit;
+};
+
+/*
+====================================================
+ParticleSystem::TraceBrushLeaf
+
+Clips the segment against each convex brush in the leaf
+====================================================
+*/
+float ParticleSystem::TraceBrushLeaf( const int first, const int count, const float maxT, void * data ) {
+	brushTrace_t * trace = (brushTrace_t *)data;
+
+	float closestT = maxT;
+	for ( int slot = first; slot < first + count; slot++ ) {
+		const Vec4 * planes = trace->planes + trace->firstPlane[ slot ];
+		const int numPlanes = trace->numPlanes[ slot ];
+
+		float tEnter = -1.0f;
+		float tExit = closestT;
+		float deepest = -1e10f;
+		Vec3 enterNormal( 0.0f );
+		Vec3 deepestNormal( 0.0f );
+		bool isMiss = false;
+		for ( int i = 0; i < numPlanes; i++ ) {
+			const Vec3 normal( planes[ i ].x, planes[ i ].y, planes[ i ].z );
+			const float distStart = normal.Dot( trace->start ) - planes[ i ].w;
+			const float distEnd = distStart + normal.Dot( trace->dir );
+
+			if ( distStart > deepest ) {
+				deepest = distStart;
+				deepestNormal = normal;
+			}
+
+			if ( distStart > 0.0f && distEnd > 0.0f ) {
+				isMiss = true;	// entirely in front of this plane
+				break;
+			}
+			if ( distStart <= 0.0f && distEnd <= 0.0f ) {
+				continue;
+			}
+
+			const float t = distStart / ( distStart - distEnd );
+			if ( distStart > 0.0f ) {
+				if ( t > tEnter ) {
+					tEnter = t;
+					enterNormal = normal;
+				}
+			} else if ( t < tExit ) {
+				tExit = t;
+			}
+		}
+		if ( isMiss ) {
+			continue;
+		}
+
+		// Started inside, which happens when a brush moves or a particle is emitted inside one.  Push out the nearest face.
+		if ( deepest <= 0.0f ) {
+			closestT = 0.0f;
+			trace->fraction = 0.0f;
+			trace->depth = -deepest;
+			trace->normal = deepestNormal;
+			trace->didHit = true;
+			continue;
+		}
+
+		if ( tEnter >= 0.0f && tEnter <= tExit && tEnter < closestT ) {
+			closestT = tEnter;
+			trace->fraction = tEnter;
+			trace->depth = 0.0f;
+			trace->normal = enterNormal;
+			trace->didHit = true;
+		}
+	}
+	return closestT;
+}
+
+/*
+====================================================
+ParticleSystem::TraceBrushes
+====================================================
+*/
+bool ParticleSystem::TraceBrushes( const Vec3 & start, const Vec3 & end, float & fraction, Vec3 & point, Vec3 & normal ) const {
+	if ( m_brushNodes.empty() ) {
+		return false;
+	}
+
+	brushTrace_t trace;
+	trace.planes = m_brushPlanes.data();
+	trace.firstPlane = m_brushFirstPlane.data();
+	trace.numPlanes = m_brushNumPlanes.data();
+	trace.start = start;
+	trace.dir = end - start;
+	trace.normal.Zero();
+	trace.fraction = fraction;
+	trace.depth = 0.0f;
+	trace.didHit = false;
+	RayCastBoundsTree( m_brushNodes, start, trace.dir, fraction, TraceBrushLeaf, &trace );
+
+	if ( !trace.didHit ) {
+		return false;
+	}
+	fraction = trace.fraction;
+	point = start + trace.dir * trace.fraction + trace.normal * trace.depth;
+	normal = trace.normal;
+	return true;
+}
+
+/*
+====================================================
+ParticleSystem::CollideRange
+====================================================
+*/
+void ParticleSystem::CollideRange( particleRangeJob_t & range ) {
+	range.decals.clear();
+
+	for ( int i = range.first; i < range.first + range.count; i++ ) {
+		if ( m_life[ i ] <= 0.0f ) {
+			// Expired, stop it where it is
+			m_velX[ i ] = 0.0f;
+			m_velY[ i ] = 0.0f;
+			m_velZ[ i ] = 0.0f;
+			m_gravity[ i ] = 0.0f;
+			continue;
+		}
+		if ( m_flags[ i ] & PF_RESTING ) {
+			continue;
+		}
+
+		const Vec3 start( m_prevX[ i ], m_prevY[ i ], m_prevZ[ i ] );
+		const Vec3 end( m_posX[ i ], m_posY[ i ], m_posZ[ i ] );
+
+		// Whichever of the world and the brushes was hit first
+		float fraction = 1.0f;
+		Vec3 point( 0.0f );
+		Vec3 normal( 0.0f );
+		int bodyId = -1;
+		bool didHit = false;
+		if ( m_rayIndex[ i ] >= 0 ) {
+			const queryHit_t & hit = m_hits[ m_rayIndex[ i ] ];
+			if ( hit.DidHit() ) {
+				fraction = hit.fraction;
+				point = hit.point;
+				normal = hit.normal;
+				bodyId = hit.bodyId;
+				didHit = true;
+			}
+		}
+		if ( TraceBrushes( start, end, fraction, point, normal ) ) {
+			bodyId = -1;
+			didHit = true;
+		}
+		if ( !didHit ) {
+			continue;
+		}
+
+		const particleType_t & type = m_types[ m_type[ i ] ];
+		const Vec3 pos = point + normal * s_skin;
+		m_posX[ i ] = pos.x;
+		m_posY[ i ] = pos.y;
+		m_posZ[ i ] = pos.z;
+
+		// Bounce, and lose some of the sliding speed
+		Vec3 vel( m_velX[ i ], m_velY[ i ], m_velZ[ i ] );
+		const float normalSpeed = vel.Dot( normal );
+		if ( normalSpeed < 0.0f ) {
+			const Vec3 velNormal = normal * normalSpeed;
+			const Vec3 velTangent = vel - velNormal;
+			vel = velTangent * ( 1.0f - type.friction ) - velNormal * type.restitution;
+		}
+
+		if ( normal.z > s_floorNormalZ && vel.GetLengthSqr() < s_restSpeedSqr ) {
+			vel.Zero();
+			m_gravity[ i ] = 0.0f;
+			m_flags[ i ] |= PF_RESTING;
+		}
+		m_velX[ i ] = vel.x;
+		m_velY[ i ] = vel.y;
+		m_velZ[ i ] = vel.z;
+
+		if ( 0 == ( m_flags[ i ] & PF_TOUCHED ) ) {
+			m_flags[ i ] |= PF_TOUCHED;
+			if ( type.spawnsDecals ) {
+				particleDecal_t decal;
+				decal.position = pos;
+				decal.normal = normal;
+				decal.type = m_type[ i ];
+				decal.bodyId = bodyId;
+				range.decals.push_back( decal );
+			}
+		}
+	}
+}
+
+/*
+====================================================
+ParticleSystem::CollideJob
+====================================================
+*/
+void ParticleSystem::CollideJob( Job_t * job, void * data ) {
+	particleRangeJob_t * ranges = (particleRangeJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		ranges[ i ].system->CollideRange( ranges[ i ] );
+	}
+}
+
+/*
+====================================================
+ParticleSystem::Update
+====================================================
+*/
+void ParticleSystem::Update( const float dt_sec, PhysicsWorld * world ) {
+	Integrate( dt_sec );
+
+	//
+	//	Trace the moving particles through the world all at once
+	//
+	m_rays.clear();
+	m_numAlive = 0;
+	for ( int i = 0; i < m_maxParticles; i++ ) {
+		m_rayIndex[ i ] = -1;
+		if ( m_life[ i ] <= 0.0f ) {
+			continue;
+		}
+		m_numAlive++;
+
+		if ( NULL == world || ( m_flags[ i ] & PF_RESTING ) ) {
+			continue;
+		}
+
+		rayCastQuery_t ray;
+		ray.start = Vec3( m_prevX[ i ], m_prevY[ i ], m_prevZ[ i ] );
+		ray.end = Vec3( m_posX[ i ], m_posY[ i ], m_posZ[ i ] );
+		ray.contentsMask = m_types[ m_type[ i ] ].collidesWith;
+		m_rayIndex[ i ] = (int)m_rays.size();
+		m_rays.push_back( ray );
+	}
+	m_hits.resize( m_rays.size() );
+	if ( NULL != world ) {
+		world->RayCastBatch( m_rays.data(), m_hits.data(), (int)m_rays.size() );
+	}
+
+	//
+	//	Brushes and the bounces
+	//
+	if ( NULL != g_jobSystem ) {
+		g_jobSystem->ParallelFor( CollideJob, m_ranges.data(), sizeof( particleRangeJob_t ), (int)m_ranges.size() );
+		g_jobSystem->Wait( NULL );
+	} else {
+		for ( int i = 0; i < m_ranges.size(); i++ ) {
+			CollideRange( m_ranges[ i ] );
+		}
+	}
+
+	m_decals.clear();
+	for ( int i = 0; i < m_ranges.size(); i++ ) {
+		m_decals.insert( m_decals.end(), m_ranges[ i ].decals.begin(), m_ranges[ i ].decals.end() );
+	}
+}
@@ -0,0 +1,139 @@
+//
+//	ParticleSystem.h
+//
+#pragma once
+#include <vector>
+#include "Math/Vector.h"
+#include "Math/Bounds.h"
+#include "Physics/Body.h"
+#include "Physics/PhysicsQueries.h"
+#include "Physics/Shapes/BoundsTree.h"
+
+struct brush_t;
+struct Job_t;
+class ParticleSystem;
+class PhysicsWorld;
+
+/*
+====================================================
+particleType_t
+
+Shared settings for a kind of particle, like blood or sparks
+====================================================
+*/
+struct particleType_t {
+	particleType_t() : lifetime( 5.0f ), restitution( 0.3f ), friction( 0.2f ), gravityScale( 1.0f ), collidesWith( BC_GENERIC ), spawnsDecals( false ) {}
+
+	float lifetime;				// seconds
+	float restitution;
+	float friction;				// fraction of the sliding speed lost on each bounce
+	float gravityScale;
+	unsigned int collidesWith;	// body contents the particles hit
+	bool spawnsDecals;			// adds a decal event the first time a particle touches something
+};
+
+/*
+====================================================
+particleDecal_t
+====================================================
+*/
+struct particleDecal_t {
+	Vec3 position;
+	Vec3 normal;
+	int type;
+	int bodyId;		// the body that was touched, -1 for brushes
+};
+
+struct particleRangeJob_t {
+	ParticleSystem * system;
+	int first;
+	int count;
+	std::vector< particleDecal_t > decals;
+};
+
+/*
+====================================================
+ParticleSystem
+
+Point particles for blood, debris and sparks, that are too many and too short lived to be bodies.
+They're stored SoA and integrated four at a time.  Each step they trace the segment they moved along
+against the physics world's query tree and any brushes, and bounce off whatever they hit first.
+There's no solver, the things they hit never move because of them.
+
+The pool is a ring, so once it's full emitting a particle recycles the oldest one.
+Particles that settle on a floor stop being traced until they expire.
+====================================================
+*/
+class ParticleSystem {
+public:
+	explicit ParticleSystem( const int maxParticles = 128 * 1024 );
+
+	int AddType( const particleType_t & type );	// returns the type's index, or -1 if there are too many
+	void Emit( const int type, const Vec3 & pos, const Vec3 & vel );
+	void Clear();
+
+	// The brushes have to be built already, and they're copied so they don't need to stay around
+	void SetBrushes( const brush_t * brushes, const int numBrushes );
+
+	// The physics world is optional, and never call this from inside a job
+	void Update( const float dt_sec, PhysicsWorld * world );
+
+	int GetMaxParticles() const { return m_maxParticles; }
+	int GetNumAlive() const { return m_numAlive; }
+	bool IsAlive( const int idx ) const { return ( m_life[ idx ] > 0.0f ); }
+	Vec3 GetPosition( const int idx ) const { return Vec3( m_posX[ idx ], m_posY[ idx ], m_posZ[ idx ] ); }
+	int GetType( const int idx ) const { return m_type[ idx ]; }
+
+	// Decals from the last update
+	const std::vector< particleDecal_t > & GetDecalEvents() const { return m_decals; }
+
+	static const int RANGE_SIZE = 4096;		// particles per job
+
+private:
+	void Integrate( const float dt_sec );
+	void CollideRange( particleRangeJob_t & range );
+	bool TraceBrushes( const Vec3 & start, const Vec3 & end, float & fraction, Vec3 & point, Vec3 & normal ) const;
+
+	static float TraceBrushLeaf( const int first, const int count, const float maxT, void * data );
+	static void CollideJob( Job_t * job, void * data );
+
+	enum particleFlags_t {
+		PF_TOUCHED	= 1 << 0,	// has hit something since it was emitted
+		PF_RESTING	= 1 << 1,	// settled, so it isn't moved or traced anymore
+	};
+
+	int m_maxParticles;
+	int m_next;		// the slot the next emitted particle goes into
+	int m_numAlive;
+
+	std::vector< particleType_t > m_types;
+
+	// Padded to a multiple of four.  Dead and resting particles have no velocity or gravity, so integrating them does nothing.
+	std::vector< float > m_posX;
+	std::vector< float > m_posY;
+	std::vector< float > m_posZ;
+	std::vector< float > m_prevX;	// where the particle started the step
+	std::vector< float > m_prevY;
+	std::vector< float > m_prevZ;
+	std::vector< float > m_velX;
+	std::vector< float > m_velY;
+	std::vector< float > m_velZ;
+	std::vector< float > m_gravity;
+	std::vector< float > m_life;		// seconds left, zero or less is dead
+	std::vector< unsigned char > m_type;
+	std::vector< unsigned char > m_flags;
+
+	// World traces for the particles that are moving, m_rayIndex is -1 for the rest
+	std::vector< int > m_rayIndex;
+	std::vector< rayCastQuery_t > m_rays;
+	std::vector< queryHit_t > m_hits;
+
+	// Brush planes are outward facing and stored as normal and distance
+	std::vector< Vec4 > m_brushPlanes;
+	std::vector< int > m_brushFirstPlane;
+	std::vector< int > m_brushNumPlanes;
+	std::vector< boundsTreeNode_t > m_brushNodes;
+
+	std::vector< particleRangeJob_t > m_ranges;
+	std::vector< particleDecal_t > m_decals;
+};
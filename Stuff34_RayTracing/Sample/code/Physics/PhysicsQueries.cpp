@@ -0,0 +1,586 @@
+//
+//  PhysicsQueries.cpp
+//
+#include "Physics/PhysicsWorld.h"
+#include "Physics/Intersections.h"
+#include "Physics/NarrowPhase.h"
+#include "JobSystem/JobSystem.h"
+
+/*
+========================================================================================================
+
+World Queries
+
+========================================================================================================
+*/
+
+#define MAX_LEAF_QUERY_BODIES 2
+
+/*
+====================================================
+IsConvexQueryShape
+
+Sweeps and overlaps move the query shape through the narrowphase as body A,
+which only works for shapes with volume
+====================================================
+*/
+static bool IsConvexQueryShape( const Shape * shape ) {
+	if ( NULL == shape ) {
+		return false;
+	}
+	const Shape::shapeType_t type = shape->GetType();
+	return ( Shape::SHAPE_SPHERE == type || Shape::SHAPE_BOX == type || Shape::SHAPE_CONVEX == type || Shape::SHAPE_CAPSULE == type );
+}
+
+/*
+====================================================
+PhysicsWorld::UpdateQueryTree
+====================================================
+*/
+void PhysicsWorld::UpdateQueryTree() {
+	if ( !m_queryTreeDirty ) {
+		return;
+	}
+	m_queryTreeDirty = false;
+
+	std::vector< int > bodyIds;
+	GetAllocatedBodyIDs( bodyIds );
+
+	std::vector< Bounds > bounds( bodyIds.size() );
+	for ( int i = 0; i < bodyIds.size(); i++ ) {
+		bounds[ i ] = m_bodyPool[ bodyIds[ i ] ].GetBounds();
+	}
+
+	std::vector< int > order;
+	BuildBoundsTree( bounds.data(), (int)bounds.size(), MAX_LEAF_QUERY_BODIES, m_queryNodes, order );
+
+	m_queryBodyIds.resize( order.size() );
+	for ( int i = 0; i < order.size(); i++ ) {
+		m_queryBodyIds[ i ] = bodyIds[ order[ i ] ];
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::FilterQuery
+
+Returns true if the query should skip the body
+====================================================
+*/
+bool PhysicsWorld::FilterQuery( const Body * body, const unsigned int contentsMask, const int ignoreBodyId ) const {
+	if ( NULL == body->m_shape ) {
+		return true;
+	}
+	if ( 0 == ( body->m_bodyContents & contentsMask ) ) {
+		return true;
+	}
+	return ( ( body - m_bodyPool ) == ignoreBodyId );
+}
+
+/*
+====================================================
+queryRayCast_t
+====================================================
+*/
+struct queryRayCast_t {
+	const PhysicsWorld * world;
+	const rayCastQuery_t * query;
+	Vec3 dir;
+	queryHit_t * hit;
+};
+
+/*
+====================================================
+PhysicsWorld::RayCastBodies
+
+Casts the ray against the bodies in a leaf of the query tree
+====================================================
+*/
+float PhysicsWorld::RayCastBodies( const int first, const int count, const float maxT, void * data ) {
+	queryRayCast_t * ray = (queryRayCast_t *)data;
+	const PhysicsWorld * world = ray->world;
+
+	float closestT = maxT;
+	for ( int slot = first; slot < first + count; slot++ ) {
+		const int bodyId = world->m_queryBodyIds[ slot ];
+		const Body * body = &world->m_bodyPool[ bodyId ];
+		if ( world->FilterQuery( body, ray->query->contentsMask, ray->query->ignoreBodyId ) ) {
+			continue;
+		}
+
+		// Shapes cast rays in model space
+		const Quat invOrient = body->m_orientation.Inverse();
+		const Vec3 start = invOrient.RotatePoint( ray->query->start - body->m_position );
+		const Vec3 dir = invOrient.RotatePoint( ray->dir );
+
+		float t;
+		Vec3 normal;
+		if ( !body->m_shape->RayCast( start, dir, closestT, t, normal ) ) {
+			continue;
+		}
+
+		ray->hit->bodyId = bodyId;
+		ray->hit->fraction = t;
+		ray->hit->point = ray->query->start + ray->dir * t;
+		ray->hit->normal = body->m_orientation.RotatePoint( normal );
+		closestT = t;
+	}
+	return closestT;
+}
+
+/*
+====================================================
+PhysicsWorld::RayCastTree
+====================================================
+*/
+bool PhysicsWorld::RayCastTree( const rayCastQuery_t & query, queryHit_t & hit ) const {
+	hit = queryHit_t();
+
+	queryRayCast_t ray;
+	ray.world = this;
+	ray.query = &query;
+	ray.dir = query.end - query.start;
+	ray.hit = &hit;
+
+	RayCastBoundsTree( m_queryNodes, query.start, ray.dir, 1.0f, RayCastBodies, &ray );
+	return hit.DidHit();
+}
+
+/*
+====================================================
+queryPacketRayCast_t
+====================================================
+*/
+struct queryPacketRayCast_t {
+	const PhysicsWorld * world;
+	const rayCastQuery_t * queries;
+	queryHit_t * hits;
+};
+
+/*
+====================================================
+PhysicsWorld::RayCastBodiesPacket
+
+Casts the packet's live rays against the bodies in a leaf of the query tree.  Rays that
+filter out a body drop out of the packet for that body only.
+====================================================
+*/
+void PhysicsWorld::RayCastBodiesPacket( const int first, const int count, rayPacket_t & packet, const int laneMask, void * data ) {
+	queryPacketRayCast_t * ray = (queryPacketRayCast_t *)data;
+	const PhysicsWorld * world = ray->world;
+
+	for ( int slot = first; slot < first + count; slot++ ) {
+		const int bodyId = world->m_queryBodyIds[ slot ];
+		const Body * body = &world->m_bodyPool[ bodyId ];
+
+		// Shapes cast rays in model space
+		const Quat invOrient = body->m_orientation.Inverse();
+		rayPacket_t local;
+		local.laneMask = 0;
+		for ( int lane = 0; lane < 4; lane++ ) {
+			local.start[ lane ] = Vec3( 0.0f );
+			local.dir[ lane ] = Vec3( 0.0f );
+			local.maxT[ lane ] = 0.0f;
+			if ( 0 == ( laneMask & ( 1 << lane ) ) ) {
+				continue;
+			}
+			const rayCastQuery_t & query = ray->queries[ lane ];
+			if ( world->FilterQuery( body, query.contentsMask, query.ignoreBodyId ) ) {
+				continue;
+			}
+
+			local.start[ lane ] = invOrient.RotatePoint( query.start - body->m_position );
+			local.dir[ lane ] = invOrient.RotatePoint( packet.dir[ lane ] );
+			local.maxT[ lane ] = packet.maxT[ lane ];
+			local.laneMask |= ( 1 << lane );
+		}
+		if ( 0 == local.laneMask ) {
+			continue;
+		}
+
+		Vec3 normals[ 4 ];
+		const int hitMask = body->m_shape->RayCastPacket( local, normals );
+		for ( int lane = 0; lane < 4; lane++ ) {
+			if ( 0 == ( hitMask & ( 1 << lane ) ) ) {
+				continue;
+			}
+
+			const float t = local.maxT[ lane ];
+			queryHit_t & hit = ray->hits[ lane ];
+			hit.bodyId = bodyId;
+			hit.fraction = t;
+			hit.point = packet.start[ lane ] + packet.dir[ lane ] * t;
+			hit.normal = body->m_orientation.RotatePoint( normals[ lane ] );
+			packet.maxT[ lane ] = t;
+		}
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::RayCastPacketTree
+
+Traces up to four rays together.  Rays that head off in different directions share
+too few nodes to be worth it, so they're traced one at a time.
+====================================================
+*/
+void PhysicsWorld::RayCastPacketTree( const rayCastQuery_t * queries, queryHit_t * hits, const int num ) const {
+	assert( num > 0 && num <= 4 );
+
+	rayPacket_t packet;
+	packet.laneMask = 0;
+	for ( int lane = 0; lane < 4; lane++ ) {
+		// Unused lanes copy the first ray, so they don't widen the packet's frustum
+		const rayCastQuery_t & query = queries[ lane < num ? lane : 0 ];
+		packet.start[ lane ] = query.start;
+		packet.dir[ lane ] = query.end - query.start;
+		packet.maxT[ lane ] = 1.0f;
+		if ( lane < num ) {
+			packet.laneMask |= ( 1 << lane );
+			hits[ lane ] = queryHit_t();
+		}
+	}
+
+	if ( num < 2 || !IsCoherentPacket( packet ) ) {
+		for ( int i = 0; i < num; i++ ) {
+			RayCastTree( queries[ i ], hits[ i ] );
+		}
+		return;
+	}
+
+	queryPacketRayCast_t ray;
+	ray.world = this;
+	ray.queries = queries;
+	ray.hits = hits;
+	RayCastBoundsTreePacket( m_queryNodes, packet, RayCastBodiesPacket, &ray );
+}
+
+/*
+====================================================
+PhysicsWorld::SweepShapeTree
+
+Runs continuous collision between a body for the query shape, moving from start to end
+in one unit of time, and each body near the sweep.  Bodies are copied and held still,
+so other queries can run against the world at the same time.
+====================================================
+*/
+bool PhysicsWorld::SweepShapeTree( const sweepQuery_t & query, queryHit_t & hit, std::vector< int > & slots ) const {
+	hit = queryHit_t();
+	if ( !IsConvexQueryShape( query.shape ) ) {
+		assert( false );
+		return false;
+	}
+
+	Body sweepBody;
+	sweepBody.m_shape = (Shape *)query.shape;
+	sweepBody.m_position = query.start;
+	sweepBody.m_orientation = query.orientation;
+	sweepBody.m_linearVelocity = query.end - query.start;
+	sweepBody.m_angularVelocity.Zero();
+	sweepBody.m_enableRotation = false;
+
+	Bounds sweptBounds = query.shape->GetBounds( query.start, query.orientation );
+	sweptBounds.Expand( query.shape->GetBounds( query.end, query.orientation ) );
+
+	slots.clear();
+	QueryBoundsTree( m_queryNodes, sweptBounds, slots );
+
+	for ( int i = 0; i < slots.size(); i++ ) {
+		const int bodyId = m_queryBodyIds[ slots[ i ] ];
+		const Body * body = &m_bodyPool[ bodyId ];
+		if ( FilterQuery( body, query.contentsMask, query.ignoreBodyId ) ) {
+			continue;
+		}
+
+		Body target = *body;
+		target.m_linearVelocity.Zero();
+		target.m_angularVelocity.Zero();
+		target.m_enableRotation = false;
+
+		Body moving = sweepBody;
+		contact_t contact;
+		if ( !Intersect( &moving, &target, 1.0f, &contact, 1 ) ) {
+			continue;
+		}
+		if ( hit.DidHit() && contact.timeOfImpact >= hit.fraction ) {
+			continue;
+		}
+
+		// The contact normal points from B to A, which is out of the body that was hit
+		hit.bodyId = bodyId;
+		hit.fraction = contact.timeOfImpact;
+		hit.point = contact.ptOnB_WorldSpace;
+		hit.normal = contact.normal;
+	}
+
+	return hit.DidHit();
+}
+
+/*
+====================================================
+PhysicsWorld::OverlapTree
+====================================================
+*/
+int PhysicsWorld::OverlapTree( const overlapQuery_t & query, int * bodyIds, const int maxIds, std::vector< int > & slots ) const {
+	if ( !IsConvexQueryShape( query.shape ) ) {
+		assert( false );
+		return 0;
+	}
+
+	Body queryBody;
+	queryBody.m_shape = (Shape *)query.shape;
+	queryBody.m_position = query.position;
+	queryBody.m_orientation = query.orientation;
+
+	slots.clear();
+	QueryBoundsTree( m_queryNodes, query.shape->GetBounds( query.position, query.orientation ), slots );
+
+	int numIds = 0;
+	for ( int i = 0; i < slots.size() && numIds < maxIds; i++ ) {
+		const int bodyId = m_queryBodyIds[ slots[ i ] ];
+		const Body * body = &m_bodyPool[ bodyId ];
+		if ( FilterQuery( body, query.contentsMask, query.ignoreBodyId ) ) {
+			continue;
+		}
+
+		// The kernels don't change the bodies, they only take them as non-const for the contacts
+		contact_t contacts[ MAX_PAIR_CONTACTS ];
+		if ( NarrowPhase( &queryBody, (Body *)body, contacts, 1, NULL ) > 0 ) {
+			bodyIds[ numIds ] = bodyId;
+			numIds++;
+		}
+	}
+	return numIds;
+}
+
+/*
+====================================================
+PhysicsWorld::RayCast
+====================================================
+*/
+bool PhysicsWorld::RayCast( const rayCastQuery_t & query, queryHit_t & hit ) {
+	UpdateQueryTree();
+	return RayCastTree( query, hit );
+}
+
+/*
+====================================================
+PhysicsWorld::SweepShape
+====================================================
+*/
+bool PhysicsWorld::SweepShape( const sweepQuery_t & query, queryHit_t & hit ) {
+	UpdateQueryTree();
+	return SweepShapeTree( query, hit, m_querySlots );
+}
+
+/*
+====================================================
+PhysicsWorld::Overlap
+====================================================
+*/
+int PhysicsWorld::Overlap( const overlapQuery_t & query, int * bodyIds, const int maxIds ) {
+	UpdateQueryTree();
+	return OverlapTree( query, bodyIds, maxIds, m_querySlots );
+}
+
+/*
+====================================================
+PhysicsWorld::QueryBounds
+
+Only tests the bounds, the caller does its own narrowphase
+====================================================
+*/
+int PhysicsWorld::QueryBounds( const Bounds & bounds, const unsigned int contentsMask, int * bodyIds, const int maxIds ) {
+	UpdateQueryTree();
+
+	m_querySlots.clear();
+	QueryBoundsTree( m_queryNodes, bounds, m_querySlots );
+
+	int numIds = 0;
+	for ( int i = 0; i < m_querySlots.size() && numIds < maxIds; i++ ) {
+		const int bodyId = m_queryBodyIds[ m_querySlots[ i ] ];
+		if ( FilterQuery( &m_bodyPool[ bodyId ], contentsMask, -1 ) ) {
+			continue;
+		}
+
+		bodyIds[ numIds ] = bodyId;
+		numIds++;
+	}
+	return numIds;
+}
+
+/*
+========================================================================================================
+
+Batched Queries
+
+========================================================================================================
+*/
+
+/*
+====================================================
+queryBatch_t
+
+The jobs all read from the same query tree, so it's brought up to date before they start
+====================================================
+*/
+struct queryBatch_t {
+	const PhysicsWorld * world;
+	const void * queries;
+	queryHit_t * hits;
+	int * bodyIds;
+	int maxIdsPerQuery;
+	int * counts;
+};
+
+struct queryBatchJob_t {
+	const queryBatch_t * batch;
+	int queryIdx;
+	int numQueries;
+};
+
+/*
+====================================================
+PhysicsWorld::RayCastJob
+====================================================
+*/
+void PhysicsWorld::RayCastJob( Job_t * job, void * data ) {
+	queryBatchJob_t * jobs = (queryBatchJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		const queryBatch_t * batch = jobs[ i ].batch;
+		const int idx = jobs[ i ].queryIdx;
+		const rayCastQuery_t * queries = (const rayCastQuery_t *)batch->queries;
+		batch->world->RayCastPacketTree( queries + idx, batch->hits + idx, jobs[ i ].numQueries );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::SweepShapeJob
+
+The job's queries share one scratch list, it only allocates until it fits the largest of them
+====================================================
+*/
+void PhysicsWorld::SweepShapeJob( Job_t * job, void * data ) {
+	queryBatchJob_t * jobs = (queryBatchJob_t *)job->m_data;
+	std::vector< int > slots;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		const queryBatch_t * batch = jobs[ i ].batch;
+		const int idx = jobs[ i ].queryIdx;
+		const sweepQuery_t * queries = (const sweepQuery_t *)batch->queries;
+		batch->world->SweepShapeTree( queries[ idx ], batch->hits[ idx ], slots );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::OverlapJob
+====================================================
+*/
+void PhysicsWorld::OverlapJob( Job_t * job, void * data ) {
+	queryBatchJob_t * jobs = (queryBatchJob_t *)job->m_data;
+	std::vector< int > slots;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		const queryBatch_t * batch = jobs[ i ].batch;
+		const int idx = jobs[ i ].queryIdx;
+		const overlapQuery_t * queries = (const overlapQuery_t *)batch->queries;
+		int * bodyIds = batch->bodyIds + idx * batch->maxIdsPerQuery;
+		batch->counts[ idx ] = batch->world->OverlapTree( queries[ idx ], bodyIds, batch->maxIdsPerQuery, slots );
+	}
+}
+
+/*
+====================================================
+RunQueryBatch
+
+Each job element handles queriesPerJob consecutive queries
+====================================================
+*/
+static void RunQueryBatch( JobFunction_t * fn, const queryBatch_t & batch, const int numQueries, const int queriesPerJob ) {
+	const int num = ( numQueries + queriesPerJob - 1 ) / queriesPerJob;
+	std::vector< queryBatchJob_t > jobs( num );
+	for ( int i = 0; i < num; i++ ) {
+		jobs[ i ].batch = &batch;
+		jobs[ i ].queryIdx = i * queriesPerJob;
+		jobs[ i ].numQueries = std::min( queriesPerJob, numQueries - jobs[ i ].queryIdx );
+	}
+
+	if ( NULL != g_jobSystem && num > 1 ) {
+		g_jobSystem->ParallelFor( fn, jobs.data(), sizeof( queryBatchJob_t ), num );
+		g_jobSystem->Wait( NULL );
+	} else {
+		Job_t job;
+		job.m_functor = fn;
+		job.m_data = jobs.data();
+		job.m_numElements = num;
+		job.m_parent = NULL;
+		job.m_unfinishedJobs = 0;
+		fn( &job, NULL );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::RayCastBatch
+====================================================
+*/
+void PhysicsWorld::RayCastBatch( const rayCastQuery_t * queries, queryHit_t * hits, const int num ) {
+	if ( num <= 0 ) {
+		return;
+	}
+	UpdateQueryTree();
+
+	queryBatch_t batch;
+	batch.world = this;
+	batch.queries = queries;
+	batch.hits = hits;
+	batch.bodyIds = NULL;
+	batch.maxIdsPerQuery = 0;
+	batch.counts = NULL;
+	RunQueryBatch( RayCastJob, batch, num, 4 );
+}
+
+/*
+====================================================
+PhysicsWorld::SweepShapeBatch
+====================================================
+*/
+void PhysicsWorld::SweepShapeBatch( const sweepQuery_t * queries, queryHit_t * hits, const int num ) {
+	if ( num <= 0 ) {
+		return;
+	}
+	UpdateQueryTree();
+
+	queryBatch_t batch;
+	batch.world = this;
+	batch.queries = queries;
+	batch.hits = hits;
+	batch.bodyIds = NULL;
+	batch.maxIdsPerQuery = 0;
+	batch.counts = NULL;
+	RunQueryBatch( SweepShapeJob, batch, num, 1 );
+}
+
+/*
+====================================================
+PhysicsWorld::OverlapBatch
+====================================================
+*/
+void PhysicsWorld::OverlapBatch( const overlapQuery_t * queries, const int num, int * bodyIds, const int maxIdsPerQuery, int * counts ) {
+	if ( num <= 0 ) {
+		return;
+	}
+	UpdateQueryTree();
+
+	queryBatch_t batch;
+	batch.world = this;
+	batch.queries = queries;
+	batch.hits = NULL;
+	batch.bodyIds = bodyIds;
+	batch.maxIdsPerQuery = maxIdsPerQuery;
+	batch.counts = counts;
+	RunQueryBatch( OverlapJob, batch, num, 1 );
+}
@@ -0,0 +1,81 @@
+//
+//	PhysicsQueries.h
+//
+#pragma once
+#include "Math/Vector.h"
+#include "Math/Quat.h"
+#include "Physics/Body.h"
+
+class Shape;
+
+/*
+====================================================
+rayCastQuery_t
+
+Traces the segment from start to end.  Only bodies whose contents overlap the mask are hit.
+====================================================
+*/
+struct rayCastQuery_t {
+	rayCastQuery_t() : start( 0.0f ), end( 0.0f ), contentsMask( BC_ALL ), ignoreBodyId( -1 ) {}
+
+	Vec3 start;
+	Vec3 end;
+	unsigned int contentsMask;
+	int ignoreBodyId;	// usually the body doing the tracing, -1 to ignore nothing
+};
+
+/*
+====================================================
+sweepQuery_t
+
+Moves the shape from start to end without rotating it.  The shape has to be convex,
+so a sphere, box, capsule or convex hull, and is placed by its model space origin.
+====================================================
+*/
+struct sweepQuery_t {
+	sweepQuery_t() : shape( NULL ), orientation( 0, 0, 0, 1 ), start( 0.0f ), end( 0.0f ), contentsMask( BC_ALL ), ignoreBodyId( -1 ) {}
+
+	const Shape * shape;
+	Quat orientation;
+	Vec3 start;
+	Vec3 end;
+	unsigned int contentsMask;
+	int ignoreBodyId;
+};
+
+/*
+====================================================
+overlapQuery_t
+
+Finds the bodies touching the shape, the shape has to be convex.
+====================================================
+*/
+struct overlapQuery_t {
+	overlapQuery_t() : shape( NULL ), position( 0.0f ), orientation( 0, 0, 0, 1 ), contentsMask( BC_ALL ), ignoreBodyId( -1 ) {}
+
+	const Shape * shape;
+	Vec3 position;
+	Quat orientation;
+	unsigned int contentsMask;
+	int ignoreBodyId;
+};
+
+/*
+====================================================
+queryHit_t
+
+The first thing a ray or sweep touched.  Fraction is how far along the query it got,
+zero when the sweep started out overlapping.  The normal is the surface normal of the
+body that was hit.  A miss has a bodyId of -1 and a fraction of one.
+====================================================
+*/
+struct queryHit_t {
+	queryHit_t() : bodyId( -1 ), fraction( 1.0f ), point( 0.0f ), normal( 0.0f ) {}
+
+	bool DidHit() const { return bodyId >= 0; }
+
+	int bodyId;
+	float fraction;
+	Vec3 point;
+	Vec3 normal;
+};
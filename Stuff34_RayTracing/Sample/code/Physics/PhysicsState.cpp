@@ -0,0 +1,488 @@
+//
+//  PhysicsState.cpp
+//
+#include "Physics/PhysicsWorld.h"
+#include "Physics/PhysicsState.h"
+#include <string.h>
+#include <algorithm>
+
+/*
+====================================================
+WriteState
+
+The snapshot is sized up front, so writing is only a copy
+====================================================
+*/
+static void WriteState( unsigned char *& data, const void * src, const int size ) {
+	memcpy( data, src, size );
+	data += size;
+}
+
+/*
+====================================================
+ReadState
+
+Returns false if the snapshot is too short
+====================================================
+*/
+static bool ReadState( const unsigned char *& data, const unsigned char * end, void * dst, const int size ) {
+	if ( end - data < size ) {
+		return false;
+	}
+	memcpy( dst, data, size );
+	data += size;
+	return true;
+}
+
+/*
+====================================================
+SkipState
+
+Returns false if the snapshot is too short
+====================================================
+*/
+static bool SkipState( const unsigned char *& data, const unsigned char * end, const int size ) {
+	if ( size < 0 || end - data < size ) {
+		return false;
+	}
+	data += size;
+	return true;
+}
+
+/*
+====================================================
+IsManifoldHeaderValid
+====================================================
+*/
+static bool IsManifoldHeaderValid( const manifoldStateHeader_t & header ) {
+	return ( header.numSlots >= 0 && header.numActive >= 0 && header.numFree >= 0 && header.numActive + header.numFree == header.numSlots );
+}
+
+/*
+====================================================
+IsManifoldRecordValid
+
+A manifold's bodies have to be two different used bodies
+====================================================
+*/
+static bool IsManifoldRecordValid( const manifoldState_t & record, const int numSlots, const bool * isUsedBody, const int maxBodies, const int maxContacts ) {
+	return ( record.slot >= 0 && record.slot < numSlots )
+		&& ( record.bodyA >= 0 && record.bodyA < maxBodies && record.bodyB >= 0 && record.bodyB < maxBodies )
+		&& ( record.bodyA != record.bodyB && isUsedBody[ record.bodyA ] && isUsedBody[ record.bodyB ] )
+		&& ( record.cacheBodyA >= -1 && record.cacheBodyA < maxBodies )
+		&& ( record.cacheNumPts >= 0 && record.cacheNumPts <= 4 )
+		&& ( record.numContacts >= 0 && record.numContacts <= maxContacts );
+}
+
+/*
+====================================================
+ManifoldCollector::GetStateSize
+====================================================
+*/
+int ManifoldCollector::GetStateSize() const {
+	int size = sizeof( manifoldStateHeader_t ) + (int)m_freeSlots.size() * sizeof( int );
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		size += sizeof( manifoldState_t ) + m_manifolds[ m_activeSlots[ i ] ].m_numContacts * sizeof( contactState_t );
+	}
+	return size;
+}
+
+/*
+====================================================
+ManifoldCollector::SaveState
+====================================================
+*/
+void ManifoldCollector::SaveState( unsigned char *& data, const Body * bodyPool ) const {
+	manifoldStateHeader_t header;
+	header.numSlots = (int)m_manifolds.size();
+	header.numActive = (int)m_activeSlots.size();
+	header.numFree = (int)m_freeSlots.size();
+	header.frame = m_frame;
+	WriteState( data, &header, sizeof( header ) );
+	WriteState( data, m_freeSlots.data(), header.numFree * sizeof( int ) );
+
+	for ( int i = 0; i < m_activeSlots.size(); i++ ) {
+		const Manifold & manifold = m_manifolds[ m_activeSlots[ i ] ];
+		const gjkCache_t & cache = manifold.m_gjkCache;
+
+		manifoldState_t record;
+		record.slot = m_activeSlots[ i ];
+		record.bodyA = (int)( manifold.m_bodyA - bodyPool );
+		record.bodyB = (int)( manifold.m_bodyB - bodyPool );
+		record.numContacts = manifold.m_numContacts;
+		record.lastQueryFrame = manifold.m_lastQueryFrame;
+		record.cacheBodyA = ( NULL == cache.bodyA ) ? -1 : (int)( cache.bodyA - bodyPool );
+		record.cacheNumPts = cache.numPts;
+		record.cacheHasAxis = cache.hasAxis ? 1 : 0;
+		record.cacheSeparation = cache.separation;
+		record.cacheAxis = cache.axis;
+		for ( int j = 0; j < 4; j++ ) {
+			record.cacheSimplexA[ j ] = cache.simplexA[ j ];
+			record.cacheSimplexB[ j ] = cache.simplexB[ j ];
+		}
+		WriteState( data, &record, sizeof( record ) );
+
+		for ( int j = 0; j < manifold.m_numContacts; j++ ) {
+			const contact_t & contact = manifold.m_contacts[ j ];
+			const ConstraintPenetration & constraint = manifold.m_constraints[ j ];
+
+			contactState_t contactState;
+			contactState.ptOnA_WorldSpace = contact.ptOnA_WorldSpace;
+			contactState.ptOnB_WorldSpace = contact.ptOnB_WorldSpace;
+			contactState.ptOnA_LocalSpace = contact.ptOnA_LocalSpace;
+			contactState.ptOnB_LocalSpace = contact.ptOnB_LocalSpace;
+			contactState.normal = contact.normal;
+			contactState.separationDistance = contact.separationDistance;
+			contactState.timeOfImpact = contact.timeOfImpact;
+			contactState.constraintNormal = constraint.m_normal;
+			for ( int k = 0; k < 3; k++ ) {
+				contactState.cachedLambda[ k ] = constraint.m_cachedLambda[ k ];
+			}
+			WriteState( data, &contactState, sizeof( contactState ) );
+		}
+	}
+}
+
+/*
+====================================================
+ManifoldCollector::RestoreState
+
+Returns false if the snapshot is bad, the manifolds are then cleared
+====================================================
+*/
+bool ManifoldCollector::RestoreState( const unsigned char *& data, const unsigned char * end, Body * bodyPool, const bool * isUsedBody, const int maxBodies ) {
+	const unsigned char * check = data;
+	if ( !IsStateValid( check, end, isUsedBody, maxBodies ) ) {
+		Clear();
+		return false;
+	}
+
+	manifoldStateHeader_t header;
+	if ( !ReadState( data, end, &header, sizeof( header ) ) ) {
+		Clear();
+		return false;
+	}
+	if ( !IsManifoldHeaderValid( header ) ) {
+		Clear();
+		return false;
+	}
+
+	m_manifolds.resize( header.numSlots );
+	m_freeSlots.resize( header.numFree );
+	if ( !ReadState( data, end, m_freeSlots.data(), header.numFree * sizeof( int ) ) ) {
+		Clear();
+		return false;
+	}
+	m_frame = header.frame;
+
+	for ( int i = 0; i < header.numFree; i++ ) {
+		if ( m_freeSlots[ i ] < 0 || m_freeSlots[ i ] >= header.numSlots ) {
+			Clear();
+			return false;
+		}
+	}
+
+	// Size the table up front, so it doesn't grow while the manifolds are inserted
+	int tableSize = 64;
+	while ( 2 * ( header.numActive + 1 ) > tableSize ) {
+		tableSize *= 2;
+	}
+	hashEntry_t empty;
+	empty.bodyA = NULL;
+	empty.bodyB = NULL;
+	empty.slot = -1;
+	m_table.assign( tableSize, empty );
+	m_numTableEntries = 0;
+	m_activeSlots.clear();
+
+	for ( int i = 0; i < header.numActive; i++ ) {
+		manifoldState_t record;
+		if ( !ReadState( data, end, &record, sizeof( record ) ) ) {
+			Clear();
+			return false;
+		}
+		if ( !IsManifoldRecordValid( record, header.numSlots, isUsedBody, maxBodies, Manifold::MAX_CONTACTS ) ) {
+			Clear();
+			return false;
+		}
+
+		Manifold & manifold = m_manifolds[ record.slot ];
+		manifold.m_bodyA = bodyPool + record.bodyA;
+		manifold.m_bodyB = bodyPool + record.bodyB;
+		manifold.m_numContacts = record.numContacts;
+		manifold.m_lastQueryFrame = record.lastQueryFrame;
+
+		gjkCache_t & cache = manifold.m_gjkCache;
+		cache.bodyA = ( record.cacheBodyA < 0 ) ? NULL : bodyPool + record.cacheBodyA;
+		cache.numPts = record.cacheNumPts;
+		cache.hasAxis = ( 0 != record.cacheHasAxis );
+		cache.separation = record.cacheSeparation;
+		cache.axis = record.cacheAxis;
+		for ( int j = 0; j < 4; j++ ) {
+			cache.simplexA[ j ] = record.cacheSimplexA[ j ];
+			cache.simplexB[ j ] = record.cacheSimplexB[ j ];
+		}
+
+		for ( int j = 0; j < record.numContacts; j++ ) {
+			contactState_t contactState;
+			if ( !ReadState( data, end, &contactState, sizeof( contactState ) ) ) {
+				Clear();
+				return false;
+			}
+
+			contact_t & contact = manifold.m_contacts[ j ];
+			contact.ptOnA_WorldSpace = contactState.ptOnA_WorldSpace;
+			contact.ptOnB_WorldSpace = contactState.ptOnB_WorldSpace;
+			contact.ptOnA_LocalSpace = contactState.ptOnA_LocalSpace;
+			contact.ptOnB_LocalSpace = contactState.ptOnB_LocalSpace;
+			contact.normal = contactState.normal;
+			contact.separationDistance = contactState.separationDistance;
+			contact.timeOfImpact = contactState.timeOfImpact;
+			contact.bodyA = manifold.m_bodyA;
+			contact.bodyB = manifold.m_bodyB;
+
+			ConstraintPenetration & constraint = manifold.m_constraints[ j ];
+			constraint.m_bodyA = manifold.m_bodyA;
+			constraint.m_bodyB = manifold.m_bodyB;
+			constraint.m_anchorA = contact.ptOnA_LocalSpace;
+			constraint.m_anchorB = contact.ptOnB_LocalSpace;
+			constraint.m_normal = contactState.constraintNormal;
+			for ( int k = 0; k < 3; k++ ) {
+				constraint.m_cachedLambda[ k ] = contactState.cachedLambda[ k ];
+			}
+		}
+
+		// The table stores pairs in address order
+		const Body * orderedA = ( manifold.m_bodyA < manifold.m_bodyB ) ? manifold.m_bodyA : manifold.m_bodyB;
+		const Body * orderedB = ( manifold.m_bodyA < manifold.m_bodyB ) ? manifold.m_bodyB : manifold.m_bodyA;
+		InsertEntry( orderedA, orderedB, record.slot );
+		m_activeSlots.push_back( record.slot );
+	}
+	return true;
+}
+
+/*
+====================================================
+ManifoldCollector::IsStateValid
+
+Walks the snapshot without restoring it, so a bad one can be turned away before anything is changed.
+Every slot has to be either free or active exactly once, and a body pair can only have one manifold,
+otherwise the hash table and the free list would hand out slots that are still in use.
+====================================================
+*/
+bool ManifoldCollector::IsStateValid( const unsigned char *& data, const unsigned char * end, const bool * isUsedBody, const int maxBodies ) {
+	manifoldStateHeader_t header;
+	if ( !ReadState( data, end, &header, sizeof( header ) ) || !IsManifoldHeaderValid( header ) ) {
+		return false;
+	}
+	// Every slot takes at least an int, so a count the snapshot can't hold is turned away before it's allocated for
+	if ( header.numSlots > ( end - data ) / (int)sizeof( int ) ) {
+		return false;
+	}
+
+	std::vector< bool > isSeen( header.numSlots, false );
+	for ( int i = 0; i < header.numFree; i++ ) {
+		int slot;
+		if ( !ReadState( data, end, &slot, sizeof( int ) ) || slot < 0 || slot >= header.numSlots || isSeen[ slot ] ) {
+			return false;
+		}
+		isSeen[ slot ] = true;
+	}
+
+	std::vector< unsigned long long > pairs;
+	pairs.reserve( header.numActive );
+	for ( int i = 0; i < header.numActive; i++ ) {
+		manifoldState_t record;
+		if ( !ReadState( data, end, &record, sizeof( record ) ) || !IsManifoldRecordValid( record, header.numSlots, isUsedBody, maxBodies, Manifold::MAX_CONTACTS ) ) {
+			return false;
+		}
+		if ( isSeen[ record.slot ] ) {
+			return false;
+		}
+		isSeen[ record.slot ] = true;
+
+		const unsigned long long lower = std::min( record.bodyA, record.bodyB );
+		const unsigned long long upper = std::max( record.bodyA, record.bodyB );
+		pairs.push_back( ( lower << 32 ) | upper );
+
+		if ( !SkipState( data, end, record.numContacts * (int)sizeof( contactState_t ) ) ) {
+			return false;
+		}
+	}
+
+	std::sort( pairs.begin(), pairs.end() );
+	return ( pairs.end() == std::adjacent_find( pairs.begin(), pairs.end() ) );
+}
+
+/*
+====================================================
+PhysicsWorld::SaveState
+
+The state is written over, so reusing the same buffer avoids allocating every snapshot
+====================================================
+*/
+void PhysicsWorld::SaveState( std::vector< unsigned char > & state ) const {
+	int size = sizeof( physicsStateHeader_t ) + m_maxBodies * sizeof( int ) + m_numUsedBodies * sizeof( Body );
+	for ( int i = 0; i < m_constraints.size(); i++ ) {
+		const VecN * lambda = m_constraints[ i ]->GetCachedLambda();
+		size += sizeof( int ) + ( ( NULL == lambda ) ? 0 : lambda->N * sizeof( float ) );
+	}
+	size += m_manifolds.GetStateSize();
+	state.resize( size );
+	unsigned char * data = state.data();
+
+	physicsStateHeader_t header;
+	header.magic = PHYSICS_STATE_MAGIC;
+	header.version = PHYSICS_STATE_VERSION;
+	header.maxBodies = m_maxBodies;
+	header.numUsedBodies = m_numUsedBodies;
+	header.numConstraints = (int)m_constraints.size();
+	header.accumulator = m_accumulator;
+	WriteState( data, &header, sizeof( header ) );
+
+	// The list orders decide which ids get allocated next and the broadphase's pair order,
+	// so they're part of the state
+	int * ids = (int *)data;
+	int numIds = 0;
+	for ( const BodyPoolNode_t * node = m_usedNodes; NULL != node; node = node->m_next ) {
+		ids[ numIds++ ] = node->bodyID;
+	}
+	for ( const BodyPoolNode_t * node = m_freeNodes; NULL != node; node = node->m_next ) {
+		ids[ numIds++ ] = node->bodyID;
+	}
+	assert( m_maxBodies == numIds );
+	data += numIds * sizeof( int );
+
+	for ( int i = 0; i < m_numUsedBodies; i++ ) {
+		WriteState( data, &m_bodyPool[ ids[ i ] ], sizeof( Body ) );
+	}
+
+	for ( int i = 0; i < m_constraints.size(); i++ ) {
+		const VecN * lambda = m_constraints[ i ]->GetCachedLambda();
+		const int num = ( NULL == lambda ) ? 0 : lambda->N;
+		WriteState( data, &num, sizeof( int ) );
+		if ( num > 0 ) {
+			WriteState( data, lambda->data, num * sizeof( float ) );
+		}
+	}
+
+	m_manifolds.SaveState( data, m_bodyPool );
+	assert( data == state.data() + state.size() );
+}
+
+/*
+====================================================
+PhysicsWorld::RestoreState
+
+The world must have the same joints registered as when the state was saved.
+The whole snapshot is checked before anything is changed, so a bad one leaves the world as it was.
+====================================================
+*/
+bool PhysicsWorld::RestoreState( const std::vector< unsigned char > & state ) {
+	const unsigned char * data = state.data();
+	const unsigned char * end = data + state.size();
+
+	physicsStateHeader_t header;
+	if ( !ReadState( data, end, &header, sizeof( header ) ) ) {
+		printf( "WARNING: PhysicsWorld: physics state is too short\n" );
+		return false;
+	}
+	const bool isValid = ( PHYSICS_STATE_MAGIC == header.magic )
+		&& ( PHYSICS_STATE_VERSION == header.version )
+		&& ( m_maxBodies == header.maxBodies )
+		&& ( header.numUsedBodies >= 0 && header.numUsedBodies <= m_maxBodies )
+		&& ( (int)m_constraints.size() == header.numConstraints );
+	if ( !isValid ) {
+		printf( "WARNING: PhysicsWorld: physics state doesn't match this world\n" );
+		return false;
+	}
+
+	int ids[ m_maxBodies ];
+	if ( !ReadState( data, end, ids, m_maxBodies * sizeof( int ) ) ) {
+		printf( "WARNING: PhysicsWorld: physics state is too short\n" );
+		return false;
+	}
+	// Every id has to be there exactly once, a repeated one would link the pool lists into a cycle
+	bool isSeen[ m_maxBodies ];
+	memset( isSeen, 0, sizeof( isSeen ) );
+	for ( int i = 0; i < m_maxBodies; i++ ) {
+		if ( ids[ i ] < 0 || ids[ i ] >= m_maxBodies || isSeen[ ids[ i ] ] ) {
+			printf( "WARNING: PhysicsWorld: physics state has a bad body id\n" );
+			return false;
+		}
+		isSeen[ ids[ i ] ] = true;
+	}
+	bool isUsedBody[ m_maxBodies ];
+	memset( isUsedBody, 0, sizeof( isUsedBody ) );
+	for ( int i = 0; i < header.numUsedBodies; i++ ) {
+		isUsedBody[ ids[ i ] ] = true;
+	}
+
+	// Walk the rest of the snapshot before touching the pool
+	const unsigned char * check = data;
+	bool isComplete = SkipState( check, end, header.numUsedBodies * (int)sizeof( Body ) );
+	for ( int i = 0; i < m_constraints.size() && isComplete; i++ ) {
+		const VecN * lambda = m_constraints[ i ]->GetCachedLambda();
+		int num = 0;
+		isComplete = ReadState( check, end, &num, sizeof( int ) )
+			&& ( num == ( ( NULL == lambda ) ? 0 : lambda->N ) )
+			&& SkipState( check, end, num * (int)sizeof( float ) );
+	}
+	if ( !isComplete || !ManifoldCollector::IsStateValid( check, end, isUsedBody, m_maxBodies ) ) {
+		printf( "WARNING: PhysicsWorld: physics state is corrupt\n" );
+		return false;
+	}
+
+	// Relink the pool in the saved order, the first numUsedBodies ids are the used list.
+	// The used bodies are about to be copied over, so only the free ones need resetting.
+	for ( int i = 0; i < m_maxBodies; i++ ) {
+		if ( i >= header.numUsedBodies ) {
+			m_bodyPool[ ids[ i ] ].Reset();
+		}
+
+		BodyPoolNode_t * node = &m_bodyPoolNodes[ ids[ i ] ];
+		const bool isLast = ( i == header.numUsedBodies - 1 ) || ( i == m_maxBodies - 1 );
+		node->m_next = isLast ? NULL : &m_bodyPoolNodes[ ids[ i + 1 ] ];
+	}
+	m_numUsedBodies = header.numUsedBodies;
+	m_usedNodes = ( m_numUsedBodies > 0 ) ? &m_bodyPoolNodes[ ids[ 0 ] ] : NULL;
+	m_freeNodes = ( m_numUsedBodies < m_maxBodies ) ? &m_bodyPoolNodes[ ids[ m_numUsedBodies ] ] : NULL;
+
+	for ( int i = 0; i < m_numUsedBodies && isComplete; i++ ) {
+		isComplete = ReadState( data, end, &m_bodyPool[ ids[ i ] ], sizeof( Body ) );
+	}
+
+	for ( int i = 0; i < m_constraints.size() && isComplete; i++ ) {
+		VecN * lambda = m_constraints[ i ]->GetCachedLambda();
+		int num = 0;
+		isComplete = ReadState( data, end, &num, sizeof( int ) );
+		if ( !isComplete || num != ( ( NULL == lambda ) ? 0 : lambda->N ) ) {
+			isComplete = false;
+			break;
+		}
+		if ( num > 0 ) {
+			isComplete = ReadState( data, end, lambda->data, num * sizeof( float ) );
+		}
+	}
+
+	// The checks above make this unreachable, but a half restored world must not be left behind
+	if ( !isComplete || !m_manifolds.RestoreState( data, end, m_bodyPool, isUsedBody, m_maxBodies ) ) {
+		printf( "WARNING: PhysicsWorld: physics state is corrupt\n" );
+		const std::vector< Constraint * > constraints = m_constraints;
+		const std::vector< Articulation * > articulations = m_articulations;
+		m_manifolds.Clear();
+		Reset();
+		m_constraints = constraints;
+		m_articulations = articulations;
+		return false;
+	}
+
+	// Rendering starts from the restored transforms, rather than blending from where the world was
+	m_accumulator = header.accumulator;
+	for ( int i = 0; i < m_numUsedBodies; i++ ) {
+		m_prevPositions[ ids[ i ] ] = m_bodyPool[ ids[ i ] ].m_position;
+		m_prevOrientations[ ids[ i ] ] = m_bodyPool[ ids[ i ] ].m_orientation;
+	}
+	m_queryTreeDirty = true;
+	return true;
+}
@@ -0,0 +1,69 @@
+//
+//	PhysicsState.h
+//
+#pragma once
+#include "Math/Vector.h"
+
+/*
+========================================================================================================
+
+World State
+
+A snapshot is a header followed by the body pool's used and free lists, the used bodies, the
+joints' warm start impulses and the manifolds.  Bodies are referenced by their pool index, so
+a snapshot can be restored into any world with the same joints registered.  Shapes, owners and
+callbacks are stored as pointers, so snapshots only make sense inside the process that saved them.
+Bump PHYSICS_STATE_VERSION whenever the layout changes.
+
+========================================================================================================
+*/
+
+#define PHYSICS_STATE_MAGIC 0x53594850	// "PHYS"
+#define PHYSICS_STATE_VERSION 1
+
+struct physicsStateHeader_t {
+	unsigned int magic;
+	unsigned int version;
+	int maxBodies;
+	int numUsedBodies;
+	int numConstraints;
+	float accumulator;
+};
+
+struct manifoldStateHeader_t {
+	int numSlots;
+	int numActive;
+	int numFree;
+	int frame;
+};
+
+// Followed by numContacts contactState_t
+struct manifoldState_t {
+	int slot;
+	int bodyA;
+	int bodyB;
+	int numContacts;
+	int lastQueryFrame;
+
+	int cacheBodyA;		// -1 for an empty cache
+	int cacheNumPts;
+	int cacheHasAxis;
+	float cacheSeparation;
+	Vec3 cacheAxis;
+	Vec3 cacheSimplexA[ 4 ];
+	Vec3 cacheSimplexB[ 4 ];
+};
+
+// The constraint's anchors are the contact's local points, so they aren't stored twice
+struct contactState_t {
+	Vec3 ptOnA_WorldSpace;
+	Vec3 ptOnB_WorldSpace;
+	Vec3 ptOnA_LocalSpace;
+	Vec3 ptOnB_LocalSpace;
+	Vec3 normal;
+	float separationDistance;
+	float timeOfImpact;
+
+	Vec3 constraintNormal;
+	float cachedLambda[ 3 ];
+};
@@ -0,0 +1,65 @@
+//
+//	PhysicsStats.cpp
+//
+#include "Physics/PhysicsStats.h"
+#include "Threading/Atomics.h"
+#include <stdio.h>
+#include <string.h>
+
+// Each set of counters gets its own cache line, so the threads don't fight over them
+struct alignas( 64 ) threadCounters_t {
+	physicsCounters_t counters;
+};
+
+static const int MAX_COUNTER_THREADS = 64;
+static threadCounters_t s_threadCounters[ MAX_COUNTER_THREADS ];
+static long s_numThreadCounters = 0;
+static thread_local int s_threadCounterIdx = -1;
+
+/*
+====================================================
+GetPhysicsCounters
+====================================================
+*/
+physicsCounters_t & GetPhysicsCounters() {
+	if ( s_threadCounterIdx < 0 ) {
+		const int idx = Atomics::Increment( s_numThreadCounters ) - 1;
+		if ( idx >= MAX_COUNTER_THREADS ) {
+			// Extra threads share the last slot, their counts might be a little off
+			printf( "WARNING: GetPhysicsCounters: more than %i threads\n", MAX_COUNTER_THREADS );
+			s_threadCounterIdx = MAX_COUNTER_THREADS - 1;
+		} else {
+			s_threadCounterIdx = idx;
+		}
+	}
+	return s_threadCounters[ s_threadCounterIdx ].counters;
+}
+
+/*
+====================================================
+ResetPhysicsCounters
+====================================================
+*/
+void ResetPhysicsCounters() {
+	memset( s_threadCounters, 0, sizeof( s_threadCounters ) );
+}
+
+/*
+====================================================
+SumPhysicsCounters
+====================================================
+*/
+void SumPhysicsCounters( physicsCounters_t & total ) {
+	memset( &total, 0, sizeof( total ) );
+
+	int num = (int)s_numThreadCounters;
+	if ( num > MAX_COUNTER_THREADS ) {
+		num = MAX_COUNTER_THREADS;
+	}
+	for ( int i = 0; i < num; i++ ) {
+		const physicsCounters_t & counters = s_threadCounters[ i ].counters;
+		total.numGjkCalls += counters.numGjkCalls;
+		total.numEpaCalls += counters.numEpaCalls;
+		total.numBytesAllocated += counters.numBytesAllocated;
+	}
+}
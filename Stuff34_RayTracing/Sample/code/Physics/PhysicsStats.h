@@ -0,0 +1,23 @@
+//
+//	PhysicsStats.h
+//
+#pragma once
+
+/*
+====================================================
+physicsCounters_t
+
+Counters bumped from deep inside the collision code, which can be running on any of the
+job threads.  Every thread gets its own copy, so counting is just an increment, and
+PhysicsWorld adds them all up at the end of a step.
+====================================================
+*/
+struct physicsCounters_t {
+	int numGjkCalls;
+	int numEpaCalls;
+	int numBytesAllocated;	// heap allocations made while stepping
+};
+
+physicsCounters_t & GetPhysicsCounters();	// the calling thread's counters
+void ResetPhysicsCounters();				// don't call these while jobs are running
+void SumPhysicsCounters( physicsCounters_t & total );
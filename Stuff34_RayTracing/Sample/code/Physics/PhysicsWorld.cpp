@@ -3,7 +3,12 @@
 //
 #include "Physics/PhysicsWorld.h"
 #include "Physics/Intersections.h"
+#include "Physics/NarrowPhase.h"
 #include "Physics/BroadPhase.h"
+#include "Physics/PhysicsStats.h"
+#include "Physics/Articulation.h"
+#include "JobSystem/JobSystem.h"
+#include "Miscellaneous/Time.h"
 
 PhysicsWorld * g_physicsWorld = NULL;
 
@@ -13,6 +18,8 @@ PhysicsWorld::PhysicsWorld
 ====================================================
 */
 PhysicsWorld::PhysicsWorld() {
+	m_fixedTimeStep = 1.0f / 60.0f;
+	m_maxStepsPerUpdate = 4;
 	Reset();	
 }
 PhysicsWorld::~PhysicsWorld() {
@@ -30,6 +37,7 @@ void PhysicsWorld::Reset() {
 // 		delete m_constraints[ i ];
 // 	}
 	m_constraints.clear();
+	m_articulations.clear();
 
 	// Initialize the free pool linked list
 	m_freeNodes = &m_bodyPoolNodes[ 0 ];
@@ -48,6 +56,12 @@ void PhysicsWorld::Reset() {
 	// Initialize the used node linked list
 	m_usedNodes = NULL;
 	m_numUsedBodies = 0;
+
+	m_accumulator = 0.0f;
+	m_queryTreeDirty = true;
+	m_prevNumSubsteps = 0;
+	m_warmStartScale = 1.0f;
+	m_broadPhase.Clear();
 }
 
 /*
@@ -77,6 +91,9 @@ bodyID_t PhysicsWorld::AllocateBody( Body body ) {
 	bodyid.body = GetBody( bodyid.id );
 	*bodyid.body = body;
 	bodyid.body->m_isUsed = true;
+	m_prevPositions[ bodyid.id ] = body.m_position;
+	m_prevOrientations[ bodyid.id ] = body.m_orientation;
+	m_queryTreeDirty = true;
 	return bodyid;
 }
 
@@ -144,6 +161,7 @@ void PhysicsWorld::FreeBody( const int bodyID ) {
 
 	// Flag the body as unused so that any manifolds will clear themselves
 	m_bodyPool[ bodyID ].Reset();
+	m_queryTreeDirty = true;
 
 	// If the head is the node to be removed, then we need to move the head
 	if ( bodyID == m_usedNodes->bodyID ) {
@@ -221,6 +239,29 @@ void PhysicsWorld::UnRegisterConstraint( Constraint * constraint ) {
 	}
 }
 
+/*
+====================================================
+PhysicsWorld::RegisterArticulation
+====================================================
+*/
+void PhysicsWorld::RegisterArticulation( Articulation * articulation ) {
+	m_articulations.push_back( articulation );
+}
+
+/*
+====================================================
+PhysicsWorld::UnRegisterArticulation
+====================================================
+*/
+void PhysicsWorld::UnRegisterArticulation( Articulation * articulation ) {
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		if ( articulation == m_articulations[ i ] ) {
+			m_articulations.erase( m_articulations.begin() + i );
+			break;
+		}
+	}
+}
+
 /*
 ====================================================
 PhysicsWorld::UpdateBodies
@@ -256,6 +297,32 @@ void PhysicsWorld::ApplyGravity( const float dt_sec ) {
 	}
 }
 
+/*
+====================================================
+PhysicsWorld::IntegrateArticulationVelocities
+
+Articulations run their own forward dynamics, gravity included
+====================================================
+*/
+void PhysicsWorld::IntegrateArticulationVelocities( const float dt_sec ) {
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		m_articulations[ i ]->IntegrateVelocities( dt_sec );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::IntegrateArticulationPositions
+
+The link bodies were moved like any other body, this puts them back on their joints
+====================================================
+*/
+void PhysicsWorld::IntegrateArticulationPositions( const float dt_sec ) {
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		m_articulations[ i ]->IntegratePositions( dt_sec );
+	}
+}
+
 /*
 ====================================================
 PhysicsWorld::FilterPair
@@ -280,6 +347,11 @@ bool PhysicsWorld::FilterPair( Body * bodyA, Body * bodyB ) {
 		return true;
 	}
 
+	// Links of the same articulation are kept apart by their joints
+	if ( NULL != bodyA->m_articulation && bodyA->m_articulation == bodyB->m_articulation ) {
+		return true;
+	}
+
 	// Filter bodies that aren't flagged to collide with each other
 	if ( 0 == ( bodyA->m_bodyContents & bodyB->m_collidesWith ) ) {
 		return true;
@@ -321,31 +393,546 @@ void PhysicsWorld::RemoveExpiredContactsAndConstraints() {
 	}
 }
 
+/*
+====================================================
+FindRoot
+
+Union-find lookup shared by the solver islands and the time of impact groups
+====================================================
+*/
+static int FindRoot( int * parents, int bodyID ) {
+	while ( parents[ bodyID ] != bodyID ) {
+		// Path halving keeps the trees flat
+		parents[ bodyID ] = parents[ parents[ bodyID ] ];
+		bodyID = parents[ bodyID ];
+	}
+	return bodyID;
+}
+
+/*
+====================================================
+PhysicsWorld::UnionIslands
+====================================================
+*/
+void PhysicsWorld::UnionIslands( const Body * bodyA, const Body * bodyB ) {
+	// Static bodies do not propagate impulses, so they don't join islands together
+	if ( NULL == bodyA || NULL == bodyB ) {
+		return;
+	}
+	if ( 0.0f == bodyA->m_invMass || 0.0f == bodyB->m_invMass ) {
+		return;
+	}
+
+	const int rootA = FindRoot( m_islandParents, (int)( bodyA - m_bodyPool ) );
+	const int rootB = FindRoot( m_islandParents, (int)( bodyB - m_bodyPool ) );
+	if ( rootA != rootB ) {
+		m_islandParents[ rootB ] = rootA;
+	}
+}
+
+/*
+====================================================
+GetIslandBody
+Returns the body that decides which island a constraint belongs to
+====================================================
+*/
+static const Body * GetIslandBody( const Body * bodyA, const Body * bodyB ) {
+	if ( NULL != bodyA && 0.0f != bodyA->m_invMass ) {
+		return bodyA;
+	}
+	if ( NULL != bodyB && 0.0f != bodyB->m_invMass ) {
+		return bodyB;
+	}
+	return ( NULL != bodyA ) ? bodyA : bodyB;
+}
+
+/*
+====================================================
+PhysicsWorld::BuildIslands
+
+Groups the bodies connected through constraints and contact manifolds,
+so that each group can iterate until it has converged independently of the others.
+====================================================
+*/
+void PhysicsWorld::BuildIslands() {
+	BodyPoolNode_t * node = m_usedNodes;
+	while ( NULL != node ) {
+		m_islandParents[ node->bodyID ] = node->bodyID;
+		m_islandIndices[ node->bodyID ] = -1;
+		node = node->m_next;
+	}
+
+	for ( int i = 0; i < m_constraints.size(); i++ ) {
+		UnionIslands( m_constraints[ i ]->m_bodyA, m_constraints[ i ]->m_bodyB );
+	}
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		const Articulation * articulation = m_articulations[ i ];
+		for ( int j = 1; j < articulation->GetNumLinks(); j++ ) {
+			UnionIslands( articulation->GetLinkBody( j ), articulation->GetLinkBody( articulation->GetLinkParent( j ) ) );
+		}
+	}
+	for ( int i = 0; i < m_manifolds.GetNumManifolds(); i++ ) {
+		const Manifold & manifold = m_manifolds.GetManifold( i );
+		if ( manifold.GetNumContacts() > 0 ) {
+			UnionIslands( manifold.GetBodyA(), manifold.GetBodyB() );
+		}
+	}
+
+	// Re-use the island storage from the previous step
+	for ( int i = 0; i < m_islands.size(); i++ ) {
+		m_islands[ i ].bodies.clear();
+		m_islands[ i ].constraints.clear();
+		m_islands[ i ].manifolds.clear();
+		m_islands[ i ].articulations.clear();
+	}
+	int numIslands = 0;
+
+	for ( int i = 0; i < m_constraints.size(); i++ ) {
+		const Body * body = GetIslandBody( m_constraints[ i ]->m_bodyA, m_constraints[ i ]->m_bodyB );
+		if ( NULL == body ) {
+			continue;
+		}
+
+		const int root = FindRoot( m_islandParents, (int)( body - m_bodyPool ) );
+		if ( m_islandIndices[ root ] < 0 ) {
+			m_islandIndices[ root ] = numIslands++;
+		}
+		if ( numIslands > m_islands.size() ) {
+			m_islands.resize( numIslands );
+		}
+		m_islands[ m_islandIndices[ root ] ].constraints.push_back( i );
+	}
+	for ( int i = 0; i < m_manifolds.GetNumManifolds(); i++ ) {
+		const Manifold & manifold = m_manifolds.GetManifold( i );
+		if ( 0 == manifold.GetNumContacts() ) {
+			continue;
+		}
+		const Body * body = GetIslandBody( manifold.GetBodyA(), manifold.GetBodyB() );
+
+		const int root = FindRoot( m_islandParents, (int)( body - m_bodyPool ) );
+		if ( m_islandIndices[ root ] < 0 ) {
+			m_islandIndices[ root ] = numIslands++;
+		}
+		if ( numIslands > m_islands.size() ) {
+			m_islands.resize( numIslands );
+		}
+		m_islands[ m_islandIndices[ root ] ].manifolds.push_back( i );
+	}
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		if ( 0 == m_articulations[ i ]->GetNumLinks() ) {
+			continue;
+		}
+		const Body * body = m_articulations[ i ]->GetLinkBody( 0 );
+
+		const int root = FindRoot( m_islandParents, (int)( body - m_bodyPool ) );
+		if ( m_islandIndices[ root ] < 0 ) {
+			m_islandIndices[ root ] = numIslands++;
+		}
+		if ( numIslands > m_islands.size() ) {
+			m_islands.resize( numIslands );
+		}
+		m_islands[ m_islandIndices[ root ] ].articulations.push_back( i );
+	}
+
+	// Only dynamic bodies are tracked for convergence
+	node = m_usedNodes;
+	while ( NULL != node ) {
+		const int root = FindRoot( m_islandParents, node->bodyID );
+		if ( m_islandIndices[ root ] >= 0 && 0.0f != m_bodyPool[ node->bodyID ].m_invMass ) {
+			m_islands[ m_islandIndices[ root ] ].bodies.push_back( node->bodyID );
+		}
+		node = node->m_next;
+	}
+
+	m_islands.resize( numIslands );
+	m_solverIslands.resize( numIslands );
+	for ( int i = 0; i < numIslands; i++ ) {
+		solverIsland_t & report = m_solverIslands[ i ];
+		report.numBodies = (int)m_islands[ i ].bodies.size();
+		report.numConstraints = (int)( m_islands[ i ].constraints.size() + m_islands[ i ].manifolds.size() + m_islands[ i ].articulations.size() );
+		report.iterationsUsed = 0;
+		report.residual = 0.0f;
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::PreSolveIsland
+
+Every substep is warm started with the cached impulses.  This isn't applying them twice, since each
+substep's solve turns them into the impulse that substep needed, which is the guess for the next one.
+====================================================
+*/
+void PhysicsWorld::PreSolveIsland( const int islandIdx, const float dt_sec, const bool isFirstSubstep ) {
+	const island_t & island = m_islands[ islandIdx ];
+	const float warmStartScale = isFirstSubstep ? m_warmStartScale : 1.0f;
+	if ( isFirstSubstep ) {
+		// The shapes don't change during the step, so their radii for the residual only need finding once
+		for ( int i = 0; i < island.bodies.size(); i++ ) {
+			const Body & body = m_bodyPool[ island.bodies[ i ] ];
+			const Bounds bounds = body.m_shape->GetBounds();
+			m_residualRadii[ island.bodies[ i ] ] = 0.5f * ( bounds.maxs - bounds.mins ).GetMagnitude();
+		}
+	}
+
+	for ( int i = 0; i < island.constraints.size(); i++ ) {
+		m_constraints[ island.constraints[ i ] ]->SetWarmStartScale( warmStartScale );
+		m_constraints[ island.constraints[ i ] ]->PreSolve( dt_sec );
+	}
+	for ( int i = 0; i < island.manifolds.size(); i++ ) {
+		m_manifolds.GetManifold( island.manifolds[ i ] ).PreSolve( dt_sec, warmStartScale );
+	}
+	for ( int i = 0; i < island.articulations.size(); i++ ) {
+		m_articulations[ island.articulations[ i ] ]->PreSolve( dt_sec );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::SolveIsland
+
+Runs a single solver iteration over the island and returns the residual.
+The residual is the largest change in velocity of any point on the island's bodies,
+which is the impulse delta of the iteration normalized by mass.  Measuring it from the bodies
+means it works for every constraint type, regardless of how it applies its impulses.
+====================================================
+*/
+float PhysicsWorld::SolveIsland( const int islandIdx ) {
+	const island_t & island = m_islands[ islandIdx ];
+
+	for ( int i = 0; i < island.bodies.size(); i++ ) {
+		const Body & body = m_bodyPool[ island.bodies[ i ] ];
+		m_prevLinearVelocity[ island.bodies[ i ] ] = body.m_linearVelocity;
+		m_prevAngularVelocity[ island.bodies[ i ] ] = body.m_angularVelocity;
+	}
+
+	for ( int i = 0; i < island.constraints.size(); i++ ) {
+		m_constraints[ island.constraints[ i ] ]->Solve();
+	}
+	for ( int i = 0; i < island.articulations.size(); i++ ) {
+		m_articulations[ island.articulations[ i ] ]->Solve();
+	}
+	for ( int i = 0; i < island.manifolds.size(); i++ ) {
+		m_manifolds.GetManifold( island.manifolds[ i ] ).Solve();
+	}
+
+	float residual = 0.0f;
+	for ( int i = 0; i < island.bodies.size(); i++ ) {
+		const Body & body = m_bodyPool[ island.bodies[ i ] ];
+		const float radius = m_residualRadii[ island.bodies[ i ] ];
+
+		const float dv = ( body.m_linearVelocity - m_prevLinearVelocity[ island.bodies[ i ] ] ).GetMagnitude();
+		const float dw = ( body.m_angularVelocity - m_prevAngularVelocity[ island.bodies[ i ] ] ).GetMagnitude();
+		const float delta = dv + dw * radius;
+		if ( delta > residual ) {
+			residual = delta;
+		}
+	}
+	return residual;
+}
+
+/*
+====================================================
+PhysicsWorld::PostSolveIsland
+====================================================
+*/
+void PhysicsWorld::PostSolveIsland( const int islandIdx ) {
+	const island_t & island = m_islands[ islandIdx ];
+	for ( int i = 0; i < island.constraints.size(); i++ ) {
+		m_constraints[ island.constraints[ i ] ]->PostSolve();
+	}
+	for ( int i = 0; i < island.manifolds.size(); i++ ) {
+		m_manifolds.GetManifold( island.manifolds[ i ] ).PostSolve();
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::SolveIslands
+
+Iterates each island until its residual drops below the tolerance
+====================================================
+*/
+void PhysicsWorld::SolveIslands( const float dt_sec ) {
+	const int minIters = std::max( m_solverSettings.minIterations, 1 );
+	const int maxIters = std::max( m_solverSettings.maxIterations, minIters );
+
+	for ( int i = 0; i < m_islands.size(); i++ ) {
+		PreSolveIsland( i, dt_sec, true );
+
+		solverIsland_t & report = m_solverIslands[ i ];
+		for ( int iters = 0; iters < maxIters; iters++ ) {
+			report.residual = SolveIsland( i );
+			report.iterationsUsed = iters + 1;
+
+			if ( report.iterationsUsed >= minIters && report.residual < m_solverSettings.residualTolerance ) {
+				break;
+			}
+		}
+
+		PostSolveIsland( i );
+	}
+}
+
+/*
+====================================================
+JoinsToiGroups
+
+Bodies that can't move never change during a time of impact event, so they
+can be shared by any number of groups without linking them together
+====================================================
+*/
+static bool JoinsToiGroups( const Body * body ) {
+	if ( 0.0f != body->m_invMass ) {
+		return true;
+	}
+	return ( body->m_linearVelocity.GetLengthSqr() > 0.0f || body->m_angularVelocity.GetLengthSqr() > 0.0f );
+}
+
+/*
+====================================================
+PhysicsWorld::UnionToiGroups
+====================================================
+*/
+void PhysicsWorld::UnionToiGroups( const Body * bodyA, const Body * bodyB ) {
+	if ( !JoinsToiGroups( bodyA ) || !JoinsToiGroups( bodyB ) ) {
+		return;
+	}
+
+	const int rootA = FindRoot( m_toiGroupParents, (int)( bodyA - m_bodyPool ) );
+	const int rootB = FindRoot( m_toiGroupParents, (int)( bodyB - m_bodyPool ) );
+	if ( rootA != rootB ) {
+		m_toiGroupParents[ rootB ] = rootA;
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::BuildToiGroups
+
+Groups the bodies linked through the ballistic contacts in [firstContact, endContact).
+Bodies in different groups can't affect each other before the end of the step.
+====================================================
+*/
+void PhysicsWorld::BuildToiGroups( const contact_t * contacts, const int firstContact, const int endContact ) {
+	BodyPoolNode_t * node = m_usedNodes;
+	while ( NULL != node ) {
+		m_toiGroupParents[ node->bodyID ] = node->bodyID;
+		m_toiGroupIndices[ node->bodyID ] = -1;
+		node = node->m_next;
+	}
+
+	for ( int i = firstContact; i < endContact; i++ ) {
+		UnionToiGroups( contacts[ i ].bodyA, contacts[ i ].bodyB );
+	}
+
+	// An impulse on one link changes the velocities of the whole articulation
+	for ( int i = 0; i < m_articulations.size(); i++ ) {
+		const Articulation * articulation = m_articulations[ i ];
+		for ( int j = 1; j < articulation->GetNumLinks(); j++ ) {
+			UnionToiGroups( articulation->GetLinkBody( j ), articulation->GetLinkBody( articulation->GetLinkParent( j ) ) );
+		}
+	}
+
+	// Re-use the group storage from the previous step
+	for ( int i = 0; i < m_toiGroups.size(); i++ ) {
+		m_toiGroups[ i ].bodies.clear();
+		m_toiGroups[ i ].contacts.clear();
+	}
+	int numGroups = 0;
+
+	for ( int i = firstContact; i < endContact; i++ ) {
+		const Body * body = JoinsToiGroups( contacts[ i ].bodyA ) ? contacts[ i ].bodyA : contacts[ i ].bodyB;
+
+		const int root = FindRoot( m_toiGroupParents, (int)( body - m_bodyPool ) );
+		if ( m_toiGroupIndices[ root ] < 0 ) {
+			m_toiGroupIndices[ root ] = numGroups++;
+		}
+		if ( numGroups > m_toiGroups.size() ) {
+			m_toiGroups.resize( numGroups );
+		}
+		m_toiGroups[ m_toiGroupIndices[ root ] ].contacts.push_back( i );
+	}
+
+	node = m_usedNodes;
+	while ( NULL != node ) {
+		const int root = FindRoot( m_toiGroupParents, node->bodyID );
+		if ( m_toiGroupIndices[ root ] >= 0 && JoinsToiGroups( &m_bodyPool[ node->bodyID ] ) ) {
+			m_toiGroups[ m_toiGroupIndices[ root ] ].bodies.push_back( node->bodyID );
+		}
+		node = node->m_next;
+	}
+
+	m_toiGroups.resize( numGroups );
+}
+
+/*
+====================================================
+PhysicsWorld::AdvanceToiGroup
+
+Integrates only the group's bodies from startTime to endTime, resolving its contacts along the way
+====================================================
+*/
+void PhysicsWorld::AdvanceToiGroup( const int groupIdx, contact_t * contacts, const float startTime, const float endTime ) {
+	const toiGroup_t & group = m_toiGroups[ groupIdx ];
+
+	float time = startTime;
+	for ( int i = 0; i < group.contacts.size(); i++ ) {
+		contact_t & contact = contacts[ group.contacts[ i ] ];
+		const float dt = contact.timeOfImpact - time;
+
+		// Position update
+		for ( int j = 0; j < group.bodies.size(); j++ ) {
+			m_bodyPool[ group.bodies[ j ] ].Update( dt );
+		}
+
+		ResolveContact( contact );
+		time += dt;
+	}
+
+	const float timeRemaining = endTime - time;
+	if ( timeRemaining > 0.0f ) {
+		for ( int j = 0; j < group.bodies.size(); j++ ) {
+			m_bodyPool[ group.bodies[ j ] ].Update( timeRemaining );
+		}
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::AdvanceToiGroupsJob
+====================================================
+*/
+void PhysicsWorld::AdvanceToiGroupsJob( Job_t * job, void * data ) {
+	toiGroupJob_t * jobs = (toiGroupJob_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		const toiGroupJob_t & groupJob = jobs[ i ];
+		groupJob.world->AdvanceToiGroup( groupJob.groupIdx, groupJob.contacts, groupJob.startTime, groupJob.endTime );
+	}
+}
+
+/*
+====================================================
+PhysicsWorld::AdvanceBodies
+
+Integrates the bodies up to endTime, resolving any ballistic contacts along the way.
+Only the bodies involved in a time of impact event are stepped through it, independent
+groups run in parallel, and everything else is integrated once at the end.
+====================================================
+*/
+void PhysicsWorld::AdvanceBodies( contact_t * contacts, const int numContacts, int & contactIdx, float & accumulatedTime, const float endTime ) {
+	int endContact = contactIdx;
+	while ( endContact < numContacts && contacts[ endContact ].timeOfImpact <= endTime ) {
+		endContact++;
+	}
+
+	const float timeRemaining = endTime - accumulatedTime;
+	if ( endContact == contactIdx ) {
+		if ( timeRemaining > 0.0f ) {
+			const int startTime = GetTimeMicroseconds();
+			UpdateBodies( timeRemaining );
+			m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
+			accumulatedTime = endTime;
+		}
+		return;
+	}
+
+	const int toiStartTime = GetTimeMicroseconds();
+	BuildToiGroups( contacts, contactIdx, endContact );
+
+	const int numGroups = (int)m_toiGroups.size();
+	if ( NULL != g_jobSystem && numGroups > 1 ) {
+		std::vector< toiGroupJob_t > & jobs = m_toiGroupJobs;
+		if ( numGroups > jobs.size() ) {
+			jobs.resize( numGroups );
+			GetPhysicsCounters().numBytesAllocated += (int)( jobs.capacity() * sizeof( toiGroupJob_t ) );
+		}
+		for ( int i = 0; i < numGroups; i++ ) {
+			jobs[ i ].world = this;
+			jobs[ i ].groupIdx = i;
+			jobs[ i ].contacts = contacts;
+			jobs[ i ].startTime = accumulatedTime;
+			jobs[ i ].endTime = endTime;
+		}
+		g_jobSystem->ParallelFor( AdvanceToiGroupsJob, jobs.data(), sizeof( toiGroupJob_t ), numGroups );
+		g_jobSystem->Wait( NULL );
+	} else {
+		for ( int i = 0; i < numGroups; i++ ) {
+			AdvanceToiGroup( i, contacts, accumulatedTime, endTime );
+		}
+	}
+	m_stepTimings.timeOfImpact += GetTimeMicroseconds() - toiStartTime;
+
+	// Everything that wasn't part of a time of impact event moves in one go
+	if ( timeRemaining > 0.0f ) {
+		const int startTime = GetTimeMicroseconds();
+		BodyPoolNode_t * node = m_usedNodes;
+		while ( NULL != node ) {
+			const int root = FindRoot( m_toiGroupParents, node->bodyID );
+			Body & body = m_bodyPool[ node->bodyID ];
+			if ( m_toiGroupIndices[ root ] < 0 || !JoinsToiGroups( &body ) ) {
+				body.Update( timeRemaining );
+			}
+			node = node->m_next;
+		}
+		m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
+	}
+
+	contactIdx = endContact;
+	accumulatedTime = endTime;
+}
+
 /*
 ====================================================
 PhysicsWorld::StepSimulation
 ====================================================
 */
 void PhysicsWorld::StepSimulation( const float dt_sec ) {
+	m_stepTimings = stepTimings_t();
+	m_stepStats = stepStats_t();
+	ResetPhysicsCounters();
+	const int stepStartTime = GetTimeMicroseconds();
+	int startTime = stepStartTime;
+
 	RemoveExpiredContactsAndConstraints();
 
+	const bool useSubsteps = m_solverSettings.enableSubstepping && m_solverSettings.numSubsteps > 1;
+	const int numSubsteps = useSubsteps ? m_solverSettings.numSubsteps : 1;
+	const float dt_substep = dt_sec / (float)numSubsteps;
+
+	// The cached impulses are from a step or a substep of the last one, so they're rescaled to this
+	// step's when the number of substeps changes
+	m_warmStartScale = ( m_prevNumSubsteps > 0 ) ? (float)m_prevNumSubsteps / (float)numSubsteps : 1.0f;
+	m_prevNumSubsteps = numSubsteps;
+
 	//
 	//	Apply Gravity to bodies
 	//
-	ApplyGravity( dt_sec );
+	ApplyGravity( dt_substep );
+	IntegrateArticulationVelocities( dt_substep );
+	m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
 
 	//
 	// Broadphase (build potential collision pairs)
 	//
+	startTime = GetTimeMicroseconds();
 	std::vector< collisionPair_t > collisionPairs;
-	BroadPhase( m_bodyPool, m_usedNodes, collisionPairs, dt_sec );
+	m_stepStats.broadPhase = m_broadPhase.GetActiveBroadPhase();
+	m_broadPhase.FindPairs( m_bodyPool, m_usedNodes, collisionPairs, dt_sec );
+	m_stepStats.broadPhaseProbe = m_broadPhase.GetProbedBroadPhase();
+	m_stepTimings.broadPhaseProbe = m_broadPhase.GetProbeTime_us();
+	m_stepTimings.broadPhase = GetTimeMicroseconds() - startTime - m_stepTimings.broadPhaseProbe;
+	m_stepStats.numCandidatePairs = (int)collisionPairs.size();
 
 	//
 	//	NarrowPhase (perform actual collision detection)
 	//
+	startTime = GetTimeMicroseconds();
 	int numContacts = 0;
 	//contact_t * contacts = (contact_t *)alloca( sizeof( contact_t ) * collisionPairs.size() );
 	contact_t * contacts = (contact_t *)malloc( sizeof( contact_t ) * collisionPairs.size() );
+	GetPhysicsCounters().numBytesAllocated += (int)( sizeof( contact_t ) * collisionPairs.size() + sizeof( collisionPair_t ) * collisionPairs.capacity() );
 	for ( int i = 0; i < collisionPairs.size(); i++ ) {
 		const collisionPair_t & pair = collisionPairs[ i ];
 		Body * bodyA = &m_bodyPool[ pair.a ];
@@ -353,15 +940,21 @@ void PhysicsWorld::StepSimulation( const float dt_sec ) {
 
 		// Skip bodies that should be filtered from collision
 		if ( FilterPair( bodyA, bodyB ) ) {
+			m_stepStats.numFilteredPairs++;
 			continue;
 		}
 
 		// Check for intersection
-		contact_t contact;
-		if ( Intersect( bodyA, bodyB, dt_sec, contact ) ) {
+		contact_t pairContacts[ MAX_PAIR_CONTACTS ];
+		const int cacheSlot = m_manifolds.GetCacheSlot( bodyA, bodyB );
+		const int numPairContacts = Intersect( bodyA, bodyB, dt_sec, pairContacts, MAX_PAIR_CONTACTS, m_manifolds.GetCache( cacheSlot ) );
+		if ( numPairContacts > 0 ) {
+			const contact_t & contact = pairContacts[ 0 ];
 			if ( 0.0f == contact.timeOfImpact ) {
 				// Static contact
-				m_manifolds.AddContact( contact );
+				for ( int j = 0; j < numPairContacts; j++ ) {
+					m_manifolds.AddContact( pairContacts[ j ] );
+				}
 			} else {
 				// Ballistic contact
 				contacts[ numContacts ] = contact;
@@ -377,6 +970,9 @@ void PhysicsWorld::StepSimulation( const float dt_sec ) {
 			}
 		}
 	}
+	m_stepTimings.narrowPhase = GetTimeMicroseconds() - startTime;
+	m_broadPhase.RecordNarrowPhase( m_stepTimings.narrowPhase, m_stepStats.numCandidatePairs );
+	m_stepStats.numBallisticContacts = numContacts;
 
 	//
 	//	Apply forces
@@ -385,52 +981,165 @@ void PhysicsWorld::StepSimulation( const float dt_sec ) {
 	//
 	//	Solve Constraints
 	//
-	for ( int i = 0; i < m_constraints.size(); i++ ) {
-		m_constraints[ i ]->PreSolve( dt_sec );
+	startTime = GetTimeMicroseconds();
+	BuildIslands();
+
+	// Sort the times of impact from first to last
+	if ( numContacts > 1 ) {
+		qsort( contacts, numContacts, sizeof( contact_t ), CompareContacts );
 	}
-	m_manifolds.PreSolve( dt_sec );
 
-	const int maxIters = 5;
-	for ( int iters = 0; iters < maxIters; iters++ ) {
-		for ( int i = 0; i < m_constraints.size(); i++ ) {
-			m_constraints[ i ]->Solve();
+	int contactIdx = 0;
+	float accumulatedTime = 0.0f;
+	if ( !useSubsteps ) {
+		SolveIslands( dt_sec );
+		m_stepTimings.solve += GetTimeMicroseconds() - startTime;
+
+		//
+		// Apply ballistic impulses and update the positions for the rest of this frame's time
+		//
+		AdvanceBodies( contacts, numContacts, contactIdx, accumulatedTime, dt_sec );
+
+		startTime = GetTimeMicroseconds();
+		IntegrateArticulationPositions( dt_sec );
+		m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
+	} else {
+		//
+		//	Substepping: re-linearize the constraints at the start of every substep,
+		//	run a single iteration and integrate positions before moving on.
+		//	The constraints still get the frame's dt so that the position error correction
+		//	is spread over the whole frame, instead of being applied again in every substep.
+		//
+		m_stepTimings.solve += GetTimeMicroseconds() - startTime;
+		for ( int step = 0; step < numSubsteps; step++ ) {
+			if ( step > 0 ) {
+				startTime = GetTimeMicroseconds();
+				ApplyGravity( dt_substep );
+				IntegrateArticulationVelocities( dt_substep );
+				m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
+			}
+
+			startTime = GetTimeMicroseconds();
+			for ( int i = 0; i < m_islands.size(); i++ ) {
+				PreSolveIsland( i, dt_sec, 0 == step );
+				m_solverIslands[ i ].residual = SolveIsland( i );
+				m_solverIslands[ i ].iterationsUsed++;
+				PostSolveIsland( i );
+			}
+			m_stepTimings.solve += GetTimeMicroseconds() - startTime;
+
+			const float endTime = ( step == numSubsteps - 1 ) ? dt_sec : dt_substep * (float)( step + 1 );
+			const float substepStartTime = accumulatedTime;
+			AdvanceBodies( contacts, numContacts, contactIdx, accumulatedTime, endTime );
+
+			startTime = GetTimeMicroseconds();
+			IntegrateArticulationPositions( accumulatedTime - substepStartTime );
+			m_stepTimings.integrate += GetTimeMicroseconds() - startTime;
 		}
-		m_manifolds.Solve();
 	}
 
-	for ( int i = 0; i < m_constraints.size(); i++ ) {
-		m_constraints[ i ]->PostSolve();
-	}
-	m_manifolds.PostSolve();
+	free( contacts );
+
+	// The bodies have moved, so the query tree is out of date
+	m_queryTreeDirty = true;
+
+	m_stepTimings.total = GetTimeMicroseconds() - stepStartTime - m_stepTimings.broadPhaseProbe;
 
 	//
-	// Apply ballistic impulses
+	//	Gather the stats
 	//
+	for ( int i = 0; i < m_islands.size(); i++ ) {
+		const island_t & island = m_islands[ i ];
+		for ( int j = 0; j < island.constraints.size(); j++ ) {
+			const VecN * lambda = m_constraints[ island.constraints[ j ] ]->GetCachedLambda();
+			if ( NULL != lambda ) {
+				m_stepStats.numConstraintRows += lambda->N;
+			}
+		}
+		for ( int j = 0; j < island.manifolds.size(); j++ ) {
+			m_stepStats.numConstraintRows += m_manifolds.GetManifold( island.manifolds[ j ] ).GetNumConstraintRows();
+		}
+		for ( int j = 0; j < island.articulations.size(); j++ ) {
+			m_stepStats.numConstraintRows += m_articulations[ island.articulations[ j ] ]->GetNumRows();
+		}
+		m_stepStats.numIterations += m_solverIslands[ i ].iterationsUsed;
+	}
+	m_stepStats.numManifolds = m_manifolds.GetNumManifolds();
 
-	// Sort the times of impact from first to last
-	if ( numContacts > 1 ) {
-		qsort( contacts, numContacts, sizeof( contact_t ), CompareContacts );
+	physicsCounters_t counters;
+	SumPhysicsCounters( counters );
+	m_stepStats.numGjkCalls = counters.numGjkCalls;
+	m_stepStats.numEpaCalls = counters.numEpaCalls;
+	m_stepStats.numBytesAllocated = counters.numBytesAllocated;
+}
+
+/*
+====================================================
+PhysicsWorld::SetFixedTimeStep
+====================================================
+*/
+void PhysicsWorld::SetFixedTimeStep( const float dt_sec, const int maxStepsPerUpdate ) {
+	if ( dt_sec <= 0.0f || maxStepsPerUpdate <= 0 ) {
+		printf( "WARNING: PhysicsWorld: invalid fixed time step %f x %i\n", dt_sec, maxStepsPerUpdate );
+		return;
 	}
+	m_fixedTimeStep = dt_sec;
+	m_maxStepsPerUpdate = maxStepsPerUpdate;
+	m_accumulator = 0.0f;
+}
 
-	float accumulatedTime = 0.0f;
-	for ( int i = 0; i < numContacts; i++ ) {
-		contact_t & contact = contacts[ i ];
-		const float dt = contact.timeOfImpact - accumulatedTime;
+/*
+====================================================
+PhysicsWorld::Update
+====================================================
+*/
+int PhysicsWorld::Update( const float dt_sec ) {
+	m_accumulator += dt_sec;
+
+	int numSteps = 0;
+	while ( m_accumulator >= m_fixedTimeStep ) {
+		// When the frame took longer than we can simulate, drop the time instead of falling further behind
+		if ( numSteps >= m_maxStepsPerUpdate ) {
+			m_accumulator = fmodf( m_accumulator, m_fixedTimeStep );
+			break;
+		}
 
-		// Position update
-		UpdateBodies( dt );
+		for ( const BodyPoolNode_t * node = m_usedNodes; NULL != node; node = node->m_next ) {
+			m_prevPositions[ node->bodyID ] = m_bodyPool[ node->bodyID ].m_position;
+			m_prevOrientations[ node->bodyID ] = m_bodyPool[ node->bodyID ].m_orientation;
+		}
 
-		ResolveContact( contact );
-		accumulatedTime += dt;
+		StepSimulation( m_fixedTimeStep );
+		m_accumulator -= m_fixedTimeStep;
+		numSteps++;
 	}
+	return numSteps;
+}
 
-	//
-	// Update the positions for the rest of this frame's time
-	//
-	const float timeRemaining = dt_sec - accumulatedTime;
-	if ( timeRemaining > 0.0f ) {
-		UpdateBodies( timeRemaining );
+/*
+====================================================
+PhysicsWorld::GetInterpolatedTransform
+====================================================
+*/
+void PhysicsWorld::GetInterpolatedTransform( const int bodyID, Vec3 & pos, Quat & orient ) const {
+	const Body * body = GetBody( bodyID );
+	if ( NULL == body ) {
+		return;
 	}
 
-	free( contacts );
-}
\ No newline at end of file
+	const float alpha = GetInterpolationAlpha();
+	const Vec3 & prevPos = m_prevPositions[ bodyID ];
+	pos = prevPos + ( body->m_position - prevPos ) * alpha;
+
+	// Normalized lerp, through the shorter arc
+	const Quat & q0 = m_prevOrientations[ bodyID ];
+	Quat q1 = body->m_orientation;
+	if ( q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w < 0.0f ) {
+		q1 *= -1.0f;
+	}
+	orient.x = q0.x + ( q1.x - q0.x ) * alpha;
+	orient.y = q0.y + ( q1.y - q0.y ) * alpha;
+	orient.z = q0.z + ( q1.z - q0.z ) * alpha;
+	orient.w = q0.w + ( q1.w - q0.w ) * alpha;
+	orient.Normalize();
+}
@@ -8,12 +8,98 @@
 #include "Physics/Constraints.h"
 #include "Physics/Manifold.h"
 #include "Physics/BroadPhase.h"
+#include "Physics/BroadPhaseManager.h"
+#include "Physics/PhysicsQueries.h"
+#include "Physics/Shapes/BoundsTree.h"
+
+struct Job_t;
+class Articulation;
 
 struct BodyPoolNode_t {
 	BodyPoolNode_t * m_next;
 	int bodyID;
 };
 
+/*
+====================================================
+solverSettings_t
+====================================================
+*/
+struct solverSettings_t {
+	solverSettings_t() {
+		maxIterations = 16;
+		minIterations = 2;
+		residualTolerance = 0.001f;
+		enableSubstepping = false;
+		numSubsteps = 4;
+	}
+
+	int maxIterations;			// upper bound on the velocity iterations an island may use
+	int minIterations;			// always run at least this many iterations
+	float residualTolerance;	// an island stops iterating once no point on its bodies changed velocity by more than this (m/s)
+
+	bool enableSubstepping;		// TGS style solve: numSubsteps substeps of dt / numSubsteps with one iteration each
+	int numSubsteps;
+};
+
+/*
+====================================================
+solverIsland_t
+
+Report of how a group of bodies connected by contacts/constraints converged
+====================================================
+*/
+struct solverIsland_t {
+	int numBodies;
+	int numConstraints;	// joints + contact manifolds
+	int iterationsUsed;
+	float residual;		// largest velocity change of any point on the island's bodies in the final iteration
+};
+
+/*
+====================================================
+stepTimings_t
+
+Where the time went in a step, in microseconds
+====================================================
+*/
+struct stepTimings_t {
+	stepTimings_t() : broadPhase( 0 ), broadPhaseProbe( 0 ), narrowPhase( 0 ), solve( 0 ), integrate( 0 ), timeOfImpact( 0 ), total( 0 ) {}
+
+	int broadPhase;
+	int broadPhaseProbe;	// measuring the broadphases that aren't in use, BROADPHASE_AUTO only and left out of the total
+	int narrowPhase;
+	int solve;			// building the islands and iterating the constraints
+	int integrate;		// gravity and moving the bodies
+	int timeOfImpact;	// moving the bodies through their ballistic contacts
+	int total;
+};
+
+/*
+====================================================
+stepStats_t
+
+What the last step had to chew through
+====================================================
+*/
+struct stepStats_t {
+	stepStats_t() : numCandidatePairs( 0 ), numFilteredPairs( 0 ), numGjkCalls( 0 ), numEpaCalls( 0 ), numBallisticContacts( 0 ),
+		numManifolds( 0 ), numConstraintRows( 0 ), numIterations( 0 ), numBytesAllocated( 0 ),
+		broadPhase( BROADPHASE_NUM ), broadPhaseProbe( BROADPHASE_NUM ) {}
+
+	int numCandidatePairs;		// pairs from the broadphase
+	int numFilteredPairs;		// candidate pairs that were skipped by FilterPair
+	int numGjkCalls;
+	int numEpaCalls;
+	int numBallisticContacts;	// contacts with a time of impact in the future
+	int numManifolds;
+	int numConstraintRows;		// rows of all the joints and contacts that were solved
+	int numIterations;			// solver iterations summed over all the islands
+	int numBytesAllocated;		// heap allocations made by the step
+	broadPhase_t broadPhase;		// the broadphase that found the candidate pairs
+	broadPhase_t broadPhaseProbe;	// another one that BROADPHASE_AUTO measured, BROADPHASE_NUM if none
+};
+
 /*
 ====================================================
 PhysicsWorld
@@ -23,7 +109,7 @@ class PhysicsWorld {
 public:
 	PhysicsWorld();
 	~PhysicsWorld();
-	void Reset();
+	void Reset();	// frees every body and unregisters the constraints and articulations, their owners delete them
 
 	bodyID_t AllocateBody( Body body );
 	void FreeBody( const int bodyID );
@@ -32,18 +118,90 @@ public:
 	void RegisterConstraint( Constraint * constraint );
 	void UnRegisterConstraint( Constraint * constraint );
 
+	// The world steps registered articulations, but doesn't own them
+	void RegisterArticulation( Articulation * articulation );
+	void UnRegisterArticulation( Articulation * articulation );
+
 	void StepSimulation( const float dt_sec );
 
+	// Runs StepSimulation at the fixed time step for as many whole steps as the frame time covers, and
+	// returns the number of steps taken.  Rendering should use the interpolated transforms, which blend
+	// the last two steps by the time left over, so motion stays smooth at any frame rate.
+	int Update( const float dt_sec );
+	void SetFixedTimeStep( const float dt_sec, const int maxStepsPerUpdate );	// time beyond the max steps is dropped
+	float GetFixedTimeStep() const { return m_fixedTimeStep; }
+	float GetInterpolationAlpha() const { return m_accumulator / m_fixedTimeStep; }
+	void GetInterpolatedTransform( const int bodyID, Vec3 & pos, Quat & orient ) const;
+
+	// Snapshots of the bodies, manifolds and warm starting, for rollback and replays.  Restoring a
+	// snapshot and stepping with the same inputs repeats the simulation exactly.
+	void SaveState( std::vector< unsigned char > & state ) const;
+	bool RestoreState( const std::vector< unsigned char > & state );
+
+	void SetSolverSettings( const solverSettings_t & settings ) { m_solverSettings = settings; }
+	const solverSettings_t & GetSolverSettings() const { return m_solverSettings; }
+	const std::vector< solverIsland_t > & GetSolverIslands() const { return m_solverIslands; }	// Islands from the last step
+	const stepTimings_t & GetStepTimings() const { return m_stepTimings; }	// Timings of the last step
+	const stepStats_t & GetStepStats() const { return m_stepStats; }		// Counters from the last step
+
+	// Which broadphase finds the candidate pairs, it can be switched between steps.  BROADPHASE_AUTO
+	// measures them as the world steps and switches to the cheapest, see BroadPhaseManager.
+	void SetBroadPhase( const broadPhase_t type ) { m_broadPhase.SetBroadPhase( type ); }
+	broadPhase_t GetBroadPhase() const { return m_broadPhase.GetBroadPhase(); }
+	void SetBroadPhaseSettings( const broadPhaseSettings_t & settings ) { m_broadPhase.SetSettings( settings ); }
+	const broadPhaseSettings_t & GetBroadPhaseSettings() const { return m_broadPhase.GetSettings(); }
+	void SetHashGridCellSize( const float cellSize ) { m_broadPhase.SetHashGridCellSize( cellSize ); }	// the lowest level, a bit over the size of the common bodies
+
 	void GetAllocatedBodyIDs( std::vector< int > & bodyIds ) const;	// Used for debug drawing
 	const Body * GetBody( const int bodyID ) const;
 
+	// World queries run against a tree of the bodies' bounds, rebuilt when the bodies have moved.
+	// The batched versions split the queries across the job system and write a result per query.
+	// Batched rays are traced in packets of four consecutive queries, so keep nearby rays together.
+	bool RayCast( const rayCastQuery_t & query, queryHit_t & hit );
+	bool SweepShape( const sweepQuery_t & query, queryHit_t & hit );
+	int Overlap( const overlapQuery_t & query, int * bodyIds, const int maxIds );	// returns the number of ids written
+	int QueryBounds( const Bounds & bounds, const unsigned int contentsMask, int * bodyIds, const int maxIds );	// bodies whose bounds touch, no narrowphase
+	void RayCastBatch( const rayCastQuery_t * queries, queryHit_t * hits, const int num );
+	void SweepShapeBatch( const sweepQuery_t * queries, queryHit_t * hits, const int num );
+	void OverlapBatch( const overlapQuery_t * queries, const int num, int * bodyIds, const int maxIdsPerQuery, int * counts );	// query i writes to bodyIds[ i * maxIdsPerQuery ]
+	void MarkQueryTreeDirty() { m_queryTreeDirty = true; }	// after moving bodies outside of StepSimulation
+
 private:
 	Body * GetBody( const int bodyID );
 	void UpdateBodies( const float dt_sec );
 	void ApplyGravity( const float dt_sec );
+	void IntegrateArticulationVelocities( const float dt_sec );
+	void IntegrateArticulationPositions( const float dt_sec );
 	bool FilterPair( Body * bodyA, Body * bodyB );
 	void RemoveExpiredContactsAndConstraints();
 
+	void UnionIslands( const Body * bodyA, const Body * bodyB );
+	void BuildIslands();
+	void PreSolveIsland( const int islandIdx, const float dt_sec, const bool isFirstSubstep );
+	float SolveIsland( const int islandIdx );
+	void PostSolveIsland( const int islandIdx );
+	void SolveIslands( const float dt_sec );
+	void AdvanceBodies( contact_t * contacts, const int numContacts, int & contactIdx, float & accumulatedTime, const float endTime );
+
+	void UnionToiGroups( const Body * bodyA, const Body * bodyB );
+	void BuildToiGroups( const contact_t * contacts, const int firstContact, const int endContact );
+	void AdvanceToiGroup( const int groupIdx, contact_t * contacts, const float startTime, const float endTime );
+	static void AdvanceToiGroupsJob( Job_t * job, void * data );
+
+	void UpdateQueryTree();
+	bool FilterQuery( const Body * body, const unsigned int contentsMask, const int ignoreBodyId ) const;
+	bool RayCastTree( const rayCastQuery_t & query, queryHit_t & hit ) const;
+	void RayCastPacketTree( const rayCastQuery_t * queries, queryHit_t * hits, const int num ) const;
+	// The tree's slots near the query are gathered into the caller's scratch, so queries don't allocate once it has grown
+	bool SweepShapeTree( const sweepQuery_t & query, queryHit_t & hit, std::vector< int > & slots ) const;
+	int OverlapTree( const overlapQuery_t & query, int * bodyIds, const int maxIds, std::vector< int > & slots ) const;
+	static float RayCastBodies( const int first, const int count, const float maxT, void * data );
+	static void RayCastBodiesPacket( const int first, const int count, rayPacket_t & packet, const int laneMask, void * data );
+	static void RayCastJob( Job_t * job, void * data );
+	static void SweepShapeJob( Job_t * job, void * data );
+	static void OverlapJob( Job_t * job, void * data );
+
 private:
 	static const int m_maxBodies = 1024;
 	Body m_bodyPool[ m_maxBodies ];
@@ -55,8 +213,61 @@ private:
 	int m_numUsedBodies;
 
 	std::vector< Constraint * >	m_constraints;
+	std::vector< Articulation * >	m_articulations;
 	ManifoldCollector			m_manifolds;
 
+	struct island_t {
+		std::vector< int > bodies;
+		std::vector< int > constraints;
+		std::vector< int > manifolds;
+		std::vector< int > articulations;
+	};
+	solverSettings_t				m_solverSettings;
+	std::vector< island_t >			m_islands;
+	std::vector< solverIsland_t >	m_solverIslands;
+	int								m_islandParents[ m_maxBodies ];
+	int								m_islandIndices[ m_maxBodies ];
+	Vec3							m_prevLinearVelocity[ m_maxBodies ];
+	Vec3							m_prevAngularVelocity[ m_maxBodies ];
+	float							m_residualRadii[ m_maxBodies ];	// turns the angular velocity change into a point's
+	int								m_prevNumSubsteps;		// of the last step, zero before the first
+	float							m_warmStartScale;		// for the first substep, from the last step's impulses to this one's
+
+	// Bodies linked by ballistic contacts, each group is advanced through its own times of impact
+	struct toiGroup_t {
+		std::vector< int > bodies;
+		std::vector< int > contacts;	// in time of impact order
+	};
+	std::vector< toiGroup_t >		m_toiGroups;
+	struct toiGroupJob_t {
+		PhysicsWorld * world;
+		int groupIdx;
+		contact_t * contacts;
+		float startTime;
+		float endTime;
+	};
+	std::vector< toiGroupJob_t >	m_toiGroupJobs;		// grows to the most groups a step has had
+	int								m_toiGroupParents[ m_maxBodies ];
+	int								m_toiGroupIndices[ m_maxBodies ];
+
+	stepTimings_t					m_stepTimings;
+	stepStats_t						m_stepStats;
+
+	BroadPhaseManager				m_broadPhase;
+
+	// Fixed time stepping, the transforms from before the last step are what rendering blends from
+	float							m_fixedTimeStep;
+	int								m_maxStepsPerUpdate;
+	float							m_accumulator;
+	Vec3							m_prevPositions[ m_maxBodies ];
+	Quat							m_prevOrientations[ m_maxBodies ];
+
+	// Bounds of the bodies for world queries, slot i of the tree is body m_queryBodyIds[ i ]
+	std::vector< boundsTreeNode_t >	m_queryNodes;
+	std::vector< int >				m_queryBodyIds;
+	std::vector< int >				m_querySlots;	// scratch for the single queries, each batch job has its own
+	bool							m_queryTreeDirty;
+
 	friend class BVH;
 	friend class LBVH;
 	friend class BoundingVolumeHierarchy;
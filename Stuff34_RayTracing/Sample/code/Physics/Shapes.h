@@ -6,6 +6,9 @@
 #include "Shapes/ShapeBox.h"
 #include "Shapes/ShapeConvex.h"
 #include "Shapes/ShapeCapsule.h"
+#include "Shapes/ShapeMesh.h"
+#include "Shapes/ShapeHeightfield.h"
+#include "Shapes/ShapeCompound.h"
 
 extern Vec3 g_boxGround[ 8 ];
 extern Vec3 g_boxWall0[ 8 ];
@@ -0,0 +1,522 @@
+//
+//  BoundsTree.cpp
+//
+#include "Physics/Shapes/BoundsTree.h"
+#include <stdlib.h>
+#include <algorithm>
+
+#define RAY_PACKET_SIMD	// comment out to slab test the rays in a packet one at a time
+
+#if defined( RAY_PACKET_SIMD )
+#include <xmmintrin.h>
+#endif
+
+/*
+========================================================================================================
+
+BoundsTree
+
+========================================================================================================
+*/
+
+struct boundsTreeItem_t {
+	Bounds bounds;
+	Vec3 center;
+	float key;	// the center along the current split axis
+	int item;
+};
+
+/*
+====================================================
+CompareTreeItems
+====================================================
+*/
+static int CompareTreeItems( const void * a, const void * b ) {
+	const boundsTreeItem_t * itemA = (const boundsTreeItem_t *)a;
+	const boundsTreeItem_t * itemB = (const boundsTreeItem_t *)b;
+
+	if ( itemA->key < itemB->key ) {
+		return -1;
+	}
+	if ( itemA->key > itemB->key ) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+====================================================
+BuildBoundsTreeNode
+
+Splits the items at the median of their centers along the longest axis
+of the center bounds.  Returns the index of the new node.
+====================================================
+*/
+static int BuildBoundsTreeNode( boundsTreeItem_t * items, const int first, const int count, const int maxLeafItems, std::vector< boundsTreeNode_t > & nodes ) {
+	const int nodeIdx = (int)nodes.size();
+	nodes.push_back( boundsTreeNode_t() );
+
+	Bounds bounds;
+	Bounds centers;
+	for ( int i = first; i < first + count; i++ ) {
+		bounds.Expand( items[ i ].bounds );
+		centers.Expand( items[ i ].center );
+	}
+	nodes[ nodeIdx ].bounds = bounds;
+
+	if ( count <= maxLeafItems ) {
+		nodes[ nodeIdx ].first = first;
+		nodes[ nodeIdx ].count = count;
+		return nodeIdx;
+	}
+
+	const Vec3 widths = centers.maxs - centers.mins;
+	int axis = 0;
+	if ( widths.y > widths[ axis ] ) {
+		axis = 1;
+	}
+	if ( widths.z > widths[ axis ] ) {
+		axis = 2;
+	}
+	for ( int i = first; i < first + count; i++ ) {
+		items[ i ].key = items[ i ].center[ axis ];
+	}
+	qsort( items + first, count, sizeof( boundsTreeItem_t ), CompareTreeItems );
+
+	const int half = count / 2;
+	BuildBoundsTreeNode( items, first, half, maxLeafItems, nodes );
+	const int right = BuildBoundsTreeNode( items, first + half, count - half, maxLeafItems, nodes );
+
+	// The vector may have grown, so don't hold a reference to the node across the recursion
+	nodes[ nodeIdx ].first = right;
+	nodes[ nodeIdx ].count = 0;
+	return nodeIdx;
+}
+
+/*
+====================================================
+BuildBoundsTree
+====================================================
+*/
+void BuildBoundsTree( const Bounds * itemBounds, const int numItems, const int maxLeafItems, std::vector< boundsTreeNode_t > & nodes, std::vector< int > & order ) {
+	nodes.clear();
+	order.clear();
+	if ( numItems <= 0 ) {
+		return;
+	}
+
+	std::vector< boundsTreeItem_t > items( numItems );
+	for ( int i = 0; i < numItems; i++ ) {
+		items[ i ].bounds = itemBounds[ i ];
+		items[ i ].center = itemBounds[ i ].Center();
+		items[ i ].key = 0.0f;
+		items[ i ].item = i;
+	}
+
+	nodes.reserve( 2 * numItems / maxLeafItems + 1 );
+	BuildBoundsTreeNode( items.data(), 0, numItems, maxLeafItems, nodes );
+
+	order.resize( numItems );
+	for ( int i = 0; i < numItems; i++ ) {
+		order[ i ] = items[ i ].item;
+	}
+}
+
+/*
+====================================================
+QueryBoundsTree
+====================================================
+*/
+void QueryBoundsTree( const std::vector< boundsTreeNode_t > & nodes, const Bounds & bounds, std::vector< int > & slots ) {
+	if ( nodes.empty() ) {
+		return;
+	}
+
+	// Median splits keep the tree balanced, so this is far deeper than it will ever get
+	int stack[ 64 ];
+	int stackSize = 0;
+	stack[ stackSize++ ] = 0;
+
+	while ( stackSize > 0 ) {
+		const int nodeIdx = stack[ --stackSize ];
+		const boundsTreeNode_t & node = nodes[ nodeIdx ];
+		if ( !node.bounds.DoesIntersect( bounds ) ) {
+			continue;
+		}
+
+		if ( node.count > 0 ) {
+			for ( int i = node.first; i < node.first + node.count; i++ ) {
+				slots.push_back( i );
+			}
+			continue;
+		}
+
+		stack[ stackSize++ ] = node.first;
+		stack[ stackSize++ ] = nodeIdx + 1;
+	}
+}
+
+/*
+====================================================
+RayCastBoundsTree
+====================================================
+*/
+void RayCastBoundsTree( const std::vector< boundsTreeNode_t > & nodes, const Vec3 & start, const Vec3 & dir, const float maxT, boundsTreeRayFn_t fn, void * data ) {
+	if ( nodes.empty() ) {
+		return;
+	}
+
+	float t = maxT;
+	float tEnter;
+	int axis;
+	if ( !nodes[ 0 ].bounds.DoesIntersectRay( start, dir, t, tEnter, axis ) ) {
+		return;
+	}
+
+	// Each entry remembers where the ray entered the node, so it can be dropped once a closer hit is found
+	struct rayStackEntry_t {
+		int node;
+		float tEnter;
+	};
+	rayStackEntry_t stack[ 64 ];
+	int stackSize = 0;
+	stack[ stackSize ].node = 0;
+	stack[ stackSize ].tEnter = tEnter;
+	stackSize++;
+
+	while ( stackSize > 0 ) {
+		const rayStackEntry_t entry = stack[ --stackSize ];
+		if ( entry.tEnter > t ) {
+			continue;
+		}
+
+		const boundsTreeNode_t & node = nodes[ entry.node ];
+		if ( node.count > 0 ) {
+			t = fn( node.first, node.count, t, data );
+			continue;
+		}
+
+		const int left = entry.node + 1;
+		const int right = node.first;
+		float tLeft;
+		float tRight;
+		const bool hitLeft = nodes[ left ].bounds.DoesIntersectRay( start, dir, t, tLeft, axis );
+		const bool hitRight = nodes[ right ].bounds.DoesIntersectRay( start, dir, t, tRight, axis );
+
+		// Push the far child first, so the near one is visited first
+		if ( hitLeft && hitRight ) {
+			const bool leftIsNear = ( tLeft <= tRight );
+			stack[ stackSize ].node = leftIsNear ? right : left;
+			stack[ stackSize ].tEnter = leftIsNear ? tRight : tLeft;
+			stackSize++;
+			stack[ stackSize ].node = leftIsNear ? left : right;
+			stack[ stackSize ].tEnter = leftIsNear ? tLeft : tRight;
+			stackSize++;
+		} else if ( hitLeft ) {
+			stack[ stackSize ].node = left;
+			stack[ stackSize ].tEnter = tLeft;
+			stackSize++;
+		} else if ( hitRight ) {
+			stack[ stackSize ].node = right;
+			stack[ stackSize ].tEnter = tRight;
+			stackSize++;
+		}
+	}
+}
+
+/*
+====================================================
+IsCoherentPacket
+====================================================
+*/
+bool IsCoherentPacket( const rayPacket_t & packet ) {
+	int first = -1;
+	for ( int lane = 0; lane < 4; lane++ ) {
+		if ( 0 == ( packet.laneMask & ( 1 << lane ) ) ) {
+			continue;
+		}
+		if ( first < 0 ) {
+			first = lane;
+			continue;
+		}
+
+		for ( int axis = 0; axis < 3; axis++ ) {
+			if ( ( packet.dir[ lane ][ axis ] < 0.0f ) != ( packet.dir[ first ][ axis ] < 0.0f ) ) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+====================================================
+packetTraversal_t
+
+The packet's rays in SoA form, along with the interval bounds of the frustum around them
+====================================================
+*/
+struct packetTraversal_t {
+	float startX[ 4 ];
+	float startY[ 4 ];
+	float startZ[ 4 ];
+	float invDirX[ 4 ];
+	float invDirY[ 4 ];
+	float invDirZ[ 4 ];
+
+	bool isCoherent;
+	bool isNegative[ 3 ];
+	float startLo[ 3 ];
+	float startHi[ 3 ];
+	float invDirLo[ 3 ];
+	float invDirHi[ 3 ];
+};
+
+/*
+====================================================
+SafeInverse
+
+Keeps axis aligned rays finite, the sign still picks the right slab planes
+====================================================
+*/
+static float SafeInverse( const float d ) {
+	if ( fabsf( d ) < 1e-12f ) {
+		return ( d < 0.0f ) ? -1e12f : 1e12f;
+	}
+	return 1.0f / d;
+}
+
+/*
+====================================================
+IntervalMul
+
+The range of a * b for a in [ aLo, aHi ] and b in [ bLo, bHi ]
+====================================================
+*/
+static void IntervalMul( const float aLo, const float aHi, const float bLo, const float bHi, float & lo, float & hi ) {
+	const float p0 = aLo * bLo;
+	const float p1 = aLo * bHi;
+	const float p2 = aHi * bLo;
+	const float p3 = aHi * bHi;
+	lo = std::min( std::min( p0, p1 ), std::min( p2, p3 ) );
+	hi = std::max( std::max( p0, p1 ), std::max( p2, p3 ) );
+}
+
+/*
+====================================================
+FrustumMissesBounds
+
+The frustum is every ray with a start and inverse direction inside the packet's ranges.
+If even the earliest entry into the slabs is after the latest exit, no ray can hit the bounds.
+====================================================
+*/
+static bool FrustumMissesBounds( const packetTraversal_t & traversal, const Bounds & bounds, const float maxT ) {
+	float enter = 0.0f;
+	float exit = maxT;
+	for ( int axis = 0; axis < 3; axis++ ) {
+		const float nearPlane = traversal.isNegative[ axis ] ? bounds.maxs[ axis ] : bounds.mins[ axis ];
+		const float farPlane = traversal.isNegative[ axis ] ? bounds.mins[ axis ] : bounds.maxs[ axis ];
+
+		float enterLo;
+		float enterHi;
+		IntervalMul( nearPlane - traversal.startHi[ axis ], nearPlane - traversal.startLo[ axis ], traversal.invDirLo[ axis ], traversal.invDirHi[ axis ], enterLo, enterHi );
+
+		float exitLo;
+		float exitHi;
+		IntervalMul( farPlane - traversal.startHi[ axis ], farPlane - traversal.startLo[ axis ], traversal.invDirLo[ axis ], traversal.invDirHi[ axis ], exitLo, exitHi );
+
+		enter = std::max( enter, enterLo );
+		exit = std::min( exit, exitHi );
+	}
+	return ( enter > exit );
+}
+
+/*
+====================================================
+SlabTestPacket
+
+Returns the lanes of laneMask that hit the bounds before their maxT, and where each one enters
+====================================================
+*/
+static int SlabTestPacket( const packetTraversal_t & traversal, const rayPacket_t & packet, const int laneMask, const Bounds & bounds, float * tEnter ) {
+#if defined( RAY_PACKET_SIMD )
+	const __m128 startX = _mm_loadu_ps( traversal.startX );
+	const __m128 startY = _mm_loadu_ps( traversal.startY );
+	const __m128 startZ = _mm_loadu_ps( traversal.startZ );
+	const __m128 invDirX = _mm_loadu_ps( traversal.invDirX );
+	const __m128 invDirY = _mm_loadu_ps( traversal.invDirY );
+	const __m128 invDirZ = _mm_loadu_ps( traversal.invDirZ );
+
+	const __m128 t0X = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.mins.x ), startX ), invDirX );
+	const __m128 t1X = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.maxs.x ), startX ), invDirX );
+	const __m128 t0Y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.mins.y ), startY ), invDirY );
+	const __m128 t1Y = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.maxs.y ), startY ), invDirY );
+	const __m128 t0Z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.mins.z ), startZ ), invDirZ );
+	const __m128 t1Z = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( bounds.maxs.z ), startZ ), invDirZ );
+
+	__m128 tNear = _mm_max_ps( _mm_min_ps( t0X, t1X ), _mm_min_ps( t0Y, t1Y ) );
+	tNear = _mm_max_ps( tNear, _mm_min_ps( t0Z, t1Z ) );
+	tNear = _mm_max_ps( tNear, _mm_setzero_ps() );
+
+	__m128 tFar = _mm_min_ps( _mm_max_ps( t0X, t1X ), _mm_max_ps( t0Y, t1Y ) );
+	tFar = _mm_min_ps( tFar, _mm_max_ps( t0Z, t1Z ) );
+	tFar = _mm_min_ps( tFar, _mm_loadu_ps( packet.maxT ) );
+
+	_mm_storeu_ps( tEnter, tNear );
+	return ( _mm_movemask_ps( _mm_cmple_ps( tNear, tFar ) ) & laneMask );
+#else
+	int hitMask = 0;
+	for ( int lane = 0; lane < 4; lane++ ) {
+		int axis;
+		if ( ( laneMask & ( 1 << lane ) ) && bounds.DoesIntersectRay( packet.start[ lane ], packet.dir[ lane ], packet.maxT[ lane ], tEnter[ lane ], axis ) ) {
+			hitMask |= ( 1 << lane );
+		}
+	}
+	return hitMask;
+#endif
+}
+
+/*
+====================================================
+NearestEntry
+====================================================
+*/
+static float NearestEntry( const int laneMask, const float * tEnter ) {
+	float nearest = 1e6f;
+	for ( int lane = 0; lane < 4; lane++ ) {
+		if ( laneMask & ( 1 << lane ) ) {
+			nearest = std::min( nearest, tEnter[ lane ] );
+		}
+	}
+	return nearest;
+}
+
+/*
+====================================================
+RayCastBoundsTreePacket
+====================================================
+*/
+void RayCastBoundsTreePacket( const std::vector< boundsTreeNode_t > & nodes, rayPacket_t & packet, boundsTreePacketFn_t fn, void * data ) {
+	if ( nodes.empty() || 0 == ( packet.laneMask & 15 ) ) {
+		return;
+	}
+
+	// Unused lanes copy a used one, so they can't widen the frustum
+	int firstLane = 0;
+	while ( 0 == ( packet.laneMask & ( 1 << firstLane ) ) ) {
+		firstLane++;
+	}
+
+	packetTraversal_t traversal;
+	traversal.isCoherent = IsCoherentPacket( packet );
+	for ( int axis = 0; axis < 3; axis++ ) {
+		traversal.isNegative[ axis ] = ( packet.dir[ firstLane ][ axis ] < 0.0f );
+		traversal.startLo[ axis ] = 1e6f;
+		traversal.startHi[ axis ] = -1e6f;
+		traversal.invDirLo[ axis ] = 1e30f;
+		traversal.invDirHi[ axis ] = -1e30f;
+	}
+	for ( int lane = 0; lane < 4; lane++ ) {
+		const int src = ( packet.laneMask & ( 1 << lane ) ) ? lane : firstLane;
+		const Vec3 & start = packet.start[ src ];
+		const Vec3 invDir = Vec3( SafeInverse( packet.dir[ src ].x ), SafeInverse( packet.dir[ src ].y ), SafeInverse( packet.dir[ src ].z ) );
+
+		traversal.startX[ lane ] = start.x;
+		traversal.startY[ lane ] = start.y;
+		traversal.startZ[ lane ] = start.z;
+		traversal.invDirX[ lane ] = invDir.x;
+		traversal.invDirY[ lane ] = invDir.y;
+		traversal.invDirZ[ lane ] = invDir.z;
+
+		for ( int axis = 0; axis < 3; axis++ ) {
+			traversal.startLo[ axis ] = std::min( traversal.startLo[ axis ], start[ axis ] );
+			traversal.startHi[ axis ] = std::max( traversal.startHi[ axis ], start[ axis ] );
+			traversal.invDirLo[ axis ] = std::min( traversal.invDirLo[ axis ], invDir[ axis ] );
+			traversal.invDirHi[ axis ] = std::max( traversal.invDirHi[ axis ], invDir[ axis ] );
+		}
+	}
+
+	struct packetStackEntry_t {
+		int node;
+		int laneMask;
+		float tEnter[ 4 ];
+	};
+	packetStackEntry_t stack[ 64 ];
+	int stackSize = 0;
+
+	stack[ 0 ].node = 0;
+	stack[ 0 ].laneMask = SlabTestPacket( traversal, packet, packet.laneMask & 15, nodes[ 0 ].bounds, stack[ 0 ].tEnter );
+	if ( 0 == stack[ 0 ].laneMask ) {
+		return;
+	}
+	stackSize++;
+
+	while ( stackSize > 0 ) {
+		const packetStackEntry_t entry = stack[ --stackSize ];
+
+		// Drop the rays that found a hit closer than where they enter this node
+		int laneMask = 0;
+		float maxT = 0.0f;
+		for ( int lane = 0; lane < 4; lane++ ) {
+			if ( ( entry.laneMask & ( 1 << lane ) ) && entry.tEnter[ lane ] <= packet.maxT[ lane ] ) {
+				laneMask |= ( 1 << lane );
+				maxT = std::max( maxT, packet.maxT[ lane ] );
+			}
+		}
+		if ( 0 == laneMask ) {
+			continue;
+		}
+
+		const boundsTreeNode_t & node = nodes[ entry.node ];
+		if ( node.count > 0 ) {
+			fn( node.first, node.count, packet, laneMask, data );
+			continue;
+		}
+
+		packetStackEntry_t children[ 2 ];
+		children[ 0 ].node = entry.node + 1;
+		children[ 1 ].node = node.first;
+		for ( int i = 0; i < 2; i++ ) {
+			const Bounds & bounds = nodes[ children[ i ].node ].bounds;
+			if ( traversal.isCoherent && FrustumMissesBounds( traversal, bounds, maxT ) ) {
+				children[ i ].laneMask = 0;
+				continue;
+			}
+			children[ i ].laneMask = SlabTestPacket( traversal, packet, laneMask, bounds, children[ i ].tEnter );
+		}
+
+		// Push the far child first, so the near one is visited first
+		int nearIdx = 0;
+		if ( children[ 0 ].laneMask && children[ 1 ].laneMask ) {
+			if ( NearestEntry( children[ 1 ].laneMask, children[ 1 ].tEnter ) < NearestEntry( children[ 0 ].laneMask, children[ 0 ].tEnter ) ) {
+				nearIdx = 1;
+			}
+		}
+		const int farIdx = 1 - nearIdx;
+		if ( children[ farIdx ].laneMask ) {
+			stack[ stackSize++ ] = children[ farIdx ];
+		}
+		if ( children[ nearIdx ].laneMask ) {
+			stack[ stackSize++ ] = children[ nearIdx ];
+		}
+	}
+}
+
+/*
+====================================================
+WorldBoundsToModelSpace
+====================================================
+*/
+Bounds WorldBoundsToModelSpace( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient ) {
+	const Quat invOrient = orient.Inverse();
+
+	Bounds localBounds;
+	for ( int i = 0; i < 8; i++ ) {
+		Vec3 corner;
+		corner.x = ( i & 1 ) ? worldBounds.maxs.x : worldBounds.mins.x;
+		corner.y = ( i & 2 ) ? worldBounds.maxs.y : worldBounds.mins.y;
+		corner.z = ( i & 4 ) ? worldBounds.maxs.z : worldBounds.mins.z;
+		localBounds.Expand( invOrient.RotatePoint( corner - pos ) );
+	}
+	return localBounds;
+}
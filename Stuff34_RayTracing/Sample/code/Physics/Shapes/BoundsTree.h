@@ -0,0 +1,63 @@
+//
+//	BoundsTree.h
+//
+#pragma once
+#include "Math/Bounds.h"
+#include "Math/Quat.h"
+#include <vector>
+
+/*
+====================================================
+boundsTreeNode_t
+
+A flat bounding volume hierarchy over the parts of a shape.  Nodes are stored depth first,
+so an inner node's left child is the next node.  Leaves own a contiguous range of slots.
+====================================================
+*/
+struct boundsTreeNode_t {
+	Bounds bounds;
+	int first;	// leaf: first slot, inner node: index of the right child
+	int count;	// leaf: number of slots, inner node: zero
+};
+
+// order[ slot ] is the item stored in each slot, callers reorder their items to match
+void BuildBoundsTree( const Bounds * itemBounds, const int numItems, const int maxLeafItems, std::vector< boundsTreeNode_t > & nodes, std::vector< int > & order );
+
+// Appends the slots of every item whose leaf overlaps the bounds
+void QueryBoundsTree( const std::vector< boundsTreeNode_t > & nodes, const Bounds & bounds, std::vector< int > & slots );
+
+// Called for every leaf the ray reaches, returns the new maxT so closer hits cull the rest of the tree
+typedef float ( *boundsTreeRayFn_t )( const int first, const int count, const float maxT, void * data );
+
+// Visits the leaves along the segment start to start + dir * maxT, nearest first
+void RayCastBoundsTree( const std::vector< boundsTreeNode_t > & nodes, const Vec3 & start, const Vec3 & dir, const float maxT, boundsTreeRayFn_t fn, void * data );
+
+/*
+====================================================
+rayPacket_t
+
+Up to four rays traced through a tree together.  The rays should start close to each other
+and head the same way, like a shotgun spread or a fan of visibility checks, so that they
+visit the same nodes.
+====================================================
+*/
+struct rayPacket_t {
+	Vec3 start[ 4 ];
+	Vec3 dir[ 4 ];
+	float maxT[ 4 ];	// the leaf callback lowers these as it finds hits
+	int laneMask;		// bit i is set if ray i is in use
+};
+
+// True when the rays' directions have the same sign on every axis, which is what the frustum test needs
+bool IsCoherentPacket( const rayPacket_t & packet );
+
+// Called for every leaf the packet reaches, laneMask is the rays that reached it
+typedef void ( *boundsTreePacketFn_t )( const int first, const int count, rayPacket_t & packet, const int laneMask, void * data );
+
+// Visits the leaves along the packet's rays.  Coherent packets first cull nodes against the frustum around
+// all the rays, then every packet runs the slab test on all its rays at once.  Rays drop out of the packet
+// in the subtrees they miss.
+void RayCastBoundsTreePacket( const std::vector< boundsTreeNode_t > & nodes, rayPacket_t & packet, boundsTreePacketFn_t fn, void * data );
+
+// The model space bounds of world space bounds, for a shape placed at pos and orient
+Bounds WorldBoundsToModelSpace( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient );
@@ -1,4 +1,123 @@
 //
 //  ShapeBase.cpp
 //
-#include "Physics/Shapes/ShapeBase.h"
\ No newline at end of file
+#include "Physics/Shapes/ShapeBase.h"
+#include <math.h>
+
+/*
+========================================================================================================
+
+Shape
+
+========================================================================================================
+*/
+
+/*
+====================================================
+Shape::RayCastPacket
+
+Shapes without a packet path cast the rays one at a time
+====================================================
+*/
+int Shape::RayCastPacket( rayPacket_t & packet, Vec3 * normals ) const {
+	int hitMask = 0;
+	for ( int lane = 0; lane < 4; lane++ ) {
+		if ( 0 == ( packet.laneMask & ( 1 << lane ) ) ) {
+			continue;
+		}
+
+		float t;
+		if ( RayCast( packet.start[ lane ], packet.dir[ lane ], packet.maxT[ lane ], t, normals[ lane ] ) ) {
+			packet.maxT[ lane ] = t;
+			hitMask |= ( 1 << lane );
+		}
+	}
+	return hitMask;
+}
+
+/*
+========================================================================================================
+
+Ray Casts
+
+========================================================================================================
+*/
+
+/*
+====================================================
+RayCastSphere
+====================================================
+*/
+bool RayCastSphere( const Vec3 & start, const Vec3 & dir, const Vec3 & center, const float radius, const float maxT, float & t, Vec3 & normal ) {
+	const Vec3 m = start - center;
+	const float c = m.Dot( m ) - radius * radius;
+	if ( c <= 0.0f ) {
+		// Started inside
+		t = 0.0f;
+		normal = dir * -1.0f;
+		normal.Normalize();
+		return true;
+	}
+
+	const float a = dir.Dot( dir );
+	const float b = m.Dot( dir );
+	if ( b >= 0.0f || a <= 0.0f ) {
+		// Heading away from the sphere
+		return false;
+	}
+
+	const float delta = b * b - a * c;
+	if ( delta < 0.0f ) {
+		return false;
+	}
+
+	const float hitT = ( -b - sqrtf( delta ) ) / a;
+	if ( hitT > maxT ) {
+		return false;
+	}
+
+	t = hitT;
+	normal = start + dir * hitT - center;
+	normal.Normalize();
+	return true;
+}
+
+/*
+====================================================
+RayCastTriangle
+
+Moller-Trumbore, hits either side of the triangle
+====================================================
+*/
+bool RayCastTriangle( const Vec3 & start, const Vec3 & dir, const Vec3 & a, const Vec3 & b, const Vec3 & c, const float minT, const float maxT, float & t, Vec3 & normal ) {
+	const Vec3 ab = b - a;
+	const Vec3 ac = c - a;
+	const Vec3 p = dir.Cross( ac );
+	const float det = ab.Dot( p );
+	if ( fabsf( det ) < 1e-12f ) {
+		return false;
+	}
+	const float invDet = 1.0f / det;
+
+	const Vec3 s = start - a;
+	const float u = s.Dot( p ) * invDet;
+	if ( u < 0.0f || u > 1.0f ) {
+		return false;
+	}
+
+	const Vec3 q = s.Cross( ab );
+	const float v = dir.Dot( q ) * invDet;
+	if ( v < 0.0f || u + v > 1.0f ) {
+		return false;
+	}
+
+	const float hitT = ac.Dot( q ) * invDet;
+	if ( hitT < minT || hitT > maxT ) {
+		return false;
+	}
+
+	t = hitT;
+	normal = ab.Cross( ac );
+	normal.Normalize();
+	return true;
+}
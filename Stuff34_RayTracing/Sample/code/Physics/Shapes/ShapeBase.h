@@ -6,6 +6,7 @@
 #include "Math/Quat.h"
 #include "Math/Matrix.h"
 #include "Math/Bounds.h"
+#include "Physics/Shapes/BoundsTree.h"
 #include <vector>
 
 /*
@@ -15,6 +16,8 @@ Shape
 */
 class Shape {
 public:
+	virtual ~Shape() {}
+
 	virtual Mat3 InertiaTensor() const = 0;
 
 	virtual Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const = 0;
@@ -27,6 +30,9 @@ public:
 		SHAPE_BOX,
 		SHAPE_CONVEX,
 		SHAPE_CAPSULE,
+		SHAPE_MESH,
+		SHAPE_HEIGHTFIELD,
+		SHAPE_COMPOUND,
 	};
 	virtual shapeType_t GetType() const = 0;
 
@@ -34,6 +40,18 @@ public:
 
 	virtual float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const { return 0.0f; }
 
+	// Model space ray cast, dir doesn't need to be normalized and hits are between start and start + dir * maxT.
+	// Rays that start inside a solid shape hit it at t = 0.
+	virtual bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const = 0;
+
+	// Model space ray casts for the packet's rays.  A hit lowers that ray's maxT to the hit and
+	// writes its normal, the return value is the mask of rays that hit.
+	virtual int RayCastPacket( rayPacket_t & packet, Vec3 * normals ) const;
+
 protected:
 	Vec3 m_centerOfMass;
 };
+
+// Ray casts against the primitives the shapes are made of, hits are accepted between minT and maxT
+bool RayCastSphere( const Vec3 & start, const Vec3 & dir, const Vec3 & center, const float radius, const float maxT, float & t, Vec3 & normal );
+bool RayCastTriangle( const Vec3 & start, const Vec3 & dir, const Vec3 & a, const Vec3 & b, const Vec3 & c, const float minT, const float maxT, float & t, Vec3 & normal );
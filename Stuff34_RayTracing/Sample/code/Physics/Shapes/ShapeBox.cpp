@@ -133,6 +133,29 @@ Bounds ShapeBox::GetBounds() const {
 	return m_bounds;
 }
 
+/*
+====================================================
+ShapeBox::RayCast
+====================================================
+*/
+bool ShapeBox::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	int axis;
+	if ( !m_bounds.DoesIntersectRay( start, dir, maxT, t, axis ) ) {
+		return false;
+	}
+
+	if ( axis < 0 ) {
+		// Started inside
+		normal = dir * -1.0f;
+		normal.Normalize();
+		return true;
+	}
+
+	normal.Zero();
+	normal[ axis ] = ( dir[ axis ] > 0.0f ) ? -1.0f : 1.0f;
+	return true;
+}
+
 /*
 ====================================================
 ShapeBox::FastestLinearSpeed
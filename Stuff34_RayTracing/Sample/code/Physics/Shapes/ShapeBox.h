@@ -25,6 +25,8 @@ public:
 
 	float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const override;
 
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
 	shapeType_t GetType() const override { return SHAPE_BOX; }
 
 public:
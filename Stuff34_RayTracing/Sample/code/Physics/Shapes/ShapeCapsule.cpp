@@ -191,4 +191,57 @@ Bounds ShapeCapsule::GetBounds() const {
 	tmp.Expand( b + Vec3( m_radius ) );
 	tmp.Expand( b - Vec3( m_radius ) );
 	return tmp;
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+ShapeCapsule::RayCast
+
+The nearest hit of the cylinder and the two end spheres
+====================================================
+*/
+bool ShapeCapsule::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	if ( !IsExternal( m_radius, m_height, start ) ) {
+		t = 0.0f;
+		normal = dir * -1.0f;
+		normal.Normalize();
+		return true;
+	}
+
+	const float halfHeight = m_height * 0.5f;
+	bool didHit = false;
+	float bestT = maxT;
+
+	// Infinite cylinder around z, the hit only counts between the end caps
+	const float a = dir.x * dir.x + dir.y * dir.y;
+	const float b = start.x * dir.x + start.y * dir.y;
+	const float c = start.x * start.x + start.y * start.y - m_radius * m_radius;
+	const float delta = b * b - a * c;
+	if ( a > 1e-12f && delta >= 0.0f ) {
+		const float hitT = ( -b - sqrtf( delta ) ) / a;
+		const float z = start.z + dir.z * hitT;
+		if ( hitT >= 0.0f && hitT <= bestT && z >= -halfHeight && z <= halfHeight ) {
+			bestT = hitT;
+			normal = Vec3( start.x + dir.x * hitT, start.y + dir.y * hitT, 0.0f );
+			normal.Normalize();
+			didHit = true;
+		}
+	}
+
+	for ( int i = 0; i < 2; i++ ) {
+		const Vec3 center = Vec3( 0.0f, 0.0f, ( 0 == i ) ? -halfHeight : halfHeight );
+
+		float hitT;
+		Vec3 hitNormal;
+		if ( RayCastSphere( start, dir, center, m_radius, bestT, hitT, hitNormal ) ) {
+			bestT = hitT;
+			normal = hitNormal;
+			didHit = true;
+		}
+	}
+
+	if ( didHit ) {
+		t = bestT;
+	}
+	return didHit;
+}
@@ -27,6 +27,8 @@ public:
 	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
 	Bounds GetBounds() const override;
 
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
 	shapeType_t GetType() const override { return SHAPE_CAPSULE; }
 
 public:
@@ -0,0 +1,230 @@
+//
+//  ShapeCompound.cpp
+//
+#include "Physics/Shapes/ShapeCompound.h"
+
+/*
+========================================================================================================
+
+ShapeCompound
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ShapeCompound::Build
+====================================================
+*/
+void ShapeCompound::Build( const compoundChild_t * children, const int num ) {
+	m_children.clear();
+	m_nodes.clear();
+	m_bounds.Clear();
+	m_centerOfMass.Zero();
+	m_inertiaTensor.Zero();
+
+	if ( num <= 0 ) {
+		printf( "WARNING: ShapeCompound: no children\n" );
+		return;
+	}
+
+	float totalMass = 0.0f;
+	for ( int i = 0; i < num; i++ ) {
+		assert( NULL != children[ i ].shape );
+		totalMass += children[ i ].mass;
+	}
+	if ( totalMass <= 0.0f ) {
+		printf( "WARNING: ShapeCompound: children have no mass\n" );
+		return;
+	}
+
+	// The center of mass is the mass weighted average of the children's centers of mass
+	for ( int i = 0; i < num; i++ ) {
+		const compoundChild_t & child = children[ i ];
+		const Vec3 childCenter = child.position + child.orientation.RotatePoint( child.shape->GetCenterOfMass() );
+		m_centerOfMass += childCenter * ( child.mass / totalMass );
+	}
+
+	// Rotate each child's tensor into the compound and move it to the compound's center of mass.
+	// The tensors are per unit mass, so each one is weighted by its share of the mass.
+	for ( int i = 0; i < num; i++ ) {
+		const compoundChild_t & child = children[ i ];
+		const Mat3 orient = child.orientation.ToMat3();
+		const Mat3 childTensor = orient * child.shape->InertiaTensor() * orient.Transpose();
+
+		const Vec3 R = child.position + child.orientation.RotatePoint( child.shape->GetCenterOfMass() ) - m_centerOfMass;
+		const float R2 = R.GetLengthSqr();
+		Mat3 patTensor;
+		patTensor.rows[ 0 ] = Vec3(	R2 - R.x * R.x,		-R.x * R.y,		-R.x * R.z );
+		patTensor.rows[ 1 ] = Vec3(		-R.y * R.x,	R2 - R.y * R.y,		-R.y * R.z );
+		patTensor.rows[ 2 ] = Vec3(		-R.z * R.x,		-R.z * R.y,	R2 - R.z * R.z );
+
+		m_inertiaTensor += ( childTensor + patTensor ) * ( child.mass / totalMass );
+	}
+
+	std::vector< Bounds > childBounds( num );
+	for ( int i = 0; i < num; i++ ) {
+		childBounds[ i ] = children[ i ].shape->GetBounds( children[ i ].position, children[ i ].orientation );
+		m_bounds.Expand( childBounds[ i ] );
+	}
+
+	std::vector< int > order;
+	BuildBoundsTree( childBounds.data(), num, MAX_LEAF_CHILDREN, m_nodes, order );
+
+	// Store the children in leaf order, so each leaf owns a contiguous range
+	m_children.resize( num );
+	for ( int i = 0; i < num; i++ ) {
+		m_children[ i ] = children[ order[ i ] ];
+	}
+}
+
+/*
+====================================================
+ShapeCompound::GetChildTransform
+====================================================
+*/
+void ShapeCompound::GetChildTransform( const int idx, const Vec3 & pos, const Quat & orient, Vec3 & childPos, Quat & childOrient ) const {
+	const compoundChild_t & child = m_children[ idx ];
+	childPos = pos + orient.RotatePoint( child.position );
+	childOrient = orient * child.orientation;
+}
+
+/*
+====================================================
+ShapeCompound::QueryChildren
+====================================================
+*/
+void ShapeCompound::QueryChildren( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient, std::vector< int > & children ) const {
+	QueryBoundsTree( m_nodes, WorldBoundsToModelSpace( worldBounds, pos, orient ), children );
+}
+
+/*
+====================================================
+ShapeCompound::Support
+
+The support of the union is the furthest of the children's supports
+====================================================
+*/
+Vec3 ShapeCompound::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	Vec3 maxPt;
+	float maxDist = -1e6f;
+	for ( int i = 0; i < m_children.size(); i++ ) {
+		Vec3 childPos;
+		Quat childOrient;
+		GetChildTransform( i, pos, orient, childPos, childOrient );
+
+		const Vec3 pt = m_children[ i ].shape->Support( dir, childPos, childOrient, bias );
+		const float dist = dir.Dot( pt );
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			maxPt = pt;
+		}
+	}
+	return maxPt;
+}
+
+/*
+====================================================
+ShapeCompound::GetBounds
+====================================================
+*/
+Bounds ShapeCompound::GetBounds( const Vec3 & pos, const Quat & orient ) const {
+	Bounds bounds;
+	for ( int i = 0; i < m_children.size(); i++ ) {
+		Vec3 childPos;
+		Quat childOrient;
+		GetChildTransform( i, pos, orient, childPos, childOrient );
+		bounds.Expand( m_children[ i ].shape->GetBounds( childPos, childOrient ) );
+	}
+	return bounds;
+}
+
+/*
+====================================================
+ShapeCompound::FastestLinearSpeed
+
+Each child moves with the rotation about the compound's center of mass,
+plus its own spin about its center of mass
+====================================================
+*/
+float ShapeCompound::FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const {
+	float maxSpeed = 0.0f;
+	for ( int i = 0; i < m_children.size(); i++ ) {
+		const compoundChild_t & child = m_children[ i ];
+		const Vec3 r = child.position + child.orientation.RotatePoint( child.shape->GetCenterOfMass() ) - m_centerOfMass;
+		float speed = dir.Dot( angularVelocity.Cross( r ) );
+
+		const Quat invOrient = child.orientation.Inverse();
+		speed += child.shape->FastestLinearSpeed( invOrient.RotatePoint( angularVelocity ), invOrient.RotatePoint( dir ) );
+		if ( speed > maxSpeed ) {
+			maxSpeed = speed;
+		}
+	}
+	return maxSpeed;
+}
+
+/*
+====================================================
+compoundRayCast_t
+====================================================
+*/
+struct compoundRayCast_t {
+	const ShapeCompound * compound;
+	Vec3 start;
+	Vec3 dir;
+	bool didHit;
+	float t;
+	Vec3 normal;
+};
+
+/*
+====================================================
+RayCastCompoundChildren
+====================================================
+*/
+static float RayCastCompoundChildren( const int first, const int count, const float maxT, void * data ) {
+	compoundRayCast_t * ray = (compoundRayCast_t *)data;
+
+	float closestT = maxT;
+	for ( int slot = first; slot < first + count; slot++ ) {
+		const compoundChild_t & child = ray->compound->m_children[ slot ];
+
+		// Move the ray into the child's model space, t is unchanged since the transform is rigid
+		const Quat invOrient = child.orientation.Inverse();
+		const Vec3 start = invOrient.RotatePoint( ray->start - child.position );
+		const Vec3 dir = invOrient.RotatePoint( ray->dir );
+
+		float t;
+		Vec3 normal;
+		if ( !child.shape->RayCast( start, dir, closestT, t, normal ) ) {
+			continue;
+		}
+
+		ray->didHit = true;
+		ray->t = t;
+		ray->normal = child.orientation.RotatePoint( normal );
+		closestT = t;
+	}
+	return closestT;
+}
+
+/*
+====================================================
+ShapeCompound::RayCast
+====================================================
+*/
+bool ShapeCompound::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	compoundRayCast_t ray;
+	ray.compound = this;
+	ray.start = start;
+	ray.dir = dir;
+	ray.didHit = false;
+	ray.t = maxT;
+
+	RayCastBoundsTree( m_nodes, start, dir, maxT, RayCastCompoundChildren, &ray );
+	if ( ray.didHit ) {
+		t = ray.t;
+		normal = ray.normal;
+	}
+	return ray.didHit;
+}
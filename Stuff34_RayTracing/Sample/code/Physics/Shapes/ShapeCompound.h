@@ -0,0 +1,68 @@
+//
+//	ShapeCompound.h
+//
+#pragma once
+#include "Physics/Shapes/ShapeBase.h"
+#include "Physics/Shapes/BoundsTree.h"
+
+/*
+====================================================
+compoundChild_t
+
+The child shape is placed in the compound's model space by position and orientation.
+Mass is relative to the other children, the body's mass is still set by the body.
+The compound doesn't own the child shapes.
+====================================================
+*/
+struct compoundChild_t {
+	compoundChild_t() : shape( NULL ), position( 0.0f ), orientation( 0, 0, 0, 1 ), mass( 1.0f ) {}
+
+	Shape * shape;
+	Vec3 position;
+	Quat orientation;
+	float mass;
+};
+
+/*
+====================================================
+ShapeCompound
+
+Several shapes rigidly welded into one body, so they need one broadphase proxy and no
+constraints.  The children are kept in a bounding volume hierarchy so the narrowphase only
+visits the ones near the other body.
+====================================================
+*/
+class ShapeCompound : public Shape {
+public:
+	explicit ShapeCompound( const compoundChild_t * children, const int num ) {
+		Build( children, num );
+	}
+	void Build( const compoundChild_t * children, const int num );
+
+	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+
+	Mat3 InertiaTensor() const override { return m_inertiaTensor; }
+
+	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
+	Bounds GetBounds() const override { return m_bounds; }
+
+	float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const override;
+
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
+	shapeType_t GetType() const override { return SHAPE_COMPOUND; }
+
+	// Appends the children whose bounds overlap the world space bounds, when the compound is placed at pos and orient
+	void QueryChildren( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient, std::vector< int > & children ) const;
+
+	// Where a child ends up when the compound is placed at pos and orient
+	void GetChildTransform( const int idx, const Vec3 & pos, const Quat & orient, Vec3 & childPos, Quat & childOrient ) const;
+
+	static const int MAX_LEAF_CHILDREN = 2;
+
+public:
+	std::vector< compoundChild_t > m_children;	// sorted so each leaf's children are contiguous
+	std::vector< boundsTreeNode_t > m_nodes;
+	Mat3 m_inertiaTensor;
+	Bounds m_bounds;
+};
@@ -3,6 +3,16 @@
 //
 #include "Physics/Shapes/ShapeConvex.h"
 #include "Math/Random.h"
+#include "JobSystem/JobSystem.h"
+#include <float.h>
+
+#define SUPPORT_SIMD	// comment out to use the scalar scan for the support mapping
+#define HULL_QUICKHULL	// comment out to grow hulls one point at a time with AddPoint
+#define CONVEX_COOKED_CACHE	// comment out to always build hulls from scratch instead of loading them from generated/
+
+#if defined( SUPPORT_SIMD )
+#include <xmmintrin.h>
+#endif
 
 /*
 ========================================================================================================
@@ -312,15 +322,822 @@ static void BuildTetrahedron( const Vec3 * verts, const int num, std::vector< Ve
 	hullTris.push_back( tri );
 }
 
-void BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris ) {
-	if ( verts.size() < 4 ) {
+/*
+========================================================================================================
+
+QuickHull
+
+Each face keeps a conflict list of the points in front of it.  The furthest of those points is
+added by walking the faces it can see across their adjacency to find the horizon, and only the
+points orphaned by the removed faces get tested against the new ones.  Points within epsilon of
+a face count as being on it, and coplanar triangles are merged and re-triangulated at the end.
+
+========================================================================================================
+*/
+
+struct qhFace_t {
+	int v[ 3 ];
+	int adj[ 3 ];		// adj[ i ] is the face across the edge v[ i ] -> v[ ( i + 1 ) % 3 ]
+	Vec3 normal;
+	float dist;
+	int conflictHead;	// first point in front of this face, the rest are chained through qhHull_t::nextConflict
+	int furthestPt;
+	float furthestDist;
+	int visibleMark;
+	bool isValid;
+};
+
+struct qhEdge_t {
+	int face;
+	int edge;
+};
+
+struct qhHull_t {
+	const Vec3 * pts;
+	int numPts;
+	float epsilon;
+	int mark;
+
+	std::vector< qhFace_t > faces;
+	std::vector< int > nextConflict;
+	std::vector< int > visibleFaces;
+	std::vector< qhEdge_t > horizon;
+	std::vector< int > orphans;
+};
+
+static float DistanceToFace( const qhHull_t & hull, const qhFace_t & face, const Vec3 & pt ) {
+	return face.normal.Dot( pt ) - face.dist;
+}
+
+static int AddFace( qhHull_t & hull, const int a, const int b, const int c ) {
+	const Vec3 & ptA = hull.pts[ a ];
+	const Vec3 & ptB = hull.pts[ b ];
+	const Vec3 & ptC = hull.pts[ c ];
+
+	qhFace_t face;
+	face.v[ 0 ] = a;
+	face.v[ 1 ] = b;
+	face.v[ 2 ] = c;
+	face.adj[ 0 ] = -1;
+	face.adj[ 1 ] = -1;
+	face.adj[ 2 ] = -1;
+	face.normal = ( ptB - ptA ).Cross( ptC - ptA );
+	const float length = face.normal.GetMagnitude();
+	if ( length > 0.0f ) {
+		face.normal /= length;
+	}
+	face.dist = face.normal.Dot( ( ptA + ptB + ptC ) * ( 1.0f / 3.0f ) );
+	face.conflictHead = -1;
+	face.furthestPt = -1;
+	face.furthestDist = 0.0f;
+	face.visibleMark = 0;
+	face.isValid = true;
+
+	hull.faces.push_back( face );
+	return (int)hull.faces.size() - 1;
+}
+
+static void AddConflict( qhHull_t & hull, const int faceIdx, const int ptIdx, const float dist ) {
+	qhFace_t & face = hull.faces[ faceIdx ];
+	hull.nextConflict[ ptIdx ] = face.conflictHead;
+	face.conflictHead = ptIdx;
+	if ( face.furthestPt < 0 || dist > face.furthestDist ) {
+		face.furthestPt = ptIdx;
+		face.furthestDist = dist;
+	}
+}
+
+/*
+====================================================
+AssignToFaces
+
+Puts the point in the conflict list of the face it is furthest in front of, points that aren't
+in front of any of the faces are inside the hull and get dropped.
+====================================================
+*/
+static void AssignToFaces( qhHull_t & hull, const int ptIdx, const int firstFace, const int endFace ) {
+	int bestFace = -1;
+	float bestDist = hull.epsilon;
+	for ( int i = firstFace; i < endFace; i++ ) {
+		const float dist = DistanceToFace( hull, hull.faces[ i ], hull.pts[ ptIdx ] );
+		if ( dist > bestDist ) {
+			bestDist = dist;
+			bestFace = i;
+		}
+	}
+
+	if ( bestFace >= 0 ) {
+		AddConflict( hull, bestFace, ptIdx, bestDist );
+	}
+}
+
+/*
+====================================================
+RemoveConflict
+
+Drops a point the hull failed to expand to, it is treated as lying on the surface.
+====================================================
+*/
+static void RemoveConflict( qhHull_t & hull, const int faceIdx, const int ptIdx ) {
+	qhFace_t & face = hull.faces[ faceIdx ];
+
+	int prev = -1;
+	for ( int pt = face.conflictHead; pt >= 0; pt = hull.nextConflict[ pt ] ) {
+		if ( pt == ptIdx ) {
+			if ( prev < 0 ) {
+				face.conflictHead = hull.nextConflict[ pt ];
+			} else {
+				hull.nextConflict[ prev ] = hull.nextConflict[ pt ];
+			}
+			break;
+		}
+		prev = pt;
+	}
+
+	face.furthestPt = -1;
+	face.furthestDist = 0.0f;
+	for ( int pt = face.conflictHead; pt >= 0; pt = hull.nextConflict[ pt ] ) {
+		const float dist = DistanceToFace( hull, face, hull.pts[ pt ] );
+		if ( face.furthestPt < 0 || dist > face.furthestDist ) {
+			face.furthestPt = pt;
+			face.furthestDist = dist;
+		}
+	}
+}
+
+/*
+====================================================
+FindHorizon
+
+Same walk as the EPA, entering each visible face through the edge it was reached by and leaving
+through the next two edges in winding order gives the horizon as a closed counter clockwise loop.
+====================================================
+*/
+static void FindHorizon( qhHull_t & hull, const Vec3 & eye, const int faceIdx, const int edgeIdx ) {
+	qhFace_t & face = hull.faces[ faceIdx ];
+	if ( face.visibleMark == hull.mark ) {
+		return;
+	}
+
+	if ( DistanceToFace( hull, face, eye ) <= hull.epsilon ) {
+		qhEdge_t edge;
+		edge.face = faceIdx;
+		edge.edge = edgeIdx;
+		hull.horizon.push_back( edge );
 		return;
 	}
 
+	face.visibleMark = hull.mark;
+	hull.visibleFaces.push_back( faceIdx );
+
+	for ( int i = 1; i < 3; i++ ) {
+		const int edge = ( edgeIdx + i ) % 3;
+		const int neighbor = hull.faces[ faceIdx ].adj[ edge ];
+		const qhFace_t & next = hull.faces[ neighbor ];
+		for ( int j = 0; j < 3; j++ ) {
+			if ( next.adj[ j ] == faceIdx ) {
+				FindHorizon( hull, eye, neighbor, j );
+				break;
+			}
+		}
+	}
+}
+
+/*
+====================================================
+AddEyePoint
+
+Replaces the faces visible from the eye point with a fan of faces connecting it to the horizon.
+Returns false, leaving the hull untouched, if the horizon isn't a simple loop.
+====================================================
+*/
+static bool AddEyePoint( qhHull_t & hull, const int seedIdx, const int eyeIdx ) {
+	const Vec3 & eye = hull.pts[ eyeIdx ];
+
+	hull.mark++;
+	hull.visibleFaces.clear();
+	hull.horizon.clear();
+
+	hull.faces[ seedIdx ].visibleMark = hull.mark;
+	hull.visibleFaces.push_back( seedIdx );
+	for ( int i = 0; i < 3; i++ ) {
+		const int neighbor = hull.faces[ seedIdx ].adj[ i ];
+		const qhFace_t & next = hull.faces[ neighbor ];
+		for ( int j = 0; j < 3; j++ ) {
+			if ( next.adj[ j ] == seedIdx ) {
+				FindHorizon( hull, eye, neighbor, j );
+				break;
+			}
+		}
+	}
+
+	const int numHorizon = (int)hull.horizon.size();
+	if ( numHorizon < 3 ) {
+		return false;
+	}
+	for ( int i = 0; i < numHorizon; i++ ) {
+		const qhEdge_t & edge = hull.horizon[ i ];
+		const qhEdge_t & next = hull.horizon[ ( i + 1 ) % numHorizon ];
+		const int end = hull.faces[ edge.face ].v[ edge.edge ];
+		const int start = hull.faces[ next.face ].v[ ( next.edge + 1 ) % 3 ];
+		if ( end != start ) {
+			return false;
+		}
+	}
+
+	// Retire the visible faces and collect the points they were holding
+	hull.orphans.clear();
+	for ( int i = 0; i < hull.visibleFaces.size(); i++ ) {
+		qhFace_t & face = hull.faces[ hull.visibleFaces[ i ] ];
+		face.isValid = false;
+		for ( int pt = face.conflictHead; pt >= 0; pt = hull.nextConflict[ pt ] ) {
+			if ( pt != eyeIdx ) {
+				hull.orphans.push_back( pt );
+			}
+		}
+		face.conflictHead = -1;
+	}
+
+	// Build the fan.  Each horizon edge is reversed so the new face winds the same way as the one it replaced.
+	const int firstIdx = (int)hull.faces.size();
+	int prevIdx = -1;
+	for ( int i = 0; i < numHorizon; i++ ) {
+		const qhEdge_t & edge = hull.horizon[ i ];
+		const int a = hull.faces[ edge.face ].v[ ( edge.edge + 1 ) % 3 ];
+		const int b = hull.faces[ edge.face ].v[ edge.edge ];
+
+		const int faceIdx = AddFace( hull, a, b, eyeIdx );
+		hull.faces[ faceIdx ].adj[ 0 ] = edge.face;
+		hull.faces[ edge.face ].adj[ edge.edge ] = faceIdx;
+
+		// Consecutive fan faces share the edge running out to the eye point
+		if ( prevIdx >= 0 ) {
+			hull.faces[ faceIdx ].adj[ 2 ] = prevIdx;
+			hull.faces[ prevIdx ].adj[ 1 ] = faceIdx;
+		}
+		prevIdx = faceIdx;
+	}
+	hull.faces[ firstIdx ].adj[ 2 ] = prevIdx;
+	hull.faces[ prevIdx ].adj[ 1 ] = firstIdx;
+
+	// Anything still outside the hull must be in front of one of the new faces
+	const int endIdx = (int)hull.faces.size();
+	for ( int i = 0; i < hull.orphans.size(); i++ ) {
+		AssignToFaces( hull, hull.orphans[ i ], firstIdx, endIdx );
+	}
+	return true;
+}
+
+/*
+====================================================
+BuildInitialSimplex
+
+Builds the largest tetrahedron it can from the extreme points, returns false if the points are
+flat or collinear within epsilon.
+====================================================
+*/
+static bool BuildInitialSimplex( qhHull_t & hull ) {
+	const Vec3 * pts = hull.pts;
+	const int num = hull.numPts;
+
+	// Extreme points along each axis give the starting edge, and scale the epsilon
+	int extremes[ 6 ] = { 0, 0, 0, 0, 0, 0 };
+	Vec3 maxAbs( 0.0f );
+	for ( int i = 0; i < num; i++ ) {
+		for ( int axis = 0; axis < 3; axis++ ) {
+			if ( pts[ i ][ axis ] > pts[ extremes[ axis * 2 + 0 ] ][ axis ] ) {
+				extremes[ axis * 2 + 0 ] = i;
+			}
+			if ( pts[ i ][ axis ] < pts[ extremes[ axis * 2 + 1 ] ][ axis ] ) {
+				extremes[ axis * 2 + 1 ] = i;
+			}
+			if ( fabsf( pts[ i ][ axis ] ) > maxAbs[ axis ] ) {
+				maxAbs[ axis ] = fabsf( pts[ i ][ axis ] );
+			}
+		}
+	}
+	hull.epsilon = 3.0f * FLT_EPSILON * ( maxAbs.x + maxAbs.y + maxAbs.z );
+
+	int simplex[ 4 ];
+	float maxDist = 0.0f;
+	for ( int axis = 0; axis < 3; axis++ ) {
+		const float dist = ( pts[ extremes[ axis * 2 + 0 ] ] - pts[ extremes[ axis * 2 + 1 ] ] ).GetLengthSqr();
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			simplex[ 0 ] = extremes[ axis * 2 + 0 ];
+			simplex[ 1 ] = extremes[ axis * 2 + 1 ];
+		}
+	}
+	if ( sqrtf( maxDist ) <= hull.epsilon ) {
+		return false;
+	}
+
+	const Vec3 & ptA = pts[ simplex[ 0 ] ];
+	Vec3 ab = pts[ simplex[ 1 ] ] - ptA;
+	ab.Normalize();
+	maxDist = 0.0f;
+	for ( int i = 0; i < num; i++ ) {
+		const float dist = ab.Cross( pts[ i ] - ptA ).GetLengthSqr();
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			simplex[ 2 ] = i;
+		}
+	}
+	if ( sqrtf( maxDist ) <= hull.epsilon ) {
+		return false;
+	}
+
+	Vec3 normal = ( pts[ simplex[ 1 ] ] - ptA ).Cross( pts[ simplex[ 2 ] ] - ptA );
+	normal.Normalize();
+	maxDist = 0.0f;
+	for ( int i = 0; i < num; i++ ) {
+		const float dist = fabsf( normal.Dot( pts[ i ] - ptA ) );
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			simplex[ 3 ] = i;
+		}
+	}
+	if ( maxDist <= hull.epsilon ) {
+		return false;
+	}
+
+	// Make sure the fourth point is behind the first face so every face winds counter clockwise
+	if ( normal.Dot( pts[ simplex[ 3 ] ] - ptA ) > 0.0f ) {
+		std::swap( simplex[ 0 ], simplex[ 1 ] );
+	}
+
+	AddFace( hull, simplex[ 0 ], simplex[ 1 ], simplex[ 2 ] );
+	AddFace( hull, simplex[ 0 ], simplex[ 2 ], simplex[ 3 ] );
+	AddFace( hull, simplex[ 2 ], simplex[ 1 ], simplex[ 3 ] );
+	AddFace( hull, simplex[ 1 ], simplex[ 0 ], simplex[ 3 ] );
+
+	// Link each edge with its reversed twin
+	for ( int i = 0; i < 4; i++ ) {
+		qhFace_t & face = hull.faces[ i ];
+		for ( int e = 0; e < 3; e++ ) {
+			const int a = face.v[ e ];
+			const int b = face.v[ ( e + 1 ) % 3 ];
+			for ( int j = 0; j < 4; j++ ) {
+				const qhFace_t & other = hull.faces[ j ];
+				for ( int k = 0; k < 3; k++ ) {
+					if ( other.v[ k ] == b && other.v[ ( k + 1 ) % 3 ] == a ) {
+						face.adj[ e ] = j;
+					}
+				}
+			}
+		}
+	}
+
+	for ( int i = 0; i < num; i++ ) {
+		if ( i == simplex[ 0 ] || i == simplex[ 1 ] || i == simplex[ 2 ] || i == simplex[ 3 ] ) {
+			continue;
+		}
+		AssignToFaces( hull, i, 0, 4 );
+	}
+	return true;
+}
+
+/*
+====================================================
+MergeCoplanarFaces
+
+Flood fills across the faces whose corners all lie within epsilon of a seed face's plane, and
+re-triangulates each group as a fan around its boundary.  Vertices inside a group drop out of
+the hull, as do vertices on a straight stretch of boundary that no other face needs as a corner.
+====================================================
+*/
+struct qhPolygon_t {
+	int firstFace;
+	int numFaces;
+	int firstVert;
+	int numVerts;	// zero when the group isn't a simple polygon and keeps its triangles
+};
+
+// True if the loop turns at vertex i, rather than running straight through it
+static bool IsLoopCorner( const qhHull_t & hull, const std::vector< int > & loop, const int i, const float epsilon ) {
+	const int numLoop = (int)loop.size();
+	const Vec3 & prev = hull.pts[ loop[ ( i + numLoop - 1 ) % numLoop ] ];
+	const Vec3 & pt = hull.pts[ loop[ i ] ];
+	const Vec3 & next = hull.pts[ loop[ ( i + 1 ) % numLoop ] ];
+	const Vec3 line = next - prev;
+	const float length = line.GetMagnitude();
+	return ( length > 0.0f && line.Cross( pt - prev ).GetMagnitude() / length > epsilon );
+}
+
+static void MergeCoplanarFaces( qhHull_t & hull, std::vector< tri_t > & tris ) {
+	const float mergeEpsilon = 2.0f * hull.epsilon;
+	const int numFaces = (int)hull.faces.size();
+
+	std::vector< int > groups( numFaces, -1 );
+	std::vector< int > groupFaces;
+	std::vector< int > polygonVerts;
+	std::vector< qhPolygon_t > polygons;
+	std::vector< edge_t > boundary;
+	std::vector< int > loop;
+	std::vector< bool > isCorner( hull.numPts, false );
+
+	for ( int seedIdx = 0; seedIdx < numFaces; seedIdx++ ) {
+		if ( !hull.faces[ seedIdx ].isValid || groups[ seedIdx ] >= 0 ) {
+			continue;
+		}
+		const qhFace_t & seed = hull.faces[ seedIdx ];
+		const int groupIdx = (int)polygons.size();
+
+		qhPolygon_t polygon;
+		polygon.firstFace = (int)groupFaces.size();
+		polygon.firstVert = (int)polygonVerts.size();
+		polygon.numVerts = 0;
+
+		groupFaces.push_back( seedIdx );
+		groups[ seedIdx ] = groupIdx;
+		for ( int m = polygon.firstFace; m < groupFaces.size(); m++ ) {
+			const qhFace_t & face = hull.faces[ groupFaces[ m ] ];
+			for ( int e = 0; e < 3; e++ ) {
+				const int neighborIdx = face.adj[ e ];
+				if ( groups[ neighborIdx ] >= 0 ) {
+					continue;
+				}
+
+				const qhFace_t & neighbor = hull.faces[ neighborIdx ];
+				bool isCoplanar = true;
+				for ( int v = 0; v < 3; v++ ) {
+					if ( fabsf( DistanceToFace( hull, seed, hull.pts[ neighbor.v[ v ] ] ) ) > mergeEpsilon ) {
+						isCoplanar = false;
+					}
+				}
+				if ( isCoplanar ) {
+					groups[ neighborIdx ] = groupIdx;
+					groupFaces.push_back( neighborIdx );
+				}
+			}
+		}
+		polygon.numFaces = (int)groupFaces.size() - polygon.firstFace;
+
+		// Chain the boundary edges of the group into a loop
+		boundary.clear();
+		loop.clear();
+		if ( polygon.numFaces > 1 ) {
+			for ( int m = polygon.firstFace; m < groupFaces.size(); m++ ) {
+				const qhFace_t & face = hull.faces[ groupFaces[ m ] ];
+				for ( int e = 0; e < 3; e++ ) {
+					if ( groups[ face.adj[ e ] ] != groupIdx ) {
+						edge_t edge;
+						edge.a = face.v[ e ];
+						edge.b = face.v[ ( e + 1 ) % 3 ];
+						boundary.push_back( edge );
+					}
+				}
+			}
+
+			loop.push_back( boundary[ 0 ].a );
+			int current = boundary[ 0 ].b;
+			while ( current != loop[ 0 ] && loop.size() < boundary.size() ) {
+				loop.push_back( current );
+				int next = -1;
+				for ( int b = 0; b < boundary.size(); b++ ) {
+					if ( boundary[ b ].a == current ) {
+						next = boundary[ b ].b;
+						break;
+					}
+				}
+				if ( next < 0 ) {
+					break;
+				}
+				current = next;
+			}
+			if ( current != loop[ 0 ] || loop.size() != boundary.size() ) {
+				loop.clear();
+			}
+		}
+
+		// Only the loop vertices that aren't on a straight line between their neighbors are corners.
+		// The fan starts from one of them so its first and last triangles aren't slivers.
+		const int numLoop = (int)loop.size();
+		int numCorners = 0;
+		int firstCorner = -1;
+		for ( int i = 0; i < numLoop; i++ ) {
+			if ( IsLoopCorner( hull, loop, i, mergeEpsilon ) ) {
+				if ( firstCorner < 0 ) {
+					firstCorner = i;
+				}
+				numCorners++;
+			}
+		}
+
+		if ( numCorners >= 3 ) {
+			for ( int i = 0; i < numLoop; i++ ) {
+				polygonVerts.push_back( loop[ ( firstCorner + i ) % numLoop ] );
+			}
+			polygon.numVerts = numLoop;
+
+			for ( int i = 0; i < numLoop; i++ ) {
+				if ( IsLoopCorner( hull, loop, i, mergeEpsilon ) ) {
+					isCorner[ loop[ i ] ] = true;
+				}
+			}
+		} else {
+			for ( int m = polygon.firstFace; m < groupFaces.size(); m++ ) {
+				const qhFace_t & face = hull.faces[ groupFaces[ m ] ];
+				isCorner[ face.v[ 0 ] ] = true;
+				isCorner[ face.v[ 1 ] ] = true;
+				isCorner[ face.v[ 2 ] ] = true;
+			}
+		}
+
+		polygons.push_back( polygon );
+	}
+
+	// A vertex that any neighboring face still needs stays in every polygon that touches it, so the
+	// triangulation has no t-junctions
+	std::vector< int > corners;
+	for ( int p = 0; p < polygons.size(); p++ ) {
+		const qhPolygon_t & polygon = polygons[ p ];
+
+		if ( 0 == polygon.numVerts ) {
+			for ( int m = 0; m < polygon.numFaces; m++ ) {
+				const qhFace_t & face = hull.faces[ groupFaces[ polygon.firstFace + m ] ];
+				tri_t tri;
+				tri.a = face.v[ 0 ];
+				tri.b = face.v[ 1 ];
+				tri.c = face.v[ 2 ];
+				tris.push_back( tri );
+			}
+			continue;
+		}
+
+		corners.clear();
+		for ( int i = 0; i < polygon.numVerts; i++ ) {
+			const int vertIdx = polygonVerts[ polygon.firstVert + i ];
+			if ( isCorner[ vertIdx ] ) {
+				corners.push_back( vertIdx );
+			}
+		}
+
+		for ( int i = 1; i < (int)corners.size() - 1; i++ ) {
+			tri_t tri;
+			tri.a = corners[ 0 ];
+			tri.b = corners[ i ];
+			tri.c = corners[ i + 1 ];
+			tris.push_back( tri );
+		}
+	}
+}
+
+/*
+====================================================
+QuickHull
+====================================================
+*/
+static bool QuickHull( const Vec3 * verts, const int num, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris ) {
+	hullPts.clear();
+	hullTris.clear();
+
+	qhHull_t hull;
+	hull.pts = verts;
+	hull.numPts = num;
+	hull.epsilon = 0.0f;
+	hull.mark = 0;
+	hull.nextConflict.resize( num, -1 );
+	hull.faces.reserve( 64 );
+
+	// The caller falls back to a hull without triangles, and says so if it needs to
+	if ( !BuildInitialSimplex( hull ) ) {
+		return false;
+	}
+
+	// Faces are only ever appended, so one pass picks up every face that has points in front of it
+	for ( int faceIdx = 0; faceIdx < hull.faces.size(); faceIdx++ ) {
+		while ( hull.faces[ faceIdx ].isValid && hull.faces[ faceIdx ].conflictHead >= 0 ) {
+			const int eyeIdx = hull.faces[ faceIdx ].furthestPt;
+			if ( !AddEyePoint( hull, faceIdx, eyeIdx ) ) {
+				RemoveConflict( hull, faceIdx, eyeIdx );
+			}
+		}
+	}
+
+	std::vector< tri_t > tris;
+	MergeCoplanarFaces( hull, tris );
+
+	// Compact the points down to the ones the triangles use
+	std::vector< int > remap( num, -1 );
+	hullTris.reserve( tris.size() );
+	for ( int i = 0; i < tris.size(); i++ ) {
+		const int idx[ 3 ] = { tris[ i ].a, tris[ i ].b, tris[ i ].c };
+		for ( int v = 0; v < 3; v++ ) {
+			if ( remap[ idx[ v ] ] < 0 ) {
+				remap[ idx[ v ] ] = (int)hullPts.size();
+				hullPts.push_back( verts[ idx[ v ] ] );
+			}
+		}
+
+		tri_t tri;
+		tri.a = remap[ tris[ i ].a ];
+		tri.b = remap[ tris[ i ].b ];
+		tri.c = remap[ tris[ i ].c ];
+		hullTris.push_back( tri );
+	}
+	return true;
+}
+
+/*
+====================================================
+BuildDegenerateHull
+
+For points that are flat, collinear or too few to enclose a volume.  There are no triangles, the
+hull is just the points, which is still exact for the support mapping.
+====================================================
+*/
+static void BuildDegenerateHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris ) {
+	hullPts = verts;
+	hullTris.clear();
+}
+
+/*
+====================================================
+BuildConvexHull
+
+Returns false if the points don't enclose a volume, the hull is then built by BuildDegenerateHull
+====================================================
+*/
+bool BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris ) {
+	if ( verts.size() < 4 ) {
+		BuildDegenerateHull( verts, hullPts, hullTris );
+		return false;
+	}
+
+#if defined( HULL_QUICKHULL )
+	if ( !QuickHull( verts.data(), (int)verts.size(), hullPts, hullTris ) ) {
+		BuildDegenerateHull( verts, hullPts, hullTris );
+		return false;
+	}
+#else
 	// Build a tetrahedron
 	BuildTetrahedron( verts.data(), (int)verts.size(), hullPts, hullTris );
 
 	ExpandConvexHull( hullPts, hullTris, verts );
+#endif
+	return true;
+}
+
+/*
+====================================================
+HullVolume
+====================================================
+*/
+static float HullVolume( const std::vector< Vec3 > & hullPts, const std::vector< tri_t > & hullTris ) {
+	float volume = 0.0f;
+	for ( int i = 0; i < hullTris.size(); i++ ) {
+		const tri_t & tri = hullTris[ i ];
+		volume += hullPts[ tri.a ].Dot( hullPts[ tri.b ].Cross( hullPts[ tri.c ] ) );
+	}
+	return volume / 6.0f;
+}
+
+struct vertCost_t {
+	int idx;
+	float cost;
+};
+
+static int CompareVertCosts( const void * p1, const void * p2 ) {
+	const vertCost_t & a = *(const vertCost_t *)p1;
+	const vertCost_t & b = *(const vertCost_t *)p2;
+
+	if ( a.cost != b.cost ) {
+		return ( a.cost < b.cost ) ? -1 : 1;
+	}
+	return a.idx - b.idx;
+}
+
+/*
+====================================================
+SimplifyConvexHull
+
+Removes hull vertices until there are at most maxVerts of them, and returns the fraction of the
+original volume that was lost.  Every round scores each vertex by the volume of the cap it raises
+above its ring of neighbors, then drops a batch of the cheapest ones, no two of them adjacent, and
+rebuilds the hull from the survivors.  Since the new hull is built from a subset of the points it
+always sits inside the original.
+====================================================
+*/
+float SimplifyConvexHull( std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris, int maxVerts ) {
+	if ( maxVerts < 4 ) {
+		maxVerts = 4;
+	}
+	if ( hullPts.size() <= maxVerts ) {
+		return 0.0f;
+	}
+
+	const float originalVolume = HullVolume( hullPts, hullTris );
+
+	std::vector< float > costs;
+	std::vector< Vec3 > ringCenters;
+	std::vector< int > ringCounts;
+	std::vector< vertCost_t > order;
+	std::vector< bool > isBlocked;
+	std::vector< bool > isRemoved;
+	std::vector< Vec3 > survivors;
+	std::vector< Vec3 > newPts;
+	std::vector< tri_t > newTris;
+
+	while ( hullPts.size() > maxVerts ) {
+		const int numPts = (int)hullPts.size();
+
+		// The ring center of a vertex is the average of its neighbors, counting each shared edge twice
+		ringCenters.assign( numPts, Vec3( 0.0f ) );
+		ringCounts.assign( numPts, 0 );
+		for ( int t = 0; t < hullTris.size(); t++ ) {
+			const int idx[ 3 ] = { hullTris[ t ].a, hullTris[ t ].b, hullTris[ t ].c };
+			for ( int v = 0; v < 3; v++ ) {
+				ringCenters[ idx[ v ] ] += hullPts[ idx[ ( v + 1 ) % 3 ] ] + hullPts[ idx[ ( v + 2 ) % 3 ] ];
+				ringCounts[ idx[ v ] ] += 2;
+			}
+		}
+
+		// The cap is the cone from the ring center over the fan of triangles around the vertex
+		costs.assign( numPts, 0.0f );
+		for ( int t = 0; t < hullTris.size(); t++ ) {
+			const int idx[ 3 ] = { hullTris[ t ].a, hullTris[ t ].b, hullTris[ t ].c };
+			for ( int v = 0; v < 3; v++ ) {
+				const Vec3 center = ringCenters[ idx[ v ] ] / (float)ringCounts[ idx[ v ] ];
+				const Vec3 a = hullPts[ idx[ 0 ] ] - center;
+				const Vec3 b = hullPts[ idx[ 1 ] ] - center;
+				const Vec3 c = hullPts[ idx[ 2 ] ] - center;
+				costs[ idx[ v ] ] += fabsf( a.Dot( b.Cross( c ) ) ) / 6.0f;
+			}
+		}
+
+		order.resize( numPts );
+		for ( int i = 0; i < numPts; i++ ) {
+			order[ i ].idx = i;
+			order[ i ].cost = costs[ i ];
+		}
+		qsort( order.data(), order.size(), sizeof( vertCost_t ), CompareVertCosts );
+
+		// Removing neighbors in the same round would make their costs meaningless
+		int numToRemove = numPts - maxVerts;
+		if ( numToRemove > numPts / 8 ) {
+			numToRemove = ( numPts / 8 > 0 ) ? numPts / 8 : 1;
+		}
+		isBlocked.assign( numPts, false );
+		isRemoved.assign( numPts, false );
+		int numRemoved = 0;
+		for ( int i = 0; i < numPts && numRemoved < numToRemove; i++ ) {
+			const int vertIdx = order[ i ].idx;
+			if ( isBlocked[ vertIdx ] ) {
+				continue;
+			}
+			isRemoved[ vertIdx ] = true;
+			numRemoved++;
+
+			for ( int t = 0; t < hullTris.size(); t++ ) {
+				const tri_t & tri = hullTris[ t ];
+				if ( tri.a == vertIdx || tri.b == vertIdx || tri.c == vertIdx ) {
+					isBlocked[ tri.a ] = true;
+					isBlocked[ tri.b ] = true;
+					isBlocked[ tri.c ] = true;
+				}
+			}
+		}
+
+		survivors.clear();
+		for ( int i = 0; i < numPts; i++ ) {
+			if ( !isRemoved[ i ] ) {
+				survivors.push_back( hullPts[ i ] );
+			}
+		}
+
+		newPts.clear();
+		newTris.clear();
+		if ( !BuildConvexHull( survivors, newPts, newTris ) || newPts.size() >= numPts ) {
+			// The batch left the survivors flat, so take out the cheapest vertex that can go on its own.
+			// One always can, since any vertex outside four of the hull's that aren't coplanar leaves a volume.
+			bool didShrink = false;
+			for ( int i = 0; i < numPts && !didShrink; i++ ) {
+				survivors.clear();
+				for ( int j = 0; j < numPts; j++ ) {
+					if ( j != order[ i ].idx ) {
+						survivors.push_back( hullPts[ j ] );
+					}
+				}
+
+				newPts.clear();
+				newTris.clear();
+				didShrink = BuildConvexHull( survivors, newPts, newTris ) && newPts.size() < numPts;
+			}
+			if ( !didShrink ) {
+				printf( "WARNING: SimplifyConvexHull: stuck at %i verts, above the limit of %i\n", numPts, maxVerts );
+				break;
+			}
+		}
+		hullPts.swap( newPts );
+		hullTris.swap( newTris );
+	}
+
+	const float volume = HullVolume( hullPts, hullTris );
+	if ( originalVolume <= 0.0f ) {
+		return 0.0f;
+	}
+	return ( originalVolume - volume ) / originalVolume;
 }
 
 /*
@@ -654,9 +1471,17 @@ static void PrintTensor( const Mat3 & mat ) {
 ShapeConvex::Build
 ====================================================
 */
-void ShapeConvex::Build( const Vec3 * pts, const int num ) {
+void ShapeConvex::Build( const Vec3 * pts, const int num, const int maxVerts, const bool useCache ) {
+#if defined( CONVEX_COOKED_CACHE )
+	const unsigned long long hash = useCache ? HashPoints( pts, num, maxVerts ) : 0;
+	if ( useCache && LoadCooked( hash ) ) {
+		return;
+	}
+#endif
+
 	m_points.clear();
 	m_points.reserve( num );
+	m_volumeError = 0.0f;
 #if 1
 	for ( int i = 0; i < num; i++ ) {
 		m_points.push_back( pts[ i ] );
@@ -664,7 +1489,20 @@ void ShapeConvex::Build( const Vec3 * pts, const int num ) {
 
 	std::vector< Vec3 > hullPoints;
 	std::vector< tri_t > hullTriangles;
-	BuildConvexHull( m_points, hullPoints, hullTriangles );
+	const bool hasVolume = BuildConvexHull( m_points, hullPoints, hullTriangles );
+	if ( !hasVolume ) {
+		printf( "WARNING: ShapeConvex: %i points don't enclose a volume, the shape has no triangles\n", num );
+		if ( hullPoints.empty() ) {
+			hullPoints.push_back( Vec3( 0.0f ) );
+		}
+	}
+
+	if ( maxVerts > 0 && hasVolume ) {
+		m_volumeError = SimplifyConvexHull( hullPoints, hullTriangles, maxVerts );
+		if ( m_volumeError > 0.05f ) {
+			printf( "WARNING: ShapeConvex: simplifying to %i verts lost %.1f%% of the volume\n", (int)hullPoints.size(), m_volumeError * 100.0f );
+		}
+	}
 	m_points = hullPoints;
 #else
 	// First thing to do is to remove any points that are close to each other
@@ -735,6 +1573,9 @@ void ShapeConvex::Build( const Vec3 * pts, const int num ) {
 	m_bounds.Clear();
 	m_bounds.Expand( m_points.data(), (int)m_points.size() );
 
+	m_triangles = hullTriangles;
+	BuildSupportData( hullTriangles );
+
 #if 0
 	m_centerOfMass = CalculateCenterOfMass( hullPoints, hullTriangles );
 
@@ -744,9 +1585,23 @@ void ShapeConvex::Build( const Vec3 * pts, const int num ) {
 
 	m_inertiaTensor = CalculateInertiaTensorMonteCarlo( hullPoints, hullTriangles, m_centerOfMass );
 #elif 1
-	m_centerOfMass = CalculateCenterOfMassTetrahedron( hullPoints, hullTriangles );
+	if ( hullTriangles.empty() ) {
+		// Without a volume there's no real mass distribution, so give it a solid sphere's
+		// around the points' center, that's all it needs to stay simulated
+		m_centerOfMass.Zero();
+		for ( int i = 0; i < hullPoints.size(); i++ ) {
+			m_centerOfMass += hullPoints[ i ];
+		}
+		m_centerOfMass *= 1.0f / (float)hullPoints.size();
+
+		const float radius = std::max( 0.5f * ( m_bounds.maxs - m_bounds.mins ).GetMagnitude(), 0.01f );
+		m_inertiaTensor.Identity();
+		m_inertiaTensor *= 0.4f * radius * radius;
+	} else {
+		m_centerOfMass = CalculateCenterOfMassTetrahedron( hullPoints, hullTriangles );
 
-	m_inertiaTensor = CalculateInertiaTensorTetrahedron( hullPoints, hullTriangles, m_centerOfMass );
+		m_inertiaTensor = CalculateInertiaTensorTetrahedron( hullPoints, hullTriangles, m_centerOfMass );
+	}
 
 	assert( m_centerOfMass.IsValid() );
 	if ( !m_centerOfMass.IsValid() ) {
@@ -833,27 +1688,205 @@ void ShapeConvex::Build( const Vec3 * pts, const int num ) {
 		m_inertiaTensor += tensor;
 	}
 #endif
+
+#if defined( CONVEX_COOKED_CACHE )
+	if ( useCache && m_centerOfMass.IsValid() ) {
+		SaveCooked( hash );
+	}
+#endif
 }
 
 /*
 ====================================================
-ShapeConvex::Support
+CompareEdges
 ====================================================
 */
-Vec3 ShapeConvex::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
-	// Find the point in furthest in direction
-	Vec3 maxPt = orient.RotatePoint( m_points[ 0 ] ) + pos;
-	float maxDist = dir.Dot( maxPt );
-	for ( int i = 1; i < m_points.size(); i++ ) {
-		const Vec3 pt = orient.RotatePoint( m_points[ i ] ) + pos;
-		const float dist = dir.Dot( pt );
+static int CompareEdges( const void * p1, const void * p2 ) {
+	const edge_t & a = *(const edge_t *)p1;
+	const edge_t & b = *(const edge_t *)p2;
 
-		if ( dist > maxDist ) {
-			maxDist = dist;
-			maxPt = pt;
+	if ( a.a != b.a ) {
+		return ( a.a < b.a ) ? -1 : 1;
+	}
+	if ( a.b != b.b ) {
+		return ( a.b < b.b ) ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+====================================================
+ShapeConvex::BuildSupportData
+
+Builds the SoA vertex arrays and the vertex adjacency graph used by the support mapping
+====================================================
+*/
+void ShapeConvex::BuildSupportData( const std::vector< tri_t > & hullTris ) {
+	const int numPoints = (int)m_points.size();
+
+	//
+	//	SoA vertices, the padding duplicates the first point so it can never win the scan
+	//
+	const int numPadded = ( numPoints + 3 ) & ~3;
+	m_pointsX.resize( numPadded );
+	m_pointsY.resize( numPadded );
+	m_pointsZ.resize( numPadded );
+	for ( int i = 0; i < numPadded; i++ ) {
+		const Vec3 & pt = m_points[ ( i < numPoints ) ? i : 0 ];
+		m_pointsX[ i ] = pt.x;
+		m_pointsY[ i ] = pt.y;
+		m_pointsZ[ i ] = pt.z;
+	}
+
+	//
+	//	Starting points for hill climbing
+	//
+	const Vec3 axes[ 6 ] = {
+		Vec3( 1, 0, 0 ), Vec3( -1, 0, 0 ),
+		Vec3( 0, 1, 0 ), Vec3( 0, -1, 0 ),
+		Vec3( 0, 0, 1 ), Vec3( 0, 0, -1 ),
+	};
+	for ( int i = 0; i < 6; i++ ) {
+		m_extremeVerts[ i ] = ( numPoints > 0 ) ? FindPointFurthestInDir( m_points.data(), numPoints, axes[ i ] ) : 0;
+	}
+
+	//
+	//	Vertex adjacency from the hull triangles
+	//
+	m_adjacencyOffsets.clear();
+	m_adjacency.clear();
+	if ( numPoints <= HILL_CLIMB_THRESHOLD ) {
+		return;
+	}
+
+	std::vector< edge_t > edges;
+	edges.reserve( hullTris.size() * 6 );
+	for ( int i = 0; i < hullTris.size(); i++ ) {
+		const tri_t & tri = hullTris[ i ];
+		const int idx[ 3 ] = { tri.a, tri.b, tri.c };
+		for ( int j = 0; j < 3; j++ ) {
+			edge_t edge;
+			edge.a = idx[ j ];
+			edge.b = idx[ ( j + 1 ) % 3 ];
+			edges.push_back( edge );
+
+			std::swap( edge.a, edge.b );
+			edges.push_back( edge );
+		}
+	}
+
+	// Sort by the first vertex so the edges become a compressed neighbor list, then remove the duplicates
+	qsort( edges.data(), edges.size(), sizeof( edge_t ), CompareEdges );
+
+	m_adjacencyOffsets.resize( numPoints + 1, 0 );
+	m_adjacency.reserve( edges.size() / 2 );
+	for ( int i = 0; i < edges.size(); i++ ) {
+		if ( i > 0 && edges[ i ].a == edges[ i - 1 ].a && edges[ i ].b == edges[ i - 1 ].b ) {
+			continue;
+		}
+		m_adjacency.push_back( edges[ i ].b );
+		m_adjacencyOffsets[ edges[ i ].a + 1 ]++;
+	}
+	for ( int i = 0; i < numPoints; i++ ) {
+		m_adjacencyOffsets[ i + 1 ] += m_adjacencyOffsets[ i ];
+	}
+}
+
+/*
+====================================================
+ShapeConvex::FindSupportVertex
+
+Returns the index of the hull vertex furthest along the model space direction
+====================================================
+*/
+int ShapeConvex::FindSupportVertex( const Vec3 & dir ) const {
+	const int numPoints = (int)m_points.size();
+
+	if ( numPoints > HILL_CLIMB_THRESHOLD && !m_adjacency.empty() ) {
+		//
+		//	Hill climb across the hull.  A linear function on a convex polytope has no
+		//	local maxima, so when no neighbor is further along, we've found the support.
+		//
+		int best = m_extremeVerts[ 0 ];
+		float bestDist = dir.Dot( m_points[ best ] );
+		for ( int i = 1; i < 6; i++ ) {
+			const float dist = dir.Dot( m_points[ m_extremeVerts[ i ] ] );
+			if ( dist > bestDist ) {
+				bestDist = dist;
+				best = m_extremeVerts[ i ];
+			}
+		}
+
+		int current = -1;
+		while ( current != best ) {
+			current = best;
+			for ( int i = m_adjacencyOffsets[ current ]; i < m_adjacencyOffsets[ current + 1 ]; i++ ) {
+				const int neighbor = m_adjacency[ i ];
+				const float dist = dir.Dot( m_points[ neighbor ] );
+				if ( dist > bestDist ) {
+					bestDist = dist;
+					best = neighbor;
+				}
+			}
 		}
+		return best;
 	}
 
+#if defined( SUPPORT_SIMD )
+	const int numPadded = (int)m_pointsX.size();
+	const __m128 dirX = _mm_set1_ps( dir.x );
+	const __m128 dirY = _mm_set1_ps( dir.y );
+	const __m128 dirZ = _mm_set1_ps( dir.z );
+	const __m128 four = _mm_set1_ps( 4.0f );
+
+	// Track the indices as floats, so that everything stays in SSE1
+	__m128 bestDist = _mm_set1_ps( -FLT_MAX );
+	__m128 bestIdx = _mm_setzero_ps();
+	__m128 idx = _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f );
+	for ( int i = 0; i < numPadded; i += 4 ) {
+		const __m128 x = _mm_loadu_ps( &m_pointsX[ i ] );
+		const __m128 y = _mm_loadu_ps( &m_pointsY[ i ] );
+		const __m128 z = _mm_loadu_ps( &m_pointsZ[ i ] );
+		const __m128 dist = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, dirX ), _mm_mul_ps( y, dirY ) ), _mm_mul_ps( z, dirZ ) );
+
+		const __m128 isFurther = _mm_cmpgt_ps( dist, bestDist );
+		bestDist = _mm_or_ps( _mm_and_ps( isFurther, dist ), _mm_andnot_ps( isFurther, bestDist ) );
+		bestIdx = _mm_or_ps( _mm_and_ps( isFurther, idx ), _mm_andnot_ps( isFurther, bestIdx ) );
+		idx = _mm_add_ps( idx, four );
+	}
+
+	float dists[ 4 ];
+	float indices[ 4 ];
+	_mm_storeu_ps( dists, bestDist );
+	_mm_storeu_ps( indices, bestIdx );
+
+	// Reduce the lanes, prefer the lowest index on ties to match the scalar scan
+	int best = (int)indices[ 0 ];
+	float maxDist = dists[ 0 ];
+	for ( int i = 1; i < 4; i++ ) {
+		const int laneIdx = (int)indices[ i ];
+		if ( dists[ i ] > maxDist || ( dists[ i ] == maxDist && laneIdx < best ) ) {
+			maxDist = dists[ i ];
+			best = laneIdx;
+		}
+	}
+	return best;
+#else
+	return FindPointFurthestInDir( m_points.data(), numPoints, dir );
+#endif
+}
+
+/*
+====================================================
+ShapeConvex::Support
+====================================================
+*/
+Vec3 ShapeConvex::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	// Find the point in furthest in direction, rotate the direction into model space once instead of rotating every point
+	const Vec3 localDir = orient.Inverse().RotatePoint( dir );
+	const int idx = FindSupportVertex( localDir );
+	const Vec3 maxPt = orient.RotatePoint( m_points[ idx ] ) + pos;
+
 	Vec3 norm = dir;
 	norm.Normalize();
 	norm *= bias;
@@ -893,14 +1926,110 @@ ShapeConvex::FastestLinearSpeed
 ====================================================
 */
 float ShapeConvex::FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const {
-	float maxSpeed = 0.0f;
-	for ( int i = 0; i < m_points.size(); i++ ) {
-		Vec3 r = m_points[ i ] - m_centerOfMass;
-		Vec3 linearVelocity = angularVelocity.Cross( r );
-		float speed = dir.Dot( linearVelocity );
-		if ( speed > maxSpeed ) {
-			maxSpeed = speed;
+	// dir.Dot( w.Cross( r ) ) == r.Dot( dir.Cross( w ) ), so this is a support query along dir x w
+	const Vec3 supportDir = dir.Cross( angularVelocity );
+	const int idx = FindSupportVertex( supportDir );
+
+	const float maxSpeed = supportDir.Dot( m_points[ idx ] - m_centerOfMass );
+	if ( maxSpeed > 0.0f ) {
+		return maxSpeed;
+	}
+	return 0.0f;
+}
+
+/*
+====================================================
+ShapeConvex::RayCast
+
+Clips the ray against the plane of each hull triangle
+====================================================
+*/
+bool ShapeConvex::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	// A hull without a volume has nothing for the ray to enter
+	if ( m_triangles.empty() ) {
+		return false;
+	}
+
+	float tMin = 0.0f;
+	float tMax = maxT;
+	bool didEnter = false;
+
+	for ( int i = 0; i < m_triangles.size(); i++ ) {
+		const tri_t & tri = m_triangles[ i ];
+		const Vec3 & a = m_points[ tri.a ];
+		const Vec3 & b = m_points[ tri.b ];
+		const Vec3 & c = m_points[ tri.c ];
+
+		Vec3 planeNormal = ( b - a ).Cross( c - a );
+		planeNormal.Normalize();
+
+		const float dist = planeNormal.Dot( start - a );
+		const float denom = planeNormal.Dot( dir );
+		if ( fabsf( denom ) < 1e-12f ) {
+			// Parallel to the plane, so it misses unless it starts behind it
+			if ( dist > 0.0f ) {
+				return false;
+			}
+			continue;
 		}
+
+		const float planeT = -dist / denom;
+		if ( denom < 0.0f ) {
+			if ( planeT > tMin ) {
+				tMin = planeT;
+				normal = planeNormal;
+				didEnter = true;
+			}
+		} else if ( planeT < tMax ) {
+			tMax = planeT;
+		}
+
+		if ( tMin > tMax ) {
+			return false;
+		}
+	}
+
+	if ( !didEnter ) {
+		// Started inside
+		normal = dir * -1.0f;
+		normal.Normalize();
+	}
+	t = tMin;
+	return true;
+}
+
+/*
+========================================================================================================
+
+Cooking
+
+========================================================================================================
+*/
+
+static void CookConvexShapesJob( Job_t * job, void * data ) {
+	convexCook_t * cooks = (convexCook_t *)job->m_data;
+
+	for ( int i = 0; i < job->m_numElements; i++ ) {
+		convexCook_t & cook = cooks[ i ];
+		cook.shape = new ShapeConvex( cook.pts, cook.numPts, cook.maxVerts, cook.useCache );
 	}
-	return maxSpeed;
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+CookConvexShapes
+
+Builds a shape for each set of points, spread across the job system when it's running.
+====================================================
+*/
+void CookConvexShapes( convexCook_t * cooks, const int num ) {
+	if ( NULL != g_jobSystem && num > 1 ) {
+		g_jobSystem->ParallelFor( CookConvexShapesJob, cooks, sizeof( convexCook_t ), num );
+		g_jobSystem->Wait( NULL );
+		return;
+	}
+
+	for ( int i = 0; i < num; i++ ) {
+		cooks[ i ].shape = new ShapeConvex( cooks[ i ].pts, cooks[ i ].numPts, cooks[ i ].maxVerts, cooks[ i ].useCache );
+	}
+}
@@ -68,7 +68,8 @@ struct edge_t {
 };
 
 void ExpandConvexHull( std::vector< Vec3 > & hullPoints, std::vector< tri_t > & hullTris, const std::vector< Vec3 > & verts );
-void BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris );
+bool BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris );	// false if the points don't enclose a volume
+float SimplifyConvexHull( std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris, int maxVerts );
 
 /*
 ====================================================
@@ -77,10 +78,12 @@ ShapeConvex
 */
 class ShapeConvex : public Shape {
 public:
-	explicit ShapeConvex( const Vec3 * pts, const int num ) {
-		Build( pts, num );
+	// A maxVerts above zero simplifies the hull down to that many vertices.
+	// With useCache the cooked hull is loaded from generated/, or saved there once it's built.
+	explicit ShapeConvex( const Vec3 * pts, const int num, const int maxVerts = 0, const bool useCache = false ) {
+		Build( pts, num, maxVerts, useCache );
 	}
-	void Build( const Vec3 * pts, const int num );
+	void Build( const Vec3 * pts, const int num, const int maxVerts = 0, const bool useCache = false );
 
 	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
 
@@ -91,10 +94,52 @@ public:
 
 	float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const override;
 
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
 	shapeType_t GetType() const override { return SHAPE_CONVEX; }
 
+	int FindSupportVertex( const Vec3 & localDir ) const;
+	void BuildSupportData( const std::vector< tri_t > & hullTris );
+
+	// Cooked hulls are cached in generated/, keyed by a hash of the points they were built from
+	static unsigned long long HashPoints( const Vec3 * pts, const int num, const int maxVerts );
+	bool LoadCooked( const unsigned long long hash );
+	bool SaveCooked( const unsigned long long hash ) const;
+
 public:
 	std::vector< Vec3 > m_points;
+	std::vector< tri_t > m_triangles;	// the hull, indexing m_points
 	Bounds m_bounds;
 	Mat3 m_inertiaTensor;
-};
\ No newline at end of file
+	float m_volumeError;	// fraction of the full hull's volume lost to simplification
+
+	// Hulls with more vertices than this walk the adjacency graph instead of scanning every point
+	static const int HILL_CLIMB_THRESHOLD = 32;
+
+	// SoA copy of m_points, padded to a multiple of four for the SIMD scan
+	std::vector< float > m_pointsX;
+	std::vector< float > m_pointsY;
+	std::vector< float > m_pointsZ;
+
+	// The neighbors of vertex i are m_adjacency[ m_adjacencyOffsets[ i ] ] to m_adjacency[ m_adjacencyOffsets[ i + 1 ] - 1 ]
+	std::vector< int > m_adjacencyOffsets;
+	std::vector< int > m_adjacency;
+	int m_extremeVerts[ 6 ];	// furthest vertices along +x, -x, +y, -y, +z, -z are the starting points for hill climbing
+};
+
+/*
+====================================================
+convexCook_t
+
+One hull to cook with CookConvexShapes, the points only need to live until it returns.
+====================================================
+*/
+struct convexCook_t {
+	const Vec3 * pts;
+	int numPts;
+	int maxVerts;			// zero keeps every extreme point
+	bool useCache;			// load and save the cooked hull in generated/
+	ShapeConvex * shape;	// output
+};
+
+void CookConvexShapes( convexCook_t * cooks, const int num );
@@ -0,0 +1,268 @@
+//
+//  ShapeConvexCooked.cpp
+//
+#include "Physics/Shapes/ShapeConvex.h"
+#include "Miscellaneous/Fileio.h"
+#include <string.h>
+
+/*
+========================================================================================================
+
+Cooked ShapeConvex
+
+The file is a header followed by the arrays it describes, in the same order as the header's counts.
+Bump COOKED_CONVEX_VERSION whenever the layout, or anything that changes the built hull, changes.
+
+========================================================================================================
+*/
+
+#define COOKED_CONVEX_MAGIC 0x4C4C5548	// "HULL"
+#define COOKED_CONVEX_VERSION 3
+
+// Plain floats rather than the math types, so the header can be copied straight in and out of the file
+struct cookedConvexHeader_t {
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long hash;
+
+	int numPoints;
+	int numTriangles;
+	int numAdjacencyOffsets;
+	int numAdjacency;
+	int extremeVerts[ 6 ];
+	float volumeError;
+
+	float centerOfMass[ 3 ];
+	float inertiaTensor[ 9 ];
+	float boundsMins[ 3 ];
+	float boundsMaxs[ 3 ];
+};
+
+static void CookedConvexFileName( const unsigned long long hash, char * fileName ) {
+	sprintf( fileName, "generated/hull_%016llx.hull", hash );
+}
+
+// In 64 bits, so the counts from a corrupt header can't wrap around to the file's size
+static unsigned long long CookedConvexSize( const cookedConvexHeader_t & header ) {
+	unsigned long long size = sizeof( cookedConvexHeader_t );
+	size += (unsigned long long)header.numPoints * 3 * sizeof( float );
+	size += (unsigned long long)header.numTriangles * sizeof( tri_t );
+	size += (unsigned long long)header.numAdjacencyOffsets * sizeof( int );
+	size += (unsigned long long)header.numAdjacency * sizeof( int );
+	return size;
+}
+
+/*
+====================================================
+IsCookedConvexValid
+
+Checks every index in the file against the points, so a corrupt file can't send the support
+mapping or the ray cast out of bounds.  The adjacency is either missing, for hulls small enough
+to scan, or has an offset per point plus one that runs from zero to the end of the neighbors.
+====================================================
+*/
+static bool IsCookedConvexValid( const cookedConvexHeader_t & header, const tri_t * tris, const int * offsets, const int * adjacency ) {
+	const int numPoints = header.numPoints;
+	if ( numPoints <= 0 ) {
+		return false;
+	}
+
+	for ( int i = 0; i < 6; i++ ) {
+		if ( header.extremeVerts[ i ] < 0 || header.extremeVerts[ i ] >= numPoints ) {
+			return false;
+		}
+	}
+
+	for ( int i = 0; i < header.numTriangles; i++ ) {
+		const tri_t & tri = tris[ i ];
+		if ( tri.a < 0 || tri.a >= numPoints || tri.b < 0 || tri.b >= numPoints || tri.c < 0 || tri.c >= numPoints ) {
+			return false;
+		}
+	}
+
+	if ( 0 == header.numAdjacencyOffsets ) {
+		return ( 0 == header.numAdjacency );
+	}
+	if ( header.numAdjacencyOffsets != numPoints + 1 || 0 != offsets[ 0 ] || header.numAdjacency != offsets[ numPoints ] ) {
+		return false;
+	}
+	for ( int i = 0; i < numPoints; i++ ) {
+		if ( offsets[ i + 1 ] < offsets[ i ] ) {
+			return false;
+		}
+	}
+	for ( int i = 0; i < header.numAdjacency; i++ ) {
+		if ( adjacency[ i ] < 0 || adjacency[ i ] >= numPoints ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+====================================================
+ShapeConvex::HashPoints
+
+64 bit FNV-1a over the raw points and the vertex limit
+====================================================
+*/
+unsigned long long ShapeConvex::HashPoints( const Vec3 * pts, const int num, const int maxVerts ) {
+	unsigned long long hash = 14695981039346656037ULL;
+
+	const unsigned char * bytes = (const unsigned char *)pts;
+	const unsigned int size = num * sizeof( Vec3 );
+	for ( unsigned int i = 0; i < size; i++ ) {
+		hash ^= bytes[ i ];
+		hash *= 1099511628211ULL;
+	}
+
+	const unsigned char * limitBytes = (const unsigned char *)&maxVerts;
+	for ( unsigned int i = 0; i < sizeof( maxVerts ); i++ ) {
+		hash ^= limitBytes[ i ];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+====================================================
+ShapeConvex::LoadCooked
+
+Returns false, leaving the shape alone, if there's no valid cooked file for this hash
+====================================================
+*/
+bool ShapeConvex::LoadCooked( const unsigned long long hash ) {
+	char fileName[ 256 ];
+	CookedConvexFileName( hash, fileName );
+
+	fileMapping_t mapping;
+	if ( !MapFileData( fileName, mapping ) ) {
+		return false;
+	}
+
+	cookedConvexHeader_t header;
+	if ( mapping.size < sizeof( header ) ) {
+		UnmapFileData( mapping );
+		return false;
+	}
+	memcpy( &header, mapping.data, sizeof( header ) );
+
+	const bool isCurrent = ( COOKED_CONVEX_MAGIC == header.magic )
+		&& ( COOKED_CONVEX_VERSION == header.version )
+		&& ( hash == header.hash )
+		&& ( header.numPoints >= 0 && header.numTriangles >= 0 && header.numAdjacencyOffsets >= 0 && header.numAdjacency >= 0 )
+		&& ( CookedConvexSize( header ) == mapping.size );
+	if ( !isCurrent ) {
+		printf( "WARNING: ShapeConvex: discarding stale cooked hull %s\n", fileName );
+		UnmapFileData( mapping );
+		return false;
+	}
+
+	const unsigned char * data = mapping.data + sizeof( header );
+	const float * pointData = (const float *)data;
+	data += header.numPoints * 3 * sizeof( float );
+	const tri_t * triData = (const tri_t *)data;
+	data += header.numTriangles * sizeof( tri_t );
+	const int * offsetData = (const int *)data;
+	data += header.numAdjacencyOffsets * sizeof( int );
+	const int * adjacencyData = (const int *)data;
+
+	// Checked before anything is copied, so a bad file leaves the shape alone and it gets cooked again
+	if ( !IsCookedConvexValid( header, triData, offsetData, adjacencyData ) ) {
+		printf( "WARNING: ShapeConvex: discarding corrupt cooked hull %s\n", fileName );
+		UnmapFileData( mapping );
+		return false;
+	}
+
+	m_points.resize( header.numPoints );
+	for ( int i = 0; i < header.numPoints; i++ ) {
+		m_points[ i ] = Vec3( pointData[ i * 3 + 0 ], pointData[ i * 3 + 1 ], pointData[ i * 3 + 2 ] );
+	}
+
+	m_triangles.assign( triData, triData + header.numTriangles );
+	m_adjacencyOffsets.assign( offsetData, offsetData + header.numAdjacencyOffsets );
+	m_adjacency.assign( adjacencyData, adjacencyData + header.numAdjacency );
+
+	UnmapFileData( mapping );
+
+	for ( int i = 0; i < 6; i++ ) {
+		m_extremeVerts[ i ] = header.extremeVerts[ i ];
+	}
+	m_volumeError = header.volumeError;
+	m_centerOfMass = Vec3( header.centerOfMass[ 0 ], header.centerOfMass[ 1 ], header.centerOfMass[ 2 ] );
+	for ( int i = 0; i < 3; i++ ) {
+		m_inertiaTensor.rows[ i ] = Vec3( header.inertiaTensor[ i * 3 + 0 ], header.inertiaTensor[ i * 3 + 1 ], header.inertiaTensor[ i * 3 + 2 ] );
+	}
+	m_bounds.mins = Vec3( header.boundsMins[ 0 ], header.boundsMins[ 1 ], header.boundsMins[ 2 ] );
+	m_bounds.maxs = Vec3( header.boundsMaxs[ 0 ], header.boundsMaxs[ 1 ], header.boundsMaxs[ 2 ] );
+
+	// The SoA copy is cheaper to rebuild than to store
+	const int numPoints = (int)m_points.size();
+	const int numPadded = ( numPoints + 3 ) & ~3;
+	m_pointsX.resize( numPadded );
+	m_pointsY.resize( numPadded );
+	m_pointsZ.resize( numPadded );
+	for ( int i = 0; i < numPadded; i++ ) {
+		const Vec3 & pt = m_points[ ( i < numPoints ) ? i : 0 ];
+		m_pointsX[ i ] = pt.x;
+		m_pointsY[ i ] = pt.y;
+		m_pointsZ[ i ] = pt.z;
+	}
+	return true;
+}
+
+/*
+====================================================
+ShapeConvex::SaveCooked
+====================================================
+*/
+bool ShapeConvex::SaveCooked( const unsigned long long hash ) const {
+	cookedConvexHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = COOKED_CONVEX_MAGIC;
+	header.version = COOKED_CONVEX_VERSION;
+	header.hash = hash;
+	header.numPoints = (int)m_points.size();
+	header.numTriangles = (int)m_triangles.size();
+	header.numAdjacencyOffsets = (int)m_adjacencyOffsets.size();
+	header.numAdjacency = (int)m_adjacency.size();
+	for ( int i = 0; i < 6; i++ ) {
+		header.extremeVerts[ i ] = m_extremeVerts[ i ];
+	}
+	header.volumeError = m_volumeError;
+	for ( int i = 0; i < 3; i++ ) {
+		header.centerOfMass[ i ] = m_centerOfMass[ i ];
+		header.boundsMins[ i ] = m_bounds.mins[ i ];
+		header.boundsMaxs[ i ] = m_bounds.maxs[ i ];
+		for ( int j = 0; j < 3; j++ ) {
+			header.inertiaTensor[ i * 3 + j ] = m_inertiaTensor.rows[ i ][ j ];
+		}
+	}
+
+	std::vector< unsigned char > buffer( (size_t)CookedConvexSize( header ) );
+	unsigned char * data = buffer.data();
+
+	memcpy( data, &header, sizeof( header ) );
+	data += sizeof( header );
+
+	float * pointData = (float *)data;
+	for ( int i = 0; i < header.numPoints; i++ ) {
+		pointData[ i * 3 + 0 ] = m_points[ i ].x;
+		pointData[ i * 3 + 1 ] = m_points[ i ].y;
+		pointData[ i * 3 + 2 ] = m_points[ i ].z;
+	}
+	data += header.numPoints * 3 * sizeof( float );
+
+	memcpy( data, m_triangles.data(), header.numTriangles * sizeof( tri_t ) );
+	data += header.numTriangles * sizeof( tri_t );
+
+	memcpy( data, m_adjacencyOffsets.data(), header.numAdjacencyOffsets * sizeof( int ) );
+	data += header.numAdjacencyOffsets * sizeof( int );
+
+	memcpy( data, m_adjacency.data(), header.numAdjacency * sizeof( int ) );
+	data += header.numAdjacency * sizeof( int );
+
+	char fileName[ 256 ];
+	CookedConvexFileName( hash, fileName );
+	return SaveFileData( fileName, buffer.data(), (unsigned int)buffer.size() );
+}
@@ -0,0 +1,392 @@
+//
+//  ShapeHeightfield.cpp
+//
+#include "Physics/Shapes/ShapeHeightfield.h"
+#include <math.h>
+
+/*
+========================================================================================================
+
+ShapeHeightfield
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ShapeHeightfield::Build
+====================================================
+*/
+void ShapeHeightfield::Build( const float * heights, const int numX, const int numY, const float spacingX, const float spacingY ) {
+	assert( numX >= 2 && numY >= 2 );
+
+	m_numX = numX;
+	m_numY = numY;
+	m_spacingX = spacingX;
+	m_spacingY = spacingY;
+
+	float heightMax = heights[ 0 ];
+	m_heightMin = heights[ 0 ];
+	for ( int i = 1; i < numX * numY; i++ ) {
+		m_heightMin = std::min( m_heightMin, heights[ i ] );
+		heightMax = std::max( heightMax, heights[ i ] );
+	}
+	m_heightScale = ( heightMax - m_heightMin ) / 65535.0f;
+
+	// Lay out the pyramid, each level halves the blocks of the one below
+	m_levels.clear();
+	mipLevel_t level;
+	level.numX = numX - 1;
+	level.numY = numY - 1;
+	while ( true ) {
+		level.ranges.resize( level.numX * level.numY );
+		m_levels.push_back( level );
+		if ( 1 == level.numX && 1 == level.numY ) {
+			break;
+		}
+		level.numX = ( level.numX + 1 ) / 2;
+		level.numY = ( level.numY + 1 ) / 2;
+	}
+
+	m_samples.resize( numX * numY );
+	UpdateHeights( heights );
+
+	// Treat the whole grid as having uniform density, even though it's only used by static bodies
+	m_centerOfMass = m_bounds.Center();
+}
+
+/*
+====================================================
+ShapeHeightfield::UpdateHeights
+====================================================
+*/
+void ShapeHeightfield::UpdateHeights( const float * heights ) {
+	const float invScale = ( m_heightScale > 0.0f ) ? ( 1.0f / m_heightScale ) : 0.0f;
+	for ( int i = 0; i < m_numX * m_numY; i++ ) {
+		float q = ( heights[ i ] - m_heightMin ) * invScale + 0.5f;
+		q = std::max( q, 0.0f );
+		q = std::min( q, 65535.0f );
+		m_samples[ i ] = (unsigned short)q;
+	}
+
+	BuildPyramid();
+}
+
+/*
+====================================================
+ShapeHeightfield::BuildPyramid
+====================================================
+*/
+void ShapeHeightfield::BuildPyramid() {
+	// Level zero holds the range of each cell's four corners
+	mipLevel_t & base = m_levels[ 0 ];
+	for ( int y = 0; y < base.numY; y++ ) {
+		for ( int x = 0; x < base.numX; x++ ) {
+			const unsigned short s00 = m_samples[ y * m_numX + x ];
+			const unsigned short s10 = m_samples[ y * m_numX + x + 1 ];
+			const unsigned short s01 = m_samples[ ( y + 1 ) * m_numX + x ];
+			const unsigned short s11 = m_samples[ ( y + 1 ) * m_numX + x + 1 ];
+
+			heightRange_t & range = base.ranges[ y * base.numX + x ];
+			range.min = std::min( std::min( s00, s10 ), std::min( s01, s11 ) );
+			range.max = std::max( std::max( s00, s10 ), std::max( s01, s11 ) );
+		}
+	}
+
+	// Every other level holds the range of the two by two blocks below it
+	for ( int l = 1; l < m_levels.size(); l++ ) {
+		const mipLevel_t & below = m_levels[ l - 1 ];
+		mipLevel_t & level = m_levels[ l ];
+		for ( int y = 0; y < level.numY; y++ ) {
+			for ( int x = 0; x < level.numX; x++ ) {
+				heightRange_t range;
+				range.min = 65535;
+				range.max = 0;
+				for ( int cy = y * 2; cy < std::min( y * 2 + 2, below.numY ); cy++ ) {
+					for ( int cx = x * 2; cx < std::min( x * 2 + 2, below.numX ); cx++ ) {
+						const heightRange_t & child = below.ranges[ cy * below.numX + cx ];
+						range.min = std::min( range.min, child.min );
+						range.max = std::max( range.max, child.max );
+					}
+				}
+				level.ranges[ y * level.numX + x ] = range;
+			}
+		}
+	}
+
+	const heightRange_t & top = m_levels.back().ranges[ 0 ];
+	m_bounds.mins = Vec3( 0.0f, 0.0f, m_heightMin + m_heightScale * top.min );
+	m_bounds.maxs = Vec3( ( m_numX - 1 ) * m_spacingX, ( m_numY - 1 ) * m_spacingY, m_heightMin + m_heightScale * top.max );
+}
+
+/*
+====================================================
+ShapeHeightfield::QueryCells
+====================================================
+*/
+void ShapeHeightfield::QueryCells( const Bounds & localBounds, std::vector< int > & cells ) const {
+	if ( !m_bounds.DoesIntersect( localBounds ) ) {
+		return;
+	}
+
+	// Widen the height range to whole quantization steps, so the culling stays conservative
+	unsigned short qMin = 0;
+	unsigned short qMax = 65535;
+	if ( m_heightScale > 0.0f ) {
+		const float lo = floorf( ( localBounds.mins.z - m_heightMin ) / m_heightScale );
+		const float hi = ceilf( ( localBounds.maxs.z - m_heightMin ) / m_heightScale );
+		qMin = (unsigned short)std::min( std::max( lo, 0.0f ), 65535.0f );
+		qMax = (unsigned short)std::min( std::max( hi, 0.0f ), 65535.0f );
+	}
+
+	QueryCells_r( (int)m_levels.size() - 1, 0, 0, localBounds, qMin, qMax, cells );
+}
+
+/*
+====================================================
+ShapeHeightfield::QueryCells_r
+====================================================
+*/
+void ShapeHeightfield::QueryCells_r( const int level, const int bx, const int by, const Bounds & localBounds, const unsigned short qMin, const unsigned short qMax, std::vector< int > & cells ) const {
+	const mipLevel_t & mip = m_levels[ level ];
+	const heightRange_t & range = mip.ranges[ by * mip.numX + bx ];
+	if ( range.max < qMin || range.min > qMax ) {
+		return;
+	}
+
+	const int size = 1 << level;
+	const int cellsX = m_numX - 1;
+	const int cellsY = m_numY - 1;
+	const float x0 = bx * size * m_spacingX;
+	const float y0 = by * size * m_spacingY;
+	const float x1 = std::min( ( bx + 1 ) * size, cellsX ) * m_spacingX;
+	const float y1 = std::min( ( by + 1 ) * size, cellsY ) * m_spacingY;
+	if ( x1 < localBounds.mins.x || x0 > localBounds.maxs.x || y1 < localBounds.mins.y || y0 > localBounds.maxs.y ) {
+		return;
+	}
+
+	if ( 0 == level ) {
+		cells.push_back( by * cellsX + bx );
+		return;
+	}
+
+	const mipLevel_t & below = m_levels[ level - 1 ];
+	for ( int cy = by * 2; cy < std::min( by * 2 + 2, below.numY ); cy++ ) {
+		for ( int cx = bx * 2; cx < std::min( bx * 2 + 2, below.numX ); cx++ ) {
+			QueryCells_r( level - 1, cx, cy, localBounds, qMin, qMax, cells );
+		}
+	}
+}
+
+/*
+====================================================
+ShapeHeightfield::GetCellTriangles
+====================================================
+*/
+void ShapeHeightfield::GetCellTriangles( const int cell, Vec3 * triangles ) const {
+	const int cx = cell % ( m_numX - 1 );
+	const int cy = cell / ( m_numX - 1 );
+
+	const Vec3 a = GetVertex( cx, cy );
+	const Vec3 b = GetVertex( cx + 1, cy );
+	const Vec3 c = GetVertex( cx, cy + 1 );
+	const Vec3 d = GetVertex( cx + 1, cy + 1 );
+
+	// Both wind counter clockwise seen from above
+	triangles[ 0 ] = a;
+	triangles[ 1 ] = b;
+	triangles[ 2 ] = d;
+
+	triangles[ 3 ] = a;
+	triangles[ 4 ] = d;
+	triangles[ 5 ] = c;
+}
+
+/*
+====================================================
+ShapeHeightfield::RayCastCell
+====================================================
+*/
+bool ShapeHeightfield::RayCastCell( const int cx, const int cy, const Vec3 & start, const Vec3 & dir, const float minT, const float maxT, float & t, Vec3 & normal ) const {
+	Vec3 tris[ 6 ];
+	GetCellTriangles( cy * ( m_numX - 1 ) + cx, tris );
+
+	bool didHit = false;
+	float bestT = maxT;
+	for ( int i = 0; i < 2; i++ ) {
+		const Vec3 & a = tris[ i * 3 + 0 ];
+		const Vec3 & b = tris[ i * 3 + 1 ];
+		const Vec3 & c = tris[ i * 3 + 2 ];
+
+		float hitT;
+		Vec3 hitNormal;
+		if ( RayCastTriangle( start, dir, a, b, c, minT, bestT, hitT, hitNormal ) ) {
+			bestT = hitT;
+			normal = hitNormal;
+			didHit = true;
+		}
+	}
+
+	if ( didHit ) {
+		t = bestT;
+	}
+	return didHit;
+}
+
+/*
+====================================================
+ShapeHeightfield::RayCast
+
+Walks the pyramid like a DDA.  A block the ray passes over or under is skipped in one step and
+the walk climbs back up a level, a block the ray might touch is split into the level below it,
+and only cells at the bottom have their triangles tested.
+====================================================
+*/
+bool ShapeHeightfield::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	// Clip the ray to the bounds
+	float tMin = 0.0f;
+	float tMax = maxT;
+	for ( int axis = 0; axis < 3; axis++ ) {
+		if ( fabsf( dir[ axis ] ) < 1e-12f ) {
+			if ( start[ axis ] < m_bounds.mins[ axis ] || start[ axis ] > m_bounds.maxs[ axis ] ) {
+				return false;
+			}
+			continue;
+		}
+
+		float t0 = ( m_bounds.mins[ axis ] - start[ axis ] ) / dir[ axis ];
+		float t1 = ( m_bounds.maxs[ axis ] - start[ axis ] ) / dir[ axis ];
+		if ( t0 > t1 ) {
+			std::swap( t0, t1 );
+		}
+		tMin = std::max( tMin, t0 );
+		tMax = std::min( tMax, t1 );
+		if ( tMin > tMax ) {
+			return false;
+		}
+	}
+
+	// Blocks are found from a point just past the current time, so the walk never sticks on a block edge
+	const float lengthXY = sqrtf( dir.x * dir.x + dir.y * dir.y );
+	const float tNudge = ( lengthXY > 0.0f ) ? ( 1e-4f * std::min( m_spacingX, m_spacingY ) / lengthXY ) : 0.0f;
+
+	const int cellsX = m_numX - 1;
+	const int cellsY = m_numY - 1;
+	const int top = (int)m_levels.size() - 1;
+	int level = top;
+	float tCur = tMin;
+
+	while ( tCur <= tMax ) {
+		const mipLevel_t & mip = m_levels[ level ];
+		const int size = 1 << level;
+
+		const Vec3 pt = start + dir * ( tCur + tNudge );
+		int bx = (int)floorf( pt.x / ( m_spacingX * size ) );
+		int by = (int)floorf( pt.y / ( m_spacingY * size ) );
+		bx = std::min( std::max( bx, 0 ), mip.numX - 1 );
+		by = std::min( std::max( by, 0 ), mip.numY - 1 );
+
+		// When the ray leaves this block
+		const float x0 = bx * size * m_spacingX;
+		const float y0 = by * size * m_spacingY;
+		const float x1 = std::min( ( bx + 1 ) * size, cellsX ) * m_spacingX;
+		const float y1 = std::min( ( by + 1 ) * size, cellsY ) * m_spacingY;
+		float tExit = tMax;
+		if ( dir.x > 0.0f ) {
+			tExit = std::min( tExit, ( x1 - start.x ) / dir.x );
+		} else if ( dir.x < 0.0f ) {
+			tExit = std::min( tExit, ( x0 - start.x ) / dir.x );
+		}
+		if ( dir.y > 0.0f ) {
+			tExit = std::min( tExit, ( y1 - start.y ) / dir.y );
+		} else if ( dir.y < 0.0f ) {
+			tExit = std::min( tExit, ( y0 - start.y ) / dir.y );
+		}
+		tExit = std::max( tExit, std::min( tCur + tNudge, tMax ) );
+
+		const heightRange_t & range = mip.ranges[ by * mip.numX + bx ];
+		const float rangeMin = m_heightMin + m_heightScale * range.min;
+		const float rangeMax = m_heightMin + m_heightScale * range.max;
+		const float zA = start.z + dir.z * tCur;
+		const float zB = start.z + dir.z * tExit;
+		const bool isOutside = ( std::max( zA, zB ) < rangeMin || std::min( zA, zB ) > rangeMax );
+
+		if ( !isOutside && level > 0 ) {
+			level--;
+			continue;
+		}
+
+		if ( !isOutside && RayCastCell( bx, by, start, dir, tCur - tNudge, tExit + tNudge, t, normal ) ) {
+			return true;
+		}
+
+		if ( tExit >= tMax ) {
+			break;
+		}
+		tCur = tExit;
+		level = std::min( level + 1, top );
+	}
+
+	return false;
+}
+
+/*
+====================================================
+ShapeHeightfield::Support
+
+The narrowphase works on cell triangles, this is only here to complete the interface
+====================================================
+*/
+Vec3 ShapeHeightfield::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	Vec3 maxPt;
+	float maxDist = -1e6f;
+	for ( int i = 0; i < 8; i++ ) {
+		Vec3 corner;
+		corner.x = ( i & 1 ) ? m_bounds.maxs.x : m_bounds.mins.x;
+		corner.y = ( i & 2 ) ? m_bounds.maxs.y : m_bounds.mins.y;
+		corner.z = ( i & 4 ) ? m_bounds.maxs.z : m_bounds.mins.z;
+
+		const Vec3 pt = orient.RotatePoint( corner ) + pos;
+		const float dist = dir.Dot( pt );
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			maxPt = pt;
+		}
+	}
+
+	Vec3 norm = dir;
+	norm.Normalize();
+	norm *= bias;
+
+	return maxPt + norm;
+}
+
+/*
+====================================================
+ShapeHeightfield::InertiaTensor
+
+Heightfields are static, so this is never inverted for anything that matters
+====================================================
+*/
+Mat3 ShapeHeightfield::InertiaTensor() const {
+	Mat3 tensor;
+	tensor.Identity();
+	return tensor;
+}
+
+/*
+====================================================
+ShapeHeightfield::GetBounds
+====================================================
+*/
+Bounds ShapeHeightfield::GetBounds( const Vec3 & pos, const Quat & orient ) const {
+	Bounds bounds;
+	for ( int i = 0; i < 8; i++ ) {
+		Vec3 corner;
+		corner.x = ( i & 1 ) ? m_bounds.maxs.x : m_bounds.mins.x;
+		corner.y = ( i & 2 ) ? m_bounds.maxs.y : m_bounds.mins.y;
+		corner.z = ( i & 4 ) ? m_bounds.maxs.z : m_bounds.mins.z;
+		bounds.Expand( orient.RotatePoint( corner ) + pos );
+	}
+	return bounds;
+}
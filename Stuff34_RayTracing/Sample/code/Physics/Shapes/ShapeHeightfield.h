@@ -0,0 +1,71 @@
+//
+//	ShapeHeightfield.h
+//
+#pragma once
+#include "Physics/Shapes/ShapeBase.h"
+
+/*
+====================================================
+ShapeHeightfield
+
+A regular grid of heights for terrain and water.  Samples are quantized to 16 bits between
+the lowest and highest height, and a pyramid of min/max blocks over the cells lets queries
+skip whole regions.  The grid starts at the model space origin and runs along +x and +y,
+with heights along +z.  Each cell is split into two triangles when it is queried.
+Heightfields are static, so they only work on bodies with zero inverse mass.
+====================================================
+*/
+class ShapeHeightfield : public Shape {
+public:
+	explicit ShapeHeightfield( const float * heights, const int numX, const int numY, const float spacingX, const float spacingY ) {
+		Build( heights, numX, numY, spacingX, spacingY );
+	}
+	void Build( const float * heights, const int numX, const int numY, const float spacingX, const float spacingY );
+
+	// Re-quantizes new heights into the range picked at build time, for surfaces like water that move every frame
+	void UpdateHeights( const float * heights );
+
+	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+
+	Mat3 InertiaTensor() const override;
+
+	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
+	Bounds GetBounds() const override { return m_bounds; }
+
+	shapeType_t GetType() const override { return SHAPE_HEIGHTFIELD; }
+
+	float GetHeight( const int x, const int y ) const { return m_heightMin + m_heightScale * m_samples[ y * m_numX + x ]; }
+	Vec3 GetVertex( const int x, const int y ) const { return Vec3( x * m_spacingX, y * m_spacingY, GetHeight( x, y ) ); }
+
+	// Appends the index of every cell whose height range overlaps the model space bounds
+	void QueryCells( const Bounds & localBounds, std::vector< int > & cells ) const;
+	void GetCellTriangles( const int cell, Vec3 * triangles ) const;	// writes two triangles, six vertices
+
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
+private:
+	struct heightRange_t {
+		unsigned short min;
+		unsigned short max;
+	};
+	struct mipLevel_t {
+		int numX;	// blocks along x, each covers 1 << level cells
+		int numY;
+		std::vector< heightRange_t > ranges;
+	};
+
+	void BuildPyramid();
+	void QueryCells_r( const int level, const int bx, const int by, const Bounds & localBounds, const unsigned short qMin, const unsigned short qMax, std::vector< int > & cells ) const;
+	bool RayCastCell( const int cx, const int cy, const Vec3 & start, const Vec3 & dir, const float minT, const float maxT, float & t, Vec3 & normal ) const;
+
+public:
+	int m_numX;		// samples along x, there is one less cell
+	int m_numY;
+	float m_spacingX;
+	float m_spacingY;
+	float m_heightMin;
+	float m_heightScale;
+	std::vector< unsigned short > m_samples;
+	std::vector< mipLevel_t > m_levels;	// level zero is one block per cell, the last level is a single block
+	Bounds m_bounds;
+};
@@ -0,0 +1,404 @@
+//
+//  ShapeMesh.cpp
+//
+#include "Physics/Shapes/ShapeMesh.h"
+
+/*
+========================================================================================================
+
+ShapeMesh
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ShapeMesh::Build
+
+A mesh without vertices is rejected and left empty.  Triangles with an index outside the
+vertices are dropped.
+====================================================
+*/
+void ShapeMesh::Build( const Vec3 * verts, const int numVerts, const int * indices, const int numIndices ) {
+	m_verts.clear();
+	m_triangles.clear();
+	m_nodes.clear();
+	m_leafTriangles.clear();
+	m_leafTriangleIdx.clear();
+	m_bounds.Clear();
+	m_centerOfMass.Zero();
+
+	if ( numVerts <= 0 ) {
+		printf( "WARNING: ShapeMesh: no vertices\n" );
+		return;
+	}
+
+	m_verts.resize( numVerts );
+	for ( int i = 0; i < numVerts; i++ ) {
+		m_verts[ i ] = verts[ i ];
+		m_bounds.Expand( verts[ i ] );
+	}
+	m_centerOfMass = m_bounds.Center();
+
+	std::vector< int > validIndices;
+	validIndices.reserve( numIndices );
+	for ( int i = 0; i + 2 < numIndices; i += 3 ) {
+		bool isValid = true;
+		for ( int v = 0; v < 3; v++ ) {
+			if ( indices[ i + v ] < 0 || indices[ i + v ] >= numVerts ) {
+				isValid = false;
+			}
+		}
+		if ( isValid ) {
+			validIndices.insert( validIndices.end(), indices + i, indices + i + 3 );
+		}
+	}
+	if ( validIndices.size() != ( numIndices / 3 ) * 3 ) {
+		printf( "WARNING: ShapeMesh: dropped %i triangles that index outside the %i vertices\n", numIndices / 3 - (int)validIndices.size() / 3, numVerts );
+	}
+	indices = validIndices.data();
+
+	const int numTris = (int)validIndices.size() / 3;
+	if ( 0 == numTris ) {
+		printf( "WARNING: ShapeMesh: no triangles\n" );
+		return;
+	}
+
+	std::vector< Bounds > triBounds( numTris );
+	for ( int i = 0; i < numTris; i++ ) {
+		for ( int v = 0; v < 3; v++ ) {
+			triBounds[ i ].Expand( verts[ indices[ i * 3 + v ] ] );
+		}
+	}
+
+	std::vector< int > order;
+	BuildBoundsTree( triBounds.data(), numTris, MAX_LEAF_TRIANGLES, m_nodes, order );
+
+	// Store the triangles in leaf order, so each leaf owns a contiguous range
+	m_triangles.resize( numTris );
+	for ( int i = 0; i < numTris; i++ ) {
+		const int src = order[ i ];
+		m_triangles[ i ].a = indices[ src * 3 + 0 ];
+		m_triangles[ i ].b = indices[ src * 3 + 1 ];
+		m_triangles[ i ].c = indices[ src * 3 + 2 ];
+	}
+
+	// A leaf holds at most four triangles, so one packed test covers a whole leaf
+	assert( MAX_LEAF_TRIANGLES <= 4 );
+	m_leafTriangleIdx.resize( numTris, -1 );
+	for ( int i = 0; i < m_nodes.size(); i++ ) {
+		const boundsTreeNode_t & node = m_nodes[ i ];
+		if ( node.count <= 0 ) {
+			continue;
+		}
+
+		triangle4_t tris;
+		memset( &tris, 0, sizeof( tris ) );
+		for ( int lane = 0; lane < node.count; lane++ ) {
+			Vec3 a;
+			Vec3 b;
+			Vec3 c;
+			GetTriangle( node.first + lane, a, b, c );
+			SetTriangle4( tris, lane, a, b, c );
+		}
+
+		m_leafTriangleIdx[ node.first ] = (int)m_leafTriangles.size();
+		m_leafTriangles.push_back( tris );
+	}
+}
+
+/*
+====================================================
+ShapeMesh::QueryTriangles
+====================================================
+*/
+void ShapeMesh::QueryTriangles( const Bounds & localBounds, std::vector< int > & triangles ) const {
+	QueryBoundsTree( m_nodes, localBounds, triangles );
+}
+
+/*
+====================================================
+ShapeMesh::QueryTriangles
+
+Same as above, for world space bounds when the mesh is placed at pos and orient
+====================================================
+*/
+void ShapeMesh::QueryTriangles( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient, std::vector< int > & triangles ) const {
+	QueryTriangles( WorldBoundsToModelSpace( worldBounds, pos, orient ), triangles );
+}
+
+/*
+====================================================
+ShapeMesh::GetTriangle
+====================================================
+*/
+void ShapeMesh::GetTriangle( const int idx, Vec3 & a, Vec3 & b, Vec3 & c ) const {
+	const tri_t & tri = m_triangles[ idx ];
+	a = m_verts[ tri.a ];
+	b = m_verts[ tri.b ];
+	c = m_verts[ tri.c ];
+}
+
+/*
+====================================================
+ShapeMesh::Support
+
+The narrowphase works on single triangles, this is only here to complete the interface
+====================================================
+*/
+Vec3 ShapeMesh::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	if ( m_verts.empty() ) {
+		return pos;
+	}
+
+	Vec3 maxPt = orient.RotatePoint( m_verts[ 0 ] ) + pos;
+	float maxDist = dir.Dot( maxPt );
+	for ( int i = 1; i < m_verts.size(); i++ ) {
+		const Vec3 pt = orient.RotatePoint( m_verts[ i ] ) + pos;
+		const float dist = dir.Dot( pt );
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			maxPt = pt;
+		}
+	}
+
+	Vec3 norm = dir;
+	norm.Normalize();
+	norm *= bias;
+
+	return maxPt + norm;
+}
+
+/*
+====================================================
+ShapeMesh::InertiaTensor
+
+Meshes are static, so this is never inverted for anything that matters
+====================================================
+*/
+Mat3 ShapeMesh::InertiaTensor() const {
+	Mat3 tensor;
+	tensor.Identity();
+	return tensor;
+}
+
+/*
+====================================================
+ShapeMesh::GetBounds
+====================================================
+*/
+Bounds ShapeMesh::GetBounds( const Vec3 & pos, const Quat & orient ) const {
+	Vec3 corners[ 8 ];
+	corners[ 0 ] = Vec3( m_bounds.mins.x, m_bounds.mins.y, m_bounds.mins.z );
+	corners[ 1 ] = Vec3( m_bounds.mins.x, m_bounds.mins.y, m_bounds.maxs.z );
+	corners[ 2 ] = Vec3( m_bounds.mins.x, m_bounds.maxs.y, m_bounds.mins.z );
+	corners[ 3 ] = Vec3( m_bounds.maxs.x, m_bounds.mins.y, m_bounds.mins.z );
+
+	corners[ 4 ] = Vec3( m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.maxs.z );
+	corners[ 5 ] = Vec3( m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z );
+	corners[ 6 ] = Vec3( m_bounds.maxs.x, m_bounds.mins.y, m_bounds.maxs.z );
+	corners[ 7 ] = Vec3( m_bounds.mins.x, m_bounds.maxs.y, m_bounds.maxs.z );
+
+	Bounds bounds;
+	for ( int i = 0; i < 8; i++ ) {
+		bounds.Expand( orient.RotatePoint( corners[ i ] ) + pos );
+	}
+	return bounds;
+}
+
+/*
+====================================================
+meshRayCast_t
+====================================================
+*/
+struct meshRayCast_t {
+	const ShapeMesh * mesh;
+	Vec3 start;
+	Vec3 dir;
+	bool didHit;
+	float t;
+	Vec3 normal;
+};
+
+/*
+====================================================
+LeafTriangleNormal
+====================================================
+*/
+static Vec3 LeafTriangleNormal( const triangle4_t & tris, const int lane ) {
+	const Vec3 edge1( tris.edge1[ 0 ][ lane ], tris.edge1[ 1 ][ lane ], tris.edge1[ 2 ][ lane ] );
+	const Vec3 edge2( tris.edge2[ 0 ][ lane ], tris.edge2[ 1 ][ lane ], tris.edge2[ 2 ][ lane ] );
+	Vec3 normal = edge1.Cross( edge2 );
+	normal.Normalize();
+	return normal;
+}
+
+/*
+====================================================
+RayCastMeshLeaf
+====================================================
+*/
+static float RayCastMeshLeaf( const int first, const int count, const float maxT, void * data ) {
+	meshRayCast_t * ray = (meshRayCast_t *)data;
+	const triangle4_t & tris = ray->mesh->m_leafTriangles[ ray->mesh->m_leafTriangleIdx[ first ] ];
+
+	float t;
+	const int lane = RayTriangleIntersectionTest4( ray->start, ray->dir, tris, 0.0f, maxT, t );
+	if ( lane < 0 ) {
+		return maxT;
+	}
+
+	ray->didHit = true;
+	ray->t = t;
+	ray->normal = LeafTriangleNormal( tris, lane );
+	return t;
+}
+
+/*
+====================================================
+ShapeMesh::RayCast
+====================================================
+*/
+bool ShapeMesh::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	meshRayCast_t ray;
+	ray.mesh = this;
+	ray.start = start;
+	ray.dir = dir;
+	ray.didHit = false;
+	ray.t = maxT;
+
+	RayCastBoundsTree( m_nodes, start, dir, maxT, RayCastMeshLeaf, &ray );
+	if ( ray.didHit ) {
+		t = ray.t;
+		normal = ray.normal;
+	}
+	return ray.didHit;
+}
+
+/*
+====================================================
+meshPacketRayCast_t
+====================================================
+*/
+struct meshPacketRayCast_t {
+	const ShapeMesh * mesh;
+	Vec3 * normals;
+	int hitMask;
+};
+
+/*
+====================================================
+RayCastMeshLeafPacket
+====================================================
+*/
+static void RayCastMeshLeafPacket( const int first, const int count, rayPacket_t & packet, const int laneMask, void * data ) {
+	meshPacketRayCast_t * ray = (meshPacketRayCast_t *)data;
+	const triangle4_t & tris = ray->mesh->m_leafTriangles[ ray->mesh->m_leafTriangleIdx[ first ] ];
+
+	for ( int i = 0; i < 4; i++ ) {
+		if ( 0 == ( laneMask & ( 1 << i ) ) ) {
+			continue;
+		}
+
+		float t;
+		const int lane = RayTriangleIntersectionTest4( packet.start[ i ], packet.dir[ i ], tris, 0.0f, packet.maxT[ i ], t );
+		if ( lane < 0 ) {
+			continue;
+		}
+
+		packet.maxT[ i ] = t;
+		ray->normals[ i ] = LeafTriangleNormal( tris, lane );
+		ray->hitMask |= ( 1 << i );
+	}
+}
+
+/*
+====================================================
+ShapeMesh::RayCastPacket
+====================================================
+*/
+int ShapeMesh::RayCastPacket( rayPacket_t & packet, Vec3 * normals ) const {
+	meshPacketRayCast_t ray;
+	ray.mesh = this;
+	ray.normals = normals;
+	ray.hitMask = 0;
+
+	RayCastBoundsTreePacket( m_nodes, packet, RayCastMeshLeafPacket, &ray );
+	return ray.hitMask;
+}
+
+/*
+========================================================================================================
+
+ShapeTriangle
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ShapeTriangle::Support
+====================================================
+*/
+Vec3 ShapeTriangle::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	Vec3 maxPt = orient.RotatePoint( m_points[ 0 ] ) + pos;
+	float maxDist = dir.Dot( maxPt );
+	for ( int i = 1; i < 3; i++ ) {
+		const Vec3 pt = orient.RotatePoint( m_points[ i ] ) + pos;
+		const float dist = dir.Dot( pt );
+		if ( dist > maxDist ) {
+			maxDist = dist;
+			maxPt = pt;
+		}
+	}
+
+	Vec3 norm = dir;
+	norm.Normalize();
+	norm *= bias;
+
+	return maxPt + norm;
+}
+
+/*
+====================================================
+ShapeTriangle::InertiaTensor
+====================================================
+*/
+Mat3 ShapeTriangle::InertiaTensor() const {
+	Mat3 tensor;
+	tensor.Identity();
+	return tensor;
+}
+
+/*
+====================================================
+ShapeTriangle::GetBounds
+====================================================
+*/
+Bounds ShapeTriangle::GetBounds( const Vec3 & pos, const Quat & orient ) const {
+	Bounds bounds;
+	for ( int i = 0; i < 3; i++ ) {
+		bounds.Expand( orient.RotatePoint( m_points[ i ] ) + pos );
+	}
+	return bounds;
+}
+
+/*
+====================================================
+ShapeTriangle::GetBounds
+====================================================
+*/
+Bounds ShapeTriangle::GetBounds() const {
+	Bounds bounds;
+	bounds.Expand( m_points, 3 );
+	return bounds;
+}
+
+/*
+====================================================
+ShapeTriangle::RayCast
+====================================================
+*/
+bool ShapeTriangle::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	return RayCastTriangle( start, dir, m_points[ 0 ], m_points[ 1 ], m_points[ 2 ], 0.0f, maxT, t, normal );
+}
@@ -0,0 +1,86 @@
+//
+//	ShapeMesh.h
+//
+#pragma once
+#include "Physics/Shapes/ShapeBase.h"
+#include "Physics/Shapes/BoundsTree.h"
+#include "Models/ModelStatic.h"
+#include "Math/IntersectionTests.h"
+
+/*
+====================================================
+ShapeMesh
+
+A triangle soup for static level geometry.  The triangles are kept in a bounding volume
+hierarchy so the narrowphase only visits the ones near the other body.  Meshes have no volume,
+so they only work on bodies with zero inverse mass.
+====================================================
+*/
+class ShapeMesh : public Shape {
+public:
+	explicit ShapeMesh( const Vec3 * verts, const int numVerts, const int * indices, const int numIndices ) {
+		Build( verts, numVerts, indices, numIndices );
+	}
+	void Build( const Vec3 * verts, const int numVerts, const int * indices, const int numIndices );
+
+	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+
+	Mat3 InertiaTensor() const override;
+
+	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
+	Bounds GetBounds() const override { return m_bounds; }
+
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+	int RayCastPacket( rayPacket_t & packet, Vec3 * normals ) const override;
+
+	shapeType_t GetType() const override { return SHAPE_MESH; }
+
+	// Appends the triangles whose bounds overlap the model space bounds
+	void QueryTriangles( const Bounds & localBounds, std::vector< int > & triangles ) const;
+	void QueryTriangles( const Bounds & worldBounds, const Vec3 & pos, const Quat & orient, std::vector< int > & triangles ) const;
+	void GetTriangle( const int idx, Vec3 & a, Vec3 & b, Vec3 & c ) const;
+
+	static const int MAX_LEAF_TRIANGLES = 4;
+
+public:
+	std::vector< Vec3 > m_verts;
+	std::vector< tri_t > m_triangles;	// sorted so each leaf's triangles are contiguous
+	std::vector< boundsTreeNode_t > m_nodes;
+	std::vector< triangle4_t > m_leafTriangles;	// each leaf's triangles packed for the four wide ray test
+	std::vector< int > m_leafTriangleIdx;		// the packed triangles of the leaf that starts at a triangle, -1 elsewhere
+	Bounds m_bounds;
+};
+
+/*
+====================================================
+ShapeTriangle
+
+A single mesh triangle, in the mesh's model space, standing in as a convex shape so the GJK
+kernels can collide against it.  It shares the mesh's center of mass so contact points come
+out in the mesh body's space.
+====================================================
+*/
+class ShapeTriangle : public Shape {
+public:
+	ShapeTriangle() {}
+	ShapeTriangle( const Vec3 & a, const Vec3 & b, const Vec3 & c, const Vec3 & centerOfMass ) {
+		m_points[ 0 ] = a;
+		m_points[ 1 ] = b;
+		m_points[ 2 ] = c;
+		m_centerOfMass = centerOfMass;
+	}
+
+	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+
+	Mat3 InertiaTensor() const override;
+
+	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
+	Bounds GetBounds() const override;
+
+	bool RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const override;
+
+	shapeType_t GetType() const override { return SHAPE_CONVEX; }
+
+public:
+	Vec3 m_points[ 3 ];
+};
@@ -56,4 +56,13 @@ Bounds ShapeSphere::GetBounds() const {
 	tmp.mins = Vec3( -m_radius );
 	tmp.maxs = Vec3( m_radius );
 	return tmp;
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+ShapeSphere::RayCast
+====================================================
+*/
+bool ShapeSphere::RayCast( const Vec3 & start, const Vec3 & dir, const float maxT, float & t, Vec3 & normal ) const {
+	return RayCastSphere( start, dir, Vec3( 0.0f ), m_radius, maxT, t, normal );
+}
@@ -9,6 +9,8 @@
 
 #include <algorithm>
 
+//#define BENCHMARK_MAP_RAYCASTS	// uncomment to print the ray cast throughput against the map on startup
+
 Player * g_player;
 
 /*
@@ -50,6 +52,10 @@ void SceneGame::Initialize( DeviceContext * device ) {
 	AddPlayerBody();
 
 	LoadMap( device );
+
+#if defined( BENCHMARK_MAP_RAYCASTS )
+	BenchmarkMapRayCasts();
+#endif
 }
 
 /*
@@ -59,7 +65,7 @@ SceneGame::Update
 */
 void SceneGame::Update( const float dt_sec ) {
 	m_playerEntity.Update( dt_sec );
-	m_physicsWorld.StepSimulation( dt_sec );
+	m_physicsWorld.Update( dt_sec );
 }
 
 /*
@@ -92,10 +92,12 @@ void Application::Initialize() {
 	//
 	//	Add brushes
 	//
-	std::vector< Vec3 > pts;
+	std::vector< std::vector< Vec3 > > brushPts( g_brushes.size() );
+	std::vector< convexCook_t > cooks;
+	cooks.reserve( g_brushes.size() );
 	for ( int i = 0; i < g_brushes.size(); i++ ) {
 		const brush_t & brush = g_brushes[ i ];
-		pts.clear();
+		std::vector< Vec3 > & pts = brushPts[ i ];
 
 		for ( int w = 0; w < brush.numPlanes; w++ ) {
 			const winding_t & winding = brush.windings[ w ];
@@ -109,6 +111,17 @@ void Application::Initialize() {
 			continue;
 		}
 
+		convexCook_t cook;
+		cook.pts = pts.data();
+		cook.numPts = (int)pts.size();
+		cook.maxVerts = 0;
+		cook.useCache = true;
+		cook.shape = NULL;
+		cooks.push_back( cook );
+	}
+	CookConvexShapes( cooks.data(), (int)cooks.size() );
+
+	for ( int i = 0; i < cooks.size(); i++ ) {
 		Body body;
 		body.m_position = Vec3( 0, 0, 0 );
 		body.m_orientation = Quat( 0, 0, 0, 1 );
@@ -118,7 +131,7 @@ void Application::Initialize() {
 		body.m_elasticity = 1.0f;//0.5f;
 		body.m_enableRotation = false;
 		body.m_friction = 1.0f;//0.5f;
-		body.m_shape = new ShapeConvex( pts.data(), pts.size() );
+		body.m_shape = cooks[ i ].shape;
 
 		Vec3 cm = body.m_shape->GetCenterOfMass();
 		assert( cm.IsValid() );
@@ -711,7 +724,10 @@ void Application::UpdateUniforms() {
 				g_player->m_bodyid.body->m_position.z = 0;
 				g_player->m_bodyid.body->m_linearVelocity.z = 0;
 			}
-			camPos = g_player->m_bodyid.body->m_position + Vec3( 0, 0, 1 );
+			Vec3 playerPos;
+			Quat playerOrient;
+			g_physicsWorld->GetInterpolatedTransform( g_player->m_bodyid.id, playerPos, playerOrient );
+			camPos = playerPos + Vec3( 0, 0, 1 );
 
 			Vec3 lookDir;
 			lookDir.x = cosf( g_player->m_cameraPositionPhi ) * sinf( g_player->m_cameraPositionTheta );